@@ -12,9 +12,14 @@
 
 #include "Application.h"
 #include "CommandParsing.h"
+#include "Metropolis/GibbsSimulation.h"
+#include "Metropolis/TemperingSimulation.h"
 #include "Metropolis/Simulation.h"
 #include "Metropolis/SimulationArgs.h"
+#include "Metropolis/SerialSim/PairStatistics.h"
 #include "Metropolis/Utilities/DeviceQuery.h"
+#include "Metropolis/Utilities/ResultCache.h"
+#include "Metropolis/Utilities/StartupProfile.h"
 #include <iostream>
 #include <fstream>
 
@@ -22,14 +27,61 @@
 int metrosim::run(int argc, char** argv)
 {
 	SimulationArgs args = SimulationArgs();
-	if (!getCommands(argc, argv, &args))
 	{
-		exit(EXIT_FAILURE);
+		StartupPhase phase("Command-Line-Parse");
+		if (!getCommands(argc, argv, &args))
+		{
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (!args.reweightPath.empty())
+	{
+		exit(PairStatistics::reweight(args.reweightPath, args.reweightFrames) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	//a cached run is copied into place without opening a device
+	ResultCache cache = ResultCache(args.cacheDirectory);
+	bool caching = !args.cacheDirectory.empty();
+	if (caching && !cache.identify(args))
+	{
+		std::cerr << "Warning: Could not hash the inputs; the result cache is disabled" << std::endl;
+		caching = false;
+	}
+	long finalStep = cache.getStartStep() + cache.getSteps();
+	if (caching)
+	{
+		if (cache.restore(Simulation::resultsPath(args), Simulation::statePath(args, finalStep)))
+		{
+			fprintf(stdout, "Restored cached results of %ld steps from %s\n", cache.getSteps(),
+				args.cacheDirectory.c_str());
+			exit(EXIT_SUCCESS);
+		}
+
+		std::string checkpoint;
+		long cachedSteps = cache.findCheckpoint(checkpoint);
+		if (cachedSteps > 0)
+		{
+			//a resumed chain is cached apart from the fresh chain of the same length
+			cache.resumeFrom(cachedSteps);
+			if (cache.restore(Simulation::resultsPath(args), Simulation::statePath(args, finalStep)))
+			{
+				fprintf(stdout, "Restored cached results of %ld steps resumed after %ld steps from %s\n",
+					cache.getSteps(), cachedSteps, args.cacheDirectory.c_str());
+				exit(EXIT_SUCCESS);
+			}
+
+			fprintf(stdout, "Resuming from the cached checkpoint after %ld steps\n", cachedSteps);
+			args.filePath = checkpoint;
+			args.fileType = InputFile::State;
+			args.stepCount = cache.getSteps() - cachedSteps;
+		}
 	}
 
 	DeviceContext context = DeviceContext();
 	if (args.simulationMode == SimulationMode::Parallel)
 	{
+		StartupPhase phase("Device-Open");
 		if (!openDeviceContext(&context, MIN_MAJOR_VER, MIN_MINOR_VER, args.deviceIndex))
 		{
 			exit(EXIT_FAILURE);
@@ -54,8 +106,30 @@ int metrosim::run(int argc, char** argv)
 	}
 	
 
-	Simulation sim = Simulation(args);
-	sim.run();
+	if (args.gibbsInterval > 0)
+	{
+		GibbsSimulation sim(args);
+		sim.run();
+	}
+	else if (!args.soluteTemperatures.empty())
+	{
+		TemperingSimulation sim(args);
+		sim.run();
+	}
+	else
+	{
+		Simulation sim = Simulation(args);
+		sim.run();
+	}
+
+	if (caching)
+	{
+		std::string statePath = args.stateInterval >= 0 ? Simulation::statePath(args, finalStep) : "";
+		if (!cache.store(Simulation::resultsPath(args), statePath))
+		{
+			std::cerr << "Warning: Could not store the results in " << args.cacheDirectory << std::endl;
+		}
+	}
 	
 	if (args.silencedOutput) {
 		 std::cout.rdbuf(cout_sbuf); // restore the original stream buffer
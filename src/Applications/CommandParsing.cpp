@@ -8,6 +8,7 @@
 /// @date Updated 2/26/2014 -> further shoehorning done by Albert Wallace on 27 February
 
 
+#include <algorithm>
 #include <getopt.h>
 #include <iostream>
 #include <string>
@@ -20,6 +21,32 @@
 using std::string;
 
 #define LONG_NAME 400
+#define LONG_SHADOW 401
+#define LONG_SHADOW_INTERVAL 402
+#define LONG_SHADOW_TOLERANCE 403
+#define LONG_HARD_CORE 404
+#define LONG_OUTPUT_KINDS 405
+#define LONG_OUTPUT_SPHERE 406
+#define LONG_OUTPUT_CUBE 407
+#define LONG_OUTPUT_STRIDE 408
+#define LONG_SHARED_TOPOLOGY 409
+#define LONG_NEIGHBOR_SKIN 410
+#define LONG_MULTIPOLE_RADIUS 411
+#define LONG_MIXED_PRECISION 412
+#define LONG_GIBBS 413
+#define LONG_GIBBS_TRANSFERS 414
+#define LONG_NON_PERIODIC 415
+#define LONG_ADAPTIVE_RESOLUTION 416
+#define LONG_HYBRID_WIDTH 417
+#define LONG_CACHE 418
+#define LONG_RANDOM_BATCH_EWALD 419
+#define LONG_HOST_BATCH 420
+#define LONG_PAIR_STATISTICS 421
+#define LONG_REWEIGHT 422
+#define LONG_CUTOFF_SCAN 423
+#define LONG_SOLUTE_TEMPERING 424
+#define LONG_SOLUTE_KINDS 425
+#define LONG_EXCHANGE_INTERVAL 426
 
 
 	//bool metrosim::getCommands(int argc, char** argv, SimulationArgs* args) //RBAl
@@ -66,6 +93,32 @@ using std::string;
 			{"version",				no_argument,		0,	'V'},
 			{"silent",				no_argument,		0,	'k'},
 			{"name",				required_argument,	0,	LONG_NAME},
+			{"shadow",				required_argument,	0,	LONG_SHADOW},
+			{"shadow-interval",		required_argument,	0,	LONG_SHADOW_INTERVAL},
+			{"shadow-tolerance",	required_argument,	0,	LONG_SHADOW_TOLERANCE},
+			{"hard-core",			required_argument,	0,	LONG_HARD_CORE},
+			{"output-kinds",		required_argument,	0,	LONG_OUTPUT_KINDS},
+			{"output-sphere",		required_argument,	0,	LONG_OUTPUT_SPHERE},
+			{"output-cube",			required_argument,	0,	LONG_OUTPUT_CUBE},
+			{"output-stride",		required_argument,	0,	LONG_OUTPUT_STRIDE},
+			{"shared-topology",		no_argument,		0,	LONG_SHARED_TOPOLOGY},
+			{"neighbor-skin",		required_argument,	0,	LONG_NEIGHBOR_SKIN},
+			{"multipole-radius",	required_argument,	0,	LONG_MULTIPOLE_RADIUS},
+			{"mixed-precision",		no_argument,		0,	LONG_MIXED_PRECISION},
+			{"gibbs",				required_argument,	0,	LONG_GIBBS},
+			{"gibbs-transfers",		required_argument,	0,	LONG_GIBBS_TRANSFERS},
+			{"solute-tempering",	required_argument,	0,	LONG_SOLUTE_TEMPERING},
+			{"solute-kinds",		required_argument,	0,	LONG_SOLUTE_KINDS},
+			{"exchange-interval",	required_argument,	0,	LONG_EXCHANGE_INTERVAL},
+			{"non-periodic",		no_argument,		0,	LONG_NON_PERIODIC},
+			{"adaptive-resolution",	required_argument,	0,	LONG_ADAPTIVE_RESOLUTION},
+			{"hybrid-width",		required_argument,	0,	LONG_HYBRID_WIDTH},
+			{"cache",				required_argument,	0,	LONG_CACHE},
+			{"random-batch-ewald",	required_argument,	0,	LONG_RANDOM_BATCH_EWALD},
+			{"host-batch",			no_argument,		0,	LONG_HOST_BATCH},
+			{"pair-statistics",		no_argument,		0,	LONG_PAIR_STATISTICS},
+			{"reweight",			required_argument,	0,	LONG_REWEIGHT},
+			{"cutoff-scan",			required_argument,	0,	LONG_CUTOFF_SCAN},
 			{0, 0, 0, 0} 
 		};
 
@@ -92,6 +145,245 @@ using std::string;
 						return false;
 					}
 					break;
+				case LONG_SHADOW:
+					params->shadowFlag = true;
+					if (!fromString<string>(optarg, params->shadowEngine))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --shadow: Invalid shadow engine" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_SHADOW_INTERVAL:
+					if (!fromString<int>(optarg, params->shadowInterval))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --shadow-interval: Invalid shadow interval" << std::endl;
+						return false;
+					}
+					if (params->shadowInterval <= 0)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --shadow-interval: Shadow interval must be greater than zero" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_SHADOW_TOLERANCE:
+					if (!fromString<double>(optarg, params->shadowTolerance))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --shadow-tolerance: Invalid shadow tolerance" << std::endl;
+						return false;
+					}
+					if (params->shadowTolerance < 0)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --shadow-tolerance: Shadow tolerance must be non-negative" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_HARD_CORE:
+					if (!fromString<double>(optarg, params->hardCoreFraction))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --hard-core: Invalid hard-core fraction" << std::endl;
+						return false;
+					}
+					if (params->hardCoreFraction < 0 || params->hardCoreFraction >= 1)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --hard-core: Hard-core fraction must be at least 0 and less than 1" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_OUTPUT_KINDS:
+					if (!parseKindList(optarg, params->outputKinds))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --output-kinds: Invalid list of molecule kinds" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_OUTPUT_SPHERE:
+				case LONG_OUTPUT_CUBE:
+					if (params->outputRegionFlag)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " Only one output region may be specified" << std::endl;
+						return false;
+					}
+					params->outputRegionFlag = true;
+					params->outputRegionCube = getopt_ret == LONG_OUTPUT_CUBE;
+					if (!parseOutputRegion(optarg, params->outputRegionMolecule, params->outputRegionExtent))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --" << long_options[long_index].name;
+						std::cerr << ": Region must be <molecule>:<extent> with a positive extent" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_OUTPUT_STRIDE:
+					if (!fromString<int>(optarg, params->outputStride))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --output-stride: Invalid output stride" << std::endl;
+						return false;
+					}
+					if (params->outputStride <= 0)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --output-stride: Output stride must be greater than zero" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_SHARED_TOPOLOGY:
+					params->sharedTopologyFlag = true;
+					break;
+				case LONG_NEIGHBOR_SKIN:
+					if (!fromString<double>(optarg, params->neighborSkin))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --neighbor-skin: Invalid neighbor skin" << std::endl;
+						return false;
+					}
+					if (params->neighborSkin < 0)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --neighbor-skin: Neighbor skin must be non-negative" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_MULTIPOLE_RADIUS:
+					if (!fromString<double>(optarg, params->multipoleRadius))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --multipole-radius: Invalid multipole radius" << std::endl;
+						return false;
+					}
+					if (params->multipoleRadius < 0)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --multipole-radius: Multipole radius must be non-negative" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_MIXED_PRECISION:
+					params->mixedPrecisionFlag = true;
+					break;
+				case LONG_GIBBS:
+					if (!fromString<int>(optarg, params->gibbsInterval))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --gibbs: Invalid sync interval" << std::endl;
+						return false;
+					}
+					if (params->gibbsInterval <= 0)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --gibbs: Sync interval must be greater than zero" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_GIBBS_TRANSFERS:
+					if (!fromString<int>(optarg, params->gibbsTransfers))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --gibbs-transfers: Invalid transfer count" << std::endl;
+						return false;
+					}
+					if (params->gibbsTransfers < 0)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --gibbs-transfers: Transfer count must be non-negative" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_SOLUTE_TEMPERING:
+					if (!parseCutoffList(optarg, params->soluteTemperatures))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --solute-tempering: Invalid list of temperatures" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_SOLUTE_KINDS:
+					if (!parseKindList(optarg, params->soluteKinds))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --solute-kinds: Invalid list of molecule kinds" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_EXCHANGE_INTERVAL:
+					if (!fromString<int>(optarg, params->exchangeInterval))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --exchange-interval: Invalid exchange interval" << std::endl;
+						return false;
+					}
+					if (params->exchangeInterval <= 0)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --exchange-interval: Exchange interval must be greater than zero" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_NON_PERIODIC:
+					params->nonPeriodicFlag = true;
+					break;
+				case LONG_ADAPTIVE_RESOLUTION:
+					if (!parseOutputRegion(optarg, params->adaptiveSolute, params->adaptiveRadius))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --adaptive-resolution: Region must be <molecule>:<radius> with a positive radius" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_HYBRID_WIDTH:
+					if (!fromString<double>(optarg, params->hybridWidth))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --hybrid-width: Invalid hybrid width" << std::endl;
+						return false;
+					}
+					if (params->hybridWidth <= 0)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --hybrid-width: Hybrid width must be greater than zero" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_CACHE:
+					params->cacheDirectory = optarg;
+					break;
+				case LONG_RANDOM_BATCH_EWALD:
+					if (!fromString<int>(optarg, params->randomBatchEwald))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --random-batch-ewald: Invalid batch size" << std::endl;
+						return false;
+					}
+					if (params->randomBatchEwald < 0)
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --random-batch-ewald: Batch size must be non-negative" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_CUTOFF_SCAN:
+					if (!parseCutoffList(optarg, params->cutoffScan))
+					{
+						std::cerr << APP_NAME << ": ";
+						std::cerr << " --cutoff-scan: Invalid list of cutoffs" << std::endl;
+						return false;
+					}
+					break;
+				case LONG_PAIR_STATISTICS:
+					params->pairStatisticsFlag = true;
+					break;
+				case LONG_REWEIGHT:
+					params->reweightPath = optarg;
+					break;
 				case 'i':	/* status interval */
 					params->statusFlag = true;
 					if (!fromString<int>(optarg, params->statusInterval))
@@ -152,6 +444,9 @@ using std::string;
 				case 'p':	/* run parallel */
 					params->parallelFlag = true;
 					break;
+				case LONG_HOST_BATCH:	/* run the parallel batch algorithm on the host */
+					params->hostBatchFlag = true;
+					break;
 				case 'k': 	/* Silence cout */
 					params->silentOutputFlag = true;
 					break;
@@ -223,6 +518,20 @@ using std::string;
 	//bool metrosim::parseCommandLine(CommandParameters* params, SimulationArgs* args) //RBAl
 	bool parseCommandLine(CommandParameters* params, SimulationArgs* args)
 	{
+		//a reweighting run reads pair statistics files instead of simulating
+		if (!params->reweightPath.empty())
+		{
+			if (params->argCount < 1)
+			{
+				std::cerr << APP_NAME << ": ";
+				std::cerr << " --reweight: No pair statistics files specified" << std::endl;
+				return false;
+			}
+			args->reweightPath = params->reweightPath;
+			args->reweightFrames.assign(params->argList, params->argList + params->argCount);
+			return true;
+		}
+
 		if (params->argCount < 1)
 		{
 			std::cerr << APP_NAME << ": Input file not specified" << std::endl;
@@ -247,6 +556,25 @@ using std::string;
 			return false;
 		}
 
+		if (params->hostBatchFlag && (params->serialFlag || params->parallelFlag || params->deviceFlag))
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --host-batch: Cannot be combined with --serial, --parallel or --device" << std::endl;
+			return false;
+		}
+
+		//the host batch engine has none of the serial engine's extensions
+		if (params->hostBatchFlag && (params->sharedTopologyFlag || params->neighborSkin > 0 ||
+			params->multipoleRadius > 0 || params->hardCoreFraction > 0 || params->mixedPrecisionFlag ||
+			params->gibbsInterval > 0 || params->nonPeriodicFlag || params->adaptiveRadius > 0 ||
+			params->randomBatchEwald > 0 || !params->soluteTemperatures.empty()))
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --host-batch: Serial engine options such as --hard-core, --neighbor-skin or";
+			std::cerr << " --gibbs are not supported" << std::endl;
+			return false;
+		}
+
 		// Assign the relevant information that will be used in the simulation
 		// to the command arguments container.
 
@@ -258,6 +586,10 @@ using std::string;
 		{
 			args->simulationMode = SimulationMode::Serial;
 		}
+		else if (params->hostBatchFlag) /* host batch flag set */
+		{
+			args->simulationMode = SimulationMode::HostBatch;
+		}
 
 		if (!parseInputFile(params->argList[0], args->filePath, args->fileType))
 		{
@@ -272,6 +604,133 @@ using std::string;
 		args->simulationName = params->simulationName;
 		args->silencedOutput = params->silentOutputFlag;
 
+		if (params->shadowFlag && params->shadowEngine != "serial")
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --shadow: Unknown shadow engine '" << params->shadowEngine;
+			std::cerr << "' (supported engines: serial)" << std::endl;
+			return false;
+		}
+
+		args->shadowEngine = params->shadowFlag ? params->shadowEngine : "";
+		args->shadowInterval = params->shadowInterval;
+		args->shadowTolerance = params->shadowTolerance;
+		args->hardCoreFraction = params->hardCoreFraction;
+		args->outputKinds = params->outputKinds;
+		args->outputRegionMolecule = params->outputRegionFlag ? params->outputRegionMolecule : -1;
+		args->outputRegionExtent = params->outputRegionExtent;
+		args->outputRegionCube = params->outputRegionCube;
+		args->outputStride = params->outputStride;
+
+		if (params->parallelFlag && params->sharedTopologyFlag)
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --shared-topology: Shared topology is only supported in serial simulations" << std::endl;
+			return false;
+		}
+		args->sharedTopology = params->sharedTopologyFlag;
+		args->neighborSkin = params->neighborSkin;
+		args->multipoleRadius = params->multipoleRadius;
+
+		if (params->mixedPrecisionFlag && (params->parallelFlag || params->multipoleRadius > 0))
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --mixed-precision: Only supported in serial simulations without --multipole-radius" << std::endl;
+			return false;
+		}
+		args->mixedPrecision = params->mixedPrecisionFlag;
+
+		if (params->gibbsInterval > 0 && (params->parallelFlag || params->hardCoreFraction > 0 ||
+			params->neighborSkin > 0 || params->multipoleRadius > 0 || params->mixedPrecisionFlag ||
+			params->shadowFlag))
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --gibbs: Only supported in serial simulations without --shadow, --hard-core,";
+			std::cerr << " --neighbor-skin, --multipole-radius or --mixed-precision" << std::endl;
+			return false;
+		}
+		args->gibbsInterval = params->gibbsInterval;
+		args->gibbsTransfers = params->gibbsTransfers;
+
+		//the replicas share the plain serial engine of the Gibbs boxes
+		if (!params->soluteTemperatures.empty() && (params->parallelFlag || params->gibbsInterval > 0 ||
+			params->hardCoreFraction > 0 || params->neighborSkin > 0 || params->multipoleRadius > 0 ||
+			params->mixedPrecisionFlag || params->shadowFlag || params->adaptiveRadius > 0 ||
+			!params->cacheDirectory.empty() || params->randomBatchEwald > 0 || !params->cutoffScan.empty() ||
+			params->pairStatisticsFlag))
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --solute-tempering: Only supported in serial simulations without --gibbs, --shadow,";
+			std::cerr << " --hard-core, --neighbor-skin, --multipole-radius, --mixed-precision,";
+			std::cerr << " --adaptive-resolution, --cache or the final configuration reports" << std::endl;
+			return false;
+		}
+		if (params->soluteTemperatures.empty() != params->soluteKinds.empty())
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --solute-tempering: Must be given together with --solute-kinds" << std::endl;
+			return false;
+		}
+		args->soluteTemperatures = params->soluteTemperatures;
+		args->soluteKinds = params->soluteKinds;
+		args->exchangeInterval = params->exchangeInterval;
+
+		if (params->nonPeriodicFlag && (params->parallelFlag || params->gibbsInterval > 0 ||
+			params->hardCoreFraction > 0 || params->mixedPrecisionFlag))
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --non-periodic: Only supported in serial simulations without --gibbs,";
+			std::cerr << " --hard-core or --mixed-precision" << std::endl;
+			return false;
+		}
+		args->nonPeriodic = params->nonPeriodicFlag;
+
+		if (params->adaptiveRadius > 0 && (params->parallelFlag || params->gibbsInterval > 0 ||
+			params->shadowFlag || params->hardCoreFraction > 0 || params->multipoleRadius > 0 ||
+			params->mixedPrecisionFlag))
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --adaptive-resolution: Only supported in serial simulations without --gibbs,";
+			std::cerr << " --shadow, --hard-core, --multipole-radius or --mixed-precision" << std::endl;
+			return false;
+		}
+		args->adaptiveSolute = params->adaptiveRadius > 0 ? params->adaptiveSolute : -1;
+		args->adaptiveRadius = params->adaptiveRadius;
+		args->hybridWidth = params->hybridWidth;
+
+		if (!params->cacheDirectory.empty() && params->gibbsInterval > 0)
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --cache: Gibbs-ensemble runs can not be cached" << std::endl;
+			return false;
+		}
+		args->cacheDirectory = params->cacheDirectory;
+
+		if (params->randomBatchEwald > 0 && (params->parallelFlag || params->gibbsInterval > 0 ||
+			params->nonPeriodicFlag))
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --random-batch-ewald: Only supported in periodic serial simulations without --gibbs" << std::endl;
+			return false;
+		}
+		args->randomBatchEwald = params->randomBatchEwald;
+
+		if (!params->cutoffScan.empty() && params->gibbsInterval > 0)
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --cutoff-scan: Cannot be combined with --gibbs" << std::endl;
+			return false;
+		}
+		args->cutoffScan = params->cutoffScan;
+
+		if (params->pairStatisticsFlag && (params->gibbsInterval > 0 || !params->cacheDirectory.empty()))
+		{
+			std::cerr << APP_NAME << ": ";
+			std::cerr << " --pair-statistics: Cannot be combined with --gibbs or --cache" << std::endl;
+			return false;
+		}
+		args->pairStatistics = params->pairStatisticsFlag;
+
 		if (!params->parallelFlag && params->deviceFlag)
 		{
 			std::cerr << APP_NAME << ": Cannot use graphics device in serial simulation" << std::endl;
@@ -315,6 +774,64 @@ using std::string;
 		return false;
 	}
 
+	bool parseOutputRegion(const std::string& spec, int& molecule, double& extent)
+	{
+		size_t colon = spec.find(':');
+		if (colon == std::string::npos)
+			return false;
+
+		if (!fromString<int>(spec.substr(0, colon), molecule) || molecule < 0)
+			return false;
+
+		if (!fromString<double>(spec.substr(colon + 1), extent) || extent <= 0)
+			return false;
+
+		return true;
+	}
+
+	bool parseKindList(const std::string& spec, std::vector<int>& kinds)
+	{
+		kinds.clear();
+		size_t start = 0;
+		while (start <= spec.size())
+		{
+			size_t comma = spec.find(',', start);
+			if (comma == std::string::npos)
+				comma = spec.size();
+
+			int kind;
+			if (!fromString<int>(spec.substr(start, comma - start), kind) || kind < 0)
+				return false;
+			kinds.push_back(kind);
+
+			start = comma + 1;
+		}
+		return !kinds.empty();
+	}
+
+	bool parseCutoffList(const std::string& spec, std::vector<double>& cutoffs)
+	{
+		cutoffs.clear();
+		size_t start = 0;
+		while (start <= spec.size())
+		{
+			size_t comma = spec.find(',', start);
+			if (comma == std::string::npos)
+				comma = spec.size();
+
+			double cutoff;
+			if (!fromString<double>(spec.substr(start, comma - start), cutoff) || cutoff <= 0)
+				return false;
+			cutoffs.push_back(cutoff);
+
+			start = comma + 1;
+		}
+
+		std::sort(cutoffs.begin(), cutoffs.end());
+		cutoffs.erase(std::unique(cutoffs.begin(), cutoffs.end()), cutoffs.end());
+		return !cutoffs.empty();
+	}
+
 	//void metrosim::printHelpScreen() //RBAl
 	void printHelpScreen()
 	{
@@ -340,6 +857,12 @@ using std::string;
 				"\tinteraction. This value must a valid integer that is greater than\n"
 				"\tzero. If value specified is greater than the device capabilities,\n"
 				"\tthe number used will be the device maximum.\n\n";
+		cout << "--host-batch\n";
+		cout << "\tRun the batch algorithm of the --parallel mode on host CPU\n"
+			  "\tthreads, using the same kernels the GPU runs. Useful to develop\n"
+			  "\tand benchmark the batch algorithm without a CUDA device. Cannot\n"
+			  "\tbe combined with --serial, --parallel, --device or the options of\n"
+			  "\tthe serial engine.\n\n";
 
 		cout << "GPU Operation Flags\n"
 			  "====================\n";
@@ -412,6 +935,194 @@ using std::string;
 				"\tname with the current step number appended at the end:\n\n";
 		cout << "\t\t<simulation-name>_<step-num>.state\n\n";
 
+		cout << "Verification Options\n"
+			  "=====================\n";
+		cout << "These options cross-check the selected engine against a reference\n"
+				"engine while the simulation runs.\n\n";
+		cout << "--shadow <engine>\n";
+		cout << "\tRuns the given reference engine alongside the selected engine and\n"
+				"\tcompares the old and new energy contributions of the changed\n"
+				"\tmolecule. The first divergence is reported with the step number,\n"
+				"\tthe molecule index, both energies and the neighbor counts at the\n"
+				"\told and new positions. The only supported engine is 'serial',\n"
+				"\tthe plain all-pairs CPU evaluation.\n\n";
+		cout << "--shadow-interval <interval>\n";
+		cout << "\tSpecifies the number of simulation steps between shadow checks.\n"
+				"\tThe default of 1 checks every step; larger values reduce the\n"
+				"\toverhead of the reference engine.\n\n";
+		cout << "--shadow-tolerance <tolerance>\n";
+		cout << "\tSpecifies the relative tolerance used when comparing energies.\n"
+				"\tTwo energies diverge when they differ by more than the tolerance\n"
+				"\ttimes max(1, |reference energy|). Defaults to 1e-4.\n\n";
+
+		cout << "Performance Options\n"
+			  "=====================\n";
+		cout << "These options speed up the serial engine. --hard-core and\n"
+				"\t--multipole-radius trade exactness for speed.\n\n";
+		cout << "--hard-core <fraction>\n";
+		cout << "\tRejects a trial move before any energy evaluation when one of its\n"
+				"\theavy atoms (atoms with Lennard-Jones parameters) lands within\n"
+				"\tthe hard-core radius of a heavy atom of another molecule. The\n"
+				"\tradius is the given fraction of the smallest heavy atom sigma,\n"
+				"\twhere the Lennard-Jones repulsion makes acceptance vanishingly\n"
+				"\tunlikely. Overlaps are found with an occupancy map of the box,\n"
+				"\tso only gross overlaps are caught. Values must be less than 1;\n"
+				"\t0, the default, disables the pre-screen.\n\n";
+		cout << "--shared-topology\n";
+		cout << "\tKeeps the molecules, atoms and bond, angle, dihedral and hop\n"
+				"\tarrays in POSIX shared memory, keyed by a hash of the precision,\n"
+				"\tthe OPLS and Z-matrix files and the molecule count. The first run\n"
+				"\tpublishes them and later runs with the same topology build their\n"
+				"\tbox from them without parsing the OPLS and Z-matrix files,\n"
+				"\twhatever their seeds and step counts. The topology arrays are\n"
+				"\tmapped read-only, so concurrent replicas share one copy; atoms\n"
+				"\tmove, so each run copies them. The last run using a segment\n"
+				"\tremoves it when it finishes, and a segment whose publisher died\n"
+				"\tbefore completing it is removed by the next run. Segments held\n"
+				"\tby runs that were killed persist until removed as\n"
+				"\t/dev/shm/mcgpu-topology-<hash>.\n\n";
+		cout << "--neighbor-skin <angstroms>\n";
+		cout << "\tFinds neighbors with per-molecule lists of every molecule within\n"
+				"\tthe cutoff plus this skin. A helper thread rebuilds the lists\n"
+				"\tfrom a snapshot of the coordinates while sampling continues,\n"
+				"\tand moves accepted in the meantime are replayed before the new\n"
+				"\tlists are swapped in. Whenever the skin no longer covers the\n"
+				"\tdisplacements since the snapshot, the cell grid is searched\n"
+				"\tinstead, so results are unchanged. 0, the default, disables\n"
+				"\tthe lists.\n\n";
+		cout << "--multipole-radius <angstroms>\n";
+		cout << "\tEvaluates molecule pairs whose primary atoms are between this\n"
+				"\tradius and the cutoff from molecular moments (charge, dipole,\n"
+				"\tquadrupole, and factored Lennard-Jones coefficients) instead of\n"
+				"\tatom by atom. Pairs too close for the expansion to converge\n"
+				"\tstay atomistic. At the end of the run every approximated pair\n"
+				"\tis compared with the atomistic energy and the largest error is\n"
+				"\treported against its analytic bound. 0, the default, disables\n"
+				"\tthe approximation.\n\n";
+		cout << "--mixed-precision\n";
+		cout << "\tEstimates the energy change of each trial move in single\n"
+				"\tprecision with a rigorous bound on its rounding error. Moves that\n"
+				"\tare certainly rejected for the drawn random number are rejected\n"
+				"\tstraight away; all others are evaluated again in full precision.\n"
+				"\tThe chain and energies are the same as without the option.\n"
+				"\tRequires a double precision build.\n\n";
+		cout << "--random-batch-ewald <batch size>\n";
+		cout << "\tEstimates the Ewald electrostatic energy of the final\n"
+				"\tconfiguration, with the reciprocal-space sum taken over random\n"
+				"\tbatches of this many k-vectors drawn from the Gaussian weight of\n"
+				"\tthe Ewald kernel. Each batch costs time proportional to the atom\n"
+				"\tcount times the batch size. The mean over 16 batches is reported\n"
+				"\twith its standard error and the time per batch, next to the\n"
+				"\tcutoff Coulomb energy the simulation samples with. The chain is\n"
+				"\tnot changed. 0, the default, disables the estimate.\n\n";
+
+		cout << "Ensemble Options\n"
+			  "=====================\n";
+		cout << "--gibbs <interval>\n";
+		cout << "\tRuns a Gibbs-ensemble simulation of two coexisting phases. Two\n"
+				"\tboxes are built from the configuration and the molecules are\n"
+				"\tdealt alternately between them. Each box makes the given number\n"
+				"\tof displacement moves on its own thread; the boxes then meet at\n"
+				"\ta sync point for one volume exchange and a batch of molecule\n"
+				"\ttransfers. --steps sets the displacement moves per box. Only\n"
+				"\tthe results file is written.\n\n";
+		cout << "--gibbs-transfers <count>\n";
+		cout << "\tSpecifies the number of molecule transfers attempted at each\n"
+				"\tGibbs sync point. Defaults to 10.\n\n";
+		cout << "--solute-tempering <temperature>[,<temperature>...]\n";
+		cout << "\tRuns a solute-tempering replica exchange simulation. One replica\n"
+				"\truns at the configuration temperature and one at each listed\n"
+				"\tsolute temperature, which must be higher. Every replica keeps\n"
+				"\tthe configuration temperature, but scales the energy of pairs of\n"
+				"\tsolute molecules by T0/T and that of solute-solvent pairs by its\n"
+				"\tsquare root, so only the solute is heated and far fewer replicas\n"
+				"\tare needed than in temperature replica exchange. Each replica\n"
+				"\tmakes its displacement moves on its own thread; at each exchange\n"
+				"\tneighboring replicas attempt to swap their scaling factors.\n"
+				"\t--steps sets the displacement moves per replica. Only the results\n"
+				"\tfile is written.\n\n";
+		cout << "--solute-kinds <kind>[,<kind>...]\n";
+		cout << "\tSpecifies the molecule kinds that form the solute of\n"
+				"\t--solute-tempering, by their index in the configuration.\n\n";
+		cout << "--exchange-interval <steps>\n";
+		cout << "\tSpecifies the number of displacement moves each replica makes\n"
+				"\tbetween exchange attempts. Defaults to 100.\n\n";
+		cout << "--non-periodic\n";
+		cout << "\tSimulates an isolated droplet or cluster. Distances are taken\n"
+				"\tas they are, without periodic images, and molecules are never\n"
+				"\twrapped back into the box, which only sets the initial lattice.\n"
+				"\tNeighbors are found on a hashed grid that stores occupied cells\n"
+				"\tonly, so memory does not grow with the empty space around the\n"
+				"\tcluster.\n\n";
+		cout << "--adaptive-resolution <molecule>:<radius>\n";
+		cout << "\tKeeps molecules atomistic within the given radius of where the\n"
+				"\tgiven solute molecule starts, and treats molecules beyond a\n"
+				"\thybrid shell as single sites at their primary atoms. Inside the\n"
+				"\tshell the two descriptions are blended by the product of the\n"
+				"\tmolecules' weights. The coarse-grained potential of each pair of\n"
+				"\tmolecule kinds is tabulated at startup by averaging the\n"
+				"\tatomistic energy over random orientations.\n\n";
+		cout << "--hybrid-width <angstroms>\n";
+		cout << "\tSpecifies the width of the hybrid shell of adaptive resolution.\n"
+				"\tDefaults to 2.\n\n";
+
+		cout << "--cutoff-scan <cutoff>[,<cutoff>...]\n";
+		cout << "\tReports the energy of the final configuration at each of the\n"
+				"\tlisted cutoffs, from a single pass that bins every molecule pair\n"
+				"\tinto the distance shell between two consecutive cutoffs. Pairs\n"
+				"\tare binned by the distance of their primary atoms, as the\n"
+				"\tsimulation's own cutoff selects them, so each reported energy is\n"
+				"\tthe energy a run with that cutoff would compute for the same\n"
+				"\tconfiguration. The energy and molecule pairs of every shell are\n"
+				"\treported too. The chain is not changed.\n\n";
+
+		cout << "Reweighting Options\n"
+			  "=====================\n";
+		cout << "--pair-statistics\n";
+		cout << "\tWrites a .pairstats file next to every state file. Atoms with\n"
+				"\tthe same sigma, epsilon and charge form a type, and the file\n"
+				"\tholds the sums of r^-12, r^-6 and r^-1 over the atom pairs of\n"
+				"\teach pair of types that the system energy evaluates. The chain\n"
+				"\tis not changed.\n\n";
+		cout << "--reweight <parameter file> <pairstats file>...\n";
+		cout << "\tPrints the Lennard-Jones, Coulomb and total energy of each pair\n"
+				"\tstatistics file under each parameter set of the parameter file,\n"
+				"\twith the change from the simulated parameters. A set starts with\n"
+				"\ta [name] line and lists the types it changes, one\n"
+				"\t'type sigma epsilon charge' line each; the other types keep\n"
+				"\ttheir parameters. Each evaluation costs the square of the type\n"
+				"\tcount, and no simulation is run.\n\n";
+
+		cout << "Cache Options\n"
+			  "=====================\n";
+		cout << "--cache <directory>\n";
+		cout << "\tKeeps finished runs in the given directory, keyed by a hash of\n"
+				"\tthe input files, the build precision and every setting that can\n"
+				"\tchange the output. A run that is already cached is not run\n"
+				"\tagain; its results and final state files are copied into place.\n"
+				"\tA longer run of a cached chain resumes from the longest cached\n"
+				"\tcheckpoint, as it would from a state file.\n\n";
+
+		cout << "Output Options\n"
+			  "=====================\n";
+		cout << "These options limit the molecules written to state files, PDB\n"
+				"files and trajectory frames. Filtered state files hold only the\n"
+				"selected molecules.\n\n";
+		cout << "--output-kinds <kind>[,<kind>...]\n";
+		cout << "\tWrites only molecules of the listed kinds. A kind is the index\n"
+				"\tof the molecule in the Z-matrix file, starting at 0.\n\n";
+		cout << "--output-sphere <molecule>:<radius>\n";
+		cout << "\tWrites only molecules whose primary atom lies within the given\n"
+				"\tradius of the primary atom of the reference molecule.\n\n";
+		cout << "--output-cube <molecule>:<half-width>\n";
+		cout << "\tWrites only molecules whose primary atom lies inside the cube\n"
+				"\tof the given half-width centered on the primary atom of the\n"
+				"\treference molecule.\n\n";
+		cout << "--output-stride <stride>\n";
+		cout << "\tWrites a PDB trajectory frame at every <stride>-th status update\n"
+				"\tand keeps only every <stride>-th intermediate state file. The\n"
+				"\tfinal PDB and state files are always written.\n\n";
+
 		cout << "Generic Tool Options\n"
 			  "=====================\n";
 		cout << "\n";
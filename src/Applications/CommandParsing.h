@@ -11,6 +11,7 @@
 #define METROSIM_COMMAND_PARSING_H
 
 #include <string>
+#include <vector>
 #include "Metropolis/SimulationArgs.h"
 
 #ifndef APP_NAME
@@ -18,6 +19,11 @@
 #endif
 
 #define DEFAULT_STATUS_INTERVAL 100
+#define DEFAULT_SHADOW_INTERVAL 1
+#define DEFAULT_SHADOW_TOLERANCE 1e-4
+#define DEFAULT_GIBBS_TRANSFERS 10
+#define DEFAULT_HYBRID_WIDTH 2.0
+#define DEFAULT_EXCHANGE_INTERVAL 100
 
 	/// Contains the intermediate values and flags read in from the command
 	/// line.
@@ -89,11 +95,113 @@
 
 		/// Declares whether the parallel execution option was specified.
 		bool parallelFlag;
+
+		/// Declares whether the host batch execution option was specified.
+		bool hostBatchFlag;
 		
 		/// Declares whether or not to silence the printed run 
 		/// information to standard cout.
 		bool silentOutputFlag;
 
+		/// Declares whether the shadow cross-check option was specified.
+		bool shadowFlag;
+
+		/// The name of the reference engine used to cross-check the
+		/// energies computed by the selected engine.
+		std::string shadowEngine;
+
+		/// The number of simulation steps between shadow cross-checks.
+		/// This must be a valid integer number greater than zero.
+		int shadowInterval;
+
+		/// The relative tolerance allowed between the selected engine and
+		/// the shadow engine before a divergence is reported.
+		double shadowTolerance;
+
+		/// The hard-core radius used to pre-screen trial moves, as a
+		/// fraction of the smallest heavy atom sigma. Zero disables it.
+		double hardCoreFraction;
+
+		/// The molecule kinds selected for output. Empty selects all kinds.
+		std::vector<int> outputKinds;
+
+		/// Declares whether an output region option was specified.
+		bool outputRegionFlag;
+
+		/// The index of the molecule at the center of the output region.
+		int outputRegionMolecule;
+
+		/// The radius of a spherical output region, or the half-width of a
+		/// cubic one.
+		double outputRegionExtent;
+
+		/// Declares whether the output region is a cube instead of a sphere.
+		bool outputRegionCube;
+
+		/// Writes only every n-th output frame. Zero disables trajectory
+		/// frames and keeps every state snapshot.
+		int outputStride;
+
+		/// Declares whether the topology should be shared between processes.
+		bool sharedTopologyFlag;
+
+		/// The skin added to the cutoff by the neighbor lists, in angstroms.
+		/// Zero disables the lists.
+		double neighborSkin;
+
+		/// The distance beyond which molecule pairs are approximated from
+		/// multipoles, in angstroms. Zero disables the approximation.
+		double multipoleRadius;
+
+		/// Declares whether trial moves are first evaluated in single precision.
+		bool mixedPrecisionFlag;
+
+		/// The displacement moves each Gibbs box makes between sync points.
+		/// Zero runs a single box.
+		int gibbsInterval;
+
+		/// The molecule transfers attempted at each Gibbs sync point.
+		int gibbsTransfers;
+
+		/// The solute temperatures of the tempering rungs above the
+		/// configuration temperature. Empty runs a single box.
+		std::vector<double> soluteTemperatures;
+
+		/// The molecule kinds that solute tempering scales.
+		std::vector<int> soluteKinds;
+
+		/// The displacement moves each replica makes between exchanges.
+		int exchangeInterval;
+
+		/// Declares whether the box has no periodic images.
+		bool nonPeriodicFlag;
+
+		/// The molecule at the center of the atomistic region, and the
+		/// radius of that region. A radius of zero disables adaptive
+		/// resolution.
+		int adaptiveSolute;
+		double adaptiveRadius;
+
+		/// The width of the hybrid shell around the atomistic region.
+		double hybridWidth;
+
+		/// The directory of the result cache. Empty disables the cache.
+		std::string cacheDirectory;
+
+		/// The k-vectors in each random batch of the Ewald estimate. Zero
+		/// disables the estimate.
+		int randomBatchEwald;
+
+		/// The cutoffs to report the final energy at. Empty skips the scan.
+		std::vector<double> cutoffScan;
+
+		/// Declares whether pair statistics files should be written.
+		bool pairStatisticsFlag;
+
+		/// The parameter set file of a reweighting run. Empty runs a
+		/// simulation.
+		std::string reweightPath;
+
 		/// Default constructor
 		CommandParameters() :	statusInterval(DEFAULT_STATUS_INTERVAL),
 								stateInterval(0),
@@ -111,7 +219,30 @@
 								threadFlag(false),
 								serialFlag(false),
 								parallelFlag(false),
-								silentOutputFlag(false) {}
+								hostBatchFlag(false),
+								silentOutputFlag(false),
+								shadowFlag(false),
+								shadowInterval(DEFAULT_SHADOW_INTERVAL),
+								shadowTolerance(DEFAULT_SHADOW_TOLERANCE),
+								hardCoreFraction(0),
+								outputRegionFlag(false),
+								outputRegionMolecule(-1),
+								outputRegionExtent(0),
+								outputRegionCube(false),
+								outputStride(0),
+								sharedTopologyFlag(false),
+								neighborSkin(0),
+								multipoleRadius(0),
+								mixedPrecisionFlag(false),
+								gibbsInterval(0),
+								gibbsTransfers(DEFAULT_GIBBS_TRANSFERS),
+								exchangeInterval(DEFAULT_EXCHANGE_INTERVAL),
+								nonPeriodicFlag(false),
+								adaptiveSolute(-1),
+								adaptiveRadius(0),
+								hybridWidth(DEFAULT_HYBRID_WIDTH),
+								randomBatchEwald(0),
+								pairStatisticsFlag(false) {}
 	};
 
 	/// Goes through each argument specified from the command line and checks
@@ -153,6 +284,29 @@
 
 	bool parseInputFile(char* filename, std::string& name, InputFileType& type);
 
+	/// Parses an output region of the form <molecule>:<extent>.
+	///
+	/// @param[in] spec The region specification given on the command line.
+	/// @param[out] molecule The index of the reference molecule.
+	/// @param[out] extent The radius or half-width of the region.
+	/// @returns True if the specification was valid.
+	bool parseOutputRegion(const std::string& spec, int& molecule, double& extent);
+
+	/// Parses a comma separated list of molecule kinds.
+	///
+	/// @param[in] spec The list given on the command line.
+	/// @param[out] kinds The kind indices in the list.
+	/// @returns True if every entry was a non-negative integer.
+	bool parseKindList(const std::string& spec, std::vector<int>& kinds);
+
+	/// Parses a comma separated list of cutoffs.
+	///
+	/// @param[in] spec The list given on the command line.
+	/// @param[out] cutoffs The distinct cutoffs in the list, sorted in
+	///     ascending order.
+	/// @returns True if every entry was a positive number.
+	bool parseCutoffList(const std::string& spec, std::vector<double>& cutoffs);
+
 	/// Outputs the help documentation to the standard output stream and
 	/// displays how to use the application.
 	void printHelpScreen();
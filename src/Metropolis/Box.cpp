@@ -26,6 +26,9 @@ Box::Box()
 	dihedrals = NULL;
 	hops = NULL;
 
+	topologySegment = NULL;
+	topologySegmentSize = 0;
+
 	atomCount = 0;
 	moleculeCount = 0;
 }
@@ -75,7 +78,12 @@ int Box::changeMolecule(int molIdx)
 }
 
 void Box::keepMoleculeInBox(int molIdx)
-{		
+{
+		if (!environment->periodic)
+		{
+			return;
+		}
+		
 		for (int j = 0; j < molecules[molIdx].numOfAtoms; j++)
         {
 		    //X axis
@@ -89,11 +97,16 @@ void Box::keepMoleculeInBox(int molIdx)
 
 int Box::rollback(int molIdx)
 {
-	copyMolecule(&molecules[molIdx],&changedMol);
+	memcpy(molecules[molIdx].atoms, changedMol.atoms, sizeof(Atom) * changedMol.numOfAtoms);
 
 	return molIdx;
 }
 
+int Box::commitChange(int molIdx)
+{
+	return molIdx;
+}
+
 void Box::saveChangedMol(int molIdx)
 {
 	Molecule *mol_src = &molecules[molIdx];
@@ -116,6 +129,13 @@ void Box::saveChangedMol(int molIdx)
 	copyMolecule(&changedMol,mol_src);
 }
 
+void Box::swapChangedMol(int molIdx)
+{
+	Atom *changedAtoms = molecules[molIdx].atoms;
+	molecules[molIdx].atoms = changedMol.atoms;
+	changedMol.atoms = changedAtoms;
+}
+
 void Box::copyMolecule(Molecule *mol_dst, Molecule *mol_src)
 {
     mol_dst->numOfAtoms = mol_src->numOfAtoms;
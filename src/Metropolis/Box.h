@@ -40,8 +40,13 @@ class Box
 		Hop *hops;
 		int atomCount, moleculeCount, bondCount, angleCount, dihedralCount, hopCount;
 		
+		/// The read-only shared memory mapping that holds the bond, angle,
+		///   dihedral and hop arrays, or NULL if the box owns them.
+		void *topologySegment;
+		size_t topologySegmentSize;
+		
 		Box();
-		~Box();
+		virtual ~Box();
 		Atom *getAtoms(){return atoms;};
 		int getAtomCount(){return atomCount;};
 		Molecule *getMolecules(){return molecules;};
@@ -66,16 +71,29 @@ class Box
 		/// @param molecule The index of the molecule to be fixed.
 		void keepMoleculeInBox(int molIdx);
 		
-		/// Rolls back the previous molecule change.
+		/// Rolls back the previous molecule change. Only the atoms are
+		///   restored, since a change never alters the topology.
 		/// @param molIdx The index of the molecule to be reverted.
 		/// @return Returns the index of the reverted molecule.
 		/// @note This method is virtual to be overridden by an subclass.
 		virtual int rollback(int molIdx);
 		
+		/// Commits the previous molecule change once it has been accepted.
+		/// @param molIdx The index of the molecule that was changed.
+		/// @return Returns the index of the committed molecule.
+		/// @note This method is virtual to be overridden by an subclass.
+		virtual int commitChange(int molIdx);
+		
 		/// Saves the unchanged version of a molecule to be changed.
 		/// @param molIdx The index of the molecule to be saved.
 		void saveChangedMol(int molIdx);
 		
+		/// Exchanges the atoms of a changed molecule with those of its saved
+		///   copy. Calling it a second time restores the change, so the
+		///   unchanged molecule can be evaluated without a rollback.
+		/// @param molIdx The index of the changed molecule.
+		void swapChangedMol(int molIdx);
+		
 		/// Copies the data of one molecule to another.
 		/// @param mol_dst A pointer to the destination molecule.
 		/// @param mol_src A pointer to the source molecule.
@@ -0,0 +1,276 @@
+/*
+	Driver for Gibbs-ensemble simulations. Two serial boxes built from the
+	same configuration exchange volume and molecules, so the coexisting
+	phases of a fluid are sampled in one run. Each box advances its
+	displacement moves on its own thread; the threads only meet at sync
+	points, where a batch of volume-exchange and particle-transfer moves is
+	made.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include "GibbsSimulation.h"
+#include "Metropolis/Utilities/MathLibrary.h"
+#include "SerialSim/SerialCalcs.h"
+
+GibbsSimulation::GibbsSimulation(SimulationArgs simArgs)
+	: MultiBoxSimulation(simArgs, 2, "CPU Gibbs Ensemble", GIBBS_STREAM_OFFSET)
+{
+	volumeAttempts = volumeAccepts = 0;
+	transferAttempts = transferAccepts = 0;
+
+	Environment *enviro = walkers[0].box->environment;
+	if (2 * enviro->cutoff > std::min(enviro->x, std::min(enviro->y, enviro->z)))
+	{
+		std::cerr << "Error: Gibbs ensemble requires a cutoff of at most half the box" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	//start with the molecules of the lattice dealt alternately to the boxes
+	int moleculeCount = enviro->numOfMolecules;
+	for (int b = 0; b < 2; b++)
+	{
+		Phase &phase = phases[b];
+		walkers[b].box->present.assign(moleculeCount, 0);
+		walkers[b].members = &phase.members;
+		phase.slotOf.assign(moleculeCount, -1);
+		phase.displacementAttempts = 0;
+		phase.displacementAccepts = 0;
+		for (int i = b; i < moleculeCount; i += 2)
+		{
+			walkers[b].box->present[i] = 1;
+			phase.slotOf[i] = phase.members.size();
+			phase.members.push_back(i);
+		}
+	}
+}
+
+long GibbsSimulation::syncInterval()
+{
+	return args.gibbsInterval;
+}
+
+void GibbsSimulation::sync(long cycle)
+{
+	for (int b = 0; b < 2; b++)
+	{
+		phases[b].displacementAttempts += walkers[b].attempts;
+		phases[b].displacementAccepts += walkers[b].accepts;
+	}
+
+	//the batch of moves that couple the boxes
+	volumeAttempts++;
+	if (volumeMove())
+	{
+		volumeAccepts++;
+	}
+	for (int i = 0; i < args.gibbsTransfers; i++)
+	{
+		transferAttempts++;
+		if (transferMove())
+		{
+			transferAccepts++;
+		}
+	}
+}
+
+bool GibbsSimulation::volumeMove()
+{
+	Real oldVolumes[2] = {volume(0), volume(1)};
+	Real delta = randomReal(-1.0, 1.0) * GIBBS_MAX_VOLUME_FRACTION * std::min(oldVolumes[0], oldVolumes[1]);
+	Real newVolumes[2] = {oldVolumes[0] + delta, oldVolumes[1] - delta};
+
+	//keep the minimum image convention valid in both boxes
+	for (int b = 0; b < 2; b++)
+	{
+		Environment *enviro = walkers[b].box->environment;
+		Real factor = cbrt(newVolumes[b] / oldVolumes[b]);
+		if (2 * enviro->cutoff > factor * std::min(enviro->x, std::min(enviro->y, enviro->z)))
+		{
+			return false;
+		}
+	}
+
+	std::vector<Atom> saved[2];
+	Environment savedEnvironment[2];
+	Real newEnergies[2];
+	Real exponent = 0;
+	for (int b = 0; b < 2; b++)
+	{
+		SerialBox *box = walkers[b].box;
+		saved[b].assign(box->atoms, box->atoms + box->atomCount);
+		savedEnvironment[b] = *box->environment;
+
+		scale(b, cbrt(newVolumes[b] / oldVolumes[b]));
+		newEnergies[b] = SerialCalcs::calcSystemEnergy(box);
+		exponent += -(newEnergies[b] - walkers[b].energy) / walkers[b].kT +
+			phases[b].members.size() * log(newVolumes[b] / oldVolumes[b]);
+	}
+
+	if (exponent >= 0 || exp(exponent) >= randomReal(0.0, 1.0))
+	{
+		walkers[0].energy = newEnergies[0];
+		walkers[1].energy = newEnergies[1];
+		return true;
+	}
+
+	for (int b = 0; b < 2; b++)
+	{
+		SerialBox *box = walkers[b].box;
+		memcpy(box->atoms, &saved[b][0], sizeof(Atom) * box->atomCount);
+		*box->environment = savedEnvironment[b];
+		box->resetSpatialIndex();
+	}
+	return false;
+}
+
+bool GibbsSimulation::transferMove()
+{
+	int source = randomReal(0.0, 1.0) < 0.5 ? 0 : 1;
+	Walker &from = walkers[source];
+	Walker &to = walkers[1 - source];
+	if (phases[source].members.empty())
+	{
+		return false;
+	}
+
+	int molIdx = randomMember(phases[source].members);
+	Real removal = SerialCalcs::calcMolecularEnergyContribution(from.box, molIdx);
+
+	//copy the molecule into the other box at a random position, with a
+	//uniformly random orientation
+	Environment *fromEnviro = from.box->environment;
+	Environment *toEnviro = to.box->environment;
+	Molecule &sourceMolecule = from.box->molecules[molIdx];
+	Molecule &target = to.box->molecules[molIdx];
+	Atom primary = sourceMolecule.atoms[fromEnviro->primaryAtomIndex];
+
+	Real rotation[3][3];
+	randomRotation(rotation);
+	Real center[3] = {randomReal(0.0, toEnviro->x), randomReal(0.0, toEnviro->y), randomReal(0.0, toEnviro->z)};
+
+	for (int i = 0; i < target.numOfAtoms; i++)
+	{
+		Atom atom = sourceMolecule.atoms[i];
+		Real offset[3] = {SerialCalcs::makePeriodic(atom.x - primary.x, fromEnviro->x),
+						  SerialCalcs::makePeriodic(atom.y - primary.y, fromEnviro->y),
+						  SerialCalcs::makePeriodic(atom.z - primary.z, fromEnviro->z)};
+		target.atoms[i].x = center[0] + rotation[0][0] * offset[0] + rotation[0][1] * offset[1] + rotation[0][2] * offset[2];
+		target.atoms[i].y = center[1] + rotation[1][0] * offset[0] + rotation[1][1] * offset[1] + rotation[1][2] * offset[2];
+		target.atoms[i].z = center[2] + rotation[2][0] * offset[0] + rotation[2][1] * offset[1] + rotation[2][2] * offset[2];
+	}
+	to.box->keepMoleculeInBox(molIdx);
+
+	Real insertion = SerialCalcs::calcMolecularEnergyContribution(to.box, molIdx);
+	Real exponent = -(insertion - removal) / from.kT +
+		log(phases[source].members.size() * volume(1 - source) /
+			((phases[1 - source].members.size() + 1) * volume(source)));
+
+	if (exponent >= 0 || exp(exponent) >= randomReal(0.0, 1.0))
+	{
+		from.energy -= removal;
+		to.energy += insertion;
+		transferMembership(source, 1 - source, molIdx);
+		to.box->commitChange(molIdx);
+		return true;
+	}
+	return false;
+}
+
+void GibbsSimulation::scale(int b, Real factor)
+{
+	SerialBox *box = walkers[b].box;
+	const std::vector<int> &members = phases[b].members;
+	Environment *enviro = box->environment;
+	Real oldDimensions[3] = {enviro->x, enviro->y, enviro->z};
+	enviro->x *= factor;
+	enviro->y *= factor;
+	enviro->z *= factor;
+
+	//molecules keep their shape; only their primary atoms are scaled
+	for (int m = 0; m < members.size(); m++)
+	{
+		Molecule &molecule = box->molecules[members[m]];
+		Atom primary = molecule.atoms[enviro->primaryAtomIndex];
+		for (int i = 0; i < molecule.numOfAtoms; i++)
+		{
+			Atom &atom = molecule.atoms[i];
+			atom.x = primary.x * factor + SerialCalcs::makePeriodic(atom.x - primary.x, oldDimensions[0]);
+			atom.y = primary.y * factor + SerialCalcs::makePeriodic(atom.y - primary.y, oldDimensions[1]);
+			atom.z = primary.z * factor + SerialCalcs::makePeriodic(atom.z - primary.z, oldDimensions[2]);
+		}
+		box->keepMoleculeInBox(members[m]);
+	}
+	box->resetSpatialIndex();
+}
+
+void GibbsSimulation::transferMembership(int from, int to, int molIdx)
+{
+	Phase &source = phases[from];
+	int slot = source.slotOf[molIdx];
+	int last = source.members.back();
+	source.members[slot] = last;
+	source.slotOf[last] = slot;
+	source.members.pop_back();
+	source.slotOf[molIdx] = -1;
+	walkers[from].box->present[molIdx] = 0;
+
+	Phase &target = phases[to];
+	target.slotOf[molIdx] = target.members.size();
+	target.members.push_back(molIdx);
+	walkers[to].box->present[molIdx] = 1;
+}
+
+Real GibbsSimulation::volume(int b)
+{
+	Environment *enviro = walkers[b].box->environment;
+	return enviro->x * enviro->y * enviro->z;
+}
+
+void GibbsSimulation::printBoxes()
+{
+	for (int b = 0; b < 2; b++)
+	{
+		std::cout << "--Box " << b << ": " << phases[b].members.size() << " molecules, volume "
+			<< volume(b) << ", energy " << walkers[b].energy << std::endl;
+	}
+}
+
+void GibbsSimulation::printResults()
+{
+	for (int b = 0; b < 2; b++)
+	{
+		std::cout << "Box " << b << " Density: " << phases[b].members.size() / volume(b)
+			<< " molecules/A^3" << std::endl;
+		std::cout << "Box " << b << " Displacement Acceptance: " << phases[b].displacementAccepts
+			<< " of " << phases[b].displacementAttempts << std::endl;
+	}
+	std::cout << "Volume Acceptance: " << volumeAccepts << " of " << volumeAttempts << std::endl;
+	std::cout << "Transfer Acceptance: " << transferAccepts << " of " << transferAttempts << std::endl;
+}
+
+void GibbsSimulation::writeInformation(std::ostream &resultsFile)
+{
+	resultsFile << "Sync-Interval = " << args.gibbsInterval << std::endl;
+	resultsFile << "Transfers-Per-Sync = " << args.gibbsTransfers << std::endl;
+}
+
+void GibbsSimulation::writeResults(std::ostream &resultsFile)
+{
+	for (int b = 0; b < 2; b++)
+	{
+		resultsFile << "Box-" << b << "-Molecule-Count = " << phases[b].members.size() << std::endl;
+		resultsFile << "Box-" << b << "-Volume = " << volume(b) << std::endl;
+		resultsFile << "Box-" << b << "-Density = " << phases[b].members.size() / volume(b) << std::endl;
+		resultsFile << "Box-" << b << "-Final-Energy = " << walkers[b].energy << std::endl;
+		resultsFile << "Box-" << b << "-Displacement-Accepts = " << phases[b].displacementAccepts << std::endl;
+		resultsFile << "Box-" << b << "-Displacement-Attempts = " << phases[b].displacementAttempts << std::endl;
+	}
+	resultsFile << "Volume-Accepts = " << volumeAccepts << std::endl;
+	resultsFile << "Volume-Attempts = " << volumeAttempts << std::endl;
+	resultsFile << "Transfer-Accepts = " << transferAccepts << std::endl;
+	resultsFile << "Transfer-Attempts = " << transferAttempts << std::endl;
+}
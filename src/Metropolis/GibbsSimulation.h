@@ -0,0 +1,81 @@
+/*
+	Driver for Gibbs-ensemble simulations. Two serial boxes built from the
+	same configuration exchange volume and molecules, so the coexisting
+	phases of a fluid are sampled in one run. Each box advances its
+	displacement moves on its own thread; the threads only meet at sync
+	points, where a batch of volume-exchange and particle-transfer moves is
+	made.
+*/
+
+#ifndef GIBBSSIMULATION_H
+#define GIBBSSIMULATION_H
+
+#include <vector>
+#include "MultiBoxSimulation.h"
+
+/// The largest volume exchange, as a fraction of the smaller box volume.
+#define GIBBS_MAX_VOLUME_FRACTION 0.01
+
+/// Seed offset of the random number stream of each box thread.
+#define GIBBS_STREAM_OFFSET 7919
+
+class GibbsSimulation : public MultiBoxSimulation
+{
+	public:
+		GibbsSimulation(SimulationArgs simArgs);
+
+	private:
+		/// The membership and displacement totals of one of the two boxes.
+		struct Phase
+		{
+			/// The molecules that belong to the box, and the slot of each
+			///   molecule in that list (-1 when it is in the other box).
+			std::vector<int> members;
+			std::vector<int> slotOf;
+
+			long displacementAttempts;
+			long displacementAccepts;
+		};
+
+		Phase phases[2];
+
+		long volumeAttempts, volumeAccepts;
+		long transferAttempts, transferAccepts;
+
+		long syncInterval();
+
+		/// Makes a batch of volume-exchange and particle-transfer moves.
+		/// @param cycle The index of the cycle.
+		void sync(long cycle);
+
+		/// Attempts to move volume from one box to the other.
+		/// @return Returns true if the move was accepted.
+		bool volumeMove();
+
+		/// Attempts to move a random molecule of one box to a random
+		///   position in the other.
+		/// @return Returns true if the move was accepted.
+		bool transferMove();
+
+		/// Scales the box and the positions of its molecules.
+		/// @param b The index of the box to scale.
+		/// @param factor The factor applied to each edge of the box.
+		void scale(int b, Real factor);
+
+		/// Moves a molecule to the other box's membership lists.
+		/// @param from The index of the box that held the molecule.
+		/// @param to The index of the box that receives the molecule.
+		/// @param molIdx The index of the molecule.
+		void transferMembership(int from, int to, int molIdx);
+
+		/// @param b The index of a box.
+		/// @return Returns the volume of the box.
+		Real volume(int b);
+
+		void printBoxes();
+		void printResults();
+		void writeInformation(std::ostream &resultsFile);
+		void writeResults(std::ostream &resultsFile);
+};
+
+#endif
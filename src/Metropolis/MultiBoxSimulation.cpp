@@ -0,0 +1,207 @@
+/*
+	Shared driver of the simulations that advance several serial boxes built
+	from the same configuration at once. Each box makes its displacement
+	moves on its own thread with its own random stream; the threads only
+	meet at sync points, where the subclass makes the moves that couple the
+	boxes. Used by the Gibbs ensemble and by solute-tempering replica
+	exchange.
+*/
+
+#include <math.h>
+#include <omp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include "MultiBoxSimulation.h"
+#include "Simulation.h"
+#include "Metropolis/Utilities/MathLibrary.h"
+#include "SerialSim/SerialCalcs.h"
+#include "Utilities/StartupProfile.h"
+
+MultiBoxSimulation::MultiBoxSimulation(SimulationArgs simArgs, int boxCount, const std::string &mode,
+									   unsigned int streamOffset)
+{
+	StartupPhase setupPhase("Simulation-Setup");
+	args = simArgs;
+	this->mode = mode;
+
+	int processorCount = omp_get_num_procs();
+	threadsToSpawn = std::max(processorCount / 2, 1);
+	if (args.threadCount > 0)
+	{
+		threadsToSpawn = std::min(omp_get_max_threads(), args.threadCount);
+	}
+	std::cout << processorCount << " processors detected by OpenMP; using " << threadsToSpawn
+		<< " threads across " << boxCount << " boxes." << std::endl;
+	omp_set_dynamic(0);
+
+	long stepStart = 0;
+	walkers.resize(boxCount);
+	for (int b = 0; b < boxCount; b++)
+	{
+		Walker &walker = walkers[b];
+		walker.box = (SerialBox*) SerialCalcs::createBox(args.filePath, args.fileType, &stepStart, &simSteps);
+		if (walker.box == NULL)
+		{
+			std::cerr << "Error: Unable to initialize simulation Box" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		walker.energy = 0;
+		walker.members = NULL;
+		walker.moves = walker.attempts = walker.accepts = 0;
+		walker.threads = std::max(threadsToSpawn / boxCount, 1);
+		walker.kT = kBoltz * walker.box->environment->temp;
+	}
+
+	if (args.stepCount > 0)
+		simSteps = args.stepCount;
+
+	Environment *enviro = walkers[0].box->environment;
+	for (int b = 0; b < boxCount; b++)
+	{
+		walkers[b].stream = enviro->randomseed + streamOffset * (b + 1);
+	}
+	std::cout << "Using seed: " << enviro->randomseed << std::endl;
+	seed(enviro->randomseed);
+}
+
+MultiBoxSimulation::~MultiBoxSimulation()
+{
+	for (int b = 0; b < walkers.size(); b++)
+	{
+		delete walkers[b].box;
+		walkers[b].box = NULL;
+	}
+}
+
+void MultiBoxSimulation::run()
+{
+	std::cout << "Simulation Name: " << args.simulationName << std::endl;
+
+	{
+		StartupPhase phase("Initial-Energy");
+		for (int b = 0; b < walkers.size(); b++)
+		{
+			walkers[b].energy = SerialCalcs::calcSystemEnergy(walkers[b].box);
+		}
+	}
+	printStartupReport(std::cout);
+	prepare();
+
+	long interval = syncInterval();
+	long cycles = (simSteps + interval - 1) / interval;
+	std::cout << std::endl << "Running " << simSteps << " displacement steps per box in "
+		<< cycles << " cycles" << std::endl << std::endl;
+
+	double startTime = omp_get_wtime();
+	long done = 0;
+	std::vector<pthread_t> threads(walkers.size());
+	for (long cycle = 0; cycle < cycles; cycle++)
+	{
+		if (args.statusInterval > 0 && done % args.statusInterval < interval)
+		{
+			printStatus(cycle);
+		}
+
+		//every box advances independently up to the next sync point
+		for (int b = 0; b < walkers.size(); b++)
+		{
+			walkers[b].moves = std::min(interval, simSteps - done);
+			walkers[b].attempts = 0;
+			walkers[b].accepts = 0;
+			if (pthread_create(&threads[b], NULL, runDisplacements, &walkers[b]) != 0)
+			{
+				std::cerr << "Error: Could not start the thread of box " << b << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+		for (int b = 0; b < walkers.size(); b++)
+		{
+			pthread_join(threads[b], NULL);
+		}
+		done += walkers[0].moves;
+
+		sync(cycle);
+	}
+	printStatus(cycles);
+
+	finish(omp_get_wtime() - startTime);
+}
+
+void *MultiBoxSimulation::runDisplacements(void *walker)
+{
+	Walker *self = (Walker*) walker;
+	SerialBox *box = self->box;
+
+	//each box thread keeps its own random stream and OpenMP team size
+	seedThread(&self->stream);
+	omp_set_num_threads(self->threads);
+
+	for (long move = 0; move < self->moves; move++)
+	{
+		if (self->members != NULL && self->members->empty())
+		{
+			break;
+		}
+		int changeIdx = self->members != NULL ? randomMember(*self->members) : box->chooseMolecule();
+		self->attempts++;
+
+		Real oldEnergyCont = SerialCalcs::calcMolecularEnergyContribution(box, changeIdx);
+		box->changeMolecule(changeIdx);
+		Real newEnergyCont = SerialCalcs::calcMolecularEnergyContribution(box, changeIdx);
+
+		bool accept = newEnergyCont < oldEnergyCont ||
+			exp(-(newEnergyCont - oldEnergyCont) / self->kT) >= randomReal(0.0, 1.0);
+		if (accept)
+		{
+			self->accepts++;
+			self->energy += newEnergyCont - oldEnergyCont;
+			box->commitChange(changeIdx);
+		}
+		else
+		{
+			box->rollback(changeIdx);
+		}
+	}
+
+	return NULL;
+}
+
+int MultiBoxSimulation::randomMember(const std::vector<int> &members)
+{
+	int slot = (int) randomReal(0, members.size());
+	return members[std::min(slot, (int) members.size() - 1)];
+}
+
+void MultiBoxSimulation::printStatus(long cycle)
+{
+	std::cout << "Cycle " << cycle << ":" << std::endl;
+	printBoxes();
+}
+
+void MultiBoxSimulation::finish(double runTime)
+{
+	std::cout << std::endl << "Finished running " << simSteps << " displacement steps per box" << std::endl;
+	std::cout << "Run Time: " << runTime << " seconds" << std::endl;
+	printResults();
+
+	std::string resultsName = Simulation::resultsPath(args);
+	std::ofstream resultsFile(resultsName.c_str());
+	resultsFile << "######### MCGPU Results File #############" << std::endl;
+	resultsFile << "[Information]" << std::endl;
+	if (!args.simulationName.empty())
+		resultsFile << "Simulation-Name = " << args.simulationName << std::endl;
+	resultsFile << "Simulation-Mode = " << mode << std::endl;
+	resultsFile << "Threads-Used = " << threadsToSpawn << std::endl;
+	resultsFile << "Steps = " << simSteps << std::endl;
+	writeInformation(resultsFile);
+	resultsFile << std::endl;
+	resultsFile << "[Results]" << std::endl;
+	resultsFile << "Run-Time = " << runTime << " seconds" << std::endl;
+	writeResults(resultsFile);
+	resultsFile << std::endl;
+	writeStartupReport(resultsFile);
+	resultsFile.close();
+}
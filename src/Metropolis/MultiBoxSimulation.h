@@ -0,0 +1,105 @@
+/*
+	Shared driver of the simulations that advance several serial boxes built
+	from the same configuration at once. Each box makes its displacement
+	moves on its own thread with its own random stream; the threads only
+	meet at sync points, where the subclass makes the moves that couple the
+	boxes. Used by the Gibbs ensemble and by solute-tempering replica
+	exchange.
+*/
+
+#ifndef MULTIBOXSIMULATION_H
+#define MULTIBOXSIMULATION_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "SimulationArgs.h"
+#include "SerialSim/SerialBox.h"
+
+class MultiBoxSimulation
+{
+	public:
+		virtual ~MultiBoxSimulation();
+		void run();
+
+	protected:
+		/// One box, with everything its thread needs.
+		struct Walker
+		{
+			SerialBox *box;
+
+			/// The energy of the box, as its moves see it.
+			Real energy;
+
+			/// The molecules the moves choose from, or NULL to choose
+			///   from every molecule of the box.
+			const std::vector<int> *members;
+
+			/// The displacement moves of the current cycle, and how many
+			///   of them were made and accepted.
+			long moves;
+			long attempts;
+			long accepts;
+
+			unsigned int stream;
+			int threads;
+			Real kT;
+		};
+
+		/// Builds the boxes, divides the threads among them and seeds the
+		///   random streams. Exits if a box can not be built.
+		/// @param simArgs The arguments of the run.
+		/// @param boxCount The number of boxes.
+		/// @param mode The Simulation-Mode of the results file.
+		/// @param streamOffset The seed offset of the stream of each box.
+		MultiBoxSimulation(SimulationArgs simArgs, int boxCount, const std::string &mode, unsigned int streamOffset);
+
+		SimulationArgs args;
+		std::vector<Walker> walkers;
+		long simSteps;
+		int threadsToSpawn;
+		std::string mode;
+
+		/// Picks a uniformly random element of a list.
+		/// @param members A list, which must not be empty.
+		/// @return Returns the element.
+		static int randomMember(const std::vector<int> &members);
+
+		/// @return Returns the displacement moves of each box between two
+		///   sync points.
+		virtual long syncInterval() = 0;
+
+		/// Reports anything the run needs to know before the first cycle,
+		///   once the initial energies are known.
+		virtual void prepare() {}
+
+		/// Makes the moves that couple the boxes, once every box has
+		///   finished the displacement moves of a cycle.
+		/// @param cycle The index of the cycle.
+		virtual void sync(long cycle) = 0;
+
+		/// Prints the state of every box at a status interval.
+		virtual void printBoxes() = 0;
+
+		/// Prints the acceptance of every kind of move at the end of the run.
+		virtual void printResults() = 0;
+
+		/// @param resultsFile Receives the "Key = value" lines of the
+		///   [Information] section that describe the run.
+		virtual void writeInformation(std::ostream &resultsFile) = 0;
+
+		/// @param resultsFile Receives the "Key = value" lines of the
+		///   [Results] section.
+		virtual void writeResults(std::ostream &resultsFile) = 0;
+
+	private:
+		/// Runs the displacement moves of one box between two sync points.
+		/// @param walker A pointer to the Walker of the box.
+		/// @return Returns NULL.
+		static void *runDisplacements(void *walker);
+
+		void printStatus(long cycle);
+		void finish(double runTime);
+};
+
+#endif
@@ -0,0 +1,215 @@
+/*
+	Single-source kernels of the batch energy algorithm. Each function does
+	the work of one thread for one index, and compiles both for the CUDA
+	device and for the host, so the GPU engine (ParallelCalcs) and the CPU
+	thread engine (HostBatchCalcs) run the same code and only differ in how
+	they launch it over the index range.
+*/
+
+#ifndef BATCHKERNELS_H
+#define BATCHKERNELS_H
+
+#include <math.h>
+#include <stdlib.h>
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/Utilities/StructLibrary.h"
+#include "Metropolis/Utilities/Coalesced_Structs.h"
+
+#ifdef __CUDACC__
+#define BATCH_KERNEL __host__ __device__ inline
+#else
+#define BATCH_KERNEL inline
+#endif
+
+/// Marks a molecule slot that is not part of the batch.
+#define BATCH_NO -1
+
+namespace BatchKernels
+{
+	/// Makes a distance periodic within a specified range.
+	/// @param x The distance to be made periodic.
+	/// @param boxDim The magnitude of the periodic range.
+	/// @return Returns the periodic distance.
+	BATCH_KERNEL Real makePeriodic(Real x, Real boxDim)
+	{
+		while (x < -0.5 * boxDim)
+		{
+			x += boxDim;
+		}
+
+		while (x > 0.5 * boxDim)
+		{
+			x -= boxDim;
+		}
+
+		return x;
+	}
+
+	/// Calculates the geometric mean of two values.
+	/// @param d1 The first value.
+	/// @param d2 The second value.
+	/// @return Returns the geometric mean of the two supplied
+	///   values.
+	BATCH_KERNEL Real calcBlending(Real d1, Real d2)
+	{
+		return sqrt(d1 * d2);
+	}
+
+	/// Calculates the LJ energy between two atoms.
+	/// @param atoms Pointer to the AtomData struct.
+	/// @param atom1 The index of the first atom.
+	/// @param atom2 The index of the second atom.
+	/// @param r2 The distance between the two atoms, squared.
+	/// @return Returns the LJ energy between the two specified
+	///   atoms.
+	BATCH_KERNEL Real calc_lj(AtomData *atoms, int atom1, int atom2, Real r2)
+	{
+		//store LJ constants locally
+		Real sigma = calcBlending(atoms->sigma[atom1], atoms->sigma[atom2]);
+		Real epsilon = calcBlending(atoms->epsilon[atom1], atoms->epsilon[atom2]);
+
+		if (r2 == 0.0)
+		{
+			return 0.0;
+		}
+
+		//calculate terms
+		const Real sig2OverR2 = (sigma * sigma) / r2;
+		const Real sig6OverR6 = (sig2OverR2 * sig2OverR2 * sig2OverR2);
+		const Real sig12OverR12 = (sig6OverR6 * sig6OverR6);
+		return 4.0 * epsilon * (sig12OverR12 - sig6OverR6);
+	}
+
+	/// Calculates the charge energy between two atoms.
+	/// @param charge1 The charge of atom 1.
+	/// @param charge2 The charge of atom 2.
+	/// @param r The distance between the two atoms.
+	/// @returns Returns the charge energy between two atoms.
+	BATCH_KERNEL Real calcCharge(Real charge1, Real charge2, Real r)
+	{
+		if (r == 0.0)
+		{
+			return 0.0;
+		}
+
+		// conversion factor below for units in kcal/mol
+		const Real e = 332.06;
+		return (charge1 * charge2 * e) / r;
+	}
+
+	/// Checks the distance between the chosen molecule and one other
+	///   molecule, and stores the index of the other molecule in
+	///   'inCutoff' if it is within the cutoff, or BATCH_NO if not.
+	///   Every slot below the molecule count is written, so the array
+	///   needs no clearing between batches.
+	/// @param molecules Pointer to the MoleculeData struct.
+	/// @param atoms Pointer to the AtomData struct.
+	/// @param currentMol The index of the current changed molecule.
+	/// @param startIdx The optional starting index for other molecules.
+	///   Used for system energy calculation.
+	/// @param enviro Pointer to the Environment struct.
+	/// @param inCutoff Pointer to the neighbor molecules array.
+	/// @param otherMol The index of the other molecule.
+	BATCH_KERNEL void checkMoleculeDistance(MoleculeData *molecules, AtomData *atoms, int currentMol, int startIdx,
+											Environment *enviro, int *inCutoff, int otherMol)
+	{
+		if (otherMol >= molecules->moleculeCount)
+		{
+			return;
+		}
+
+		inCutoff[otherMol] = BATCH_NO;
+
+		//checks validity of molecule pair
+		if (otherMol >= startIdx && otherMol != currentMol)
+		{
+			//find primary atom indices for this pair of molecules
+			int atom1 = molecules->atomsIdx[currentMol] + enviro->primaryAtomIndex;
+			int atom2 = molecules->atomsIdx[otherMol] + enviro->primaryAtomIndex;
+
+			//calculate periodic difference in coordinates
+			Real deltaX = makePeriodic(atoms->x[atom1] - atoms->x[atom2], enviro->x);
+			Real deltaY = makePeriodic(atoms->y[atom1] - atoms->y[atom2], enviro->y);
+			Real deltaZ = makePeriodic(atoms->z[atom1] - atoms->z[atom2], enviro->z);
+
+			Real r2 = (deltaX * deltaX) +
+						(deltaY * deltaY) +
+						(deltaZ * deltaZ);
+
+			//if within cutoff, write index to inCutoff
+			if (r2 < enviro->cutoff * enviro->cutoff)
+			{
+				inCutoff[otherMol] = otherMol;
+			}
+		}
+	}
+
+	/// Calculates the inter-atomic energy of one atom pair of the
+	///   molecule pair (the chosen molecule, a neighbor molecule from the
+	///   batch). Slots without a valid atom pair are set to zero, so
+	///   energies left over from earlier batches are never summed.
+	/// @param molecules Pointer to the MoleculeData struct.
+	/// @param atoms Pointer to the AtomData struct.
+	/// @param currentMol The index of the current changed molecule.
+	/// @param enviro Pointer to the Environment struct.
+	/// @param energies Pointer to the energies array.
+	/// @param energyCount The maximum index to be used in the
+	///   energies array.
+	/// @param molBatch Pointer to the list of valid neighbor
+	///   molecule indexes.
+	/// @param maxMolSize The size (in Atoms) of the largest molecule.
+	///   Used for energy segmentation size calculation.
+	/// @param energyIdx The slot of the atom pair in the energies array.
+	BATCH_KERNEL void calcInterAtomicEnergy(MoleculeData *molecules, AtomData *atoms, int currentMol,
+											Environment *enviro, Real *energies, int energyCount,
+											int *molBatch, int maxMolSize, int energyIdx)
+	{
+		if (energyIdx >= energyCount)
+		{
+			return;
+		}
+
+		int segmentSize = maxMolSize * maxMolSize;
+		Real totalEnergy = 0;
+
+		//get other molecule index
+		int otherMol = molBatch[energyIdx / segmentSize];
+		if (otherMol != BATCH_NO)
+		{
+			//get atom pair for this index
+			int x = (energyIdx % segmentSize) / maxMolSize;
+			int y = (energyIdx % segmentSize) % maxMolSize;
+
+			//check validity of atom pair
+			if (x < molecules->numOfAtoms[currentMol] && y < molecules->numOfAtoms[otherMol])
+			{
+				//get atom indices
+				int atom1 = molecules->atomsIdx[currentMol] + x;
+				int atom2 = molecules->atomsIdx[otherMol] + y;
+
+				//check validity of atoms (ensure they are not dummy atoms)
+				if (atoms->sigma[atom1] >= 0 && atoms->epsilon[atom1] >= 0 &&
+					atoms->sigma[atom2] >= 0 && atoms->epsilon[atom2] >= 0)
+				{
+					//calculate periodic distance between atoms
+					Real deltaX = makePeriodic(atoms->x[atom1] - atoms->x[atom2], enviro->x);
+					Real deltaY = makePeriodic(atoms->y[atom1] - atoms->y[atom2], enviro->y);
+					Real deltaZ = makePeriodic(atoms->z[atom1] - atoms->z[atom2], enviro->z);
+
+					Real r2 = (deltaX * deltaX) +
+						 (deltaY * deltaY) +
+						 (deltaZ * deltaZ);
+
+					//calculate interatomic energies
+					totalEnergy += calc_lj(atoms, atom1, atom2, r2);
+					totalEnergy += calcCharge(atoms->charge[atom1], atoms->charge[atom2], sqrt(r2));
+				}
+			}
+		}
+
+		//store energy
+		energies[energyIdx] = totalEnergy;
+	}
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*
+	Holds the coalesced molecule data used by the batch algorithm when it
+	runs on host CPU threads. The host counterpart of ParallelBox.
+	Subclass of Box.
+*/
+
+#include "HostBatchBox.h"
+
+HostBatchBox::HostBatchBox(): Box()
+{
+	atomsH = NULL;
+	moleculesH = NULL;
+	nbrMolsH = NULL;
+	molBatchH = NULL;
+	energiesH = NULL;
+	energyCount = 0;
+	maxMolSize = 0;
+}
+
+HostBatchBox::~HostBatchBox()
+{
+	if (atomsH != NULL)
+	{
+		FREE(atomsH->x);
+		FREE(atomsH->y);
+		FREE(atomsH->z);
+		FREE(atomsH->sigma);
+		FREE(atomsH->epsilon);
+		FREE(atomsH->charge);
+		delete atomsH;
+	}
+	if (moleculesH != NULL)
+	{
+		FREE(moleculesH->atomsIdx);
+		FREE(moleculesH->numOfAtoms);
+		delete moleculesH;
+	}
+	FREE(nbrMolsH);
+	FREE(molBatchH);
+	FREE(energiesH);
+}
+
+int HostBatchBox::changeMolecule(int molIdx)
+{
+	Box::changeMolecule(molIdx);
+	writeChange(molIdx);
+
+	return molIdx;
+}
+
+int HostBatchBox::rollback(int molIdx)
+{
+	Box::rollback(molIdx);
+	writeChange(molIdx);
+
+	return molIdx;
+}
+
+void HostBatchBox::buildBatchData()
+{
+	atomsH = new AtomData(atoms, atomCount);
+	moleculesH = new MoleculeData(molecules, moleculeCount);
+
+	//data structures for neighbor batch in energy calculation
+	nbrMolsH = (int*) malloc(moleculeCount * sizeof(int));
+	molBatchH = (int*) malloc(moleculeCount * sizeof(int));
+
+	//upper bound on number of atoms in any molecule
+	maxMolSize = 0;
+	for (int i = 0; i < moleculesH->moleculeCount; i++)
+	{
+		if (moleculesH->numOfAtoms[i] > maxMolSize)
+		{
+			maxMolSize = moleculesH->numOfAtoms[i];
+		}
+	}
+
+	//one segment of energies for each molecule, with room for every
+	//interatomic energy of one pair of molecules
+	energyCount = moleculesH->moleculeCount * maxMolSize * maxMolSize;
+	energiesH = (Real*) calloc(energyCount, sizeof(Real));
+}
+
+void HostBatchBox::writeChange(int changeIdx)
+{
+	//sigma, epsilon, and charge will not change, so only positions are copied
+	int startIdx = moleculesH->atomsIdx[changeIdx];
+	for (int i = 0; i < molecules[changeIdx].numOfAtoms; i++)
+	{
+		atomsH->x[startIdx + i] = molecules[changeIdx].atoms[i].x;
+		atomsH->y[startIdx + i] = molecules[changeIdx].atoms[i].y;
+		atomsH->z[startIdx + i] = molecules[changeIdx].atoms[i].z;
+	}
+}
@@ -0,0 +1,51 @@
+/*
+	Holds the coalesced molecule data used by the batch algorithm when it
+	runs on host CPU threads. The host counterpart of ParallelBox.
+	Subclass of Box.
+*/
+
+#ifndef HOSTBATCHBOX_H
+#define HOSTBATCHBOX_H
+
+#include "Metropolis/Box.h"
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/Utilities/StructLibrary.h"
+#include "Metropolis/Utilities/Coalesced_Structs.h"
+
+class HostBatchBox : public Box
+{
+	private:
+		/// Copies the atoms of a changed molecule into the coalesced
+		///   arrays. Called after changing a molecule in the simulation.
+		/// @param changeIdx The index of the changed molecule.
+		void writeChange(int changeIdx);
+
+	public:
+		AtomData *atomsH;
+		MoleculeData *moleculesH;
+		int *nbrMolsH, *molBatchH;
+		Real *energiesH;
+		int energyCount, maxMolSize;
+
+		HostBatchBox();
+		~HostBatchBox();
+
+		/// Changes a specified molecule in a random way, and updates
+		///   the coalesced arrays.
+		/// @param molIdx The index of the molecule to be changed.
+		/// @return Returns the index of the changed molecule.
+		virtual int changeMolecule(int molIdx);
+
+		/// Rolls back the previous changes to the specified molecule,
+		///   and updates the coalesced arrays.
+		/// @param molIdx The index of the molecule that was changed.
+		/// @return Returns the index of the changed molecule.
+		virtual int rollback(int molIdx);
+
+		/// Builds the coalesced arrays and the batch buffers from the
+		///   loaded molecules, as ParallelBox::copyDataToDevice does
+		///   for the device.
+		void buildBatchData();
+};
+
+#endif
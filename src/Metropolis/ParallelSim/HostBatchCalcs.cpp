@@ -0,0 +1,107 @@
+/*
+	Runs the batch energy algorithm of the parallel engine on host CPU
+	threads. The kernels are shared with ParallelCalcs through
+	BatchKernels.h; only the launches over the index ranges differ.
+*/
+
+#include <iostream>
+#include <omp.h>
+#include "HostBatchCalcs.h"
+#include "BatchKernels.h"
+#include "Metropolis/Utilities/FileUtilities.h"
+
+Box* HostBatchCalcs::createBox(std::string inputPath, InputFileType inputType, long* startStep, long* steps)
+{
+	HostBatchBox* box = new HostBatchBox();
+	if (!loadBoxData(inputPath, inputType, box, startStep, steps))
+	{
+		if (inputType != InputFile::Unknown)
+		{
+			std::cerr << "Error: Could not build from file: " << inputPath << std::endl;
+			return NULL;
+		}
+		else
+		{
+			std::cerr << "Error: Can not build environment with unknown file: " << inputPath << std::endl;
+			return NULL;
+		}
+	}
+	box->buildBatchData();
+	return (Box*) box;
+}
+
+Real HostBatchCalcs::calcSystemEnergy(Box *box)
+{
+	Real totalEnergy = 0;
+
+	//for each molecule
+	for (int mol = 0; mol < box->moleculeCount; mol++)
+	{
+		//use startIdx parameter to prevent double-calculating energies (Ex mols 3->5 and mols 5->3)
+		totalEnergy += calcMolecularEnergyContribution(box, mol, mol + 1);
+	}
+
+	return totalEnergy;
+}
+
+Real HostBatchCalcs::calcMolecularEnergyContribution(Box *box, int molIdx, int startIdx)
+{
+	HostBatchBox *hBox = (HostBatchBox*) box;
+
+	if (hBox == NULL)
+	{
+		return 0;
+	}
+
+	return calcBatchEnergy(hBox, createMolBatch(hBox, molIdx, startIdx), molIdx);
+}
+
+int HostBatchCalcs::createMolBatch(HostBatchBox *box, int currentMol, int startIdx)
+{
+	//check molecule distances in parallel, one index per iteration as one thread per index on the device
+	#pragma omp parallel for schedule(static)
+	for (int otherMol = 0; otherMol < box->moleculeCount; otherMol++)
+	{
+		BatchKernels::checkMoleculeDistance(box->moleculesH, box->atomsH, currentMol, startIdx,
+											box->environment, box->nbrMolsH, otherMol);
+	}
+
+	//copy over neighbor molecules that don't have BATCH_NO as their index value
+	int batchSize = 0;
+	for (int i = 0; i < box->moleculeCount; i++)
+	{
+		if (box->nbrMolsH[i] != BATCH_NO)
+		{
+			box->molBatchH[batchSize++] = box->nbrMolsH[i];
+		}
+	}
+
+	return batchSize;
+}
+
+Real HostBatchCalcs::calcBatchEnergy(HostBatchBox *box, int numMols, int molIdx)
+{
+	if (numMols <= 0) return 0;
+
+	//There will only be as many energy segments filled in as there are molecules in the batch.
+	int validEnergies = numMols * box->maxMolSize * box->maxMolSize;
+
+	//calculate interatomic energies between changed molecule and all molecules in batch
+	#pragma omp parallel for schedule(static)
+	for (int energyIdx = 0; energyIdx < validEnergies; energyIdx++)
+	{
+		BatchKernels::calcInterAtomicEnergy(box->moleculesH, box->atomsH, molIdx, box->environment,
+											box->energiesH, validEnergies, box->molBatchH,
+											box->maxMolSize, energyIdx);
+	}
+
+	//sum reduction on all of the individual energy contributions
+	Real totalEnergy = 0;
+	#pragma omp parallel for schedule(static) reduction(+:totalEnergy)
+	for (int energyIdx = 0; energyIdx < validEnergies; energyIdx++)
+	{
+		totalEnergy += box->energiesH[energyIdx];
+	}
+
+	return totalEnergy;
+}
@@ -0,0 +1,62 @@
+/*
+	Runs the batch energy algorithm of the parallel engine on host CPU
+	threads. The kernels are shared with ParallelCalcs through
+	BatchKernels.h; only the launches over the index ranges differ.
+*/
+
+#ifndef HOSTBATCHCALCS_H
+#define HOSTBATCHCALCS_H
+
+#include <string>
+#include "Metropolis/Box.h"
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/SimulationArgs.h"
+#include "HostBatchBox.h"
+
+namespace HostBatchCalcs
+{
+	/// Factory method for creating a Box from a configuration file.
+	/// @param inputPath The path to the configuration or state file.
+	/// @param inputType The type of the input file.
+	/// @param startStep Filled with the first step of the simulation.
+	/// @param steps Filled with the number of steps in the input file.
+	/// @return Returns a pointer to the filled-in Box.
+	Box* createBox(std::string inputPath, InputFileType inputType, long* startStep, long* steps);
+
+	/// Calculates the system energy using consecutive calls to
+	///   calcMolecularEnergyContribution.
+	/// @param box A HostBatchBox cast as a Box, passed from Simulation.
+	/// @return Returns total system energy.
+	Real calcSystemEnergy(Box *box);
+
+	/// Calculates the inter-molecular energy contribution of a given molecule,
+	///   without intramolecular energy, using the batch method.
+	/// @param box A HostBatchBox cast as a Box, passed from Simulation.
+	/// @param molIdx the index of the current changed molecule.
+	/// @param startIdx The optional starting index for other molecules.
+	///   Used for system energy calculation.
+	/// @return Returns total molecular energy contribution, without
+	///   intramolecular energy.
+	Real calcMolecularEnergyContribution(Box *box, int molIdx, int startIdx = 0);
+
+	/// Creates a batch of molecule IDs within the cutoff distance of
+	///   the chosen molecule, and returns the batch size.
+	/// @param box A HostBatchBox containing the molecule data.
+	/// @param currentMol The index of the current changed molecule.
+	/// @param startIdx The optional starting index for other molecules.
+	///   Used for system energy calculation.
+	/// @return Returns batch size (number of molecules within cutoff).
+	int createMolBatch(HostBatchBox *box, int currentMol, int startIdx);
+
+	/// Given a box with a filled-in molecule batch, calculate the
+	///   inter-molecular energy contribution of a given molecule,
+	///   with every molecule specified in the batch.
+	/// @param box A HostBatchBox containing the molecule data.
+	/// @param numMols The number of molecules within the cutoff.
+	/// @param molIdx The index of the current changed molecule.
+	/// @return Returns total molecular energy contribution, without
+	///   intramolecular energy.
+	Real calcBatchEnergy(HostBatchBox *box, int numMols, int molIdx);
+}
+
+#endif
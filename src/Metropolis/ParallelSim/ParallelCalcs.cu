@@ -11,8 +11,10 @@
 #include "ParallelCalcs.h"
 #include "ParallelCalcs.cuh"
 #include "ParallelBox.cuh"
+#include "BatchKernels.h"
 #include <string>
 #include "Metropolis/Utilities/FileUtilities.h"
+#include "Metropolis/Utilities/StartupProfile.h"
 #include "Metropolis/Box.h"
 #include "Metropolis/SimulationArgs.h"
 #include <thrust/reduce.h>
@@ -20,8 +22,6 @@
 #include <thrust/remove.h>
 #include <thrust/device_ptr.h>
 
-#define NO -1
-
 #define MAX_WARP 32
 #define MOL_BLOCK 256
 #define BATCH_BLOCK 512
@@ -45,7 +45,10 @@ Box* ParallelCalcs::createBox(string inputPath, InputFileType inputType, long* s
 			return NULL;
 		}
 	}
-	box->copyDataToDevice();
+	{
+		StartupPhase phase("Device-Copy");
+		box->copyDataToDevice();
+	}
 	return (Box*) box;
 }
 
@@ -77,22 +80,19 @@ Real ParallelCalcs::calcMolecularEnergyContribution(Box *box, int molIdx, int st
 
 struct isThisTrue {
 	__device__ bool operator()(const int &x) {
-	  return x != NO;
+	  return x != BATCH_NO;
 	}
 };
 
 int ParallelCalcs::createMolBatch(ParallelBox *box, int currentMol, int startIdx)
 {
-	//initialize neighbor molecule slots to NO
-	cudaMemset(box->nbrMolsD, NO, box->moleculeCount * sizeof(int));
-	
-	//check molecule distances in parallel, conditionally replacing NO with index value in box->nbrMolsD
+	//check molecule distances in parallel, writing either BATCH_NO or the index value to each slot of box->nbrMolsD
 	checkMoleculeDistances<<<box->moleculeCount / MOL_BLOCK + 1, MOL_BLOCK>>>(box->moleculesD, box->atomsD, currentMol, startIdx, box->environmentD, box->nbrMolsD);
 	
 	thrust::device_ptr<int> neighborMoleculesOnDevice = thrust::device_pointer_cast(&box->nbrMolsD[0]);
 	thrust::device_ptr<int> moleculesInBatchOnDevice = thrust::device_pointer_cast(&box->molBatchD[0]);
 	
-	//copy over neighbor molecules that don't have NO as their index value
+	//copy over neighbor molecules that don't have BATCH_NO as their index value
 	thrust::device_ptr<int> lastElementFound = thrust::copy_if(neighborMoleculesOnDevice, neighborMoleculesOnDevice + box->moleculeCount, moleculesInBatchOnDevice, isThisTrue());
 	
 	return lastElementFound - moleculesInBatchOnDevice;
@@ -117,133 +117,13 @@ Real ParallelCalcs::calcBatchEnergy(ParallelBox *box, int numMols, int molIdx)
 __global__ void ParallelCalcs::checkMoleculeDistances(MoleculeData *molecules, AtomData *atoms, int currentMol, int startIdx, Environment *enviro, int *inCutoff)
 {
 	int otherMol = blockIdx.x * blockDim.x + threadIdx.x;
-	
-	//checks validity of molecule pair
-	if (otherMol < molecules->moleculeCount && otherMol >= startIdx && otherMol != currentMol)
-	{
-		//find primary atom indices for this pair of molecules
-		int atom1 = molecules->atomsIdx[currentMol] + enviro->primaryAtomIndex;
-		int atom2 = molecules->atomsIdx[otherMol] + enviro->primaryAtomIndex;
-			
-		//calculate periodic difference in coordinates
-		Real deltaX = makePeriodic(atoms->x[atom1] - atoms->x[atom2], enviro->x);
-		Real deltaY = makePeriodic(atoms->y[atom1] - atoms->y[atom2], enviro->y);
-		Real deltaZ = makePeriodic(atoms->z[atom1] - atoms->z[atom2], enviro->z);
-		
-		Real r2 = (deltaX * deltaX) +
-					(deltaY * deltaY) + 
-					(deltaZ * deltaZ);
-		
-		//if within curoff, write index to inCutoff
-		if (r2 < enviro->cutoff * enviro->cutoff)
-		{
-			inCutoff[otherMol] = otherMol;
-		}
-	}
+	BatchKernels::checkMoleculeDistance(molecules, atoms, currentMol, startIdx, enviro, inCutoff, otherMol);
 }
 
 __global__ void ParallelCalcs::calcInterAtomicEnergy(MoleculeData *molecules, AtomData *atoms, int currentMol, Environment *enviro, Real *energies, int energyCount, int *molBatch, int maxMolSize)
 {
 	int energyIdx = blockIdx.x * blockDim.x + threadIdx.x;
-	int segmentSize = maxMolSize * maxMolSize;
-	
-	//check validity of thread
-	if (energyIdx < energyCount and molBatch[energyIdx / segmentSize] != NO)
-	{
-		//get other molecule index
-		int otherMol = molBatch[energyIdx / segmentSize];
-		
-		//get atom pair for this thread
-		int x = (energyIdx % segmentSize) / maxMolSize;
-		int y = (energyIdx % segmentSize) % maxMolSize;
-		
-		//check validity of atom pair
-		if (x < molecules->numOfAtoms[currentMol] && y < molecules->numOfAtoms[otherMol])
-		{
-			//get atom indices
-			int atom1 = molecules->atomsIdx[currentMol] + x;
-			int atom2 = molecules->atomsIdx[otherMol] + y;
-			
-			//check validity of atoms (ensure they are not dummy atoms)
-			if (atoms->sigma[atom1] >= 0 && atoms->epsilon[atom1] >= 0 && atoms->sigma[atom2] >= 0 && atoms->epsilon[atom2] >= 0)
-			{
-				Real totalEnergy = 0;
-			  
-				//calculate periodic distance between atoms
-				Real deltaX = makePeriodic(atoms->x[atom1] - atoms->x[atom2], enviro->x);
-				Real deltaY = makePeriodic(atoms->y[atom1] - atoms->y[atom2], enviro->y);
-				Real deltaZ = makePeriodic(atoms->z[atom1] - atoms->z[atom2], enviro->z);
-				
-				Real r2 = (deltaX * deltaX) +
-					 (deltaY * deltaY) + 
-					 (deltaZ * deltaZ);
-				
-				//calculate interatomic energies
-				totalEnergy += calc_lj(atoms, atom1, atom2, r2);
-				totalEnergy += calcCharge(atoms->charge[atom1], atoms->charge[atom2], sqrt(r2));
-				
-				//store energy
-				energies[energyIdx] = totalEnergy;
-			}
-		}
-	}
-}
-
-__device__ Real ParallelCalcs::calc_lj(AtomData *atoms, int atom1, int atom2, Real r2)
-{
-    //store LJ constants locally
-    Real sigma = calcBlending(atoms->sigma[atom1], atoms->sigma[atom2]);
-    Real epsilon = calcBlending(atoms->epsilon[atom1], atoms->epsilon[atom2]);
-    
-    if (r2 == 0.0)
-    {
-        return 0.0;
-    }
-    else
-    {
-    	//calculate terms
-    	const Real sig2OverR2 = (sigma*sigma) / r2;
-		const Real sig6OverR6 = (sig2OverR2*sig2OverR2*sig2OverR2);
-    	const Real sig12OverR12 = (sig6OverR6*sig6OverR6);
-    	const Real energy = 4.0 * epsilon * (sig12OverR12 - sig6OverR6);
-        return energy;
-    }
-}
-
-__device__ Real ParallelCalcs::calcCharge(Real charge1, Real charge2, Real r)
-{  
-    if (r == 0.0)
-    {
-        return 0.0;
-    }
-    else
-    {
-    	// conversion factor below for units in kcal/mol
-    	const Real e = 332.06;
-        return (charge1 * charge2 * e) / r;
-    }
-}
-
-__device__ Real ParallelCalcs::makePeriodic(Real x, Real boxDim)
-{
-    
-    while(x < -0.5 * boxDim)
-    {
-        x += boxDim;
-    }
-
-    while(x > 0.5 * boxDim)
-    {
-        x -= boxDim;
-    }
-
-    return x;
-
-}
-
-__device__ Real ParallelCalcs::calcBlending(Real d1, Real d2)
-{
-    return sqrt(d1 * d2);
+	BatchKernels::calcInterAtomicEnergy(molecules, atoms, currentMol, enviro, energies, energyCount, molBatch, maxMolSize, energyIdx);
 }
 
 __device__ int ParallelCalcs::getXFromIndex(int idx)
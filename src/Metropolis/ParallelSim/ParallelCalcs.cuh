@@ -52,7 +52,8 @@ namespace ParallelCalcs
 	///   other molecule. If within cutoff, store index of other
 	///   molecule in the 'inCutoff' array. This array will be
 	///   compacted to form the molecule batch for the energy
-	///   calculations.
+	///   calculations. The work of a thread is done by
+	///   BatchKernels::checkMoleculeDistance.
 	/// @param molecules Device pointer to MoleculeData struct.
 	/// @param atoms Device pointer to AtomData struct.
 	/// @param currentMol The index of the current changed molecule.
@@ -66,6 +67,8 @@ namespace ParallelCalcs
 	/// Each thread in this kernel calculates the inter-atomic
 	///   energy between one pair of atoms in the molecule pair
 	///   (the chosen molecule, a neighbor molecule from the batch).
+	///   The work of a thread is done by
+	///   BatchKernels::calcInterAtomicEnergy.
 	/// @param molecules Device pointer to MoleculeData struct.
 	/// @param atoms Device pointer to AtomData struct.
 	/// @param currentMol The index of the current changed molecule.
@@ -96,35 +99,6 @@ namespace ParallelCalcs
 	///   found will have been reset to 0.
 	__global__ void aggregateEnergies(Real *energies, int numEnergies, int interval, int batchSize);
 	
-	/// Calculates the LJ energy between two atoms.
-	/// @param atoms Device pointer to AtomData struct.
-	/// @param atom1 The index of the first atom.
-	/// @param atom2 The index of the second atom.
-	/// @param r2 The distance between the two atoms, squared.
-	/// @return Returns the LJ energy between the two specified
-	///   atoms.
-	__device__ Real calc_lj(AtomData *atoms, int atom1, int atom2, Real r2);
-	
-	/// Calculates the charge energy between two atoms.
-	/// @param charge1 The charge of atom 1.
-	/// @param charge2 The charge of atom 2.
-	/// @param r The distance between the two atoms.
-	/// @returns Returns the charge energy between two atoms.
-	__device__ Real calcCharge(Real charge1, Real charge2, Real r);
-	
-	/// Makes a distance periodic within a specified range.
-	/// @param x The distance to be made periodic.
-	/// @param boxDim The magnitude of the periodic range.
-	/// @return Returns the periodic distance.
-	__device__ Real makePeriodic(Real x, Real boxDim);
-	
-	/// Calculates the geometric mean of two values.
-	/// @param d1 The first value.
-	/// @param d2 The second value.
-	/// @return Returns the geometric mean of the two supplied
-	///   values.
-	__device__ Real calcBlending(Real d1, Real d2);
-	
 	/// This method, combined with getYFromIndex(),
 	///   provides functionality to generate a non-overlapping
 	///   sequence of unique index pairs. For example,
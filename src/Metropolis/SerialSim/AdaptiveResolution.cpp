@@ -0,0 +1,239 @@
+/*
+	Adaptive-resolution (AdResS) sampling around a solute. Molecules whose
+	primary atoms lie within a radius of the solute's starting position are
+	fully atomistic, those beyond a hybrid shell are single sites, and the
+	weight of a molecule falls smoothly from one to zero across the shell.
+	A pair is the blend lambda * atomistic + (1 - lambda) * coarse-grained,
+	where lambda is the product of the two weights, so the atom-atom double
+	loop is skipped for every pair with a coarse-grained member.
+
+	The coarse-grained potential of each pair of molecule kinds is tabulated
+	when the box is prepared, as the orientation-averaged free energy of two
+	atomistic molecules at each separation of their primary atoms.
+*/
+
+#include <math.h>
+#include <algorithm>
+#include "AdaptiveResolution.h"
+#include "SerialCalcs.h"
+#include "Metropolis/Utilities/MathLibrary.h"
+
+AdaptiveResolution::AdaptiveResolution()
+{
+	solute = -1;
+	radius = 0;
+	width = 0;
+	kT = 0;
+	tableSize = 0;
+}
+
+void AdaptiveResolution::configure(int solute, Real radius, Real width, Real kT)
+{
+	this->solute = solute;
+	this->radius = radius;
+	this->width = width;
+	this->kT = kT;
+}
+
+bool AdaptiveResolution::isEnabled() const
+{
+	return radius > 0;
+}
+
+bool AdaptiveResolution::isBuilt(int moleculeCount) const
+{
+	return kindOf.size() == moleculeCount;
+}
+
+void AdaptiveResolution::build(Molecule *molecules, Environment *environment)
+{
+	center = molecules[solute].atoms[environment->primaryAtomIndex];
+
+	kindOf.assign(environment->numOfMolecules, -1);
+	templates.clear();
+	for (int i = 0; i < environment->numOfMolecules; i++)
+	{
+		for (int k = 0; k < templates.size() && kindOf[i] < 0; k++)
+		{
+			if (sameAtomParameters(molecules[i], molecules[templates[k]]))
+			{
+				kindOf[i] = k;
+			}
+		}
+		if (kindOf[i] < 0)
+		{
+			kindOf[i] = templates.size();
+			templates.push_back(i);
+		}
+	}
+
+	std::vector<std::vector<Atom> > bodies(templates.size());
+	for (int k = 0; k < templates.size(); k++)
+	{
+		bodyFrame(molecules[templates[k]], environment, bodies[k]);
+	}
+
+	//the orientations come from a fixed stream of their own, so the tables
+	//are reproducible and the simulation stream is left untouched
+	unsigned int stream = ADRESS_TABLE_SEED;
+	seedThread(&stream);
+
+	int kinds = templates.size();
+	tableSize = (int) (environment->cutoff / ADRESS_TABLE_SPACING) + 2;
+	tables.assign(kinds * kinds * tableSize, 0);
+	for (int a = 0; a < kinds; a++)
+	{
+		for (int b = a; b < kinds; b++)
+		{
+			Real *table = &tables[(a * kinds + b) * tableSize];
+			for (int i = 1; i < tableSize; i++)
+			{
+				table[i] = tabulate(bodies[a], bodies[b], i * ADRESS_TABLE_SPACING);
+			}
+			table[0] = table[1];
+		}
+	}
+
+	seedThread(NULL);
+}
+
+Real AdaptiveResolution::weight(Molecule *molecules, Environment *environment, int molIdx) const
+{
+	if (molIdx == solute)
+	{
+		return 1;
+	}
+
+	Atom primary = molecules[molIdx].atoms[environment->primaryAtomIndex];
+	Real dx = SerialCalcs::makePeriodic(primary.x - center.x, environment->x, environment->periodic);
+	Real dy = SerialCalcs::makePeriodic(primary.y - center.y, environment->y, environment->periodic);
+	Real dz = SerialCalcs::makePeriodic(primary.z - center.z, environment->z, environment->periodic);
+	Real distance = sqrt(dx * dx + dy * dy + dz * dz);
+
+	if (distance <= radius)
+	{
+		return 1;
+	}
+	if (distance >= radius + width)
+	{
+		return 0;
+	}
+	Real c = cos(0.5 * PI * (distance - radius) / width);
+	return c * c;
+}
+
+Real AdaptiveResolution::coarseEnergy(Molecule *molecules, Environment *environment, int mol1, int mol2) const
+{
+	Atom atom1 = molecules[mol1].atoms[environment->primaryAtomIndex];
+	Atom atom2 = molecules[mol2].atoms[environment->primaryAtomIndex];
+	Real dx = SerialCalcs::makePeriodic(atom1.x - atom2.x, environment->x, environment->periodic);
+	Real dy = SerialCalcs::makePeriodic(atom1.y - atom2.y, environment->y, environment->periodic);
+	Real dz = SerialCalcs::makePeriodic(atom1.z - atom2.z, environment->z, environment->periodic);
+
+	int a = std::min(kindOf[mol1], kindOf[mol2]);
+	int b = std::max(kindOf[mol1], kindOf[mol2]);
+	const Real *table = &tables[(a * templates.size() + b) * tableSize];
+
+	//linear interpolation, held at the last entry past the cutoff
+	Real position = sqrt(dx * dx + dy * dy + dz * dz) / ADRESS_TABLE_SPACING;
+	int i = (int) position;
+	if (i >= tableSize - 1)
+	{
+		return table[tableSize - 1];
+	}
+	Real fraction = position - i;
+	return table[i] + fraction * (table[i + 1] - table[i]);
+}
+
+void AdaptiveResolution::countRegions(Molecule *molecules, Environment *environment,
+									  int *atomistic, int *hybrid, int *coarse) const
+{
+	*atomistic = *hybrid = *coarse = 0;
+	for (int i = 0; i < environment->numOfMolecules; i++)
+	{
+		Real w = weight(molecules, environment, i);
+		if (w >= 1)
+		{
+			(*atomistic)++;
+		}
+		else if (w > 0)
+		{
+			(*hybrid)++;
+		}
+		else
+		{
+			(*coarse)++;
+		}
+	}
+}
+
+int AdaptiveResolution::kindCount() const
+{
+	return templates.size();
+}
+
+Real AdaptiveResolution::tabulate(const std::vector<Atom> &body1, const std::vector<Atom> &body2, Real r) const
+{
+	//-kT ln <exp(-E / kT)> over random orientations of both molecules,
+	//summed with the largest exponent factored out
+	std::vector<double> exponents(ADRESS_ORIENTATION_SAMPLES);
+	double largest = -HUGE_VAL;
+	for (int s = 0; s < ADRESS_ORIENTATION_SAMPLES; s++)
+	{
+		Real rotation1[3][3], rotation2[3][3];
+		randomRotation(rotation1);
+		randomRotation(rotation2);
+
+		double energy = 0;
+		for (int i = 0; i < body1.size(); i++)
+		{
+			Atom atom1 = body1[i];
+			atom1.x = rotation1[0][0] * body1[i].x + rotation1[0][1] * body1[i].y + rotation1[0][2] * body1[i].z;
+			atom1.y = rotation1[1][0] * body1[i].x + rotation1[1][1] * body1[i].y + rotation1[1][2] * body1[i].z;
+			atom1.z = rotation1[2][0] * body1[i].x + rotation1[2][1] * body1[i].y + rotation1[2][2] * body1[i].z;
+			for (int j = 0; j < body2.size(); j++)
+			{
+				Atom atom2 = body2[j];
+				atom2.x = r + rotation2[0][0] * body2[j].x + rotation2[0][1] * body2[j].y + rotation2[0][2] * body2[j].z;
+				atom2.y = rotation2[1][0] * body2[j].x + rotation2[1][1] * body2[j].y + rotation2[1][2] * body2[j].z;
+				atom2.z = rotation2[2][0] * body2[j].x + rotation2[2][1] * body2[j].y + rotation2[2][2] * body2[j].z;
+
+				Real dx = atom1.x - atom2.x;
+				Real dy = atom1.y - atom2.y;
+				Real dz = atom1.z - atom2.z;
+				Real r2 = dx * dx + dy * dy + dz * dz;
+				energy += SerialCalcs::calc_lj(atom1, atom2, r2);
+				energy += SerialCalcs::calcCharge(atom1.charge, atom2.charge, sqrt(r2));
+			}
+		}
+		exponents[s] = -energy / kT;
+		largest = std::max(largest, exponents[s]);
+	}
+
+	double sum = 0;
+	for (int s = 0; s < ADRESS_ORIENTATION_SAMPLES; s++)
+	{
+		sum += exp(exponents[s] - largest);
+	}
+	return -kT * (largest + log(sum / ADRESS_ORIENTATION_SAMPLES));
+}
+
+void AdaptiveResolution::bodyFrame(const Molecule &molecule, Environment *environment, std::vector<Atom> &body)
+{
+	//only the atoms that calcInterMolecularEnergy counts, unwrapped about
+	//the primary atom, which becomes the coarse-grained site
+	Atom primary = molecule.atoms[environment->primaryAtomIndex];
+	body.clear();
+	for (int i = 0; i < molecule.numOfAtoms; i++)
+	{
+		Atom atom = molecule.atoms[i];
+		if (atom.sigma < 0 || atom.epsilon < 0)
+		{
+			continue;
+		}
+		atom.x = SerialCalcs::makePeriodic(atom.x - primary.x, environment->x, environment->periodic);
+		atom.y = SerialCalcs::makePeriodic(atom.y - primary.y, environment->y, environment->periodic);
+		atom.z = SerialCalcs::makePeriodic(atom.z - primary.z, environment->z, environment->periodic);
+		body.push_back(atom);
+	}
+}
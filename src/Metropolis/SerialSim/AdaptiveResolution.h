@@ -0,0 +1,103 @@
+/*
+	Adaptive-resolution (AdResS) sampling around a solute. Molecules whose
+	primary atoms lie within a radius of the solute's starting position are
+	fully atomistic, those beyond a hybrid shell are single sites, and the
+	weight of a molecule falls smoothly from one to zero across the shell.
+	A pair is the blend lambda * atomistic + (1 - lambda) * coarse-grained,
+	where lambda is the product of the two weights, so the atom-atom double
+	loop is skipped for every pair with a coarse-grained member.
+
+	The coarse-grained potential of each pair of molecule kinds is tabulated
+	when the box is prepared, as the orientation-averaged free energy of two
+	atomistic molecules at each separation of their primary atoms.
+*/
+
+#ifndef ADAPTIVERESOLUTION_H
+#define ADAPTIVERESOLUTION_H
+
+#include <vector>
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/Utilities/StructLibrary.h"
+
+/// The spacing of the coarse-grained tables, in angstroms.
+#define ADRESS_TABLE_SPACING 0.1
+
+/// The random orientations averaged at each table distance.
+#define ADRESS_ORIENTATION_SAMPLES 200
+
+/// Seed of the random orientations, kept apart from the simulation stream.
+#define ADRESS_TABLE_SEED 12345
+
+class AdaptiveResolution
+{
+	public:
+		AdaptiveResolution();
+
+		/// Enables adaptive resolution. A radius of zero disables it.
+		/// @param solute The index of the molecule at the center of the
+		///   atomistic region, which is always atomistic itself.
+		/// @param radius The radius of the atomistic region, in angstroms.
+		/// @param width The width of the hybrid shell, in angstroms.
+		/// @param kT The thermal energy used to average orientations.
+		void configure(int solute, Real radius, Real width, Real kT);
+
+		/// @return Returns true if adaptive resolution is enabled.
+		bool isEnabled() const;
+
+		/// Checks whether the tables cover the given number of molecules.
+		/// @param moleculeCount The number of molecules in the box.
+		/// @return Returns true if the tables have been built for the box.
+		bool isBuilt(int moleculeCount) const;
+
+		/// Sorts the molecules into kinds, fixes the center of the atomistic
+		///   region, and tabulates the coarse-grained potential of every
+		///   pair of kinds.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		void build(Molecule *molecules, Environment *environment);
+
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param molIdx The index of a molecule, which may hold a trial position.
+		/// @return Returns the atomistic weight of the molecule, from 1 in the
+		///   atomistic region to 0 beyond the hybrid shell.
+		Real weight(Molecule *molecules, Environment *environment, int molIdx) const;
+
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param mol1 The index of the first molecule.
+		/// @param mol2 The index of the second molecule.
+		/// @return Returns the coarse-grained energy of the pair, in kcal/mol.
+		Real coarseEnergy(Molecule *molecules, Environment *environment, int mol1, int mol2) const;
+
+		/// Counts the molecules in each region.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param atomistic Set to the number of fully atomistic molecules.
+		/// @param hybrid Set to the number of molecules in the hybrid shell.
+		/// @param coarse Set to the number of coarse-grained molecules.
+		void countRegions(Molecule *molecules, Environment *environment,
+						  int *atomistic, int *hybrid, int *coarse) const;
+
+		/// @return Returns the number of molecule kinds found.
+		int kindCount() const;
+
+	private:
+		int solute;
+		Real radius, width, kT;
+		Atom center;
+
+		/// The kind of each molecule, and one molecule of each kind.
+		std::vector<int> kindOf;
+		std::vector<int> templates;
+
+		/// The table of kinds a and b (a <= b) starts at
+		///   tables[(a * kinds + b) * tableSize].
+		int tableSize;
+		std::vector<Real> tables;
+
+		Real tabulate(const std::vector<Atom> &body1, const std::vector<Atom> &body2, Real r) const;
+		static void bodyFrame(const Molecule &molecule, Environment *environment, std::vector<Atom> &body);
+};
+
+#endif
@@ -0,0 +1,285 @@
+/*
+	A two-level spatial index over the molecules of a box. Small molecules are
+	binned on a fine grid with cells no smaller than the cutoff, while large
+	molecules (whose atoms spread far from their primary atom) are kept on a
+	separate coarse level, so neither kind forces a poor cell size on the other.
+	Queries always visit both levels.
+
+	In non-periodic boxes the levels are sparse: cells are hashed by their
+	integer coordinates and only occupied cells are stored, so memory follows
+	the molecules rather than the empty space around a droplet or cluster.
+*/
+
+#include <math.h>
+#include "CellGrid.h"
+
+CellGrid::CellGrid()
+{
+	fine.population = 0;
+	coarse.population = 0;
+	fine.sparse = false;
+	coarse.sparse = false;
+	cutoff = 0;
+}
+
+bool CellGrid::isBuilt(int moleculeCount) const
+{
+	return cutoff > 0 && cellOf.size() == moleculeCount;
+}
+
+void CellGrid::build(Molecule *molecules, Environment *environment)
+{
+	int moleculeCount = environment->numOfMolecules;
+	cutoff = environment->cutoff;
+
+	initLevel(fine, environment, cutoff);
+	initLevel(coarse, environment, cutoff * COARSE_CELL_FACTOR);
+
+	isLarge.assign(moleculeCount, 0);
+	cellOf.assign(moleculeCount, -1);
+	slotOf.assign(moleculeCount, -1);
+
+	for (int i = 0; i < moleculeCount; i++)
+	{
+		//bounding radius about the primary atom
+		Atom primary = molecules[i].atoms[environment->primaryAtomIndex];
+		Real radiusSQ = 0;
+		for (int j = 0; j < molecules[i].numOfAtoms; j++)
+		{
+			Real dx = molecules[i].atoms[j].x - primary.x;
+			Real dy = molecules[i].atoms[j].y - primary.y;
+			Real dz = molecules[i].atoms[j].z - primary.z;
+			Real r2 = dx * dx + dy * dy + dz * dz;
+			if (r2 > radiusSQ)
+			{
+				radiusSQ = r2;
+			}
+		}
+
+		isLarge[i] = radiusSQ > (LARGE_MOLECULE_RADIUS * cutoff) * (LARGE_MOLECULE_RADIUS * cutoff);
+		Level &level = isLarge[i] ? coarse : fine;
+		insert(level, i, cellIndex(level, primary));
+	}
+}
+
+void CellGrid::update(Molecule *molecules, Environment *environment, int molIdx)
+{
+	Level &level = isLarge[molIdx] ? coarse : fine;
+	long long cell = cellIndex(level, molecules[molIdx].atoms[environment->primaryAtomIndex]);
+
+	if (cell != cellOf[molIdx])
+	{
+		remove(level, molIdx);
+		insert(level, molIdx, cell);
+	}
+}
+
+void CellGrid::findCandidates(Molecule *molecules, Environment *environment, int molIdx,
+							std::vector<int> &candidates) const
+{
+	findCandidatesWithin(molecules[molIdx].atoms[environment->primaryAtomIndex], cutoff, candidates);
+}
+
+void CellGrid::findCandidatesWithin(const Atom &center, Real radius, std::vector<int> &candidates) const
+{
+	candidates.clear();
+	collect(fine, center, radius, candidates);
+	if (coarse.population > 0)
+	{
+		collect(coarse, center, radius, candidates);
+	}
+}
+
+int CellGrid::largeMoleculeCount() const
+{
+	return coarse.population;
+}
+
+int CellGrid::storedCellCount() const
+{
+	int count = 0;
+	const Level *levels[2] = {&fine, &coarse};
+	for (int l = 0; l < 2; l++)
+	{
+		count += levels[l]->sparse ? levels[l]->occupied.size() : levels[l]->members.size();
+	}
+	return count;
+}
+
+void CellGrid::initLevel(Level &level, Environment *environment, Real minCellSize)
+{
+	Real dimensions[3] = {environment->x, environment->y, environment->z};
+
+	level.population = 0;
+	level.sparse = !environment->periodic;
+	level.occupied.clear();
+	level.members.clear();
+	if (level.sparse)
+	{
+		//cells are unbounded, so the box dimensions do not matter
+		for (int d = 0; d < 3; d++)
+		{
+			level.cells[d] = 0;
+			level.cellSize[d] = minCellSize;
+		}
+		return;
+	}
+
+	int cellCount = 1;
+	for (int d = 0; d < 3; d++)
+	{
+		level.cells[d] = minCellSize > 0 ? (int) (dimensions[d] / minCellSize) : 1;
+		if (level.cells[d] < 1)
+		{
+			level.cells[d] = 1;
+		}
+		level.cellSize[d] = dimensions[d] / level.cells[d];
+		cellCount *= level.cells[d];
+	}
+
+	level.members.assign(cellCount, std::vector<int>());
+}
+
+long long CellGrid::cellIndex(const Level &level, const Atom &atom) const
+{
+	Real position[3] = {atom.x, atom.y, atom.z};
+	if (level.sparse)
+	{
+		return packCell((long long) floor(position[0] / level.cellSize[0]),
+						(long long) floor(position[1] / level.cellSize[1]),
+						(long long) floor(position[2] / level.cellSize[2]));
+	}
+
+	int index = 0;
+
+	for (int d = 2; d >= 0; d--)
+	{
+		//positions are not kept inside the box, so wrap them here
+		int c = (int) floor(position[d] / level.cellSize[d]) % level.cells[d];
+		if (c < 0)
+		{
+			c += level.cells[d];
+		}
+		index = index * level.cells[d] + c;
+	}
+	return index;
+}
+
+std::vector<int> &CellGrid::cellMembers(Level &level, long long cell)
+{
+	return level.sparse ? level.occupied[cell] : level.members[cell];
+}
+
+const std::vector<int> *CellGrid::findCell(const Level &level, long long cell) const
+{
+	if (!level.sparse)
+	{
+		return &level.members[cell];
+	}
+	CellMap::const_iterator found = level.occupied.find(cell);
+	return found == level.occupied.end() ? NULL : &found->second;
+}
+
+void CellGrid::insert(Level &level, int molIdx, long long cell)
+{
+	std::vector<int> &members = cellMembers(level, cell);
+	cellOf[molIdx] = cell;
+	slotOf[molIdx] = members.size();
+	members.push_back(molIdx);
+	level.population++;
+}
+
+void CellGrid::remove(Level &level, int molIdx)
+{
+	std::vector<int> &members = cellMembers(level, cellOf[molIdx]);
+	int last = members.back();
+
+	members[slotOf[molIdx]] = last;
+	slotOf[last] = slotOf[molIdx];
+	members.pop_back();
+	level.population--;
+
+	//sparse levels only keep the cells that are occupied
+	if (level.sparse && members.empty())
+	{
+		level.occupied.erase(cellOf[molIdx]);
+	}
+}
+
+long long CellGrid::packCell(long long x, long long y, long long z)
+{
+	const long long offset = 1LL << (SPARSE_CELL_BITS - 1);
+	const long long mask = (1LL << SPARSE_CELL_BITS) - 1;
+	return (((z + offset) & mask) << (2 * SPARSE_CELL_BITS)) |
+		(((y + offset) & mask) << SPARSE_CELL_BITS) | ((x + offset) & mask);
+}
+
+void CellGrid::collect(const Level &level, const Atom &atom, Real radius, std::vector<int> &candidates) const
+{
+	if (level.sparse)
+	{
+		//no wrapping, and most of the neighboring cells are not stored
+		Real position[3] = {atom.x, atom.y, atom.z};
+		long long home[3];
+		int reach[3];
+		for (int d = 0; d < 3; d++)
+		{
+			home[d] = (long long) floor(position[d] / level.cellSize[d]);
+			reach[d] = (int) ceil(radius / level.cellSize[d]);
+		}
+
+		for (long long z = home[2] - reach[2]; z <= home[2] + reach[2]; z++)
+		{
+			for (long long y = home[1] - reach[1]; y <= home[1] + reach[1]; y++)
+			{
+				for (long long x = home[0] - reach[0]; x <= home[0] + reach[0]; x++)
+				{
+					const std::vector<int> *members = findCell(level, packCell(x, y, z));
+					if (members != NULL)
+					{
+						candidates.insert(candidates.end(), members->begin(), members->end());
+					}
+				}
+			}
+		}
+		return;
+	}
+
+	int center = cellIndex(level, atom);
+	int home[3];
+	home[0] = center % level.cells[0];
+	home[1] = (center / level.cells[0]) % level.cells[1];
+	home[2] = center / (level.cells[0] * level.cells[1]);
+
+	//when the search wraps around a dimension, every cell along it is in reach
+	int low[3], high[3];
+	for (int d = 0; d < 3; d++)
+	{
+		int reach = (int) ceil(radius / level.cellSize[d]);
+		if (2 * reach + 1 >= level.cells[d])
+		{
+			low[d] = 0;
+			high[d] = level.cells[d] - 1;
+		}
+		else
+		{
+			low[d] = home[d] - reach;
+			high[d] = home[d] + reach;
+		}
+	}
+
+	for (int cz = low[2]; cz <= high[2]; cz++)
+	{
+		int z = (cz + level.cells[2]) % level.cells[2];
+		for (int cy = low[1]; cy <= high[1]; cy++)
+		{
+			int y = (cy + level.cells[1]) % level.cells[1];
+			for (int cx = low[0]; cx <= high[0]; cx++)
+			{
+				int x = (cx + level.cells[0]) % level.cells[0];
+				const std::vector<int> &members = level.members[(z * level.cells[1] + y) * level.cells[0] + x];
+				candidates.insert(candidates.end(), members.begin(), members.end());
+			}
+		}
+	}
+}
@@ -0,0 +1,113 @@
+/*
+	A two-level spatial index over the molecules of a box. Small molecules are
+	binned on a fine grid with cells no smaller than the cutoff, while large
+	molecules (whose atoms spread far from their primary atom) are kept on a
+	separate coarse level, so neither kind forces a poor cell size on the other.
+	Queries always visit both levels.
+
+	In non-periodic boxes the levels are sparse: cells are hashed by their
+	integer coordinates and only occupied cells are stored, so memory follows
+	the molecules rather than the empty space around a droplet or cluster.
+*/
+
+#ifndef CELLGRID_H
+#define CELLGRID_H
+
+#include <vector>
+#include <tr1/unordered_map>
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/Utilities/StructLibrary.h"
+
+/// Molecules whose atoms reach further than this fraction of the cutoff
+///   from their primary atom are placed on the coarse level.
+#define LARGE_MOLECULE_RADIUS 0.5
+
+/// The edge of a coarse cell, in multiples of the cutoff.
+#define COARSE_CELL_FACTOR 4
+
+/// The bits given to each coordinate of a sparse cell key.
+#define SPARSE_CELL_BITS 21
+
+class CellGrid
+{
+	public:
+		CellGrid();
+
+		/// Checks whether the grid holds the given number of molecules.
+		/// @param moleculeCount The number of molecules in the box.
+		/// @return Returns true if the grid has been built for the box.
+		bool isBuilt(int moleculeCount) const;
+
+		/// Classifies and bins every molecule of the box.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		void build(Molecule *molecules, Environment *environment);
+
+		/// Moves a molecule to the cell holding its current primary atom.
+		///   Called once a change to the molecule has been accepted.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param molIdx The index of the moved molecule.
+		void update(Molecule *molecules, Environment *environment, int molIdx);
+
+		/// Collects the molecules, on either level, that lie in cells within
+		///   one cutoff of a molecule's primary atom. The candidates still
+		///   need the exact cutoff test, and may include molIdx itself.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param molIdx The index of the molecule to search around.
+		/// @param candidates Filled with the indices of nearby molecules.
+		void findCandidates(Molecule *molecules, Environment *environment, int molIdx,
+							std::vector<int> &candidates) const;
+
+		/// Collects the molecules, on either level, that lie in cells within
+		///   a given radius of a point. The candidates still need an exact
+		///   distance test.
+		/// @param center The point to search around.
+		/// @param radius The search radius.
+		/// @param candidates Filled with the indices of nearby molecules.
+		void findCandidatesWithin(const Atom &center, Real radius, std::vector<int> &candidates) const;
+
+		/// @return Returns the number of molecules on the coarse level.
+		int largeMoleculeCount() const;
+
+		/// @return Returns the number of cells, on either level, that are
+		///   stored. Sparse levels only store occupied cells.
+		int storedCellCount() const;
+
+	private:
+		typedef std::tr1::unordered_map<long long, std::vector<int> > CellMap;
+
+		struct Level
+		{
+			int cells[3];
+			Real cellSize[3];
+			int population;
+			std::vector<std::vector<int> > members;
+
+			/// The occupied cells of a sparse level, keyed by packed cell
+			///   coordinates. Unused by dense levels.
+			bool sparse;
+			CellMap occupied;
+		};
+
+		Level fine, coarse;
+		Real cutoff;
+
+		/// For each molecule, whether it lives on the coarse level, the
+		///   index or key of its cell, and its slot within that cell.
+		std::vector<char> isLarge;
+		std::vector<long long> cellOf;
+		std::vector<int> slotOf;
+
+		void initLevel(Level &level, Environment *environment, Real minCellSize);
+		long long cellIndex(const Level &level, const Atom &atom) const;
+		std::vector<int> &cellMembers(Level &level, long long cell);
+		const std::vector<int> *findCell(const Level &level, long long cell) const;
+		void insert(Level &level, int molIdx, long long cell);
+		void remove(Level &level, int molIdx);
+		void collect(const Level &level, const Atom &atom, Real radius, std::vector<int> &candidates) const;
+		static long long packCell(long long x, long long y, long long z);
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+	Groups the molecules of a box into kinds with identical atom parameters
+	and holds the premixed parameters of every atom pair between two kinds.
+	Neighbor lists are split into runs of a single kind, so the pair kernel
+	looks up its parameter table once per run instead of blending the
+	parameters of every atom pair it evaluates. Solute tempering scales the
+	solute-solute and solute-solvent tables in place, so the scaled energy
+	costs nothing extra in the kernel.
+*/
+
+#include <math.h>
+#include <algorithm>
+#include "KindTable.h"
+#include "SerialCalcs.h"
+
+KindTable::KindTable()
+{
+	scales[0] = scales[1] = scales[2] = 1;
+}
+
+bool KindTable::isBuilt(int moleculeCount) const
+{
+	return kinds.size() == moleculeCount;
+}
+
+void KindTable::build(Molecule *molecules, Environment *environment)
+{
+	solute.clear();
+	if (!soluteTypes.empty())
+	{
+		solute.resize(environment->numOfMolecules);
+		for (int i = 0; i < environment->numOfMolecules; i++)
+		{
+			solute[i] = std::find(soluteTypes.begin(), soluteTypes.end(), molecules[i].type) != soluteTypes.end();
+		}
+	}
+
+	kinds.assign(environment->numOfMolecules, -1);
+	templates.clear();
+	for (int i = 0; i < environment->numOfMolecules; i++)
+	{
+		for (int k = 0; k < templates.size() && kinds[i] < 0; k++)
+		{
+			if (sameAtomParameters(molecules[i], molecules[templates[k]]) && isSolute(i) == isSolute(templates[k]))
+			{
+				kinds[i] = k;
+			}
+		}
+		if (kinds[i] < 0)
+		{
+			kinds[i] = templates.size();
+			templates.push_back(i);
+		}
+	}
+
+	terms.clear();
+	if (templates.size() > KIND_TABLE_MAX_KINDS)
+	{
+		return;
+	}
+
+	int kindCount = templates.size();
+	terms.resize(kindCount * kindCount);
+	for (int a = 0; a < kindCount; a++)
+	{
+		for (int b = 0; b < kindCount; b++)
+		{
+			const Molecule &molecule1 = molecules[templates[a]];
+			const Molecule &molecule2 = molecules[templates[b]];
+			std::vector<KindPairTerm> &pairs = terms[a * kindCount + b];
+
+			//both terms of the pair energy are linear in these parameters
+			Real scale = pairScale(templates[a], templates[b]);
+			for (int i = 0; i < molecule1.numOfAtoms; i++)
+			{
+				Atom atom1 = molecule1.atoms[i];
+				for (int j = 0; j < molecule2.numOfAtoms; j++)
+				{
+					Atom atom2 = molecule2.atoms[j];
+					if (atom1.sigma >= 0 && atom1.epsilon >= 0 && atom2.sigma >= 0 && atom2.epsilon >= 0)
+					{
+						KindPairTerm term;
+						term.atom1 = i;
+						term.atom2 = j;
+						term.sigma = SerialCalcs::calcBlending(atom1.sigma, atom2.sigma);
+						term.epsilon = scale * SerialCalcs::calcBlending(atom1.epsilon, atom2.epsilon);
+						term.charge = scale * SerialCalcs::calcChargeProduct(atom1.charge, atom2.charge);
+						pairs.push_back(term);
+					}
+				}
+			}
+		}
+	}
+}
+
+void KindTable::setSoluteScaling(const std::vector<int> &types, Real scale)
+{
+	soluteTypes = types;
+	scales[0] = 1;
+	scales[1] = sqrt(scale);
+	scales[2] = scale;
+	kinds.clear();
+}
+
+Real KindTable::getSoluteScale() const
+{
+	return scales[2];
+}
+
+bool KindTable::isEnabled() const
+{
+	return !terms.empty();
+}
+
+int KindTable::kindCount() const
+{
+	return templates.size();
+}
+
+void KindTable::groupRuns(const std::vector<int> &neighbors, int begin, int end,
+						  std::vector<int> &order, std::vector<NeighborRun> &runs) const
+{
+	//counting sort by kind, which keeps the order within each kind
+	int starts[KIND_TABLE_MAX_KINDS + 1] = {0};
+	for (int i = begin; i < end; i++)
+	{
+		starts[kinds[neighbors[i]] + 1]++;
+	}
+	for (int k = 0; k < templates.size(); k++)
+	{
+		starts[k + 1] += starts[k];
+	}
+
+	runs.clear();
+	for (int k = 0; k < templates.size(); k++)
+	{
+		if (starts[k + 1] > starts[k])
+		{
+			NeighborRun run;
+			run.kind = k;
+			run.begin = starts[k];
+			run.end = starts[k + 1];
+			runs.push_back(run);
+		}
+	}
+
+	order.resize(end - begin);
+	for (int i = begin; i < end; i++)
+	{
+		order[starts[kinds[neighbors[i]]]++] = i;
+	}
+}
@@ -0,0 +1,144 @@
+/*
+	Groups the molecules of a box into kinds with identical atom parameters
+	and holds the premixed parameters of every atom pair between two kinds.
+	Neighbor lists are split into runs of a single kind, so the pair kernel
+	looks up its parameter table once per run instead of blending the
+	parameters of every atom pair it evaluates. Solute tempering scales the
+	solute-solute and solute-solvent tables in place, so the scaled energy
+	costs nothing extra in the kernel.
+*/
+
+#ifndef KINDTABLE_H
+#define KINDTABLE_H
+
+#include <vector>
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/Utilities/StructLibrary.h"
+
+/// Boxes with more kinds than this evaluate pairs one at a time, since the
+///   pair tables grow with the square of the kind count.
+#define KIND_TABLE_MAX_KINDS 32
+
+/// The premixed parameters of one interacting atom pair between two kinds.
+struct KindPairTerm
+{
+	/// The indices of the atoms within their molecules.
+	int atom1;
+	int atom2;
+
+	/// The blended Lennard-Jones parameters of the pair.
+	Real sigma;
+	Real epsilon;
+
+	/// The product of the two charges, scaled to kcal/mol.
+	Real charge;
+};
+
+/// A run of neighbors of a single kind.
+struct NeighborRun
+{
+	int kind;
+
+	/// The range of the run within the grouped order.
+	int begin;
+	int end;
+};
+
+class KindTable
+{
+	public:
+		KindTable();
+
+		/// Checks whether the table matches the molecules of a box.
+		/// @param moleculeCount The number of molecules in the box.
+		/// @return Returns true if the table has been built for that count.
+		bool isBuilt(int moleculeCount) const;
+
+		/// Groups the molecules into kinds and premixes the parameters of
+		///   every pair of kinds. Positions do not matter, so the table
+		///   stays valid for the whole simulation.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		void build(Molecule *molecules, Environment *environment);
+
+		/// Marks the molecules of the given types as solute and scales the
+		///   energy of solute-solute pairs by scale and of solute-solvent
+		///   pairs by its square root. Solute and solvent molecules never
+		///   share a kind. The table is rebuilt on the next use.
+		/// @param types The molecule types of the solute. Empty removes the
+		///   scaling.
+		/// @param scale The factor applied to solute-solute pairs.
+		void setSoluteScaling(const std::vector<int> &types, Real scale);
+
+		/// @return Returns the factor applied to solute-solute pairs.
+		Real getSoluteScale() const;
+
+		/// @param molIdx The index of a molecule.
+		/// @return Returns true if the molecule is solute.
+		bool isSolute(int molIdx) const
+		{
+			return !solute.empty() && solute[molIdx];
+		}
+
+		/// @param mol1 The index of the first molecule of a pair.
+		/// @param mol2 The index of the second molecule of a pair.
+		/// @return Returns the factor applied to the energy of the pair.
+		Real pairScale(int mol1, int mol2) const
+		{
+			return solute.empty() ? 1 : scales[solute[mol1] + solute[mol2]];
+		}
+
+		/// @return Returns true if the pair tables were built, which they
+		///   are unless the box has more than KIND_TABLE_MAX_KINDS kinds.
+		bool isEnabled() const;
+
+		/// @param molIdx The index of a molecule.
+		/// @return Returns the kind of the molecule.
+		int kindOf(int molIdx) const
+		{
+			return kinds[molIdx];
+		}
+
+		/// @return Returns the number of kinds.
+		int kindCount() const;
+
+		/// @param kind1 The kind of the first molecule of a pair.
+		/// @param kind2 The kind of the second molecule of a pair.
+		/// @return Returns the interacting atom pairs of the two kinds, in the
+		///   order calcInterMolecularEnergy visits them.
+		const std::vector<KindPairTerm> &pairTerms(int kind1, int kind2) const
+		{
+			return terms[kind1 * templates.size() + kind2];
+		}
+
+		/// Groups a range of a neighbor list into runs of a single kind.
+		///   Neighbors keep their relative order within a run.
+		/// @param neighbors The neighbor list.
+		/// @param begin The first position of the range.
+		/// @param end One past the last position of the range.
+		/// @param order Filled with the positions of the range, grouped by kind.
+		/// @param runs Filled with the runs, as ranges of order.
+		void groupRuns(const std::vector<int> &neighbors, int begin, int end,
+					   std::vector<int> &order, std::vector<NeighborRun> &runs) const;
+
+	private:
+		/// The kind of each molecule.
+		std::vector<int> kinds;
+
+		/// The first molecule of each kind.
+		std::vector<int> templates;
+
+		/// The interacting atom pairs of each ordered pair of kinds.
+		std::vector<std::vector<KindPairTerm> > terms;
+
+		/// The solute types, and whether each molecule is solute. The
+		///   flags are empty when there is no solute.
+		std::vector<int> soluteTypes;
+		std::vector<char> solute;
+
+		/// The factors of solvent-solvent, solute-solvent and solute-solute
+		///   pairs, indexed by the number of solute molecules in the pair.
+		Real scales[3];
+};
+
+#endif
@@ -0,0 +1,190 @@
+/*
+	Per-molecule multipole moments used to approximate the energy of molecule
+	pairs that lie between an inner radius and the cutoff. Each molecule is
+	reduced to a charge, dipole and quadrupole about its center, plus
+	factored Lennard-Jones dispersion and repulsion coefficients, so a pair
+	costs a handful of operations instead of an atom-atom double loop.
+	Pairs inside the inner radius, or too close for the expansion to
+	converge, keep the atomistic kernel.
+*/
+
+#include <math.h>
+#include "MultipoleCache.h"
+#include "SerialCalcs.h"
+
+MultipoleCache::MultipoleCache()
+{
+	innerRadius = 0;
+}
+
+void MultipoleCache::setInnerRadius(Real radius)
+{
+	innerRadius = radius;
+}
+
+Real MultipoleCache::getInnerRadius() const
+{
+	return innerRadius;
+}
+
+bool MultipoleCache::isBuilt(int moleculeCount) const
+{
+	return poles.size() == moleculeCount;
+}
+
+void MultipoleCache::build(Molecule *molecules, Environment *environment)
+{
+	poles.resize(environment->numOfMolecules);
+	for (int i = 0; i < environment->numOfMolecules; i++)
+	{
+		compute(molecules[i], environment, poles[i]);
+	}
+}
+
+void MultipoleCache::update(Molecule *molecules, Environment *environment, int molIdx)
+{
+	compute(molecules[molIdx], environment, poles[molIdx]);
+}
+
+const Multipole &MultipoleCache::get(int molIdx) const
+{
+	return poles[molIdx];
+}
+
+void MultipoleCache::compute(const Molecule &molecule, Environment *environment, Multipole &pole)
+{
+	//atoms are wrapped into the box one at a time, so unwrap them about the
+	//primary atom; only atoms that calcInterMolecularEnergy counts are used
+	Atom primary = molecule.atoms[environment->primaryAtomIndex];
+	std::vector<Real> offsets;
+	std::vector<int> interacting;
+	Real mean[3] = {0, 0, 0};
+
+	for (int i = 0; i < molecule.numOfAtoms; i++)
+	{
+		Atom atom = molecule.atoms[i];
+		if (atom.sigma < 0 || atom.epsilon < 0)
+		{
+			continue;
+		}
+		Real offset[3];
+		offset[0] = SerialCalcs::makePeriodic(atom.x - primary.x, environment->x, environment->periodic);
+		offset[1] = SerialCalcs::makePeriodic(atom.y - primary.y, environment->y, environment->periodic);
+		offset[2] = SerialCalcs::makePeriodic(atom.z - primary.z, environment->z, environment->periodic);
+		for (int d = 0; d < 3; d++)
+		{
+			offsets.push_back(offset[d]);
+			mean[d] += offset[d];
+		}
+		interacting.push_back(i);
+	}
+
+	int count = interacting.size();
+	for (int d = 0; d < 3; d++)
+	{
+		mean[d] = count > 0 ? mean[d] / count : 0;
+	}
+	pole.center[0] = primary.x + mean[0];
+	pole.center[1] = primary.y + mean[1];
+	pole.center[2] = primary.z + mean[2];
+
+	pole.extent = 0;
+	pole.charge = 0;
+	pole.absCharge = 0;
+	pole.dispersion = 0;
+	pole.repulsion = 0;
+	for (int d = 0; d < 3; d++)
+	{
+		pole.dipole[d] = 0;
+		pole.quadrupole[d] = 0;
+		pole.quadrupole[d + 3] = 0;
+	}
+
+	for (int k = 0; k < count; k++)
+	{
+		Atom atom = molecule.atoms[interacting[k]];
+		Real x = offsets[3 * k] - mean[0];
+		Real y = offsets[3 * k + 1] - mean[1];
+		Real z = offsets[3 * k + 2] - mean[2];
+		Real r2 = x * x + y * y + z * z;
+		Real q = atom.charge;
+
+		if (r2 > pole.extent * pole.extent)
+		{
+			pole.extent = sqrt(r2);
+		}
+
+		pole.charge += q;
+		pole.absCharge += fabs(q);
+		pole.dipole[0] += q * x;
+		pole.dipole[1] += q * y;
+		pole.dipole[2] += q * z;
+		pole.quadrupole[0] += 0.5 * q * (3 * x * x - r2);
+		pole.quadrupole[1] += 0.5 * q * (3 * y * y - r2);
+		pole.quadrupole[2] += 0.5 * q * (3 * z * z - r2);
+		pole.quadrupole[3] += 1.5 * q * x * y;
+		pole.quadrupole[4] += 1.5 * q * x * z;
+		pole.quadrupole[5] += 1.5 * q * y * z;
+
+		//4 * sqrt(e1 e2) * (s1 s2)^n splits into 2 sqrt(e1) s1^n * 2 sqrt(e2) s2^n
+		Real sigma3 = atom.sigma * atom.sigma * atom.sigma;
+		pole.dispersion += 2 * sqrt(atom.epsilon) * sigma3;
+		pole.repulsion += 2 * sqrt(atom.epsilon) * sigma3 * sigma3;
+	}
+}
+
+bool MultipoleCache::pairEnergy(const Multipole &pole1, const Multipole &pole2, Environment *environment,
+								Real &energy, Real *bound)
+{
+	Real x = SerialCalcs::makePeriodic(pole2.center[0] - pole1.center[0], environment->x, environment->periodic);
+	Real y = SerialCalcs::makePeriodic(pole2.center[1] - pole1.center[1], environment->y, environment->periodic);
+	Real z = SerialCalcs::makePeriodic(pole2.center[2] - pole1.center[2], environment->z, environment->periodic);
+	Real r2 = x * x + y * y + z * z;
+	Real r = sqrt(r2);
+
+	//every atom-atom distance must stay within r of the center distance
+	Real reach = pole1.extent + pole2.extent;
+	if (r <= reach)
+	{
+		return false;
+	}
+
+	Real r3 = r2 * r;
+	Real r5 = r3 * r2;
+	Real r6 = r3 * r3;
+
+	Real dot1 = x * pole1.dipole[0] + y * pole1.dipole[1] + z * pole1.dipole[2];
+	Real dot2 = x * pole2.dipole[0] + y * pole2.dipole[1] + z * pole2.dipole[2];
+	Real dipoles = pole1.dipole[0] * pole2.dipole[0] + pole1.dipole[1] * pole2.dipole[1] +
+		pole1.dipole[2] * pole2.dipole[2];
+	const Real *q1 = pole1.quadrupole;
+	const Real *q2 = pole2.quadrupole;
+	Real quad1 = q1[0] * x * x + q1[1] * y * y + q1[2] * z * z +
+		2 * (q1[3] * x * y + q1[4] * x * z + q1[5] * y * z);
+	Real quad2 = q2[0] * x * x + q2[1] * y * y + q2[2] * z * z +
+		2 * (q2[3] * x * y + q2[4] * x * z + q2[5] * y * z);
+
+	//every term of the expansion of 1/|R + s| up to second order in s
+	Real electrostatic = pole1.charge * pole2.charge / r +
+		(pole2.charge * dot1 - pole1.charge * dot2) / r3 +
+		(dipoles * r2 - 3 * dot1 * dot2 + pole1.charge * quad2 + pole2.charge * quad1) / r5;
+
+	Real dispersion = pole1.dispersion * pole2.dispersion;
+	Real repulsion = pole1.repulsion * pole2.repulsion;
+	energy = COULOMB_FACTOR * electrostatic + repulsion / (r6 * r6) - dispersion / r6;
+
+	if (bound != NULL)
+	{
+		//the Legendre series of the Coulomb term converges with terms no
+		//larger than (reach / r)^l / r, and each Lennard-Jones term can
+		//change at most as much as it would at the closest possible distance
+		Real closest = r - reach;
+		Real closest6 = closest * closest * closest;
+		closest6 *= closest6;
+		Real ratio = reach / r;
+		*bound = COULOMB_FACTOR * pole1.absCharge * pole2.absCharge * ratio * ratio * ratio / closest +
+			repulsion * (1 / (closest6 * closest6) - 1 / (r6 * r6)) +
+			dispersion * (1 / closest6 - 1 / r6);
+	}
+	return true;
+}
@@ -0,0 +1,99 @@
+/*
+	Per-molecule multipole moments used to approximate the energy of molecule
+	pairs that lie between an inner radius and the cutoff. Each molecule is
+	reduced to a charge, dipole and quadrupole about its center, plus
+	factored Lennard-Jones dispersion and repulsion coefficients, so a pair
+	costs a handful of operations instead of an atom-atom double loop.
+	Pairs inside the inner radius, or too close for the expansion to
+	converge, keep the atomistic kernel.
+*/
+
+#ifndef MULTIPOLECACHE_H
+#define MULTIPOLECACHE_H
+
+#include <vector>
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/Utilities/StructLibrary.h"
+
+struct Multipole
+{
+	/// The expansion center, the mean position of the interacting atoms.
+	Real center[3];
+
+	/// The largest distance of an interacting atom from the center.
+	Real extent;
+
+	/// The net charge and the sum of the absolute atomic charges.
+	Real charge;
+	Real absCharge;
+
+	/// The dipole and the traceless quadrupole (xx, yy, zz, xy, xz, yz).
+	Real dipole[3];
+	Real quadrupole[6];
+
+	/// Per-molecule factors of the summed C6 and C12 coefficients. The
+	///   geometric blending rules make each pair coefficient a product of
+	///   one factor from each molecule.
+	Real dispersion;
+	Real repulsion;
+};
+
+class MultipoleCache
+{
+	public:
+		MultipoleCache();
+
+		/// Sets the inner radius, inside which pairs are always evaluated
+		///   atom by atom. A radius of zero disables the approximation.
+		/// @param radius The inner radius, in angstroms.
+		void setInnerRadius(Real radius);
+
+		/// @return Returns the inner radius.
+		Real getInnerRadius() const;
+
+		/// Checks whether the cache holds the given number of molecules.
+		/// @param moleculeCount The number of molecules in the box.
+		/// @return Returns true if the cache has been built for the box.
+		bool isBuilt(int moleculeCount) const;
+
+		/// Computes the moments of every molecule in the box.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		void build(Molecule *molecules, Environment *environment);
+
+		/// Recomputes the moments of a molecule once a change to it has
+		///   been accepted.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param molIdx The index of the changed molecule.
+		void update(Molecule *molecules, Environment *environment, int molIdx);
+
+		/// @param molIdx The index of a molecule.
+		/// @return Returns the cached moments of the molecule.
+		const Multipole &get(int molIdx) const;
+
+		/// Computes the moments of a molecule from its current coordinates,
+		///   which is the same as rotating its body-frame moments.
+		/// @param molecule The molecule.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param pole Filled with the moments of the molecule.
+		static void compute(const Molecule &molecule, Environment *environment, Multipole &pole);
+
+		/// Approximates the energy between two molecules from their moments.
+		/// @param pole1 The moments of the first molecule.
+		/// @param pole2 The moments of the second molecule.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param energy Set to the approximate energy, in kcal/mol.
+		/// @param bound If not NULL, set to an upper bound on the absolute
+		///   error of the approximation.
+		/// @return Returns false if the molecules are too close for the
+		///   expansion to converge, in which case energy is not set.
+		static bool pairEnergy(const Multipole &pole1, const Multipole &pole2, Environment *environment,
+							   Real &energy, Real *bound = NULL);
+
+	private:
+		Real innerRadius;
+		std::vector<Multipole> poles;
+};
+
+#endif
@@ -0,0 +1,234 @@
+/*
+	Per-molecule Verlet lists of every molecule within the cutoff plus a
+	skin. The lists are double-buffered: a helper thread builds the next
+	generation from a snapshot of the coordinates while sampling continues on
+	the current one, and moves committed in the meantime are replayed onto
+	the new generation before it is swapped in. A list is only used while the
+	skin still covers every displacement since its snapshot, so results are
+	the same as searching the cell grid.
+*/
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include "NeighborList.h"
+#include "CellGrid.h"
+#include "SerialCalcs.h"
+
+NeighborList::NeighborList()
+{
+	skin = 0;
+	rebuildCount = 0;
+	current.maxDisplacement = 0;
+	next.maxDisplacement = 0;
+	helperRunning = false;
+	helperDone = false;
+	pthread_mutex_init(&lock, NULL);
+}
+
+NeighborList::~NeighborList()
+{
+	if (helperRunning)
+	{
+		join();
+	}
+	pthread_mutex_destroy(&lock);
+}
+
+void NeighborList::setSkin(Real skin)
+{
+	this->skin = skin;
+}
+
+Real NeighborList::getSkin() const
+{
+	return skin;
+}
+
+void NeighborList::poll(Molecule *molecules, Environment *environment)
+{
+	if (!helperRunning)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	bool done = helperDone;
+	pthread_mutex_unlock(&lock);
+	if (!done)
+	{
+		return;
+	}
+	join();
+
+	//only the replayed molecules have moved since the snapshot
+	for (int i = 0; i < replay.size(); i++)
+	{
+		Real moved = displacement(next, molecules, environment, replay[i]);
+		if (moved > next.maxDisplacement)
+		{
+			next.maxDisplacement = moved;
+		}
+	}
+	replay.clear();
+
+	std::swap(current.start, next.start);
+	std::swap(current.members, next.members);
+	std::swap(current.reference, next.reference);
+	current.maxDisplacement = next.maxDisplacement;
+	rebuildCount++;
+}
+
+void NeighborList::commit(Molecule *molecules, Environment *environment, int molIdx)
+{
+	if (skin <= 0)
+	{
+		return;
+	}
+
+	if (current.reference.size() == environment->numOfMolecules)
+	{
+		Real moved = displacement(current, molecules, environment, molIdx);
+		if (moved > current.maxDisplacement)
+		{
+			current.maxDisplacement = moved;
+		}
+	}
+
+	if (helperRunning)
+	{
+		replay.push_back(molIdx);
+	}
+	else if (current.reference.size() != environment->numOfMolecules ||
+			 current.maxDisplacement > NEIGHBOR_REBUILD_FRACTION * skin)
+	{
+		startRebuild(molecules, environment);
+	}
+}
+
+bool NeighborList::findCandidates(Molecule *molecules, Environment *environment, int molIdx,
+								  std::vector<int> &candidates) const
+{
+	if (skin <= 0 || current.reference.size() != environment->numOfMolecules)
+	{
+		return false;
+	}
+
+	//a pair within the cutoff now was within the cutoff plus the skin at the
+	//snapshot as long as the two displacements together fit in the skin
+	if (displacement(current, molecules, environment, molIdx) + current.maxDisplacement >= skin)
+	{
+		return false;
+	}
+
+	candidates.assign(current.members.begin() + current.start[molIdx],
+					  current.members.begin() + current.start[molIdx + 1]);
+	return true;
+}
+
+int NeighborList::getRebuildCount() const
+{
+	return rebuildCount;
+}
+
+void NeighborList::startRebuild(Molecule *molecules, Environment *environment)
+{
+	//copy the coordinates so the helper never reads molecules being changed
+	int moleculeCount = environment->numOfMolecules;
+	int atomCount = 0;
+	for (int i = 0; i < moleculeCount; i++)
+	{
+		atomCount += molecules[i].numOfAtoms;
+	}
+
+	snapshotAtoms.resize(atomCount);
+	snapshotMolecules.assign(molecules, molecules + moleculeCount);
+	snapshotEnvironment = *environment;
+
+	int offset = 0;
+	for (int i = 0; i < moleculeCount; i++)
+	{
+		memcpy(&snapshotAtoms[offset], molecules[i].atoms, sizeof(Atom) * molecules[i].numOfAtoms);
+		snapshotMolecules[i].atoms = &snapshotAtoms[offset];
+		offset += molecules[i].numOfAtoms;
+	}
+
+	helperDone = false;
+	if (pthread_create(&helper, NULL, runHelper, this) != 0)
+	{
+		//without a helper the current generation simply stays in use
+		std::cerr << "Warning: NeighborList: Could not start rebuild thread" << std::endl;
+		return;
+	}
+	helperRunning = true;
+	replay.clear();
+}
+
+void NeighborList::join()
+{
+	pthread_join(helper, NULL);
+	helperRunning = false;
+}
+
+void NeighborList::build()
+{
+	Molecule *molecules = &snapshotMolecules[0];
+	Environment *environment = &snapshotEnvironment;
+	int moleculeCount = environment->numOfMolecules;
+	int primaryIndex = environment->primaryAtomIndex;
+	Real radius = environment->cutoff + skin;
+
+	CellGrid grid;
+	grid.build(molecules, environment);
+
+	next.start.assign(moleculeCount + 1, 0);
+	next.members.clear();
+	next.reference.resize(moleculeCount);
+	next.maxDisplacement = 0;
+
+	std::vector<int> candidates;
+	for (int i = 0; i < moleculeCount; i++)
+	{
+		Atom center = molecules[i].atoms[primaryIndex];
+		next.reference[i] = center;
+
+		grid.findCandidatesWithin(center, radius, candidates);
+		std::sort(candidates.begin(), candidates.end());
+		for (int j = 0; j < candidates.size(); j++)
+		{
+			Atom other = molecules[candidates[j]].atoms[primaryIndex];
+			Real dx = SerialCalcs::makePeriodic(center.x - other.x, environment->x, environment->periodic);
+			Real dy = SerialCalcs::makePeriodic(center.y - other.y, environment->y, environment->periodic);
+			Real dz = SerialCalcs::makePeriodic(center.z - other.z, environment->z, environment->periodic);
+			if (candidates[j] != i && dx * dx + dy * dy + dz * dz < radius * radius)
+			{
+				next.members.push_back(candidates[j]);
+			}
+		}
+		next.start[i + 1] = next.members.size();
+	}
+}
+
+void *NeighborList::runHelper(void *list)
+{
+	NeighborList *self = (NeighborList *) list;
+	self->build();
+
+	pthread_mutex_lock(&self->lock);
+	self->helperDone = true;
+	pthread_mutex_unlock(&self->lock);
+	return NULL;
+}
+
+Real NeighborList::displacement(const Generation &generation, Molecule *molecules,
+								Environment *environment, int molIdx)
+{
+	Atom now = molecules[molIdx].atoms[environment->primaryAtomIndex];
+	Atom then = generation.reference[molIdx];
+
+	Real dx = SerialCalcs::makePeriodic(now.x - then.x, environment->x, environment->periodic);
+	Real dy = SerialCalcs::makePeriodic(now.y - then.y, environment->y, environment->periodic);
+	Real dz = SerialCalcs::makePeriodic(now.z - then.z, environment->z, environment->periodic);
+	return sqrt(dx * dx + dy * dy + dz * dz);
+}
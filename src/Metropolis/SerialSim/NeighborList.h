@@ -0,0 +1,108 @@
+/*
+	Per-molecule Verlet lists of every molecule within the cutoff plus a
+	skin. The lists are double-buffered: a helper thread builds the next
+	generation from a snapshot of the coordinates while sampling continues on
+	the current one, and moves committed in the meantime are replayed onto
+	the new generation before it is swapped in. A list is only used while the
+	skin still covers every displacement since its snapshot, so results are
+	the same as searching the cell grid.
+*/
+
+#ifndef NEIGHBORLIST_H
+#define NEIGHBORLIST_H
+
+#include <pthread.h>
+#include <vector>
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/Utilities/StructLibrary.h"
+
+/// A rebuild starts once any molecule has moved this fraction of the skin,
+///   leaving the rest of the skin to cover moves made while it runs.
+#define NEIGHBOR_REBUILD_FRACTION 0.5
+
+class NeighborList
+{
+	public:
+		NeighborList();
+		~NeighborList();
+
+		/// Sets the skin added to the cutoff. A skin of zero disables the lists.
+		/// @param skin The skin, in angstroms.
+		void setSkin(Real skin);
+
+		/// @return Returns the skin added to the cutoff.
+		Real getSkin() const;
+
+		/// Swaps in a finished generation, once the moves committed since its
+		///   snapshot have been replayed onto it. Never waits for the helper.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		void poll(Molecule *molecules, Environment *environment);
+
+		/// Records an accepted change, and starts a rebuild on the helper
+		///   thread when the skin is running out.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param molIdx The index of the molecule that was changed.
+		void commit(Molecule *molecules, Environment *environment, int molIdx);
+
+		/// Collects the molecules that may lie within the cutoff of a
+		///   molecule's primary atom, in ascending order. The candidates still
+		///   need the exact cutoff test.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param molIdx The index of the molecule to search around, which may
+		///   hold a trial position.
+		/// @param candidates Filled with the indices of nearby molecules.
+		/// @return Returns false if the current generation can not guarantee
+		///   every neighbor, in which case the caller must search another way.
+		bool findCandidates(Molecule *molecules, Environment *environment, int molIdx,
+							std::vector<int> &candidates) const;
+
+		/// @return Returns the number of generations swapped in so far.
+		int getRebuildCount() const;
+
+	private:
+		struct Generation
+		{
+			/// The neighbors of molecule i are members[start[i]] up to
+			///   members[start[i + 1]].
+			std::vector<int> start;
+			std::vector<int> members;
+
+			/// The primary atom of each molecule when the snapshot was taken.
+			std::vector<Atom> reference;
+
+			/// The largest distance any molecule has moved from its reference.
+			Real maxDisplacement;
+		};
+
+		Real skin;
+		int rebuildCount;
+		Generation current, next;
+
+		/// Helper thread state. The snapshot and the next generation belong to
+		///   the helper from startRebuild until it is joined in poll.
+		pthread_t helper;
+		pthread_mutex_t lock;
+		bool helperRunning;
+		bool helperDone;
+		std::vector<Atom> snapshotAtoms;
+		std::vector<Molecule> snapshotMolecules;
+		Environment snapshotEnvironment;
+
+		/// The molecules committed while the helper was running.
+		std::vector<int> replay;
+
+		NeighborList(const NeighborList &);
+		NeighborList &operator=(const NeighborList &);
+
+		void startRebuild(Molecule *molecules, Environment *environment);
+		void join();
+		void build();
+		static void *runHelper(void *list);
+		static Real displacement(const Generation &generation, Molecule *molecules,
+								 Environment *environment, int molIdx);
+};
+
+#endif
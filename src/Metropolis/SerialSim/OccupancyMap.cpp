@@ -0,0 +1,170 @@
+/*
+	A voxel occupancy map over the box that tracks where heavy atoms (atoms
+	with Lennard-Jones parameters) sit. Voxels are small enough that any two
+	atoms sharing one are closer than the hard-core radius, so a trial
+	position can be rejected for a gross overlap with a handful of lookups,
+	before any pair energy is evaluated.
+*/
+
+#include <math.h>
+#include "OccupancyMap.h"
+
+OccupancyMap::OccupancyMap()
+{
+	hardCoreFraction = 0;
+	hardCoreRadius = 0;
+	moleculeCount = -1;
+}
+
+bool OccupancyMap::isBuilt(int moleculeCount, Real hardCoreFraction) const
+{
+	return this->moleculeCount == moleculeCount && this->hardCoreFraction == hardCoreFraction;
+}
+
+void OccupancyMap::build(Molecule *molecules, Environment *environment, Real hardCoreFraction)
+{
+	this->hardCoreFraction = hardCoreFraction;
+	moleculeCount = environment->numOfMolecules;
+
+	//the hard core of the closest-approaching pair of heavy atoms
+	Real minSigma = 0;
+	for (int i = 0; i < moleculeCount; i++)
+	{
+		for (int j = 0; j < molecules[i].numOfAtoms; j++)
+		{
+			const Atom &atom = molecules[i].atoms[j];
+			if (isHeavy(atom) && (minSigma == 0 || atom.sigma < minSigma))
+			{
+				minSigma = atom.sigma;
+			}
+		}
+	}
+	hardCoreRadius = hardCoreFraction * minSigma;
+
+	//any two points in a voxel are at most one voxel diagonal apart
+	Real dimensions[3] = {environment->x, environment->y, environment->z};
+	Real maxVoxelSize = hardCoreRadius / sqrt(3.0);
+	long voxelCount = 1;
+	for (int d = 0; d < 3; d++)
+	{
+		voxels[d] = maxVoxelSize > 0 ? (int) ceil(dimensions[d] / maxVoxelSize) : 1;
+		voxelSize[d] = dimensions[d] / voxels[d];
+		voxelCount *= voxels[d];
+	}
+
+	counts.assign(voxelCount, 0);
+	for (int i = 0; i < moleculeCount; i++)
+	{
+		for (int j = 0; j < molecules[i].numOfAtoms; j++)
+		{
+			if (isHeavy(molecules[i].atoms[j]))
+			{
+				counts[voxelIndex(molecules[i].atoms[j])]++;
+			}
+		}
+	}
+}
+
+void OccupancyMap::moveMolecule(const Molecule &previous, const Molecule &current)
+{
+	for (int j = 0; j < previous.numOfAtoms; j++)
+	{
+		if (isHeavy(previous.atoms[j]))
+		{
+			counts[voxelIndex(previous.atoms[j])]--;
+		}
+	}
+	for (int j = 0; j < current.numOfAtoms; j++)
+	{
+		if (isHeavy(current.atoms[j]))
+		{
+			counts[voxelIndex(current.atoms[j])]++;
+		}
+	}
+}
+
+bool OccupancyMap::overlaps(const Molecule &trial, const Molecule &previous, int reach) const
+{
+	if (hardCoreRadius <= 0)
+	{
+		return false;
+	}
+
+	for (int j = 0; j < trial.numOfAtoms; j++)
+	{
+		if (!isHeavy(trial.atoms[j]))
+		{
+			continue;
+		}
+
+		int home[3];
+		voxelCoordinates(trial.atoms[j], home);
+
+		for (int dz = -reach; dz <= reach; dz++)
+		{
+			for (int dy = -reach; dy <= reach; dy++)
+			{
+				for (int dx = -reach; dx <= reach; dx++)
+				{
+					int voxel = wrapVoxel(home[0] + dx, home[1] + dy, home[2] + dz);
+					int others = counts[voxel];
+
+					//discount the molecule's own marks
+					for (int k = 0; k < previous.numOfAtoms && others > 0; k++)
+					{
+						if (isHeavy(previous.atoms[k]) && voxelIndex(previous.atoms[k]) == voxel)
+						{
+							others--;
+						}
+					}
+
+					if (others > 0)
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
+Real OccupancyMap::getHardCoreRadius() const
+{
+	return hardCoreRadius;
+}
+
+bool OccupancyMap::isHeavy(const Atom &atom)
+{
+	return atom.sigma > 0 && atom.epsilon > 0;
+}
+
+void OccupancyMap::voxelCoordinates(const Atom &atom, int *coordinates) const
+{
+	Real position[3] = {atom.x, atom.y, atom.z};
+
+	for (int d = 0; d < 3; d++)
+	{
+		//positions are not kept inside the box, so wrap them here
+		coordinates[d] = (int) floor(position[d] / voxelSize[d]) % voxels[d];
+		if (coordinates[d] < 0)
+		{
+			coordinates[d] += voxels[d];
+		}
+	}
+}
+
+int OccupancyMap::wrapVoxel(int x, int y, int z) const
+{
+	x = (x % voxels[0] + voxels[0]) % voxels[0];
+	y = (y % voxels[1] + voxels[1]) % voxels[1];
+	z = (z % voxels[2] + voxels[2]) % voxels[2];
+	return (z * voxels[1] + y) * voxels[0] + x;
+}
+
+int OccupancyMap::voxelIndex(const Atom &atom) const
+{
+	int coordinates[3];
+	voxelCoordinates(atom, coordinates);
+	return wrapVoxel(coordinates[0], coordinates[1], coordinates[2]);
+}
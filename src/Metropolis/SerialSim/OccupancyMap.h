@@ -0,0 +1,71 @@
+/*
+	A voxel occupancy map over the box that tracks where heavy atoms (atoms
+	with Lennard-Jones parameters) sit. Voxels are small enough that any two
+	atoms sharing one are closer than the hard-core radius, so a trial
+	position can be rejected for a gross overlap with a handful of lookups,
+	before any pair energy is evaluated.
+*/
+
+#ifndef OCCUPANCYMAP_H
+#define OCCUPANCYMAP_H
+
+#include <vector>
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/Utilities/StructLibrary.h"
+
+class OccupancyMap
+{
+	public:
+		OccupancyMap();
+
+		/// Checks whether the map holds the given number of molecules at
+		///   the given hard-core fraction.
+		/// @param moleculeCount The number of molecules in the box.
+		/// @param hardCoreFraction The hard-core radius as a fraction of
+		///   the smallest heavy atom sigma.
+		/// @return Returns true if the map has been built for the box.
+		bool isBuilt(int moleculeCount, Real hardCoreFraction) const;
+
+		/// Sizes the voxels and marks every heavy atom of the box.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param hardCoreFraction The hard-core radius as a fraction of
+		///   the smallest heavy atom sigma.
+		void build(Molecule *molecules, Environment *environment, Real hardCoreFraction);
+
+		/// Moves the marks of a molecule from its previous atoms to its
+		///   current atoms. Called once a change has been accepted.
+		/// @param previous The molecule as it was before the change.
+		/// @param current The molecule as it is after the change.
+		void moveMolecule(const Molecule &previous, const Molecule &current);
+
+		/// Tests whether a heavy atom of a trial molecule lies near a heavy
+		///   atom of any other molecule.
+		/// @param trial The molecule at its trial position.
+		/// @param previous The molecule as it is marked in the map, whose own
+		///   marks are discounted.
+		/// @param reach How many voxels around each trial atom to search.
+		///   With a reach of 0, a hit means the trial certainly overlaps.
+		/// @return Returns true if another heavy atom was found.
+		bool overlaps(const Molecule &trial, const Molecule &previous, int reach) const;
+
+		/// @return Returns the hard-core radius, in angstroms.
+		Real getHardCoreRadius() const;
+
+	private:
+		int voxels[3];
+		Real voxelSize[3];
+		Real hardCoreFraction;
+		Real hardCoreRadius;
+		int moleculeCount;
+
+		/// The number of heavy atoms in each voxel.
+		std::vector<unsigned char> counts;
+
+		static bool isHeavy(const Atom &atom);
+		void voxelCoordinates(const Atom &atom, int *coordinates) const;
+		int wrapVoxel(int x, int y, int z) const;
+		int voxelIndex(const Atom &atom) const;
+};
+
+#endif
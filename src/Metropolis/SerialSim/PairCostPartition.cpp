@@ -0,0 +1,68 @@
+/*
+	Splits the molecule pairs evaluated by the serial energy calculations into
+	chunks of balanced estimated cost, so that OpenMP threads finish together
+	even when molecule sizes differ widely (e.g. a large solute in solvent).
+*/
+
+#include <math.h>
+#include <algorithm>
+#include "PairCostPartition.h"
+
+PairCostPartition::PairCostPartition()
+{
+	cutoffFraction = 1.0;
+}
+
+void PairCostPartition::update(Molecule *molecules, Environment *environment)
+{
+	int moleculeCount = environment->numOfMolecules;
+
+	//fraction of the box volume inside the cutoff sphere of a molecule
+	double volume = (double) environment->x * environment->y * environment->z;
+	double sphere = 4.0 / 3.0 * M_PI * pow((double) environment->cutoff, 3);
+	double fraction = volume > 0 ? std::min(1.0, sphere / volume) : 1.0;
+
+	if (atomPrefix.size() == moleculeCount + 1 && fraction == cutoffFraction)
+	{
+		return;
+	}
+
+	cutoffFraction = fraction;
+	atomPrefix.assign(moleculeCount + 1, 0.0);
+	for (int i = 0; i < moleculeCount; i++)
+	{
+		atomPrefix[i + 1] = atomPrefix[i] + molecules[i].numOfAtoms;
+	}
+
+	rowPrefix.assign(moleculeCount + 1, 0.0);
+	for (int i = 0; i < moleculeCount; i++)
+	{
+		rowPrefix[i + 1] = rowPrefix[i] + moleculeCost(molecules[i].numOfAtoms, i + 1, moleculeCount);
+	}
+}
+
+double PairCostPartition::moleculeCost(int atoms, int startIdx, int idx) const
+{
+	return (idx - startIdx) * CUTOFF_TEST_COST +
+		cutoffFraction * atoms * (atomPrefix[idx] - atomPrefix[startIdx]);
+}
+
+void PairCostPartition::chunkForSystem(int chunk, int chunkCount, int *begin, int *end) const
+{
+	splitPrefix(rowPrefix, chunk, chunkCount, begin, end);
+}
+
+void PairCostPartition::splitPrefix(const std::vector<double> &prefix, int chunk, int chunkCount,
+									int *begin, int *end)
+{
+	int items = (int) prefix.size() - 1;
+	double total = prefix[items];
+
+	*begin = chunk <= 0 ? 0 :
+		std::lower_bound(prefix.begin(), prefix.end(), total * chunk / chunkCount) - prefix.begin();
+	*end = chunk + 1 >= chunkCount ? items :
+		std::lower_bound(prefix.begin(), prefix.end(), total * (chunk + 1) / chunkCount) - prefix.begin();
+
+	*begin = std::min(*begin, items);
+	*end = std::min(std::max(*end, *begin), items);
+}
@@ -0,0 +1,64 @@
+/*
+	Splits the molecule pairs evaluated by the serial energy calculations into
+	chunks of balanced estimated cost, so that OpenMP threads finish together
+	even when molecule sizes differ widely (e.g. a large solute in solvent).
+*/
+
+#ifndef PAIRCOSTPARTITION_H
+#define PAIRCOSTPARTITION_H
+
+#include <vector>
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/Utilities/StructLibrary.h"
+
+/// The cost of testing a molecule pair against the cutoff, relative to the
+///   cost of evaluating the energy of a single atom pair.
+#define CUTOFF_TEST_COST 0.25
+
+class PairCostPartition
+{
+	public:
+		PairCostPartition();
+
+		/// Refreshes the cost model for the given molecules. The atom count
+		///   prefix sums are only rebuilt when the molecule count changes.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		void update(Molecule *molecules, Environment *environment);
+
+		/// Finds the rows handled by one chunk when every unique molecule
+		///   pair (i, j > i) is split into chunks of equal estimated cost.
+		///   Row i holds the pairs whose first molecule is i.
+		/// @param chunk The index of the chunk to find.
+		/// @param chunkCount The total number of chunks.
+		/// @param begin Set to the first row of the chunk.
+		/// @param end Set to one past the last row of the chunk.
+		void chunkForSystem(int chunk, int chunkCount, int *begin, int *end) const;
+
+		/// Splits a range of items into chunks of equal cost, given the
+		///   running cost of the items.
+		/// @param prefix prefix[i] holds the cost of items [0, i).
+		/// @param chunk The index of the chunk to find.
+		/// @param chunkCount The total number of chunks.
+		/// @param begin Set to the first item of the chunk.
+		/// @param end Set to one past the last item of the chunk.
+		static void splitPrefix(const std::vector<double> &prefix, int chunk, int chunkCount,
+								int *begin, int *end);
+
+	private:
+		/// atomPrefix[i] holds the number of atoms in molecules [0, i).
+		std::vector<double> atomPrefix;
+
+		/// rowPrefix[i] holds the estimated cost of rows [0, i).
+		std::vector<double> rowPrefix;
+
+		/// The estimated fraction of molecule pairs that lie within the
+		///   cutoff and therefore pay the full atom pair cost.
+		double cutoffFraction;
+
+		/// Estimated cost of the pairs between a molecule with the given
+		///   number of atoms and the molecules in [startIdx, idx).
+		double moleculeCost(int atoms, int startIdx, int idx) const;
+};
+
+#endif
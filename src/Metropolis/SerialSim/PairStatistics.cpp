@@ -0,0 +1,450 @@
+/*
+	Per-type-pair sufficient statistics of the cutoff energy. For a fixed
+	configuration and cutoff, the Lennard-Jones and Coulomb energies are
+	linear in the sums of r^-12, r^-6 and r^-1 over the atom pairs of each
+	pair of atom types, so once a snapshot has been reduced to those sums its
+	energy under any other sigma, epsilon and charge of the types costs
+	O(types^2), without touching the coordinates again.
+*/
+
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "CellGrid.h"
+#include "PairStatistics.h"
+#include "SerialCalcs.h"
+
+/// A named set of type parameters read by reweight.
+struct ParameterSet
+{
+	std::string name;
+	std::vector<int> types;
+	std::vector<AtomType> parameters;
+};
+
+PairStatistics::PairStatistics()
+{
+	step = 0;
+	cutoff = 0;
+}
+
+void PairStatistics::accumulate(Molecule *molecules, Environment *environment, long step)
+{
+	this->step = step;
+	cutoff = environment->cutoff;
+	types.clear();
+	atomCounts.clear();
+
+	//type every atom once, so the pair loop only looks types up
+	std::vector<int> firstAtom(environment->numOfMolecules + 1, 0);
+	std::vector<int> atomTypes;
+	for (int mol = 0; mol < environment->numOfMolecules; mol++)
+	{
+		firstAtom[mol] = atomTypes.size();
+		for (int i = 0; i < molecules[mol].numOfAtoms; i++)
+		{
+			Atom atom = molecules[mol].atoms[i];
+			int type = -1;
+			if (atom.sigma >= 0 && atom.epsilon >= 0)
+			{
+				type = findType(atom);
+				atomCounts[type]++;
+			}
+			atomTypes.push_back(type);
+		}
+	}
+	firstAtom[environment->numOfMolecules] = atomTypes.size();
+
+	//the boxes of every engine are searched with a grid of their own, so
+	//only the molecules near each one are tested against the cutoff
+	CellGrid grid;
+	grid.build(molecules, environment);
+
+	int typeCount = types.size();
+	TypePairSums zero = {0, 0, 0, 0};
+	std::vector<std::vector<TypePairSums> > partialSums(omp_get_max_threads());
+
+	#pragma omp parallel
+	{
+		std::vector<TypePairSums> &threadSums = partialSums[omp_get_thread_num()];
+		threadSums.assign(typeCount * typeCount, zero);
+		std::vector<int> candidates;
+
+		#pragma omp for schedule(dynamic)
+		for (int mol1 = 0; mol1 < environment->numOfMolecules; mol1++)
+		{
+			grid.findCandidates(molecules, environment, mol1, candidates);
+			std::sort(candidates.begin(), candidates.end());
+			for (int c = 0; c < candidates.size(); c++)
+			{
+				int mol2 = candidates[c];
+				if (mol2 <= mol1 || !SerialCalcs::moleculesInCutoff(molecules, environment, mol1, mol2))
+				{
+					continue;
+				}
+
+				for (int i = 0; i < molecules[mol1].numOfAtoms; i++)
+				{
+					int type1 = atomTypes[firstAtom[mol1] + i];
+					if (type1 < 0)
+					{
+						continue;
+					}
+					Atom atom1 = molecules[mol1].atoms[i];
+
+					for (int j = 0; j < molecules[mol2].numOfAtoms; j++)
+					{
+						int type2 = atomTypes[firstAtom[mol2] + j];
+						if (type2 < 0)
+						{
+							continue;
+						}
+						Atom atom2 = molecules[mol2].atoms[j];
+
+						//the same distance calcInterMolecularEnergy uses
+						Real deltaX = SerialCalcs::makePeriodic(atom1.x - atom2.x, environment->x, environment->periodic);
+						Real deltaY = SerialCalcs::makePeriodic(atom1.y - atom2.y, environment->y, environment->periodic);
+						Real deltaZ = SerialCalcs::makePeriodic(atom1.z - atom2.z, environment->z, environment->periodic);
+						Real r2 = (deltaX * deltaX) + (deltaY * deltaY) + (deltaZ * deltaZ);
+
+						//coincident atoms contribute nothing to either energy
+						if (r2 == 0.0)
+						{
+							continue;
+						}
+
+						double inverse2 = 1.0 / r2;
+						double inverse6 = inverse2 * inverse2 * inverse2;
+						TypePairSums &pair = threadSums[std::min(type1, type2) * typeCount + std::max(type1, type2)];
+						pair.pairs++;
+						pair.inverse12 += inverse6 * inverse6;
+						pair.inverse6 += inverse6;
+						pair.inverse1 += 1.0 / sqrt((double) r2);
+					}
+				}
+			}
+		}
+	}
+
+	//combine in thread order
+	sums.assign(typeCount * typeCount, zero);
+	for (int t = 0; t < partialSums.size(); t++)
+	{
+		for (int k = 0; k < partialSums[t].size(); k++)
+		{
+			sums[k].pairs += partialSums[t][k].pairs;
+			sums[k].inverse12 += partialSums[t][k].inverse12;
+			sums[k].inverse6 += partialSums[t][k].inverse6;
+			sums[k].inverse1 += partialSums[t][k].inverse1;
+		}
+	}
+}
+
+bool PairStatistics::write(const std::string &path) const
+{
+	std::ofstream file(path.c_str());
+	if (!file.is_open())
+	{
+		std::cerr << "Error: Could not open pair statistics file " << path << std::endl;
+		return false;
+	}
+
+	double lj, coulomb;
+	evaluate(types, &lj, &coulomb);
+
+	file << std::setprecision(17);
+	file << "######### MCGPU Pair Statistics #############" << std::endl;
+	file << "Step = " << step << std::endl;
+	file << "Cutoff = " << cutoff << std::endl;
+	file << "Types = " << types.size() << std::endl;
+	file << "LJ-Energy = " << lj << std::endl;
+	file << "Coulomb-Energy = " << coulomb << std::endl << std::endl;
+
+	file << "[Types]" << std::endl;
+	file << "# type sigma epsilon charge atoms" << std::endl;
+	for (int t = 0; t < types.size(); t++)
+	{
+		file << t << " " << types[t].sigma << " " << types[t].epsilon << " " << types[t].charge
+			<< " " << atomCounts[t] << std::endl;
+	}
+	file << std::endl;
+
+	file << "[Pairs]" << std::endl;
+	file << "# type1 type2 pairs sum(r^-12) sum(r^-6) sum(r^-1)" << std::endl;
+	for (int a = 0; a < types.size(); a++)
+	{
+		for (int b = a; b < types.size(); b++)
+		{
+			const TypePairSums &pair = sums[a * types.size() + b];
+			if (pair.pairs > 0)
+			{
+				file << a << " " << b << " " << pair.pairs << " " << pair.inverse12 << " "
+					<< pair.inverse6 << " " << pair.inverse1 << std::endl;
+			}
+		}
+	}
+
+	file.close();
+	return !file.fail();
+}
+
+bool PairStatistics::read(const std::string &path)
+{
+	std::ifstream file(path.c_str());
+	if (!file.is_open())
+	{
+		std::cerr << "Error: Could not open pair statistics file " << path << std::endl;
+		return false;
+	}
+
+	types.clear();
+	atomCounts.clear();
+	sums.clear();
+	TypePairSums zero = {0, 0, 0, 0};
+	std::string section, line;
+	int typeCount = -1;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+		if (line[0] == '[')
+		{
+			section = line;
+			if (section == "[Pairs]")
+			{
+				if (typeCount != types.size())
+				{
+					std::cerr << "Error: " << path << " lists " << types.size() << " of "
+						<< typeCount << " types" << std::endl;
+					return false;
+				}
+				sums.assign(typeCount * typeCount, zero);
+			}
+			continue;
+		}
+
+		std::istringstream fields(line);
+		bool valid = true;
+		if (section.empty())
+		{
+			std::string key, equals;
+			fields >> key >> equals;
+			if (key == "Step")
+			{
+				valid = !(fields >> step).fail();
+			}
+			else if (key == "Cutoff")
+			{
+				valid = !(fields >> cutoff).fail();
+			}
+			else if (key == "Types")
+			{
+				valid = !(fields >> typeCount).fail();
+			}
+		}
+		else if (section == "[Types]")
+		{
+			int index;
+			AtomType type;
+			long count;
+			valid = !(fields >> index >> type.sigma >> type.epsilon >> type.charge >> count).fail() &&
+				index == types.size();
+			types.push_back(type);
+			atomCounts.push_back(count);
+		}
+		else if (section == "[Pairs]")
+		{
+			int a, b;
+			TypePairSums pair;
+			valid = !(fields >> a >> b >> pair.pairs >> pair.inverse12 >> pair.inverse6 >> pair.inverse1).fail() &&
+				a >= 0 && a <= b && b < typeCount;
+			if (valid)
+			{
+				sums[a * typeCount + b] = pair;
+			}
+		}
+
+		if (!valid)
+		{
+			std::cerr << "Error: Invalid line " << lineNumber << " in " << path << std::endl;
+			return false;
+		}
+	}
+
+	if (typeCount < 0 || sums.size() != typeCount * typeCount)
+	{
+		std::cerr << "Error: " << path << " is not a complete pair statistics file" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void PairStatistics::evaluate(const std::vector<AtomType> &parameters, double *lj, double *coulomb) const
+{
+	*lj = 0;
+	*coulomb = 0;
+	int typeCount = types.size();
+	for (int a = 0; a < typeCount; a++)
+	{
+		for (int b = a; b < typeCount; b++)
+		{
+			const TypePairSums &pair = sums[a * typeCount + b];
+			if (pair.pairs == 0)
+			{
+				continue;
+			}
+
+			double sigma2 = sqrt((double) parameters[a].sigma * parameters[b].sigma);
+			sigma2 *= sigma2;
+			double sigma6 = sigma2 * sigma2 * sigma2;
+			double epsilon = sqrt((double) parameters[a].epsilon * parameters[b].epsilon);
+			*lj += 4.0 * epsilon * (sigma6 * sigma6 * pair.inverse12 - sigma6 * pair.inverse6);
+			*coulomb += COULOMB_FACTOR * parameters[a].charge * parameters[b].charge * pair.inverse1;
+		}
+	}
+}
+
+const std::vector<AtomType> &PairStatistics::getTypes() const
+{
+	return types;
+}
+
+long PairStatistics::getStep() const
+{
+	return step;
+}
+
+/**
+  Reads the parameter sets of reweight. Lines before the first "[name]"
+  header form a set of their own, named by its position.
+*/
+static bool readParameterSets(const std::string &path, std::vector<ParameterSet> &sets)
+{
+	std::ifstream file(path.c_str());
+	if (!file.is_open())
+	{
+		std::cerr << "Error: Could not open parameter set file " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		std::istringstream fields(line);
+		std::string first;
+		if (!(fields >> first) || first[0] == '#')
+		{
+			continue;
+		}
+
+		if (first[0] == '[')
+		{
+			ParameterSet set;
+			set.name = line.substr(line.find('[') + 1);
+			set.name = set.name.substr(0, set.name.find(']'));
+			sets.push_back(set);
+			continue;
+		}
+
+		if (sets.empty())
+		{
+			ParameterSet set;
+			set.name = "1";
+			sets.push_back(set);
+		}
+
+		std::istringstream values(line);
+		int type;
+		AtomType parameters;
+		if (!(values >> type >> parameters.sigma >> parameters.epsilon >> parameters.charge) ||
+			type < 0 || parameters.sigma < 0 || parameters.epsilon < 0)
+		{
+			std::cerr << "Error: Invalid line " << lineNumber << " in " << path
+				<< " (expected: type sigma epsilon charge)" << std::endl;
+			return false;
+		}
+		sets.back().types.push_back(type);
+		sets.back().parameters.push_back(parameters);
+	}
+
+	if (sets.empty())
+	{
+		std::cerr << "Error: " << path << " has no parameter sets" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool PairStatistics::reweight(const std::string &parameterPath, const std::vector<std::string> &framePaths)
+{
+	std::vector<ParameterSet> sets;
+	if (!readParameterSets(parameterPath, sets))
+	{
+		return false;
+	}
+
+	std::cout << "# frame step set lj coulomb total delta" << std::endl;
+	std::cout << std::setprecision(10);
+	for (int f = 0; f < framePaths.size(); f++)
+	{
+		PairStatistics frame;
+		if (!frame.read(framePaths[f]))
+		{
+			return false;
+		}
+
+		double originalLJ, originalCoulomb;
+		frame.evaluate(frame.types, &originalLJ, &originalCoulomb);
+
+		for (int s = 0; s < sets.size(); s++)
+		{
+			std::vector<AtomType> types = frame.types;
+			for (int k = 0; k < sets[s].types.size(); k++)
+			{
+				if (sets[s].types[k] >= types.size())
+				{
+					std::cerr << "Error: Parameter set '" << sets[s].name << "' changes type " << sets[s].types[k]
+						<< ", but " << framePaths[f] << " has " << types.size() << " types" << std::endl;
+					return false;
+				}
+				types[sets[s].types[k]] = sets[s].parameters[k];
+			}
+
+			double lj, coulomb;
+			frame.evaluate(types, &lj, &coulomb);
+			std::cout << framePaths[f] << " " << frame.step << " " << sets[s].name << " " << lj << " "
+				<< coulomb << " " << lj + coulomb << " " << (lj + coulomb) - (originalLJ + originalCoulomb)
+				<< std::endl;
+		}
+	}
+	return true;
+}
+
+int PairStatistics::findType(const Atom &atom)
+{
+	for (int t = 0; t < types.size(); t++)
+	{
+		if (types[t].sigma == atom.sigma && types[t].epsilon == atom.epsilon && types[t].charge == atom.charge)
+		{
+			return t;
+		}
+	}
+
+	AtomType type;
+	type.sigma = atom.sigma;
+	type.epsilon = atom.epsilon;
+	type.charge = atom.charge;
+	types.push_back(type);
+	atomCounts.push_back(0);
+	return types.size() - 1;
+}
@@ -0,0 +1,101 @@
+/*
+	Per-type-pair sufficient statistics of the cutoff energy. For a fixed
+	configuration and cutoff, the Lennard-Jones and Coulomb energies are
+	linear in the sums of r^-12, r^-6 and r^-1 over the atom pairs of each
+	pair of atom types, so once a snapshot has been reduced to those sums its
+	energy under any other sigma, epsilon and charge of the types costs
+	O(types^2), without touching the coordinates again.
+*/
+
+#ifndef PAIRSTATISTICS_H
+#define PAIRSTATISTICS_H
+
+#include <string>
+#include <vector>
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/Utilities/StructLibrary.h"
+
+/// The extension of the pair statistics files written next to state files.
+#define PAIR_STATISTICS_EXT ".pairstats"
+
+/// The parameters shared by all atoms of one type.
+struct AtomType
+{
+	Real sigma;
+	Real epsilon;
+	Real charge;
+};
+
+/// The sums over all evaluated atom pairs of two types.
+struct TypePairSums
+{
+	long pairs;
+	double inverse12;
+	double inverse6;
+	double inverse1;
+};
+
+class PairStatistics
+{
+	public:
+		PairStatistics();
+
+		/// Groups the atoms into types and sums the inverse powers of the
+		///   distances of every atom pair that calcSystemEnergy evaluates:
+		///   the non-dummy atoms of molecule pairs whose primary atoms are
+		///   within the cutoff. The pairs are found with a CellGrid built
+		///   for the call, since the box may belong to any engine.
+		/// @param molecules A pointer to the Molecule array.
+		/// @param environment A pointer to the Environment for the simulation.
+		/// @param step The simulation step of the configuration.
+		void accumulate(Molecule *molecules, Environment *environment, long step);
+
+		/// @param path The path of the pair statistics file.
+		/// @return Returns false if the file could not be written.
+		bool write(const std::string &path) const;
+
+		/// @param path The path of a file written by write.
+		/// @return Returns false if the file could not be read.
+		bool read(const std::string &path);
+
+		/// Evaluates the energy of the snapshot with new type parameters,
+		///   mixed with the same geometric rules as the simulation.
+		/// @param parameters The parameters of each type, indexed like
+		///   getTypes.
+		/// @param lj Set to the Lennard-Jones energy.
+		/// @param coulomb Set to the Coulomb energy.
+		void evaluate(const std::vector<AtomType> &parameters, double *lj, double *coulomb) const;
+
+		/// @return Returns the parameters of each type, in order of first
+		///   appearance in the box.
+		const std::vector<AtomType> &getTypes() const;
+
+		/// @return Returns the simulation step of the snapshot.
+		long getStep() const;
+
+		/// Reads parameter sets from a file and prints the energy of every
+		///   snapshot under every set. Each set starts with a "[name]" line
+		///   and lists "type sigma epsilon charge" lines for the types it
+		///   changes; the other types keep the parameters of the snapshot.
+		/// @param parameterPath The path of the parameter set file.
+		/// @param framePaths The paths of the pair statistics files.
+		/// @return Returns false if a file could not be read, or a set
+		///   names a type the snapshots do not have.
+		static bool reweight(const std::string &parameterPath, const std::vector<std::string> &framePaths);
+
+	private:
+		long step;
+		Real cutoff;
+		std::vector<AtomType> types;
+
+		/// The number of atoms of each type.
+		std::vector<long> atomCounts;
+
+		/// The sums of each unordered pair of types, at the index
+		///   first * types + second with first <= second.
+		std::vector<TypePairSums> sums;
+
+		int findType(const Atom &atom);
+};
+
+#endif
@@ -0,0 +1,249 @@
+/*
+	Random-batch Ewald estimate of the full periodic electrostatic energy of
+	a box. The real-space sum is screened with erfc over the same cutoff
+	pairs the simulation evaluates, and the reciprocal-space sum is replaced
+	by an unbiased estimate from a small batch of k-vectors drawn from the
+	Gaussian weight of the Ewald kernel. A batch costs O(atoms * batch size),
+	independent of the number of k-vectors a converged sum would need, and
+	repeating it with fresh batches measures the variance of the estimate.
+*/
+
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+#include "RandomBatchEwald.h"
+#include "SerialBox.h"
+#include "SerialCalcs.h"
+#include "Metropolis/Utilities/MathLibrary.h"
+
+/// Lattice indices are kept while their Gaussian weight exceeds exp(-37).
+#define EWALD_WEIGHT_EXPONENT 37
+
+RandomBatchEwald::RandomBatchEwald(int batchSize)
+{
+	this->batchSize = batchSize;
+	for (int d = 0; d < 3; d++)
+	{
+		limit[d] = 0;
+	}
+}
+
+void RandomBatchEwald::estimate(SerialBox *box, EwaldEstimate &result)
+{
+	SerialCalcs::prepareBox(box);
+	Molecule *molecules = box->getMolecules();
+	Environment *environment = box->getEnvironment();
+	Real alpha = sqrt(-log(EWALD_TOLERANCE)) / environment->cutoff;
+
+	//real space over the cutoff pairs, next to the plain Coulomb sum
+	double real = 0, coulomb = 0, intramolecular = 0;
+	#pragma omp parallel reduction(+:real,coulomb,intramolecular)
+	{
+		std::vector<int> neighbors;
+		#pragma omp for schedule(dynamic, 16)
+		for (int mol = 0; mol < environment->numOfMolecules; mol++)
+		{
+			if (!box->isPresent(mol))
+			{
+				continue;
+			}
+			Molecule &molecule = molecules[mol];
+			SerialCalcs::findNeighbors(box, mol, mol + 1, neighbors);
+			for (int n = 0; n < neighbors.size(); n++)
+			{
+				Molecule &other = molecules[neighbors[n]];
+				for (int i = 0; i < molecule.numOfAtoms; i++)
+				{
+					Atom atom1 = molecule.atoms[i];
+					if (atom1.sigma < 0 || atom1.epsilon < 0 || atom1.charge == 0)
+					{
+						continue;
+					}
+					for (int j = 0; j < other.numOfAtoms; j++)
+					{
+						Atom atom2 = other.atoms[j];
+						if (atom2.sigma < 0 || atom2.epsilon < 0 || atom2.charge == 0)
+						{
+							continue;
+						}
+						Real dx = SerialCalcs::makePeriodic(atom1.x - atom2.x, environment->x);
+						Real dy = SerialCalcs::makePeriodic(atom1.y - atom2.y, environment->y);
+						Real dz = SerialCalcs::makePeriodic(atom1.z - atom2.z, environment->z);
+						Real r = sqrt(dx * dx + dy * dy + dz * dz);
+						real += COULOMB_FACTOR * atom1.charge * atom2.charge * erfc(alpha * r) / r;
+						coulomb += SerialCalcs::calcCharge(atom1.charge, atom2.charge, r);
+					}
+				}
+			}
+
+			//the reciprocal sum also couples atoms of the same molecule
+			for (int i = 0; i < molecule.numOfAtoms; i++)
+			{
+				Atom atom1 = molecule.atoms[i];
+				if (atom1.sigma < 0 || atom1.epsilon < 0 || atom1.charge == 0)
+				{
+					continue;
+				}
+				for (int j = i + 1; j < molecule.numOfAtoms; j++)
+				{
+					Atom atom2 = molecule.atoms[j];
+					if (atom2.sigma < 0 || atom2.epsilon < 0 || atom2.charge == 0)
+					{
+						continue;
+					}
+					Real dx = SerialCalcs::makePeriodic(atom1.x - atom2.x, environment->x);
+					Real dy = SerialCalcs::makePeriodic(atom1.y - atom2.y, environment->y);
+					Real dz = SerialCalcs::makePeriodic(atom1.z - atom2.z, environment->z);
+					Real r = sqrt(dx * dx + dy * dy + dz * dz);
+					intramolecular += COULOMB_FACTOR * atom1.charge * atom2.charge * erf(alpha * r) / r;
+				}
+			}
+		}
+	}
+
+	gatherCharges(box);
+	double squaredCharge = 0;
+	for (int i = 0; i < charge.size(); i++)
+	{
+		squaredCharge += charge[i] * charge[i];
+	}
+
+	double normalizer;
+	buildSampler(environment, alpha, &normalizer);
+
+	//every repeat draws its batch from RANDOM_BATCH_EWALD_SEED, so runs of
+	//the same box report the same mean and spread; seedThread(NULL) after the
+	//repeats hands the thread back to the simulation stream
+	unsigned int stream = RANDOM_BATCH_EWALD_SEED;
+	seedThread(&stream);
+
+	double sum = 0, sumSquares = 0;
+	double startTime = omp_get_wtime();
+	for (int b = 0; b < RANDOM_BATCH_EWALD_REPEATS; b++)
+	{
+		double sample = batchEstimate(environment, normalizer);
+		sum += sample;
+		sumSquares += sample * sample;
+	}
+	double elapsed = omp_get_wtime() - startTime;
+
+	seedThread(NULL);
+
+	int repeats = RANDOM_BATCH_EWALD_REPEATS;
+	double mean = sum / repeats;
+	double variance = std::max(0.0, (sumSquares - repeats * mean * mean) / (repeats - 1));
+
+	result.real = real;
+	result.reciprocal = mean;
+	result.reciprocalError = sqrt(variance / repeats);
+	result.self = -COULOMB_FACTOR * alpha / sqrt(PI) * squaredCharge;
+	result.intramolecular = intramolecular;
+	result.total = result.real + result.reciprocal - result.intramolecular + result.self;
+	result.cutoffCoulomb = coulomb;
+	result.batchSize = batchSize;
+	result.batches = repeats;
+	result.secondsPerBatch = elapsed / repeats;
+}
+
+void RandomBatchEwald::gatherCharges(SerialBox *box)
+{
+	Molecule *molecules = box->getMolecules();
+	Environment *environment = box->getEnvironment();
+
+	x.clear();
+	y.clear();
+	z.clear();
+	charge.clear();
+	for (int mol = 0; mol < environment->numOfMolecules; mol++)
+	{
+		if (!box->isPresent(mol))
+		{
+			continue;
+		}
+		for (int i = 0; i < molecules[mol].numOfAtoms; i++)
+		{
+			Atom atom = molecules[mol].atoms[i];
+			if (atom.sigma >= 0 && atom.epsilon >= 0 && atom.charge != 0)
+			{
+				x.push_back(atom.x);
+				y.push_back(atom.y);
+				z.push_back(atom.z);
+				charge.push_back(atom.charge);
+			}
+		}
+	}
+}
+
+void RandomBatchEwald::buildSampler(Environment *environment, Real alpha, double *normalizer)
+{
+	//the weight exp(-k^2 / 4 alpha^2) factors over the three dimensions, so
+	//each lattice index is drawn on its own and k = 0 is rejected
+	Real dimensions[3] = {environment->x, environment->y, environment->z};
+	double product = 1;
+	for (int d = 0; d < 3; d++)
+	{
+		limit[d] = (int) ceil(sqrt((double) EWALD_WEIGHT_EXPONENT) * alpha * dimensions[d] / PI) + 1;
+		cumulative[d].assign(2 * limit[d] + 1, 0);
+
+		double total = 0;
+		for (int n = -limit[d]; n <= limit[d]; n++)
+		{
+			double k = 2 * PI * n / dimensions[d];
+			total += exp(-k * k / (4 * alpha * alpha));
+			cumulative[d][n + limit[d]] = total;
+		}
+		for (int i = 0; i < cumulative[d].size(); i++)
+		{
+			cumulative[d][i] /= total;
+		}
+		product *= total;
+	}
+	*normalizer = product - 1;
+}
+
+int RandomBatchEwald::drawIndex(int dimension) const
+{
+	const std::vector<double> &weights = cumulative[dimension];
+	double u = randomReal(0.0, 1.0);
+	int slot = std::lower_bound(weights.begin(), weights.end(), u) - weights.begin();
+	return std::min(slot, (int) weights.size() - 1) - limit[dimension];
+}
+
+Real RandomBatchEwald::batchEstimate(Environment *environment, double normalizer)
+{
+	std::vector<double> kx(batchSize), ky(batchSize), kz(batchSize);
+	for (int p = 0; p < batchSize; p++)
+	{
+		int n[3];
+		do
+		{
+			n[0] = drawIndex(0);
+			n[1] = drawIndex(1);
+			n[2] = drawIndex(2);
+		} while (n[0] == 0 && n[1] == 0 && n[2] == 0);
+
+		kx[p] = 2 * PI * n[0] / environment->x;
+		ky[p] = 2 * PI * n[1] / environment->y;
+		kz[p] = 2 * PI * n[2] / environment->z;
+	}
+
+	//each k-vector needs the structure factor over every charge
+	double total = 0;
+	int atomCount = charge.size();
+	#pragma omp parallel for reduction(+:total)
+	for (int p = 0; p < batchSize; p++)
+	{
+		double re = 0, im = 0;
+		for (int i = 0; i < atomCount; i++)
+		{
+			double phase = kx[p] * x[i] + ky[p] * y[i] + kz[p] * z[i];
+			re += charge[i] * cos(phase);
+			im += charge[i] * sin(phase);
+		}
+		double k2 = kx[p] * kx[p] + ky[p] * ky[p] + kz[p] * kz[p];
+		total += (re * re + im * im) / k2;
+	}
+
+	double volume = (double) environment->x * environment->y * environment->z;
+	return COULOMB_FACTOR * 2 * PI / volume * normalizer * total / batchSize;
+}
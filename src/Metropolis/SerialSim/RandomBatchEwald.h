@@ -0,0 +1,84 @@
+/*
+	Random-batch Ewald estimate of the full periodic electrostatic energy of
+	a box. The real-space sum is screened with erfc over the same cutoff
+	pairs the simulation evaluates, and the reciprocal-space sum is replaced
+	by an unbiased estimate from a small batch of k-vectors drawn from the
+	Gaussian weight of the Ewald kernel. A batch costs O(atoms * batch size),
+	independent of the number of k-vectors a converged sum would need, and
+	repeating it with fresh batches measures the variance of the estimate.
+*/
+
+#ifndef RANDOMBATCHEWALD_H
+#define RANDOMBATCHEWALD_H
+
+#include <vector>
+#include "Metropolis/DataTypes.h"
+#include "Metropolis/Utilities/StructLibrary.h"
+
+/// The erfc screening left at the cutoff, which sets the splitting parameter.
+#define EWALD_TOLERANCE 1e-5
+
+/// Independent batches drawn to estimate the variance.
+#define RANDOM_BATCH_EWALD_REPEATS 16
+
+/// Seed of the k-vector draws, kept apart from the simulation stream.
+#define RANDOM_BATCH_EWALD_SEED 24680
+
+class SerialBox;
+
+struct EwaldEstimate
+{
+	/// The screened real-space energy of the cutoff pairs.
+	Real real;
+
+	/// The mean reciprocal-space estimate over all batches, and its
+	///   standard error.
+	Real reciprocal;
+	Real reciprocalError;
+
+	/// The self energy and the reciprocal-space energy of atom pairs within
+	///   a molecule, both of which Ewald summation subtracts.
+	Real self;
+	Real intramolecular;
+
+	/// The estimated Ewald electrostatic energy, and the plain Coulomb
+	///   energy of the cutoff pairs that the simulation uses.
+	Real total;
+	Real cutoffCoulomb;
+
+	/// The k-vectors in each batch, the number of batches, and the mean
+	///   time taken by one batch.
+	int batchSize;
+	int batches;
+	double secondsPerBatch;
+};
+
+class RandomBatchEwald
+{
+	public:
+		/// @param batchSize The k-vectors drawn for each estimate.
+		RandomBatchEwald(int batchSize);
+
+		/// Estimates the Ewald electrostatic energy of a periodic box.
+		/// @param box A pointer to the SerialBox.
+		/// @param result Filled with the estimate and its statistics.
+		void estimate(SerialBox *box, EwaldEstimate &result);
+
+	private:
+		int batchSize;
+
+		/// The charged atoms of the box that calcInterMolecularEnergy counts.
+		std::vector<Real> x, y, z, charge;
+
+		/// The normalized cumulative weights of the lattice index along
+		///   each dimension, for indices -limit..limit.
+		std::vector<double> cumulative[3];
+		int limit[3];
+
+		void gatherCharges(SerialBox *box);
+		void buildSampler(Environment *environment, Real alpha, double *normalizer);
+		int drawIndex(int dimension) const;
+		Real batchEstimate(Environment *environment, double normalizer);
+};
+
+#endif
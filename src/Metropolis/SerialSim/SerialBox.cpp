@@ -11,6 +11,7 @@
 */
 
 #include "SerialBox.h"
+#include "Metropolis/Utilities/SharedTopology.h"
 
 using namespace std;
 
@@ -21,6 +22,7 @@ SerialBox::SerialBox() : Box()
 
 SerialBox::~SerialBox()
 {
+	releaseTopology(this);
 	FREE(angles);
 	FREE(atoms);
 	FREE(bonds);
@@ -28,4 +30,44 @@ SerialBox::~SerialBox()
 	FREE(environment);
 	FREE(hops);
 	FREE(molecules);
-}
\ No newline at end of file
+}
+
+int SerialBox::commitChange(int molIdx)
+{
+	if (grid.isBuilt(environment->numOfMolecules))
+	{
+		grid.update(molecules, environment, molIdx);
+	}
+	if (multipoles.isBuilt(environment->numOfMolecules))
+	{
+		multipoles.update(molecules, environment, molIdx);
+	}
+	neighbors.poll(molecules, environment);
+	neighbors.commit(molecules, environment, molIdx);
+	if (occupancy.getHardCoreRadius() > 0)
+	{
+		occupancy.moveMolecule(changedMol, molecules[molIdx]);
+	}
+	return molIdx;
+}
+
+void SerialBox::resetSpatialIndex()
+{
+	grid = CellGrid();
+}
+
+bool SerialBox::hasOverlap(int molIdx, Real hardCoreFraction)
+{
+	if (!occupancy.isBuilt(environment->numOfMolecules, hardCoreFraction))
+	{
+		//the map is built from committed positions, so use the saved copy
+		swapChangedMol(molIdx);
+		occupancy.build(molecules, environment, hardCoreFraction);
+		swapChangedMol(molIdx);
+	}
+	
+	//a molecule leaving a close contact may lower the energy, so only
+	//screen moves that start well clear of every other heavy atom
+	return occupancy.overlaps(molecules[molIdx], changedMol, 0) &&
+		!occupancy.overlaps(changedMol, changedMol, 1);
+}
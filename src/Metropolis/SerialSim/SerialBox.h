@@ -13,7 +13,15 @@
 #ifndef SERIALBOX_H
 #define SERIALBOX_H
 
+#include <vector>
 #include "Metropolis/Box.h"
+#include "AdaptiveResolution.h"
+#include "CellGrid.h"
+#include "KindTable.h"
+#include "MultipoleCache.h"
+#include "NeighborList.h"
+#include "OccupancyMap.h"
+#include "PairCostPartition.h"
 
 class SerialBox : public Box
 {
@@ -21,8 +29,64 @@ class SerialBox : public Box
 		SerialBox();
 		~SerialBox();
 
+		/// Keeps the spatial indexes in step with an accepted change.
+		/// @param molIdx The index of the molecule that was changed.
+		/// @return Returns the index of the committed molecule.
+		int commitChange(int molIdx);
+
+		/// Tests a changed molecule for a gross overlap with the heavy atoms
+		///   of any other molecule, building the occupancy map if needed.
+		///   Molecules that were already in close contact before the change
+		///   are never reported, since moving them may still lower the energy.
+		/// @param molIdx The index of the molecule that was changed.
+		/// @param hardCoreFraction The hard-core radius as a fraction of the
+		///   smallest heavy atom sigma.
+		/// @return Returns true if the change should be rejected outright.
+		bool hasOverlap(int molIdx, Real hardCoreFraction);
+
+		/// Checks whether a molecule belongs to this box.
+		/// @param molIdx The index of the molecule.
+		/// @return Returns true unless membership is tracked and the
+		///   molecule is elsewhere.
+		bool isPresent(int molIdx) const
+		{
+			return present.empty() || present[molIdx];
+		}
+
+		/// Discards the spatial index, which must be done whenever the
+		///   dimensions of the box change.
+		void resetSpatialIndex();
+
 		int molecTypenum;
 		Table *tables;
+
+		/// Whether each molecule belongs to this box, for ensembles that
+		///   move molecules between boxes. Empty when every molecule does.
+		std::vector<char> present;
+
+		/// Cost model used to split energy evaluations among threads.
+		PairCostPartition partition;
+
+		/// Spatial index used to find the neighbors of a molecule.
+		CellGrid grid;
+
+		/// Molecule kinds and their premixed pair parameters, used to
+		///   evaluate neighbors in runs of a single kind.
+		KindTable kinds;
+
+		/// Verlet lists rebuilt in the background, used ahead of the grid
+		///   when a skin has been set.
+		NeighborList neighbors;
+
+		/// Molecular moments used to approximate mid-range pairs.
+		MultipoleCache multipoles;
+
+		/// Heavy atom occupancy used to pre-screen trial moves.
+		OccupancyMap occupancy;
+
+		/// Atomistic weights and coarse-grained tables for adaptive
+		///   resolution around a solute.
+		AdaptiveResolution resolution;
 };
 
 #endif
\ No newline at end of file
@@ -8,8 +8,12 @@
 	-> April 21, by Nathan Coleman
 */
 
+#include <float.h>
 #include <math.h>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <omp.h>
 #include "Metropolis/DataTypes.h"
 #include "Metropolis/SimulationArgs.h"
 #include "Metropolis/Utilities/FileUtilities.h"
@@ -17,10 +21,11 @@
 
 using namespace std;
 
-Box* SerialCalcs::createBox(std::string inputPath, InputFileType inputType, long* startStep, long* steps)
+Box* SerialCalcs::createBox(std::string inputPath, InputFileType inputType, long* startStep, long* steps,
+                             bool shareTopology)
 {
 	SerialBox* box = new SerialBox();
-	if (!loadBoxData(inputPath, inputType, box, startStep, steps))
+	if (!loadBoxData(inputPath, inputType, box, startStep, steps, shareTopology))
 	{
 		if (inputType != InputFile::Unknown)
 		{
@@ -66,9 +71,9 @@ Real SerialCalcs::calcMolecularEnergyContribution(Molecule *molecules, Environme
 			Real cutoffSQ = environment->cutoff * environment->cutoff;
 				
 			//calculate difference in coordinates
-			Real deltaX = makePeriodic(atom1.x - atom2.x, environment->x);
-			Real deltaY = makePeriodic(atom1.y - atom2.y, environment->y);
-			Real deltaZ = makePeriodic(atom1.z - atom2.z, environment->z);
+			Real deltaX = makePeriodic(atom1.x - atom2.x, environment->x, environment->periodic);
+			Real deltaY = makePeriodic(atom1.y - atom2.y, environment->y, environment->periodic);
+			Real deltaZ = makePeriodic(atom1.z - atom2.z, environment->z, environment->periodic);
 			
 			Real r2 = (deltaX * deltaX) +
 						(deltaY * deltaY) + 
@@ -86,6 +91,756 @@ Real SerialCalcs::calcMolecularEnergyContribution(Molecule *molecules, Environme
 	return totalEnergy;
 }
 
+Real SerialCalcs::calcSystemEnergy(Box *box)
+{
+	SerialBox *serialBox = prepareBox(box);
+	bool multipoles = serialBox->multipoles.getInnerRadius() > 0;
+	
+	std::vector<Real> partialEnergy(omp_get_max_threads(), 0);
+	
+	#pragma omp parallel
+	{
+		int thread = omp_get_thread_num();
+		int firstMol, lastMol;
+		serialBox->partition.chunkForSystem(thread, omp_get_num_threads(), &firstMol, &lastMol);
+		
+		std::vector<int> neighbors;
+		std::vector<Real> energies;
+		Real threadEnergy = 0;
+		for (int mol = firstMol; mol < lastMol; mol++)
+		{
+			if (!serialBox->isPresent(mol))
+			{
+				continue;
+			}
+			const Multipole *pole = multipoles ? &serialBox->multipoles.get(mol) : NULL;
+			findNeighbors(serialBox, mol, mol + 1, neighbors);
+			energies.resize(neighbors.size());
+			addNeighborEnergies(serialBox, pole, mol, neighbors, 0, neighbors.size(), energies, threadEnergy);
+		}
+		partialEnergy[thread] = threadEnergy;
+	}
+	
+	//combine in thread order so the result does not depend on scheduling
+	Real totalEnergy = 0;
+	for (int i = 0; i < partialEnergy.size(); i++)
+	{
+		totalEnergy += partialEnergy[i];
+	}
+	return totalEnergy;
+}
+
+Real SerialCalcs::calcMolecularEnergyContribution(Box *box, int currentMol, int startIdx)
+{
+	SerialBox *serialBox = prepareBox(box);
+	Molecule *molecules = box->getMolecules();
+	Environment *environment = box->getEnvironment();
+	
+	std::vector<int> neighbors;
+	findNeighbors(serialBox, currentMol, startIdx, neighbors);
+	
+	//the current molecule may hold a trial position, so its moments are
+	//computed here rather than taken from the cache
+	Multipole currentPole;
+	const Multipole *pole = NULL;
+	if (serialBox->multipoles.getInnerRadius() > 0)
+	{
+		MultipoleCache::compute(molecules[currentMol], environment, currentPole);
+		pole = &currentPole;
+	}
+	
+	//estimated cost of the neighbor pairs, used to balance the threads
+	std::vector<double> costPrefix(neighbors.size() + 1, 0);
+	for (int i = 0; i < neighbors.size(); i++)
+	{
+		costPrefix[i + 1] = costPrefix[i] + CUTOFF_TEST_COST +
+			(double) molecules[currentMol].numOfAtoms * molecules[neighbors[i]].numOfAtoms;
+	}
+	
+	std::vector<Real> partialEnergy(omp_get_max_threads(), 0);
+	std::vector<Real> energies(neighbors.size());
+	
+	#pragma omp parallel
+	{
+		int thread = omp_get_thread_num();
+		int first, last;
+		PairCostPartition::splitPrefix(costPrefix, thread, omp_get_num_threads(), &first, &last);
+		
+		Real threadEnergy = 0;
+		addNeighborEnergies(serialBox, pole, currentMol, neighbors, first, last, energies, threadEnergy);
+		partialEnergy[thread] = threadEnergy;
+	}
+	
+	//combine in thread order so the result does not depend on scheduling
+	Real totalEnergy = 0;
+	for (int i = 0; i < partialEnergy.size(); i++)
+	{
+		totalEnergy += partialEnergy[i];
+	}
+	return totalEnergy;
+}
+
+void SerialCalcs::calcSoluteEnergies(Box *box, Real *soluteSolute, Real *soluteSolvent)
+{
+	SerialBox *serialBox = prepareBox(box);
+	Molecule *molecules = box->getMolecules();
+	Environment *environment = box->getEnvironment();
+	
+	std::vector<int> neighbors;
+	Real totalSolute = 0, totalSolvent = 0;
+	for (int mol = 0; mol < environment->numOfMolecules; mol++)
+	{
+		if (!serialBox->kinds.isSolute(mol) || !serialBox->isPresent(mol))
+		{
+			continue;
+		}
+		findNeighbors(serialBox, mol, 0, neighbors);
+		for (int i = 0; i < neighbors.size(); i++)
+		{
+			int other = neighbors[i];
+			if (!serialBox->kinds.isSolute(other))
+			{
+				totalSolvent += calcInterMolecularEnergy(molecules, mol, other, environment);
+			}
+			else if (other > mol)
+			{
+				totalSolute += calcInterMolecularEnergy(molecules, mol, other, environment);
+			}
+		}
+	}
+	*soluteSolute = totalSolute;
+	*soluteSolvent = totalSolvent;
+}
+
+/**
+  The bound on n roundings of unit roundoff u, n u / (1 - n u), for the
+  relative error of a product or quotient of n rounded operations.
+*/
+static double roundingGamma(double n, double unit)
+{
+	return n * unit / (1 - n * unit);
+}
+
+/**
+  The largest relative change of r^-power when r moves by at most the
+  fraction rho of itself, (1 - rho)^-power - 1.
+*/
+static double distanceFactor(int power, double rho)
+{
+	return expm1(-power * log1p(-rho));
+}
+
+Real SerialCalcs::estimateMolecularEnergyContribution(Box *box, int currentMol, Real *bound)
+{
+	SerialBox *serialBox = prepareBox(box);
+	Molecule *molecules = box->getMolecules();
+	Environment *environment = box->getEnvironment();
+	
+	std::vector<int> neighbors;
+	findNeighbors(serialBox, currentMol, 0, neighbors);
+	
+	const float boxX = environment->x, boxY = environment->y, boxZ = environment->z;
+	const float coulomb = COULOMB_FACTOR;
+	
+	//the kernel only visits atoms that calcInterMolecularEnergy would count;
+	//the extent of their coordinates bounds the rounding of every offset
+	std::vector<float> x1, y1, z1, sigma1, epsilon1, charge1;
+	double lower[3] = {0, 0, 0}, upper[3] = {0, 0, 0};
+	bool first = true;
+	int maxCount = 0;
+	for (int n = -1; n < (int) neighbors.size(); n++)
+	{
+		Molecule &molecule = molecules[n < 0 ? currentMol : neighbors[n]];
+		int count = 0;
+		for (int j = 0; j < molecule.numOfAtoms; j++)
+		{
+			Atom atom = molecule.atoms[j];
+			if (atom.sigma >= 0 && atom.epsilon >= 0)
+			{
+				double position[3] = {atom.x, atom.y, atom.z};
+				for (int k = 0; k < 3; k++)
+				{
+					lower[k] = first ? position[k] : std::min(lower[k], position[k]);
+					upper[k] = first ? position[k] : std::max(upper[k], position[k]);
+				}
+				first = false;
+				count++;
+				if (n < 0)
+				{
+					x1.push_back(atom.x);
+					y1.push_back(atom.y);
+					z1.push_back(atom.z);
+					sigma1.push_back(atom.sigma);
+					epsilon1.push_back(atom.epsilon);
+					charge1.push_back(atom.charge);
+				}
+			}
+		}
+		if (n >= 0)
+		{
+			maxCount = std::max(maxCount, count);
+		}
+	}
+	
+	double totalEnergy = 0, repulsive = 0, attractive = 0, electrostatic = 0;
+	float maxInvR = 0, coincident = 0;
+	
+	#pragma omp parallel reduction(+:totalEnergy,repulsive,attractive,electrostatic,coincident) reduction(max:maxInvR)
+	{
+		std::vector<float> x2, y2, z2, sigma2, epsilon2, charge2;
+		
+		#pragma omp for
+		for (int n = 0; n < neighbors.size(); n++)
+		{
+			Molecule &other = molecules[neighbors[n]];
+			x2.clear(); y2.clear(); z2.clear();
+			sigma2.clear(); epsilon2.clear(); charge2.clear();
+			for (int j = 0; j < other.numOfAtoms; j++)
+			{
+				Atom atom = other.atoms[j];
+				if (atom.sigma >= 0 && atom.epsilon >= 0)
+				{
+					x2.push_back(atom.x);
+					y2.push_back(atom.y);
+					z2.push_back(atom.z);
+					sigma2.push_back(atom.sigma);
+					epsilon2.push_back(atom.epsilon);
+					charge2.push_back(atom.charge);
+				}
+			}
+			int count = x2.size();
+			
+			for (int i = 0; i < x1.size(); i++)
+			{
+				float energy = 0, lj12Sum = 0, lj6Sum = 0, chargeSum = 0, nearest = 0, zeros = 0;
+				
+				//branch-free so the inner loop runs at full single precision SIMD width
+				for (int j = 0; j < count; j++)
+				{
+					float dx = x1[i] - x2[j];
+					float dy = y1[i] - y2[j];
+					float dz = z1[i] - z2[j];
+					dx += (dx < -0.5f * boxX ? boxX : 0.0f) - (dx > 0.5f * boxX ? boxX : 0.0f);
+					dy += (dy < -0.5f * boxY ? boxY : 0.0f) - (dy > 0.5f * boxY ? boxY : 0.0f);
+					dz += (dz < -0.5f * boxZ ? boxZ : 0.0f) - (dz > 0.5f * boxZ ? boxZ : 0.0f);
+					float r2 = dx * dx + dy * dy + dz * dz;
+					
+					float valid = r2 > 0 ? 1.0f : 0.0f;
+					float invR2 = valid / (r2 + (1.0f - valid));
+					float invR = sqrtf(invR2);
+					float sigma = sqrtf(sigma1[i] * sigma2[j]);
+					float epsilon = sqrtf(epsilon1[i] * epsilon2[j]);
+					float sig6 = sigma * sigma * invR2;
+					sig6 = sig6 * sig6 * sig6;
+					float lj12 = 4 * epsilon * sig6 * sig6;
+					float lj6 = 4 * epsilon * sig6;
+					float charge = coulomb * charge1[i] * charge2[j] * invR;
+					
+					energy += lj12 - lj6 + charge;
+					lj12Sum += lj12;
+					lj6Sum += lj6;
+					chargeSum += fabsf(charge);
+					nearest = fmaxf(nearest, invR);
+					zeros += 1.0f - valid;
+				}
+				
+				totalEnergy += energy;
+				repulsive += lj12Sum;
+				attractive += lj6Sum;
+				electrostatic += chargeSum;
+				maxInvR = fmaxf(maxInvR, nearest);
+				coincident += zeros;
+			}
+		}
+	}
+	
+	//Forward error analysis against the exact energy of the same
+	//coordinates, for both this estimate and the full precision engine,
+	//since the two must be ordered the same way. Every rounded operation
+	//contributes a factor (1 + d) with |d| <= u, and n such factors are
+	//bounded by gamma(n).
+	const double single = FLT_EPSILON / 2, full = DBL_EPSILON / 2;
+	double length = std::max(environment->x, std::max(environment->y, environment->z));
+	double extent = 0;
+	bool singleImage = true;
+	for (int k = 0; k < 3; k++)
+	{
+		extent = std::max(extent, std::max(fabs(lower[k]), fabs(upper[k])));
+		double side = k == 0 ? environment->x : (k == 1 ? environment->y : environment->z);
+		singleImage = singleImage && upper[k] - lower[k] < 1.5 * side * (1 - 4 * single);
+	}
+	
+	//a coincident pair is skipped by both kernels only if it is exactly
+	//coincident, and offsets beyond one and a half box lengths need more
+	//than the single image correction
+	if (coincident > 0 || !singleImage || x1.empty() || neighbors.empty())
+	{
+		*bound = x1.empty() || neighbors.empty() ? 0 : HUGE_VAL;
+		return totalEnergy;
+	}
+	
+	//An offset is off by the conversion of both coordinates and the
+	//subtraction, at most 2 u (2 + u) times the coordinate extent. The image
+	//correction adds the conversion of the box edge and one rounding, and a
+	//correction taken on the wrong side of half the box moves the offset by
+	//at most twice as much as the rounding that caused it, so the magnitude
+	//of each component is within 3 e + 3 u L of the minimum image. By the
+	//triangle inequality the distance is then within sqrt(3) times that.
+	double offsetError = 2 * extent * single * (2 + single);
+	double distanceError = 1.7320509 * (3 * offsetError + 3 * single * length);
+	double offsetErrorFull = 4 * extent * full;
+	double distanceErrorFull = 1.7320509 * (3 * offsetErrorFull + 6 * full * length);
+	
+	//r2 carries 3 roundings, invR2 one more and invR one more, so the
+	//computed 1/r overestimates the reciprocal of the true distance by at
+	//most 1 / (1 - gamma(5)); rho bounds the relative distance error
+	double inverseDistance = maxInvR / (1 - roundingGamma(5, single));
+	double rho = distanceError * inverseDistance;
+	double rhoFull = distanceErrorFull * inverseDistance;
+	if (rho >= 0.5)
+	{
+		*bound = HUGE_VAL;
+		return totalEnergy;
+	}
+	
+	//the float partial sums of magnitudes undercount by at most gamma of
+	//their length, and their double totals by gamma of the number of sums
+	double pairCount = (double) x1.size() * neighbors.size();
+	double undercount = (1 - roundingGamma(maxCount, single)) * (1 - roundingGamma(pairCount + omp_get_max_threads(), full));
+	double lj12Total = repulsive / undercount;
+	double lj6Total = attractive / undercount;
+	double chargeTotal = electrostatic / undercount;
+	
+	//Rounded operations per term, counting the conversions of the atom
+	//parameters: sigma and epsilon 4 each, invR2 4 and invR 5; sig6 is
+	//sigma^2 invR2 cubed for 44, so r^-12 carries 94, r^-6 49 and the
+	//Coulomb term 11. Each term is also off by the change of r^-n over the
+	//distance error.
+	double lj12Error = lj12Total / (1 - roundingGamma(94, single)) *
+		(roundingGamma(94, single) + distanceFactor(12, rho));
+	double lj6Error = lj6Total / (1 - roundingGamma(49, single)) *
+		(roundingGamma(49, single) + distanceFactor(6, rho));
+	double chargeError = chargeTotal / (1 - roundingGamma(11, single)) *
+		(roundingGamma(11, single) + distanceFactor(1, rho));
+	double magnitude = (lj12Total + lj6Total + chargeTotal) / (1 - roundingGamma(94, single));
+	
+	//each float sum adds three values per atom pair; the double totals add
+	//one float sum per atom of the molecule and neighbor, then the threads
+	double summationError = roundingGamma(3 * maxCount + 2, single) * magnitude +
+		roundingGamma(pairCount + omp_get_max_threads(), full) * magnitude;
+	
+	//the full precision engine rounds each term a few dozen times,
+	//including pow and sqrt, sums the terms of each neighbor, then the
+	//neighbors and the thread totals
+	double fullOperations = 300 + 2 * x1.size() * maxCount + neighbors.size() + omp_get_max_threads();
+	double engineError = (roundingGamma(fullOperations, full) + distanceFactor(12, rhoFull)) * magnitude;
+	
+	//the bound arithmetic itself rounds a few dozen times
+	*bound = (lj12Error + lj6Error + chargeError + summationError + engineError) * (1 + 64 * DBL_EPSILON);
+	return totalEnergy;
+}
+
+SerialBox* SerialCalcs::prepareBox(Box *box)
+{
+	SerialBox *serialBox = (SerialBox*) box;
+	Molecule *molecules = box->getMolecules();
+	Environment *environment = box->getEnvironment();
+	
+	serialBox->partition.update(molecules, environment);
+	if (!serialBox->grid.isBuilt(environment->numOfMolecules))
+	{
+		serialBox->grid.build(molecules, environment);
+	}
+	if (serialBox->multipoles.getInnerRadius() > 0 &&
+		!serialBox->multipoles.isBuilt(environment->numOfMolecules))
+	{
+		serialBox->multipoles.build(molecules, environment);
+	}
+	if (serialBox->resolution.isEnabled() &&
+		!serialBox->resolution.isBuilt(environment->numOfMolecules))
+	{
+		serialBox->resolution.build(molecules, environment);
+	}
+	if (!serialBox->kinds.isBuilt(environment->numOfMolecules))
+	{
+		serialBox->kinds.build(molecules, environment);
+	}
+	return serialBox;
+}
+
+void SerialCalcs::addNeighborEnergies(SerialBox *box, const Multipole *pole1, int mol1, const std::vector<int> &neighbors,
+									  int begin, int end, std::vector<Real> &energies, Real &totalEnergy)
+{
+	//the multipole and adaptive resolution paths decide per pair
+	if (!box->kinds.isEnabled() || pole1 != NULL || box->resolution.isEnabled())
+	{
+		for (int i = begin; i < end; i++)
+		{
+			totalEnergy += box->kinds.pairScale(mol1, neighbors[i]) * calcPairEnergy(box, pole1, mol1, neighbors[i]);
+		}
+		return;
+	}
+	
+	std::vector<int> order;
+	std::vector<NeighborRun> runs;
+	box->kinds.groupRuns(neighbors, begin, end, order, runs);
+	for (int r = 0; r < runs.size(); r++)
+	{
+		calcRunEnergies(box, mol1, runs[r], order, neighbors, energies);
+	}
+	
+	//sum in neighbor order, as the per pair path does
+	for (int i = begin; i < end; i++)
+	{
+		totalEnergy += energies[i];
+	}
+}
+
+void SerialCalcs::calcRunEnergies(SerialBox *box, int mol1, const NeighborRun &run, const std::vector<int> &order,
+								  const std::vector<int> &neighbors, std::vector<Real> &energies)
+{
+	Molecule *molecules = box->getMolecules();
+	Environment *enviro = box->getEnvironment();
+	const std::vector<KindPairTerm> &terms = box->kinds.pairTerms(box->kinds.kindOf(mol1), run.kind);
+	const Atom *atoms1 = molecules[mol1].atoms;
+	
+	for (int n = run.begin; n < run.end; n++)
+	{
+		const Atom *atoms2 = molecules[neighbors[order[n]]].atoms;
+		Real totalEnergy = 0;
+		for (int t = 0; t < terms.size(); t++)
+		{
+			const KindPairTerm &term = terms[t];
+			const Atom &atom1 = atoms1[term.atom1];
+			const Atom &atom2 = atoms2[term.atom2];
+			
+			Real deltaX = makePeriodic(atom1.x - atom2.x, enviro->x, enviro->periodic);
+			Real deltaY = makePeriodic(atom1.y - atom2.y, enviro->y, enviro->periodic);
+			Real deltaZ = makePeriodic(atom1.z - atom2.z, enviro->z, enviro->periodic);
+			
+			Real r2 = (deltaX * deltaX) +
+				 (deltaY * deltaY) + 
+				 (deltaZ * deltaZ);
+			
+			totalEnergy += calcMixedLJ(term.sigma, term.epsilon, r2);
+			totalEnergy += calcScaledCharge(term.charge, sqrt(r2));
+		}
+		energies[order[n]] = totalEnergy;
+	}
+}
+
+void SerialCalcs::findNeighbors(SerialBox *box, int currentMol, int startIdx, std::vector<int> &neighbors)
+{
+	Molecule *molecules = box->getMolecules();
+	Environment *environment = box->getEnvironment();
+	
+	if (!box->neighbors.findCandidates(molecules, environment, currentMol, neighbors))
+	{
+		box->grid.findCandidates(molecules, environment, currentMol, neighbors);
+	}
+	
+	screenCandidates(box, currentMol, startIdx, neighbors);
+	
+	//keep the summation order of a plain loop over the molecules
+	std::sort(neighbors.begin(), neighbors.end());
+}
+
+void SerialCalcs::screenCandidates(SerialBox *box, int currentMol, int startIdx, std::vector<int> &candidates)
+{
+	Molecule *molecules = box->getMolecules();
+	Environment *environment = box->getEnvironment();
+	int count = candidates.size();
+	if (count == 0)
+	{
+		return;
+	}
+	
+	//gather the primary atom offsets so the distance pass runs over
+	//contiguous arrays
+	int primary = environment->primaryAtomIndex;
+	Atom center = molecules[currentMol].atoms[primary];
+	std::vector<Real> offsets(3 * count);
+	Real *dx = &offsets[0], *dy = dx + count, *dz = dy + count;
+	for (int i = 0; i < count; i++)
+	{
+		const Atom &other = molecules[candidates[i]].atoms[primary];
+		dx[i] = center.x - other.x;
+		dy[i] = center.y - other.y;
+		dz[i] = center.z - other.z;
+	}
+	
+	Real cutoffSQ = environment->cutoff * environment->cutoff;
+	std::vector<char> inside(count);
+	if (environment->periodic)
+	{
+		//a single branch-free correction gives the same result as
+		//makePeriodic for offsets up to one and a half box lengths
+		Real boxX = environment->x, boxY = environment->y, boxZ = environment->z;
+		Real halfX = 0.5 * boxX, halfY = 0.5 * boxY, halfZ = 0.5 * boxZ;
+		int far = 0;
+		for (int i = 0; i < count; i++)
+		{
+			Real x = dx[i] + (dx[i] < -halfX ? boxX : 0) - (dx[i] > halfX ? boxX : 0);
+			Real y = dy[i] + (dy[i] < -halfY ? boxY : 0) - (dy[i] > halfY ? boxY : 0);
+			Real z = dz[i] + (dz[i] < -halfZ ? boxZ : 0) - (dz[i] > halfZ ? boxZ : 0);
+			Real r2 = (x * x) + (y * y) + (z * z);
+			inside[i] = r2 < cutoffSQ;
+			far |= (x < -halfX) | (x > halfX) | (y < -halfY) | (y > halfY) | (z < -halfZ) | (z > halfZ);
+		}
+		
+		//molecules that have drifted further need the full wrap
+		if (far)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				inside[i] = moleculesInCutoff(molecules, environment, currentMol, candidates[i]);
+			}
+		}
+	}
+	else
+	{
+		for (int i = 0; i < count; i++)
+		{
+			Real r2 = (dx[i] * dx[i]) + (dy[i] * dy[i]) + (dz[i] * dz[i]);
+			inside[i] = r2 < cutoffSQ;
+		}
+	}
+	
+	//compress-store: every candidate is written, and the count only
+	//advances past the ones that are kept
+	const char *present = box->present.empty() ? NULL : &box->present[0];
+	int kept = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int otherMol = candidates[i];
+		candidates[kept] = otherMol;
+		kept += inside[i] & (otherMol != currentMol) & (otherMol >= startIdx) &
+			(present == NULL || present[otherMol]);
+	}
+	candidates.resize(kept);
+}
+
+Real SerialCalcs::calcPairEnergy(SerialBox *box, const Multipole *pole1, int mol1, int mol2)
+{
+	Molecule *molecules = box->getMolecules();
+	Environment *environment = box->getEnvironment();
+	
+	if (box->resolution.isEnabled())
+	{
+		//the atom-atom loop is only needed while both molecules carry weight
+		Real lambda = box->resolution.weight(molecules, environment, mol1) *
+			box->resolution.weight(molecules, environment, mol2);
+		Real energy = 0;
+		if (lambda > 0)
+		{
+			energy += lambda * calcInterMolecularEnergy(molecules, mol1, mol2, environment);
+		}
+		if (lambda < 1)
+		{
+			energy += (1 - lambda) * box->resolution.coarseEnergy(molecules, environment, mol1, mol2);
+		}
+		return energy;
+	}
+	
+	if (pole1 != NULL)
+	{
+		Atom atom1 = molecules[mol1].atoms[environment->primaryAtomIndex];
+		Atom atom2 = molecules[mol2].atoms[environment->primaryAtomIndex];
+		
+		Real deltaX = makePeriodic(atom1.x - atom2.x, environment->x, environment->periodic);
+		Real deltaY = makePeriodic(atom1.y - atom2.y, environment->y, environment->periodic);
+		Real deltaZ = makePeriodic(atom1.z - atom2.z, environment->z, environment->periodic);
+		
+		Real r2 = (deltaX * deltaX) +
+					(deltaY * deltaY) + 
+					(deltaZ * deltaZ);
+		Real innerRadius = box->multipoles.getInnerRadius();
+		
+		Real energy;
+		if (r2 >= innerRadius * innerRadius &&
+			MultipoleCache::pairEnergy(*pole1, box->multipoles.get(mol2), environment, energy))
+		{
+			return energy;
+		}
+	}
+	return calcInterMolecularEnergy(molecules, mol1, mol2, environment);
+}
+
+int SerialCalcs::checkMultipoles(Box *box, Real *maxError, Real *maxBound, Real *totalError, int *violations)
+{
+	SerialBox *serialBox = prepareBox(box);
+	Molecule *molecules = box->getMolecules();
+	Environment *environment = box->getEnvironment();
+	Real innerRadius = serialBox->multipoles.getInnerRadius();
+	
+	int pairs = 0;
+	*maxError = 0;
+	*maxBound = 0;
+	*totalError = 0;
+	*violations = 0;
+	
+	std::vector<int> neighbors;
+	for (int mol = 0; mol < environment->numOfMolecules; mol++)
+	{
+		findNeighbors(serialBox, mol, mol + 1, neighbors);
+		for (int i = 0; i < neighbors.size(); i++)
+		{
+			int otherMol = neighbors[i];
+			Atom atom1 = molecules[mol].atoms[environment->primaryAtomIndex];
+			Atom atom2 = molecules[otherMol].atoms[environment->primaryAtomIndex];
+			
+			Real deltaX = makePeriodic(atom1.x - atom2.x, environment->x, environment->periodic);
+			Real deltaY = makePeriodic(atom1.y - atom2.y, environment->y, environment->periodic);
+			Real deltaZ = makePeriodic(atom1.z - atom2.z, environment->z, environment->periodic);
+			
+			Real r2 = (deltaX * deltaX) +
+						(deltaY * deltaY) + 
+						(deltaZ * deltaZ);
+			
+			Real energy, bound;
+			if (r2 < innerRadius * innerRadius ||
+				!MultipoleCache::pairEnergy(serialBox->multipoles.get(mol), serialBox->multipoles.get(otherMol),
+											environment, energy, &bound))
+			{
+				continue;
+			}
+			
+			Real error = energy - calcInterMolecularEnergy(molecules, mol, otherMol, environment);
+			pairs++;
+			*totalError += error;
+			*maxError = std::max(*maxError, (Real) fabs(error));
+			*maxBound = std::max(*maxBound, bound);
+			if (fabs(error) > bound)
+			{
+				(*violations)++;
+			}
+		}
+	}
+	return pairs;
+}
+
+void SerialCalcs::calcShellEnergies(Molecule *molecules, Environment *environment, const std::vector<double> &cutoffs,
+									std::vector<Real> &shellEnergies, std::vector<long> &shellPairs)
+{
+	int shells = cutoffs.size();
+	std::vector<Real> cutoffsSQ(shells);
+	for (int s = 0; s < shells; s++)
+	{
+		cutoffsSQ[s] = (Real) cutoffs[s] * (Real) cutoffs[s];
+	}
+	
+	shellEnergies.assign(shells, 0);
+	shellPairs.assign(shells, 0);
+	if (shells == 0)
+	{
+		return;
+	}
+	
+	//a grid of its own, with cells as wide as the largest cutoff, since the
+	//box may come from any engine and its cutoff may be the smaller one
+	Environment scanEnvironment(environment);
+	scanEnvironment.cutoff = cutoffs.back();
+	CellGrid grid;
+	grid.build(molecules, &scanEnvironment);
+	
+	std::vector<std::vector<Real> > partialEnergies(omp_get_max_threads(), std::vector<Real>(shells, 0));
+	std::vector<std::vector<long> > partialPairs(omp_get_max_threads(), std::vector<long>(shells, 0));
+	
+	#pragma omp parallel
+	{
+		int thread = omp_get_thread_num();
+		std::vector<int> candidates;
+		
+		#pragma omp for schedule(dynamic)
+		for (int mol1 = 0; mol1 < environment->numOfMolecules; mol1++)
+		{
+			Atom atom1 = molecules[mol1].atoms[environment->primaryAtomIndex];
+			grid.findCandidates(molecules, &scanEnvironment, mol1, candidates);
+			std::sort(candidates.begin(), candidates.end());
+			for (int c = 0; c < candidates.size(); c++)
+			{
+				int mol2 = candidates[c];
+				if (mol2 <= mol1)
+				{
+					continue;
+				}
+				
+				Atom atom2 = molecules[mol2].atoms[environment->primaryAtomIndex];
+				
+				Real deltaX = makePeriodic(atom1.x - atom2.x, environment->x, environment->periodic);
+				Real deltaY = makePeriodic(atom1.y - atom2.y, environment->y, environment->periodic);
+				Real deltaZ = makePeriodic(atom1.z - atom2.z, environment->z, environment->periodic);
+				
+				Real r2 = (deltaX * deltaX) +
+							(deltaY * deltaY) + 
+							(deltaZ * deltaZ);
+				
+				int shell = std::upper_bound(cutoffsSQ.begin(), cutoffsSQ.end(), r2) - cutoffsSQ.begin();
+				if (shell < shells)
+				{
+					partialEnergies[thread][shell] += calcInterMolecularEnergy(molecules, mol1, mol2, environment);
+					partialPairs[thread][shell]++;
+				}
+			}
+		}
+	}
+	
+	//combine in thread order
+	for (int t = 0; t < partialEnergies.size(); t++)
+	{
+		for (int s = 0; s < shells; s++)
+		{
+			shellEnergies[s] += partialEnergies[t][s];
+			shellPairs[s] += partialPairs[t][s];
+		}
+	}
+}
+
+bool SerialCalcs::moleculesInCutoff(Molecule *molecules, Environment *environment, int mol1, int mol2)
+{
+	Atom atom1 = molecules[mol1].atoms[environment->primaryAtomIndex];
+	Atom atom2 = molecules[mol2].atoms[environment->primaryAtomIndex];
+	
+	Real deltaX = makePeriodic(atom1.x - atom2.x, environment->x, environment->periodic);
+	Real deltaY = makePeriodic(atom1.y - atom2.y, environment->y, environment->periodic);
+	Real deltaZ = makePeriodic(atom1.z - atom2.z, environment->z, environment->periodic);
+	
+	Real r2 = (deltaX * deltaX) +
+				(deltaY * deltaY) + 
+				(deltaZ * deltaZ);
+	
+	return r2 < environment->cutoff * environment->cutoff;
+}
+
+int SerialCalcs::countNeighbors(Molecule *molecules, Environment *environment, int currentMol)
+{
+	int neighbors = 0;
+	Atom atom1 = molecules[currentMol].atoms[environment->primaryAtomIndex];
+	Real cutoffSQ = environment->cutoff * environment->cutoff;
+	
+	for (int otherMol = 0; otherMol < environment->numOfMolecules; otherMol++)
+	{
+		if (otherMol != currentMol)
+		{
+			Atom atom2 = molecules[otherMol].atoms[environment->primaryAtomIndex];
+			
+			Real deltaX = makePeriodic(atom1.x - atom2.x, environment->x, environment->periodic);
+			Real deltaY = makePeriodic(atom1.y - atom2.y, environment->y, environment->periodic);
+			Real deltaZ = makePeriodic(atom1.z - atom2.z, environment->z, environment->periodic);
+			
+			Real r2 = (deltaX * deltaX) +
+						(deltaY * deltaY) + 
+						(deltaZ * deltaZ);
+
+			if (r2 < cutoffSQ)
+			{
+				neighbors++;
+			}
+		}
+	}
+	return neighbors;
+}
+
 Real SerialCalcs::calcInterMolecularEnergy(Molecule *molecules, int mol1, int mol2, Environment *enviro)
 {
 	Real totalEnergy = 0;
@@ -101,9 +856,9 @@ Real SerialCalcs::calcInterMolecularEnergy(Molecule *molecules, int mol1, int mo
 			if (atom1.sigma >= 0 && atom1.epsilon >= 0 && atom2.sigma >= 0 && atom2.epsilon >= 0)
 			{
 				//calculate difference in coordinates
-				Real deltaX = makePeriodic(atom1.x - atom2.x, enviro->x);
-				Real deltaY = makePeriodic(atom1.y - atom2.y, enviro->y);
-				Real deltaZ = makePeriodic(atom1.z - atom2.z, enviro->z);
+				Real deltaX = makePeriodic(atom1.x - atom2.x, enviro->x, enviro->periodic);
+				Real deltaY = makePeriodic(atom1.y - atom2.y, enviro->y, enviro->periodic);
+				Real deltaZ = makePeriodic(atom1.z - atom2.z, enviro->z, enviro->periodic);
 				
 				Real r2 = (deltaX * deltaX) +
 					 (deltaY * deltaY) + 
@@ -123,7 +878,11 @@ Real SerialCalcs::calc_lj(Atom atom1, Atom atom2, Real r2)
     //store LJ constants locally
     Real sigma = calcBlending(atom1.sigma, atom2.sigma);
     Real epsilon = calcBlending(atom1.epsilon, atom2.epsilon);
-    
+    return calcMixedLJ(sigma, epsilon, r2);
+}
+
+Real SerialCalcs::calcMixedLJ(Real sigma, Real epsilon, Real r2)
+{
     if (r2 == 0.0)
     {
         return 0.0;
@@ -142,20 +901,32 @@ Real SerialCalcs::calc_lj(Atom atom1, Atom atom2, Real r2)
 
 Real SerialCalcs::calcCharge(Real charge1, Real charge2, Real r)
 {  
+    return calcScaledCharge(calcChargeProduct(charge1, charge2), r);
+}
+
+Real SerialCalcs::calcChargeProduct(Real charge1, Real charge2)
+{
+    return charge1 * charge2 * COULOMB_FACTOR;
+}
+
+Real SerialCalcs::calcScaledCharge(Real product, Real r)
+{
     if (r == 0.0)
     {
         return 0.0;
     }
     else
     {
-    	// conversion factor below for units in kcal/mol
-    	const Real e = 332.06;
-        return (charge1 * charge2 * e) / r;
+        return product / r;
     }
 }
 
-Real SerialCalcs::makePeriodic(Real x, Real boxDim)
+Real SerialCalcs::makePeriodic(Real x, Real boxDim, bool periodic)
 {
+    if (!periodic)
+    {
+        return x;
+    }
     
     while(x < -0.5 * boxDim)
     {
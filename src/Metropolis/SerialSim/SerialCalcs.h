@@ -12,22 +12,29 @@
 #define SERIALCALCS_H
 
 #include <string>
+#include <vector>
 #include "Metropolis/Box.h"
 #include "SerialBox.h"
 #include "Metropolis/DataTypes.h"
 #include "Metropolis/SimulationArgs.h"
 #include "Metropolis/Utilities/StructLibrary.h"
 
+/// Converts charge products over distances in angstroms to kcal/mol.
+#define COULOMB_FACTOR 332.06
+
 namespace SerialCalcs
 {
 	/// Factory method for creating a Box from a configuration file.
 	/// @param configpath The path to the configuration file.
 	/// @param steps The number of steps desired in the simulation,
+	/// @param shareTopology Whether to attach to or publish the topology
+	///   arrays in POSIX shared memory.
 	/// @return Returns a pointer to the filled-in Box.
 	/// @note This functionality should ideally reside in SerialBox,
 	///   but it was placed here due to time constraints.
 	///   TODO for future group.
-	Box* createBox(std::string inputPath, InputFileType inputType, long* startStep, long* steps);
+	Box* createBox(std::string inputPath, InputFileType inputType, long* startStep, long* steps,
+	               bool shareTopology = false);
 	
 	/// Calculates the system energy using consecutive calls to
 	///   calcMolecularEnergyContribution.
@@ -47,6 +54,153 @@ namespace SerialCalcs
 	///   intramolecular energy.
 	Real calcMolecularEnergyContribution(Molecule *molecules, Environment *environment, int currentMol, int startIdx = 0);
 	
+	/// Calculates the system energy of a Box. The unique molecule pairs are
+	///   found with the box's CellGrid and split among the OpenMP threads in
+	///   chunks of balanced estimated cost.
+	/// @param box A pointer to the SerialBox holding the simulation data.
+	/// @return Returns total system energy.
+	Real calcSystemEnergy(Box *box);
+	
+	/// Calculates the inter-molecular energy contribution of a given molecule
+	///   in a Box, without intramolecular energy. The neighbors found with
+	///   the box's CellGrid are split among the OpenMP threads in chunks of
+	///   balanced estimated cost, and the partial sums are combined in
+	///   thread order.
+	/// @param box A pointer to the SerialBox holding the simulation data.
+	/// @param currentMol the index of the current changed molecule.
+	/// @param startIdx The optional starting index for other molecules.
+	/// @return Returns total molecular energy contribution, without
+	///   intramolecular energy.
+	Real calcMolecularEnergyContribution(Box *box, int currentMol, int startIdx = 0);
+	
+	/// Splits the unscaled energy of the solute marked by the box's
+	///   KindTable into the two terms that solute tempering scales.
+	/// @param box A pointer to the SerialBox holding the simulation data.
+	/// @param soluteSolute Set to the energy between solute molecules.
+	/// @param soluteSolvent Set to the energy between solute and solvent
+	///   molecules.
+	void calcSoluteEnergies(Box *box, Real *soluteSolute, Real *soluteSolvent);
+	
+	/// Estimates the energy contribution of a molecule in single
+	///   precision, together with a rigorous bound on the difference from
+	///   calcMolecularEnergyContribution. The bound covers every rounding
+	///   of both, from the conversion of the coordinates on, and is
+	///   infinite when the analysis does not apply. The neighbors are found
+	///   exactly, so only the pair kernel is estimated.
+	/// @param box A pointer to the Box holding the simulation data.
+	/// @param currentMol The index of the molecule being evaluated.
+	/// @param bound Set to a bound on the absolute error of the estimate.
+	/// @return Returns the estimated energy contribution.
+	Real estimateMolecularEnergyContribution(Box *box, int currentMol, Real *bound);
+	
+	/// Refreshes the cost model of a Box and builds its spatial index
+	///   if needed.
+	/// @param box A pointer to the SerialBox holding the simulation data.
+	/// @return Returns the box as a SerialBox.
+	SerialBox* prepareBox(Box *box);
+	
+	/// Adds the energies between a molecule and a range of its neighbors to
+	///   a running total, in neighbor order. When the box's KindTable applies, the range is
+	///   grouped into runs of one kind and each run is evaluated by
+	///   calcRunEnergies; otherwise every pair goes through calcPairEnergy.
+	///   Either way the pairs are scaled by the solute tempering factors.
+	/// @param box A pointer to the prepared SerialBox.
+	/// @param pole1 The moments of the molecule, or NULL.
+	/// @param mol1 The index of the molecule.
+	/// @param neighbors The neighbor list of the molecule.
+	/// @param begin The first position of the range.
+	/// @param end One past the last position of the range.
+	/// @param energies Scratch space holding an entry for every neighbor.
+	/// @param totalEnergy The running total the energies are added to.
+	void addNeighborEnergies(SerialBox *box, const Multipole *pole1, int mol1, const std::vector<int> &neighbors,
+							 int begin, int end, std::vector<Real> &energies, Real &totalEnergy);
+	
+	/// Calculates the energies between a molecule and a run of neighbors of
+	///   a single kind, with the parameters premixed by the box's KindTable.
+	///   Each energy equals that of calcInterMolecularEnergy.
+	/// @param box A pointer to the prepared SerialBox.
+	/// @param mol1 The index of the molecule.
+	/// @param run The run to evaluate.
+	/// @param order The positions of the neighbors, grouped by kind.
+	/// @param neighbors The neighbor list of the molecule.
+	/// @param energies Set at the position of each neighbor of the run.
+	void calcRunEnergies(SerialBox *box, int mol1, const NeighborRun &run, const std::vector<int> &order,
+						 const std::vector<int> &neighbors, std::vector<Real> &energies);
+	
+	/// Finds the molecules within the cutoff of a given molecule using the
+	///   box's NeighborList when it is valid, or its CellGrid otherwise.
+	/// @param box A pointer to the prepared SerialBox.
+	/// @param currentMol The index of the molecule to search around.
+	/// @param startIdx The lowest index of the molecules to report.
+	/// @param neighbors Filled with the neighbor indices, in ascending order.
+	void findNeighbors(SerialBox *box, int currentMol, int startIdx, std::vector<int> &neighbors);
+	
+	/// Keeps the candidate neighbors of a molecule that lie within the
+	///   cutoff, in two branch-free passes: the primary atom distances of
+	///   all candidates are computed first, and the kept indices are then
+	///   compacted in place. The result matches moleculesInCutoff.
+	/// @param box A pointer to the prepared SerialBox.
+	/// @param currentMol The index of the molecule to search around.
+	/// @param startIdx The lowest index of the molecules to keep.
+	/// @param candidates The candidate indices, compacted to the neighbors
+	///   in their original order.
+	void screenCandidates(SerialBox *box, int currentMol, int startIdx, std::vector<int> &candidates);
+	
+	/// Determines whether the primary atoms of two molecules lie within
+	///   the cutoff of each other.
+	/// @param molecules A pointer to the Molecule array.
+	/// @param environment A pointer to the Environment for the simulation.
+	/// @param mol1 The index of the first molecule.
+	/// @param mol2 The index of the second molecule.
+	/// @return Returns true if the molecules interact.
+	bool moleculesInCutoff(Molecule *molecules, Environment *environment, int mol1, int mol2);
+	
+	/// Counts the molecules whose primary atoms lie within the cutoff of
+	///   the primary atom of a given molecule.
+	/// @param molecules A pointer to the Molecule array.
+	/// @param environment A pointer to the Environment for the simulation.
+	/// @param currentMol The index of the molecule whose neighbors are counted.
+	/// @return Returns the number of neighboring molecules, excluding
+	///   currentMol itself.
+	int countNeighbors(Molecule *molecules, Environment *environment, int currentMol);
+	
+	/// Calculates the energy between two molecules of a prepared box. Pairs
+	///   whose primary atoms lie outside the inner radius of the box's
+	///   MultipoleCache are approximated from their moments. Under adaptive
+	///   resolution the pair blends its atomistic and coarse-grained energies.
+	/// @param box A pointer to the prepared SerialBox.
+	/// @param pole1 The moments of the first molecule, or NULL to always
+	///   use the atomistic kernel.
+	/// @param mol1 The index of the first molecule.
+	/// @param mol2 The index of the second molecule.
+	/// @return Returns the energy between the two molecules.
+	Real calcPairEnergy(SerialBox *box, const Multipole *pole1, int mol1, int mol2);
+	
+	/// Compares the multipole approximation against the atomistic kernel
+	///   for every pair of the box that it currently applies to.
+	/// @param box A pointer to the SerialBox holding the simulation data.
+	/// @param maxError Set to the largest absolute error of a pair.
+	/// @param maxBound Set to the largest error bound of a pair.
+	/// @param totalError Set to the error of the total system energy.
+	/// @param violations Set to the number of pairs whose error exceeds
+	///   their bound.
+	/// @return Returns the number of approximated pairs.
+	int checkMultipoles(Box *box, Real *maxError, Real *maxBound, Real *totalError, int *violations);
+	
+	/// Bins the energy of every molecule pair into distance shells in one
+	///   pass. A pair falls in the first shell whose outer cutoff its
+	///   primary atoms are within, the same test the simulation makes with
+	///   its own cutoff, so the energy at each cutoff is the sum of the
+	///   shells up to it. The pairs are found with a CellGrid built for the
+	///   largest cutoff.
+	/// @param molecules A pointer to the Molecule array.
+	/// @param environment A pointer to the Environment for the simulation.
+	/// @param cutoffs The outer cutoff of each shell, in ascending order.
+	/// @param shellEnergies Filled with the energy of each shell.
+	/// @param shellPairs Filled with the molecule pairs in each shell.
+	void calcShellEnergies(Molecule *molecules, Environment *environment, const std::vector<double> &cutoffs,
+						   std::vector<Real> &shellEnergies, std::vector<long> &shellPairs);
+	
 	/// Calculates the inter-molecular energy between two given molecules.
 	/// @param molecules A pointer to the Molecule array.
 	/// @param mol1 The index of the first molecule.
@@ -63,6 +217,13 @@ namespace SerialCalcs
 	/// @return Returns the LJ energy between the two specified atoms.
 	Real calc_lj(Atom atom1, Atom atom2, Real r2);
 	
+	/// Calculates the LJ energy of an atom pair from blended parameters.
+	/// @param sigma The blended sigma of the pair.
+	/// @param epsilon The blended epsilon of the pair.
+	/// @param r2 The distance between the two atoms, squared.
+	/// @return Returns the LJ energy of the pair.
+	Real calcMixedLJ(Real sigma, Real epsilon, Real r2);
+	
 	/// Calculates the charge energy between two atoms.
 	/// @param charge1 The charge of atom 1.
 	/// @param charge2 The charge of atom 2.
@@ -70,11 +231,26 @@ namespace SerialCalcs
 	/// @returns Returns the charge energy between two atoms.
 	Real calcCharge(Real charge1, Real charge2, Real r);
 	
+	/// Calculates the product of two charges, scaled to kcal/mol.
+	/// @param charge1 The charge of atom 1.
+	/// @param charge2 The charge of atom 2.
+	/// @return Returns the scaled product.
+	Real calcChargeProduct(Real charge1, Real charge2);
+	
+	/// Calculates the charge energy of an atom pair from its scaled charge
+	///   product.
+	/// @param product The scaled product from calcChargeProduct.
+	/// @param r The distance between the two atoms.
+	/// @return Returns the charge energy of the pair.
+	Real calcScaledCharge(Real product, Real r);
+	
 	/// Makes a distance periodic within a specified range.
 	/// @param x The distance to be made periodic.
 	/// @param boxDim The magnitude of the periodic range.
+	/// @param periodic False if the box has no periodic images, in which
+	///   case the distance is returned unchanged.
 	/// @return Returns the periodic distance.
-	Real makePeriodic(Real x, Real boxDim);
+	Real makePeriodic(Real x, Real boxDim, bool periodic = true);
 	
 	/// Calculates the geometric mean of two values.
 	/// @param d1 The first value.
@@ -20,6 +20,8 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <math.h>
+#include <algorithm>
 
 #include "Simulation.h"
 #include "SimulationArgs.h"
@@ -28,8 +30,12 @@
 #include "Metropolis/Utilities/Parsing.h"
 #include "SerialSim/SerialBox.h"
 #include "SerialSim/SerialCalcs.h"
+#include "SerialSim/RandomBatchEwald.h"
+#include "SerialSim/PairStatistics.h"
 #include "ParallelSim/ParallelCalcs.h"
+#include "ParallelSim/HostBatchCalcs.h"
 #include "Utilities/FileUtilities.h"
+#include "Utilities/StartupProfile.h"
 
 #define RESULTS_FILE_DEFAULT "run"
 #define RESULTS_FILE_EXT ".results"
@@ -37,9 +43,14 @@
 //Constructor & Destructor
 Simulation::Simulation(SimulationArgs simArgs)
 {
+	StartupPhase setupPhase("Simulation-Setup");
 	args = simArgs;
 
 	stepStart = 0;
+	shadowChecks = 0;
+	shadowDivergences = 0;
+	shadowFirstDivergence = -1;
+	shadowMaxDeviation = 0;
 	
 	if (args.simulationMode == SimulationMode::Parallel) {
 		//we need to set this to 1 in parallel mode because it is irrelevant BUT is used in the 
@@ -63,8 +74,11 @@ Simulation::Simulation(SimulationArgs simArgs)
 
 	if (simArgs.simulationMode == SimulationMode::Parallel)
 		box = ParallelCalcs::createBox(args.filePath, args.fileType, &stepStart, &simSteps);
+	else if (simArgs.simulationMode == SimulationMode::HostBatch)
+		box = HostBatchCalcs::createBox(args.filePath, args.fileType, &stepStart, &simSteps);
 	else
-		box = SerialCalcs::createBox(args.filePath, args.fileType, &stepStart, &simSteps);
+		box = SerialCalcs::createBox(args.filePath, args.fileType, &stepStart, &simSteps,
+		                             args.sharedTopology);
 
 	if (box == NULL)
 	{
@@ -79,6 +93,37 @@ Simulation::Simulation(SimulationArgs simArgs)
 
 	if (args.stepCount > 0)
 		simSteps = args.stepCount;
+
+	if (args.neighborSkin > 0 && args.simulationMode != SimulationMode::Parallel)
+		((SerialBox*) box)->neighbors.setSkin(args.neighborSkin);
+	if (args.multipoleRadius > 0 && args.simulationMode != SimulationMode::Parallel)
+		((SerialBox*) box)->multipoles.setInnerRadius(args.multipoleRadius);
+	if (args.nonPeriodic)
+		box->environment->periodic = false;
+	if (args.adaptiveSolute >= 0)
+	{
+		if (args.adaptiveSolute >= box->environment->numOfMolecules)
+		{
+			std::cerr << "Error: Adaptive resolution solute " << args.adaptiveSolute
+				<< " does not exist" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		((SerialBox*) box)->resolution.configure(args.adaptiveSolute, args.adaptiveRadius, args.hybridWidth,
+												 kBoltz * box->environment->temp);
+	}
+
+	if (args.mixedPrecision && sizeof(Real) == sizeof(float))
+	{
+		std::cerr << "Error: Mixed precision requires a double precision build" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	if (args.outputRegionMolecule >= box->environment->numOfMolecules)
+	{
+		std::cerr << "Error: Output region molecule " << args.outputRegionMolecule
+			<< " does not exist" << std::endl;
+		exit(EXIT_FAILURE);
+	}
 }
 
 Simulation::~Simulation()
@@ -102,6 +147,10 @@ void Simulation::run()
 	Real  kT = kBoltz * enviro->temp;
 	int accepted = 0;
 	int rejected = 0;
+	int overlapRejections = 0;
+	int singlePrecisionRejections = 0;
+	int precisionRefinements = 0;
+	bool shadowEnabled = !args.shadowEngine.empty();
 
 	string directory = get_current_dir_name();
 	
@@ -119,6 +168,7 @@ void Simulation::run()
 
 	clock_t startTime, endTime;
 	int pdbSequenceNum = 0;
+	int statusUpdates = 0, stateSnapshots = 0;
 	startTime = clock();
 
 	
@@ -126,27 +176,27 @@ void Simulation::run()
 	//Calculate original starting energy for the entire system
 	if (oldEnergy == 0)
 	{
+		StartupPhase phase("Initial-Energy");
 		if (args.simulationMode == SimulationMode::Parallel)
 		{
 			oldEnergy = ParallelCalcs::calcSystemEnergy(box);
 		}
+		else if (args.simulationMode == SimulationMode::HostBatch)
+		{
+			oldEnergy = HostBatchCalcs::calcSystemEnergy(box);
+		}
 		else
 		{
-			oldEnergy = SerialCalcs::calcSystemEnergy(molecules, enviro);
+			oldEnergy = SerialCalcs::calcSystemEnergy(box);
 		}
 	}
+	printStartupReport(std::cout);
 	
 	std::cout << std::endl << "Running " << simSteps << " steps" << std::endl << std::endl;
-	
-	//determine where we want the state file to go
-	std::string baseStateFile = "";	
-	if (!args.simulationName.empty())
-	{
-		baseStateFile.append(args.simulationName);
-	}
-	else
+	if (shadowEnabled)
 	{
-		baseStateFile.append("untitled");
+		std::cout << "Shadowing with the " << args.shadowEngine << " engine every "
+			<< args.shadowInterval << " step(s)" << std::endl << std::endl;
 	}
 	
 	//Loop for each individual step
@@ -156,48 +206,164 @@ void Simulation::run()
 		if (args.statusInterval > 0 && (move - stepStart) % args.statusInterval == 0)
 		{
 			std::cout << "Step " << move << ":\n--Current Energy: " << oldEnergy << std::endl;	
-			//Make printing at each step optional
-			//writePDB(enviro, molecules, pdbSequenceNum, MCGPU);
-			//pdbSequenceNum++;					
+			//Trajectory frames are written at every n-th status update
+			if (args.outputStride > 0 && statusUpdates % args.outputStride == 0)
+			{
+				writePDB(enviro, molecules, pdbSequenceNum, MCGPU);
+				pdbSequenceNum++;
+			}
+			statusUpdates++;
 		}
 		
 		if (args.stateInterval > 0 && move > stepStart && (move - stepStart) % args.stateInterval == 0)
 		{
-			std::cout << std::endl;
-			saveState(baseStateFile, move);
-			std::cout << std::endl;
+			if (args.outputStride <= 0 || stateSnapshots % args.outputStride == 0)
+			{
+				std::cout << std::endl;
+				saveState(move);
+				std::cout << std::endl;
+			}
+			stateSnapshots++;
 		}
 		
 		//Randomly select index of a molecule for changing
 		int changeIdx = box->chooseMolecule();
 		
+		//Cross-check the selected engine against the shadow reference on sampled steps
+		bool shadowStep = shadowEnabled && (move - stepStart) % args.shadowInterval == 0;
+		Real shadowOldCont = 0, shadowNewCont = 0;
+		int shadowOldNeighbors = 0, shadowNewNeighbors = 0;
+		
+		//Screen the trial move for gross overlaps before any energy evaluation
+		bool screened = args.hardCoreFraction > 0 && args.simulationMode != SimulationMode::Parallel;
+		if (screened)
+		{
+			box->changeMolecule(changeIdx);
+			if (((SerialBox*) box)->hasOverlap(changeIdx, args.hardCoreFraction))
+			{
+				rejected++;
+				overlapRejections++;
+				box->rollback(changeIdx);
+				continue;
+			}
+			//evaluate the unchanged molecule first
+			box->swapChangedMol(changeIdx);
+		}
+		
+		//In mixed precision the contributions are first estimated in single
+		//precision, and only computed exactly when the decision needs them
+		bool preEvaluated = args.mixedPrecision;
+		Real oldBound = 0, newBound = 0;
+		
 		//Calculate the current/original/old energy contribution for the current molecule
-		if (args.simulationMode == SimulationMode::Parallel)
+		if (preEvaluated)
+		{
+			oldEnergyCont = SerialCalcs::estimateMolecularEnergyContribution(box, changeIdx, &oldBound);
+		}
+		else if (args.simulationMode == SimulationMode::Parallel)
 		{
 			oldEnergyCont = ParallelCalcs::calcMolecularEnergyContribution(box, changeIdx);
 		}
+		else if (args.simulationMode == SimulationMode::HostBatch)
+		{
+			oldEnergyCont = HostBatchCalcs::calcMolecularEnergyContribution(box, changeIdx);
+		}
 		else
 		{
-			oldEnergyCont = SerialCalcs::calcMolecularEnergyContribution(molecules, enviro, changeIdx);
+			oldEnergyCont = SerialCalcs::calcMolecularEnergyContribution(box, changeIdx);
+		}
+		
+		if (shadowStep)
+		{
+			shadowOldCont = SerialCalcs::calcMolecularEnergyContribution(molecules, enviro, changeIdx);
+			shadowOldNeighbors = SerialCalcs::countNeighbors(molecules, enviro, changeIdx);
 		}
 		
 		//Actually translate the molecule at the preselected index	
-		box->changeMolecule(changeIdx);
+		if (screened)
+		{
+			box->swapChangedMol(changeIdx);
+		}
+		else
+		{
+			box->changeMolecule(changeIdx);
+		}
 		
 		//Calculate the new energy after translation
-		if (args.simulationMode == SimulationMode::Parallel)
+		if (preEvaluated)
+		{
+			newEnergyCont = SerialCalcs::estimateMolecularEnergyContribution(box, changeIdx, &newBound);
+		}
+		else if (args.simulationMode == SimulationMode::Parallel)
 		{
 			newEnergyCont = ParallelCalcs::calcMolecularEnergyContribution(box, changeIdx);
 		}
+		else if (args.simulationMode == SimulationMode::HostBatch)
+		{
+			newEnergyCont = HostBatchCalcs::calcMolecularEnergyContribution(box, changeIdx);
+		}
 		else
 		{
-			newEnergyCont = SerialCalcs::calcMolecularEnergyContribution(molecules, enviro, changeIdx);
+			newEnergyCont = SerialCalcs::calcMolecularEnergyContribution(box, changeIdx);
+		}
+		
+		if (shadowStep)
+		{
+			shadowNewCont = SerialCalcs::calcMolecularEnergyContribution(molecules, enviro, changeIdx);
+			shadowNewNeighbors = SerialCalcs::countNeighbors(molecules, enviro, changeIdx);
 		}
 		
 		//Compare new energy and old energy to decide if we should accept or not
 		bool accept = false;
+		bool decided = false;
+		bool drawn = false;
+		Real threshold = 0;
+		
+		if (preEvaluated)
+		{
+			//the margin also covers the rounding of the exact engine's subtraction
+			//and of this one
+			Real margin = oldBound + newBound +
+				MIXED_PRECISION_EXP_ERROR * (fabs(newEnergyCont) + fabs(oldEnergyCont));
+			Real lowestDelta = (newEnergyCont - oldEnergyCont) - margin;
+			if (lowestDelta > 0)
+			{
+				//the move is certainly uphill, so the exact engine draws here too
+				threshold = randomReal(0.0, 1.0);
+				drawn = true;
+				if (exp(-lowestDelta * (1 - MIXED_PRECISION_EXP_ERROR) / kT) * (1 + MIXED_PRECISION_EXP_ERROR) < threshold)
+				{
+					decided = true;
+					singlePrecisionRejections++;
+				}
+			}
+			
+			if (!decided)
+			{
+				//too close to call, or accepted and needed exactly for the running energy
+				newEnergyCont = SerialCalcs::calcMolecularEnergyContribution(box, changeIdx);
+				box->swapChangedMol(changeIdx);
+				oldEnergyCont = SerialCalcs::calcMolecularEnergyContribution(box, changeIdx);
+				box->swapChangedMol(changeIdx);
+				precisionRefinements++;
+			}
+		}
+		
+		//checked once the decision is made, so that a single precision
+		//rejection is checked against the exact energy change
+		if (shadowStep)
+		{
+			checkShadow(move, changeIdx, oldEnergyCont, shadowOldCont, shadowOldNeighbors,
+						newEnergyCont, shadowNewCont, shadowNewNeighbors,
+						decided ? oldBound : 0, decided ? newBound : 0, decided ? threshold : -1, kT);
+		}
+		
 		//Always accept decrease in energy
-		if(newEnergyCont < oldEnergyCont)
+		if (decided)
+		{
+			accept = false;
+		}
+		else if(newEnergyCont < oldEnergyCont)
 		{
 			accept = true;
 		}
@@ -206,7 +372,12 @@ void Simulation::run()
 		{
 			Real x = exp(-(newEnergyCont - oldEnergyCont) / kT);
 			
-			if(x >= randomReal(0.0, 1.0))
+			if (!drawn)
+			{
+				threshold = randomReal(0.0, 1.0);
+			}
+			
+			if(x >= threshold)
 			{
 				accept = true;
 			}
@@ -220,6 +391,7 @@ void Simulation::run()
 		{
 			accepted++;
 			oldEnergy += newEnergyCont - oldEnergyCont;
+			box->commitChange(changeIdx);
 		}
 		else
 		{
@@ -240,7 +412,7 @@ void Simulation::run()
 	// Save the final state of the simulation
 	if (args.stateInterval >= 0)
 	{
-		saveState(baseStateFile, (stepStart + simSteps));
+		saveState(stepStart + simSteps);
 	}
 	
 	std::cout << std::endl << "Finished running " << simSteps << " steps" << std::endl;
@@ -249,13 +421,94 @@ void Simulation::run()
 	std::cout << "Accepted Moves: " << accepted << std::endl;
 	std::cout << "Rejected Moves: " << rejected << std::endl;
 	std::cout << "Acceptance Ratio: " << 100.0 * accepted / (accepted + rejected) << '\%' << std::endl;
+	if (shadowEnabled)
+	{
+		std::cout << "Shadow Checks: " << shadowChecks << " (" << shadowDivergences << " divergent)" << std::endl;
+		std::cout << "Shadow Max Deviation: " << shadowMaxDeviation << std::endl;
+	}
+	if (args.hardCoreFraction > 0 && args.simulationMode != SimulationMode::Parallel)
+	{
+		std::cout << "Overlap Rejections: " << overlapRejections << " (hard core "
+			<< ((SerialBox*) box)->occupancy.getHardCoreRadius() << " angstroms)" << std::endl;
+	}
+	if (args.mixedPrecision)
+	{
+		std::cout << "Single Precision Rejections: " << singlePrecisionRejections << std::endl;
+		std::cout << "Precision Refinements: " << precisionRefinements << std::endl;
+	}
+	if (args.neighborSkin > 0 && args.simulationMode != SimulationMode::Parallel)
+	{
+		std::cout << "Neighbor List Rebuilds: " << ((SerialBox*) box)->neighbors.getRebuildCount()
+			<< " (skin " << args.neighborSkin << " angstroms)" << std::endl;
+	}
+	int atomisticCount = 0, hybridCount = 0, coarseCount = 0;
+	if (args.adaptiveSolute >= 0)
+	{
+		((SerialBox*) box)->resolution.countRegions(box->getMolecules(), box->getEnvironment(),
+													&atomisticCount, &hybridCount, &coarseCount);
+		std::cout << "Adaptive Resolution: " << atomisticCount << " atomistic, " << hybridCount << " hybrid, "
+			<< coarseCount << " coarse-grained molecules (" << ((SerialBox*) box)->resolution.kindCount()
+			<< " kinds)" << std::endl;
+	}
+	if (args.nonPeriodic)
+	{
+		std::cout << "Stored Grid Cells: " << ((SerialBox*) box)->grid.storedCellCount()
+			<< " (non-periodic)" << std::endl;
+	}
 
-	std::string resultsName;
-	if (args.simulationName.empty())
-		resultsName = RESULTS_FILE_DEFAULT;
-	else
-		resultsName = args.simulationName;
-	resultsName.append(RESULTS_FILE_EXT);
+	//validate the approximation against the atomistic kernel on the final configuration
+	bool multipoleCheck = args.multipoleRadius > 0 && args.simulationMode != SimulationMode::Parallel;
+	Real multipoleMaxError = 0, multipoleMaxBound = 0, multipoleTotalError = 0;
+	int multipolePairs = 0, multipoleViolations = 0;
+	if (multipoleCheck)
+	{
+		multipolePairs = SerialCalcs::checkMultipoles(box, &multipoleMaxError, &multipoleMaxBound,
+													  &multipoleTotalError, &multipoleViolations);
+		std::cout << "Multipole Pairs: " << multipolePairs << " (beyond " << args.multipoleRadius
+			<< " angstroms)" << std::endl;
+		std::cout << "Multipole Max Pair Error: " << multipoleMaxError << " (bound "
+			<< multipoleMaxBound << ", " << multipoleViolations << " violations)" << std::endl;
+		std::cout << "Multipole Total Energy Error: " << multipoleTotalError << std::endl;
+	}
+
+	//estimate the full periodic electrostatics that the cutoff leaves out
+	EwaldEstimate ewald;
+	if (args.randomBatchEwald > 0)
+	{
+		RandomBatchEwald estimator = RandomBatchEwald(args.randomBatchEwald);
+		estimator.estimate((SerialBox*) box, ewald);
+		std::cout << "Random Batch Ewald Reciprocal: " << ewald.reciprocal << " +/- " << ewald.reciprocalError
+			<< " (" << ewald.batchSize << " k-vectors, " << ewald.batches << " batches, "
+			<< ewald.secondsPerBatch << " seconds per batch)" << std::endl;
+		std::cout << "Ewald Electrostatic Energy: " << ewald.total << " (cutoff Coulomb "
+			<< ewald.cutoffCoulomb << ", long-range correction " << ewald.total - ewald.cutoffCoulomb
+			<< ")" << std::endl;
+	}
+
+	//compare cutoffs on the final configuration from one pass over distance shells
+	std::vector<Real> shellEnergies;
+	std::vector<long> shellPairs;
+	if (!args.cutoffScan.empty())
+	{
+		Real halfBox = min(enviro->x, min(enviro->y, enviro->z)) / 2;
+		if (enviro->periodic && args.cutoffScan.back() > halfBox)
+		{
+			std::cerr << "Warning: Cutoffs beyond half the box (" << halfBox
+				<< " angstroms) miss pairs past the nearest periodic image" << std::endl;
+		}
+
+		SerialCalcs::calcShellEnergies(molecules, enviro, args.cutoffScan, shellEnergies, shellPairs);
+		std::cout << "Cutoff Scan (simulated cutoff " << enviro->cutoff << " angstroms):" << std::endl;
+		Real cutoffEnergy = 0;
+		for (int i = 0; i < shellEnergies.size(); i++)
+		{
+			cutoffEnergy += shellEnergies[i];
+			std::cout << "--Cutoff " << args.cutoffScan[i] << ": " << cutoffEnergy << " (shell "
+				<< shellEnergies[i] << ", " << shellPairs[i] << " molecule pairs)" << std::endl;
+		}
+	}
+
+	std::string resultsName = resultsPath(args);
 
 	// Save the simulation results.
 	std::ofstream resultsFile;
@@ -271,6 +524,8 @@ void Simulation::run()
 		resultsFile << "Simulation-Mode = GPU" << std::endl;
 	} else {
 		resultsFile << "Simulation-Mode = CPU" << std::endl;
+		if (args.simulationMode == SimulationMode::HostBatch)
+			resultsFile << "Engine = host-batch" << std::endl;
 		resultsFile << "Threads-Used = " << threadsToSpawn << std::endl;
 	}
 	resultsFile << "Starting-Step = " << stepStart << std::endl;
@@ -282,28 +537,277 @@ void Simulation::run()
 	resultsFile << "Accepted-Moves = " << accepted << std::endl;
 	resultsFile << "Rejected-Moves = " << rejected << std::endl;
 	resultsFile << "Acceptance-Rate = " << 100.0f * accepted / (float) (accepted + rejected) << '\%' << std::endl;
+	if (shadowEnabled)
+	{
+		resultsFile << "Shadow-Engine = " << args.shadowEngine << std::endl;
+		resultsFile << "Shadow-Interval = " << args.shadowInterval << std::endl;
+		resultsFile << "Shadow-Checks = " << shadowChecks << std::endl;
+		resultsFile << "Shadow-Divergences = " << shadowDivergences << std::endl;
+		resultsFile << "Shadow-First-Divergence = " << shadowFirstDivergence << std::endl;
+		resultsFile << "Shadow-Max-Deviation = " << shadowMaxDeviation << std::endl;
+	}
+	if (args.hardCoreFraction > 0 && args.simulationMode != SimulationMode::Parallel)
+	{
+		resultsFile << "Hard-Core-Radius = " << ((SerialBox*) box)->occupancy.getHardCoreRadius() << std::endl;
+		resultsFile << "Overlap-Rejections = " << overlapRejections << std::endl;
+	}
+	if (args.mixedPrecision)
+	{
+		resultsFile << "Single-Precision-Rejections = " << singlePrecisionRejections << std::endl;
+		resultsFile << "Precision-Refinements = " << precisionRefinements << std::endl;
+	}
+	if (args.neighborSkin > 0 && args.simulationMode != SimulationMode::Parallel)
+	{
+		resultsFile << "Neighbor-Skin = " << args.neighborSkin << std::endl;
+		resultsFile << "Neighbor-List-Rebuilds = " << ((SerialBox*) box)->neighbors.getRebuildCount() << std::endl;
+	}
+	if (args.adaptiveSolute >= 0)
+	{
+		resultsFile << "Adaptive-Solute = " << args.adaptiveSolute << std::endl;
+		resultsFile << "Atomistic-Radius = " << args.adaptiveRadius << std::endl;
+		resultsFile << "Hybrid-Width = " << args.hybridWidth << std::endl;
+		resultsFile << "Atomistic-Molecules = " << atomisticCount << std::endl;
+		resultsFile << "Hybrid-Molecules = " << hybridCount << std::endl;
+		resultsFile << "Coarse-Grained-Molecules = " << coarseCount << std::endl;
+	}
+	if (args.nonPeriodic)
+	{
+		resultsFile << "Periodic = false" << std::endl;
+		resultsFile << "Stored-Grid-Cells = " << ((SerialBox*) box)->grid.storedCellCount() << std::endl;
+	}
+	if (multipoleCheck)
+	{
+		resultsFile << "Multipole-Radius = " << args.multipoleRadius << std::endl;
+		resultsFile << "Multipole-Pairs = " << multipolePairs << std::endl;
+		resultsFile << "Multipole-Max-Pair-Error = " << multipoleMaxError << std::endl;
+		resultsFile << "Multipole-Max-Pair-Bound = " << multipoleMaxBound << std::endl;
+		resultsFile << "Multipole-Bound-Violations = " << multipoleViolations << std::endl;
+		resultsFile << "Multipole-Total-Energy-Error = " << multipoleTotalError << std::endl;
+	}
+	if (args.randomBatchEwald > 0)
+	{
+		resultsFile << "Ewald-Batch-Size = " << ewald.batchSize << std::endl;
+		resultsFile << "Ewald-Batches = " << ewald.batches << std::endl;
+		resultsFile << "Ewald-Real = " << ewald.real << std::endl;
+		resultsFile << "Ewald-Reciprocal = " << ewald.reciprocal << std::endl;
+		resultsFile << "Ewald-Reciprocal-Error = " << ewald.reciprocalError << std::endl;
+		resultsFile << "Ewald-Self = " << ewald.self << std::endl;
+		resultsFile << "Ewald-Intramolecular = " << ewald.intramolecular << std::endl;
+		resultsFile << "Ewald-Energy = " << ewald.total << std::endl;
+		resultsFile << "Ewald-Cutoff-Coulomb = " << ewald.cutoffCoulomb << std::endl;
+		resultsFile << "Ewald-Seconds-Per-Batch = " << ewald.secondsPerBatch << std::endl;
+	}
+	if (!args.cutoffScan.empty())
+	{
+		Real cutoffEnergy = 0;
+		for (int i = 0; i < shellEnergies.size(); i++)
+		{
+			cutoffEnergy += shellEnergies[i];
+			resultsFile << "Cutoff-Energy-" << args.cutoffScan[i] << " = " << cutoffEnergy << std::endl;
+			resultsFile << "Cutoff-Shell-Energy-" << args.cutoffScan[i] << " = " << shellEnergies[i] << std::endl;
+			resultsFile << "Cutoff-Shell-Pairs-" << args.cutoffScan[i] << " = " << shellPairs[i] << std::endl;
+		}
+	}
+
+	resultsFile << std::endl;
+	writeStartupReport(resultsFile);
 
 	resultsFile.close();
 
 
 }
 
-void Simulation::saveState(const std::string& baseFileName, int simStep)
+void Simulation::checkShadow(long step, int molIdx, Real oldEngine, Real oldReference, int oldNeighbors,
+							Real newEngine, Real newReference, int newNeighbors,
+							Real oldBound, Real newBound, Real rejectThreshold, Real kT)
 {
-	StateScanner statescan = StateScanner("");
-	std::string stateOutputPath = baseFileName;
-	std::string stepCount;
+	bool rejectedEarly = rejectThreshold >= 0;
+	bool divergent;
+	shadowChecks++;
+
+	if (rejectedEarly)
+	{
+		//single precision estimates are held to their own bounds, and the
+		//rejection must follow from the exact energy change
+		Real referenceDelta = newReference - oldReference;
+		bool outside = fabs(oldEngine - oldReference) > oldBound || fabs(newEngine - newReference) > newBound;
+		bool rejects = referenceDelta > 0 && exp(-referenceDelta / kT) < rejectThreshold;
+		divergent = outside || !rejects;
+	}
+	else
+	{
+		//deviations are relative to the reference, but never scaled below 1 so that
+		//contributions close to zero are compared absolutely
+		Real oldDeviation = fabs(oldEngine - oldReference) / max((Real) 1.0, (Real) fabs(oldReference));
+		Real newDeviation = fabs(newEngine - newReference) / max((Real) 1.0, (Real) fabs(newReference));
+		Real deviation = max(oldDeviation, newDeviation);
+
+		if (deviation > shadowMaxDeviation)
+		{
+			shadowMaxDeviation = deviation;
+		}
+		divergent = deviation > args.shadowTolerance;
+	}
+
+	if (!divergent)
+	{
+		return;
+	}
 
-	if (!toString<int>(simStep, stepCount))
+	shadowDivergences++;
+	if (shadowFirstDivergence >= 0)
+	{
 		return;
+	}
+
+	shadowFirstDivergence = step;
+	std::cerr << "Shadow divergence at step " << step << ", molecule " << molIdx << ":" << std::endl;
+	std::cerr << "--Old Energy: engine " << oldEngine << ", " << args.shadowEngine << " " << oldReference
+		<< " (" << oldNeighbors << " neighbors)" << std::endl;
+	std::cerr << "--New Energy: engine " << newEngine << ", " << args.shadowEngine << " " << newReference
+		<< " (" << newNeighbors << " neighbors)" << std::endl;
+	if (rejectedEarly)
+	{
+		std::cerr << "--Rejected in single precision with bounds " << oldBound << " and " << newBound
+			<< " against threshold " << rejectThreshold << std::endl;
+	}
+}
+
+std::string Simulation::resultsPath(const SimulationArgs &args)
+{
+	std::string resultsName;
+	if (args.simulationName.empty())
+		resultsName = RESULTS_FILE_DEFAULT;
+	else
+		resultsName = args.simulationName;
+	resultsName.append(RESULTS_FILE_EXT);
+	return resultsName;
+}
+
+std::string Simulation::statePath(const SimulationArgs &args, long simStep)
+{
+	//determine where we want the state file to go
+	std::string stateOutputPath = "";
+	if (!args.simulationName.empty())
+	{
+		stateOutputPath.append(args.simulationName);
+	}
+	else
+	{
+		stateOutputPath.append("untitled");
+	}
 
+	std::string stepCount;
+	toString<long>(simStep, stepCount);
 	stateOutputPath.append("_");
 	stateOutputPath.append(stepCount); //add the step number to the name of the output file
 	stateOutputPath.append(".state");
+	return stateOutputPath;
+}
+
+void Simulation::saveState(int simStep)
+{
+	StateScanner statescan = StateScanner("");
+	std::string stateOutputPath = statePath(args, simStep);
 
 	std::cout << "Saving state file " << stateOutputPath << std::endl;
 
-	statescan.outputState(box->getEnvironment(), box->getMolecules(), box->getMoleculeCount(), simStep, stateOutputPath);
+	if (isOutputFiltered())
+	{
+		std::vector<int> selected;
+		selectOutputMolecules(selected);
+		statescan.outputState(box->getEnvironment(), box->getMolecules(), box->getMoleculeCount(), simStep,
+							stateOutputPath, &selected);
+	}
+	else
+	{
+		statescan.outputState(box->getEnvironment(), box->getMolecules(), box->getMoleculeCount(), simStep, stateOutputPath);
+	}
+
+	//the statistics always cover the whole box, so they reproduce its energy
+	if (args.pairStatistics)
+	{
+		std::string statisticsPath = stateOutputPath.substr(0, stateOutputPath.rfind(".state"));
+		statisticsPath.append(PAIR_STATISTICS_EXT);
+		std::cout << "Saving pair statistics file " << statisticsPath << std::endl;
+
+		PairStatistics statistics = PairStatistics();
+		statistics.accumulate(box->getMolecules(), box->getEnvironment(), simStep);
+		statistics.write(statisticsPath);
+	}
+}
+
+bool Simulation::isOutputFiltered()
+{
+	return !args.outputKinds.empty() || args.outputRegionMolecule >= 0;
+}
+
+void Simulation::selectOutputMolecules(std::vector<int> &selected)
+{
+	Molecule *molecules = box->getMolecules();
+	Environment *enviro = box->getEnvironment();
+	selected.clear();
+
+	if (args.outputRegionMolecule >= 0)
+	{
+		Atom center = molecules[args.outputRegionMolecule].atoms[enviro->primaryAtomIndex];
+		Real extent = args.outputRegionExtent;
+
+		//a cube is searched through its circumscribed sphere
+		Real searchRadius = args.outputRegionCube ? extent * sqrt(3.0) : extent;
+		if (args.simulationMode == SimulationMode::Parallel || args.simulationMode == SimulationMode::HostBatch)
+		{
+			for (int i = 0; i < enviro->numOfMolecules; i++)
+			{
+				selected.push_back(i);
+			}
+		}
+		else
+		{
+			SerialBox *serialBox = SerialCalcs::prepareBox(box);
+			serialBox->grid.findCandidatesWithin(center, searchRadius, selected);
+			std::sort(selected.begin(), selected.end());
+		}
+
+		int count = 0;
+		for (int i = 0; i < selected.size(); i++)
+		{
+			Atom primary = molecules[selected[i]].atoms[enviro->primaryAtomIndex];
+			Real dx = fabs(SerialCalcs::makePeriodic(primary.x - center.x, enviro->x, enviro->periodic));
+			Real dy = fabs(SerialCalcs::makePeriodic(primary.y - center.y, enviro->y, enviro->periodic));
+			Real dz = fabs(SerialCalcs::makePeriodic(primary.z - center.z, enviro->z, enviro->periodic));
+
+			bool inside = args.outputRegionCube ?
+				(dx <= extent && dy <= extent && dz <= extent) :
+				(dx * dx + dy * dy + dz * dz <= extent * extent);
+			if (inside)
+			{
+				selected[count++] = selected[i];
+			}
+		}
+		selected.resize(count);
+	}
+	else
+	{
+		for (int i = 0; i < enviro->numOfMolecules; i++)
+		{
+			selected.push_back(i);
+		}
+	}
+
+	if (!args.outputKinds.empty())
+	{
+		int count = 0;
+		for (int i = 0; i < selected.size(); i++)
+		{
+			int type = molecules[selected[i]].type;
+			if (std::find(args.outputKinds.begin(), args.outputKinds.end(), type) != args.outputKinds.end())
+			{
+				selected[count++] = selected[i];
+			}
+		}
+		selected.resize(count);
+	}
 }
 
 int Simulation::writePDB(Environment sourceEnvironment, Molecule * sourceMoleculeCollection, int sequenceNum, string location)
@@ -325,8 +829,17 @@ int Simulation::writePDB(Environment sourceEnvironment, Molecule * sourceMolecul
 	int numOfMolecules = sourceEnvironment.numOfMolecules;
 	pdbFile << "REMARK Created by MCGPU" << std::endl;
 	
-	for (int i = 0; i < numOfMolecules; i++)
+	bool filtered = isOutputFiltered();
+	std::vector<int> selected;
+	if (filtered)
+	{
+		selectOutputMolecules(selected);
+		numOfMolecules = selected.size();
+	}
+	
+	for (int n = 0; n < numOfMolecules; n++)
 	{
+		int i = filtered ? selected[n] : n;
 		Molecule currentMol = sourceMoleculeCollection[i];    	
         for (int j = 0; j < currentMol.numOfAtoms; j++)
         {
@@ -13,11 +13,17 @@
 #ifndef SIMULATION_H
 #define SIMULATION_H
 
+#include <float.h>
+#include <vector>
 #include "SimulationArgs.h"
 #include "Box.h"
 
 #define OUT_INTERVAL 100
 
+/// Relative rounding of the energy difference, its division by kT and
+///   exp, in both the exact engine and the single precision rejection test.
+#define MIXED_PRECISION_EXP_ERROR (16 * DBL_EPSILON)
+
 const double kBoltz = 0.00198717;
 
 class Simulation
@@ -26,6 +32,15 @@ class Simulation
 		Simulation(SimulationArgs simArgs);
 		~Simulation();
 		void run();
+
+		/// @param args The arguments of a run.
+		/// @return Returns the path of the results file the run writes.
+		static std::string resultsPath(const SimulationArgs &args);
+
+		/// @param args The arguments of a run.
+		/// @param simStep The step a state is saved at.
+		/// @return Returns the path of the state file saved at the step.
+		static std::string statePath(const SimulationArgs &args, long simStep);
 		
 	private:
 		Box *box;
@@ -34,8 +49,46 @@ class Simulation
 		long stepStart;
 		int threadsToSpawn;
 
+		long shadowChecks;
+		long shadowDivergences;
+		long shadowFirstDivergence;
+		Real shadowMaxDeviation;
+
+		/// Compares the energy contributions computed by the selected engine
+		///   against the shadow reference engine for one step, reporting the
+		///   first divergence in detail. A move rejected from single
+		///   precision estimates diverges if an estimate is outside its
+		///   bound or the reference energy change would not reject it.
+		/// @param step The current simulation step.
+		/// @param molIdx The index of the changed molecule.
+		/// @param oldEngine The old contribution from the selected engine.
+		/// @param oldReference The old contribution from the shadow engine.
+		/// @param oldNeighbors The neighbor count at the old position.
+		/// @param newEngine The new contribution from the selected engine.
+		/// @param newReference The new contribution from the shadow engine.
+		/// @param newNeighbors The neighbor count at the new position.
+		/// @param oldBound The error bound of a single precision old estimate.
+		/// @param newBound The error bound of a single precision new estimate.
+		/// @param rejectThreshold The random number a move was rejected
+		///   against from its estimates, or -1 if it was not.
+		/// @param kT The Boltzmann constant times the temperature.
+		void checkShadow(long step, int molIdx, Real oldEngine, Real oldReference, int oldNeighbors,
+						Real newEngine, Real newReference, int newNeighbors,
+						Real oldBound, Real newBound, Real rejectThreshold, Real kT);
+
+		/// Checks whether any output filter (kinds or region) is active.
+		/// @return Returns true if the writers should use a selection.
+		bool isOutputFiltered();
+
+		/// Selects the molecules written by the state, PDB and trajectory
+		///   writers. Regions are searched with the serial engine's spatial
+		///   index when it is available.
+		/// @param selected Filled with the selected molecule indices, in
+		///   ascending order.
+		void selectOutputMolecules(std::vector<int> &selected);
+
 		int writePDB(Environment sourceEnvironment, Molecule * sourceMoleculeCollection, int sequenceNum, string location);
-		void saveState(const std::string& simName, int simStep);
+		void saveState(int simStep);
 		const std::string currentDateTime();
 };
 
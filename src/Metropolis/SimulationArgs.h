@@ -7,6 +7,7 @@
 #define METROSIM_SIMULATION_ARGS_H
 
 #include <string>
+#include <vector>
 
 /// Contains SimulationModeType enum
 namespace SimulationMode
@@ -25,7 +26,10 @@ namespace SimulationMode
 
 		/// Run the simulation in parallel on the GPU. The simulation
 		/// will not run if a valid CUDA device is not found.
-		Parallel
+		Parallel,
+
+		/// Run the batch algorithm of the parallel mode on CPU threads.
+		HostBatch
 	};
 }
 
@@ -94,8 +98,119 @@ struct SimulationArgs
 	///    at the very end of the simulation (which is the default
 	///    behavior with no interval specified).
 	int stateInterval;
-	
-	
+
+	/// The name of the reference engine that shadows the selected engine
+	/// and cross-checks its molecular energy contributions. An empty
+	/// string means that no shadow cross-checking is performed.
+	std::string shadowEngine;
+
+	/// The number of simulation steps between shadow cross-checks. A
+	/// value of 1 checks every step; larger values trade coverage for
+	/// lower overhead.
+	int shadowInterval;
+
+	/// The relative tolerance used when comparing the selected engine
+	/// against the shadow engine. Energies diverge when their difference
+	/// exceeds this tolerance times max(1, |reference energy|).
+	double shadowTolerance;
+
+	/// The hard-core radius used to pre-screen trial moves for overlaps,
+	/// as a fraction of the smallest Lennard-Jones sigma of any heavy atom.
+	/// A value of 0 disables the pre-screen.
+	double hardCoreFraction;
+
+	/// The molecule kinds written by the state, PDB and trajectory writers.
+	/// An empty list writes every kind.
+	std::vector<int> outputKinds;
+
+	/// The index of the molecule at the center of the output region, or
+	/// -1 to write the whole box.
+	int outputRegionMolecule;
+
+	/// The radius of a spherical output region, or the half-width of a
+	/// cubic one, in angstroms.
+	double outputRegionExtent;
+
+	/// Whether the output region is a cube instead of a sphere.
+	bool outputRegionCube;
+
+	/// Writes only every n-th output frame. A value of 0 writes no
+	/// trajectory frames and keeps every state snapshot.
+	int outputStride;
+
+	/// Whether the bond, angle, dihedral and hop arrays are attached from,
+	/// or published to, POSIX shared memory keyed by the input files.
+	bool sharedTopology;
+
+	/// The skin added to the cutoff by the background-rebuilt neighbor
+	/// lists, in angstroms. A value of 0 searches the cell grid instead.
+	double neighborSkin;
+
+	/// The distance between primary atoms beyond which molecule pairs are
+	/// evaluated from molecular multipoles instead of atom by atom, in
+	/// angstroms. A value of 0 evaluates every pair atom by atom.
+	double multipoleRadius;
+
+	/// Whether trial moves are first evaluated in single precision, falling
+	/// back to the full precision engine only when the acceptance decision
+	/// is within the error bound of the estimate.
+	bool mixedPrecision;
+
+	/// The displacement moves each box of a Gibbs-ensemble simulation makes
+	/// on its own thread between sync points. A value of 0 runs an ordinary
+	/// single box simulation.
+	int gibbsInterval;
+
+	/// The molecule transfers attempted at each Gibbs sync point.
+	int gibbsTransfers;
+
+	/// The solute temperatures of the rungs above the configuration
+	/// temperature in a solute-tempering simulation. Empty runs an ordinary
+	/// single box simulation.
+	std::vector<double> soluteTemperatures;
+
+	/// The molecule kinds whose interactions solute tempering scales.
+	std::vector<int> soluteKinds;
+
+	/// The displacement moves each replica makes on its own thread between
+	/// exchange attempts.
+	int exchangeInterval;
+
+	/// Whether the box is isolated, with no periodic images. Distances skip
+	/// the minimum image convention and neighbors are found on a sparse
+	/// hashed grid.
+	bool nonPeriodic;
+
+	/// The molecule at the center of the atomistic region of adaptive
+	/// resolution, or -1 if every molecule is atomistic.
+	int adaptiveSolute;
+
+	/// The radius of the atomistic region, and the width of the hybrid shell
+	/// beyond it, in angstroms.
+	double adaptiveRadius;
+	double hybridWidth;
+
+	/// The directory that caches finished runs by a hash of their inputs and
+	/// settings. An empty path disables the cache.
+	std::string cacheDirectory;
+
+	/// The k-vectors in each batch of the random-batch Ewald estimate made on
+	/// the final configuration. A value of 0 skips the estimate.
+	int randomBatchEwald;
+
+	/// The cutoffs, in ascending order, at which the energy of the final
+	/// configuration is reported from a single pass over distance shells.
+	/// Empty skips the scan.
+	std::vector<double> cutoffScan;
+
+	/// Whether the per-type-pair sums of r^-12, r^-6 and r^-1 are written
+	/// next to every state file.
+	bool pairStatistics;
+
+	/// The parameter set file to reweight the pair statistics files in
+	/// reweightFrames with. An empty path runs a simulation instead.
+	std::string reweightPath;
+	std::vector<std::string> reweightFrames;
 };
 
 #endif
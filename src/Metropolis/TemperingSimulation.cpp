@@ -0,0 +1,174 @@
+/*
+	Driver for solute-tempering replica exchange. Every replica is a serial
+	box of the same configuration at the same temperature, but the energy
+	of solute-solute pairs is scaled by T0/Tr and that of solute-solvent
+	pairs by its square root, so the solute of rung r behaves as if it were
+	at temperature Tr while the solvent stays at T0. Since the solvent does
+	not heat up, far fewer rungs cover a temperature range than in
+	temperature replica exchange. Each replica advances its displacement
+	moves on its own thread; at each sync point neighboring rungs attempt
+	to swap their scaling factors, which only needs the solute-solute and
+	solute-solvent energies of the two replicas.
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <iostream>
+#include "TemperingSimulation.h"
+#include "Metropolis/Utilities/MathLibrary.h"
+#include "SerialSim/SerialCalcs.h"
+
+TemperingSimulation::TemperingSimulation(SimulationArgs simArgs)
+	: MultiBoxSimulation(simArgs, simArgs.soluteTemperatures.size() + 1, "CPU Solute Tempering",
+						 TEMPERING_STREAM_OFFSET)
+{
+	//the configuration temperature is the lowest rung
+	Environment *enviro = walkers[0].box->environment;
+	temperatures.push_back(enviro->temp);
+	for (int i = 0; i < args.soluteTemperatures.size(); i++)
+	{
+		if (args.soluteTemperatures[i] <= enviro->temp)
+		{
+			std::cerr << "Error: Solute temperatures must exceed the temperature of the configuration ("
+				<< enviro->temp << " K)" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		temperatures.push_back(args.soluteTemperatures[i]);
+	}
+
+	int rungs = temperatures.size();
+	for (int r = 0; r < rungs; r++)
+	{
+		scales.push_back(temperatures[0] / temperatures[r]);
+		walkers[r].box->kinds.setSoluteScaling(args.soluteKinds, scales[r]);
+		rungOf.push_back(r);
+		replicaAt.push_back(r);
+	}
+	displacementAttempts.assign(rungs, 0);
+	displacementAccepts.assign(rungs, 0);
+	exchangeAttempts.assign(rungs - 1, 0);
+	exchangeAccepts.assign(rungs - 1, 0);
+}
+
+long TemperingSimulation::syncInterval()
+{
+	return args.exchangeInterval;
+}
+
+void TemperingSimulation::prepare()
+{
+	int solute = 0;
+	for (int i = 0; i < walkers[0].box->environment->numOfMolecules; i++)
+	{
+		solute += walkers[0].box->kinds.isSolute(i);
+	}
+	std::cout << "Tempering " << solute << " solute molecules" << std::endl;
+	if (solute == 0)
+	{
+		std::cerr << "Warning: No molecule is of a solute kind, so every exchange will be accepted" << std::endl;
+	}
+}
+
+void TemperingSimulation::sync(long cycle)
+{
+	for (int r = 0; r < walkers.size(); r++)
+	{
+		displacementAttempts[rungOf[r]] += walkers[r].attempts;
+		displacementAccepts[rungOf[r]] += walkers[r].accepts;
+	}
+
+	//alternate between the even and the odd pairs of rungs
+	exchange(cycle % 2);
+}
+
+void TemperingSimulation::exchange(int parity)
+{
+	//swapping factors leaves the coordinates alone, so the decomposed
+	//energies stay valid for the whole batch of swaps
+	int count = walkers.size();
+	std::vector<Real> soluteSolute(count), soluteSolvent(count);
+	for (int r = 0; r < count; r++)
+	{
+		SerialCalcs::calcSoluteEnergies(walkers[r].box, &soluteSolute[r], &soluteSolvent[r]);
+	}
+
+	for (int rung = parity; rung + 1 < count; rung += 2)
+	{
+		int lower = replicaAt[rung], upper = replicaAt[rung + 1];
+		Real kT = walkers[lower].kT;
+
+		//the change in the sum of the two scaled energies; only the
+		//solute terms depend on the factors
+		Real deltaScale = scales[rung + 1] - scales[rung];
+		Real deltaRoot = sqrt(scales[rung + 1]) - sqrt(scales[rung]);
+		Real delta = deltaScale * (soluteSolute[lower] - soluteSolute[upper]) +
+			deltaRoot * (soluteSolvent[lower] - soluteSolvent[upper]);
+
+		exchangeAttempts[rung]++;
+		if (delta <= 0 || exp(-delta / kT) >= randomReal(0.0, 1.0))
+		{
+			exchangeAccepts[rung]++;
+			moveToRung(lower, rung + 1, soluteSolute[lower], soluteSolvent[lower]);
+			moveToRung(upper, rung, soluteSolute[upper], soluteSolvent[upper]);
+			replicaAt[rung] = upper;
+			replicaAt[rung + 1] = lower;
+		}
+	}
+}
+
+void TemperingSimulation::moveToRung(int replica, int rung, Real soluteSolute, Real soluteSolvent)
+{
+	Real oldScale = scales[rungOf[replica]], newScale = scales[rung];
+	walkers[replica].energy += (newScale - oldScale) * soluteSolute + (sqrt(newScale) - sqrt(oldScale)) * soluteSolvent;
+	rungOf[replica] = rung;
+	walkers[replica].box->kinds.setSoluteScaling(args.soluteKinds, newScale);
+}
+
+void TemperingSimulation::printBoxes()
+{
+	for (int rung = 0; rung < walkers.size(); rung++)
+	{
+		std::cout << "--Rung " << rung << " (" << temperatures[rung] << " K): replica " << replicaAt[rung]
+			<< ", energy " << walkers[replicaAt[rung]].energy << std::endl;
+	}
+}
+
+void TemperingSimulation::printResults()
+{
+	for (int rung = 0; rung < walkers.size(); rung++)
+	{
+		std::cout << "Rung " << rung << " Displacement Acceptance: " << displacementAccepts[rung]
+			<< " of " << displacementAttempts[rung] << std::endl;
+	}
+	for (int rung = 0; rung + 1 < walkers.size(); rung++)
+	{
+		std::cout << "Exchange " << rung << "-" << rung + 1 << " Acceptance: " << exchangeAccepts[rung]
+			<< " of " << exchangeAttempts[rung] << std::endl;
+	}
+}
+
+void TemperingSimulation::writeInformation(std::ostream &resultsFile)
+{
+	resultsFile << "Exchange-Interval = " << args.exchangeInterval << std::endl;
+	resultsFile << "Solute-Kinds = ";
+	for (int i = 0; i < args.soluteKinds.size(); i++)
+		resultsFile << (i > 0 ? "," : "") << args.soluteKinds[i];
+	resultsFile << std::endl;
+}
+
+void TemperingSimulation::writeResults(std::ostream &resultsFile)
+{
+	for (int rung = 0; rung < walkers.size(); rung++)
+	{
+		resultsFile << "Rung-" << rung << "-Temperature = " << temperatures[rung] << std::endl;
+		resultsFile << "Rung-" << rung << "-Scale = " << scales[rung] << std::endl;
+		resultsFile << "Rung-" << rung << "-Final-Energy = " << walkers[replicaAt[rung]].energy << std::endl;
+		resultsFile << "Rung-" << rung << "-Displacement-Accepts = " << displacementAccepts[rung] << std::endl;
+		resultsFile << "Rung-" << rung << "-Displacement-Attempts = " << displacementAttempts[rung] << std::endl;
+	}
+	for (int rung = 0; rung + 1 < walkers.size(); rung++)
+	{
+		resultsFile << "Exchange-" << rung << "-Accepts = " << exchangeAccepts[rung] << std::endl;
+		resultsFile << "Exchange-" << rung << "-Attempts = " << exchangeAttempts[rung] << std::endl;
+	}
+}
@@ -0,0 +1,72 @@
+/*
+	Driver for solute-tempering replica exchange. Every replica is a serial
+	box of the same configuration at the same temperature, but the energy
+	of solute-solute pairs is scaled by T0/Tr and that of solute-solvent
+	pairs by its square root, so the solute of rung r behaves as if it were
+	at temperature Tr while the solvent stays at T0. Since the solvent does
+	not heat up, far fewer rungs cover a temperature range than in
+	temperature replica exchange. Each replica advances its displacement
+	moves on its own thread; at each sync point neighboring rungs attempt
+	to swap their scaling factors, which only needs the solute-solute and
+	solute-solvent energies of the two replicas.
+*/
+
+#ifndef TEMPERINGSIMULATION_H
+#define TEMPERINGSIMULATION_H
+
+#include <vector>
+#include "MultiBoxSimulation.h"
+
+/// Seed offset of the random number stream of each replica thread.
+#define TEMPERING_STREAM_OFFSET 104729
+
+class TemperingSimulation : public MultiBoxSimulation
+{
+	public:
+		TemperingSimulation(SimulationArgs simArgs);
+
+	private:
+		/// The rung whose scaling factors each replica currently has.
+		std::vector<int> rungOf;
+
+		/// The solute temperature and solute-solute factor of each rung,
+		///   and the replica at each rung.
+		std::vector<double> temperatures;
+		std::vector<Real> scales;
+		std::vector<int> replicaAt;
+
+		/// The displacement moves made at each rung.
+		std::vector<long> displacementAttempts, displacementAccepts;
+
+		/// The swaps attempted between each rung and the next.
+		std::vector<long> exchangeAttempts, exchangeAccepts;
+
+		long syncInterval();
+
+		/// Warns when no molecule is of a solute kind.
+		void prepare();
+
+		/// Credits the displacement moves of the cycle to the rungs that
+		///   made them, then attempts to swap neighboring rungs.
+		/// @param cycle The index of the cycle, whose parity picks the pairs.
+		void sync(long cycle);
+
+		/// Attempts to swap the scaling factors of every other pair of
+		///   neighboring rungs.
+		/// @param parity The lower rung of the first pair, 0 or 1.
+		void exchange(int parity);
+
+		/// Gives a replica the scaling factors of a rung.
+		/// @param replica The index of the replica to rescale.
+		/// @param rung The rung it moves to.
+		/// @param soluteSolute The unscaled solute-solute energy of the box.
+		/// @param soluteSolvent The unscaled solute-solvent energy of the box.
+		void moveToRung(int replica, int rung, Real soluteSolute, Real soluteSolvent);
+
+		void printBoxes();
+		void printResults();
+		void writeInformation(std::ostream &resultsFile);
+		void writeResults(std::ostream &resultsFile);
+};
+
+#endif
@@ -3,10 +3,18 @@
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <algorithm>
 #include <exception>
 #include <stdexcept>
 #include <sstream>
 #include "Parsing.h"
+#include "SharedTopology.h"
+#include "StartupProfile.h"
 #include "StructLibrary.h"
 #include "Metropolis/Box.h"
 #include "Metropolis/SimulationArgs.h"
@@ -14,10 +22,9 @@
 using std::string;
 using std::ifstream;
 
-#define DEFAULT_STEP_COUNT 100
 
-
-bool loadBoxData(string inputPath, InputFileType inputType, Box* box, long* startStep, long* steps)
+bool loadBoxData(string inputPath, InputFileType inputType, Box* box, long* startStep, long* steps,
+                 bool shareTopology)
 {
 	if (box == NULL)
 	{
@@ -25,40 +32,90 @@ bool loadBoxData(string inputPath, InputFileType inputType, Box* box, long* star
 		return false;
 	}
 
+    StartupPhase loadPhase("Box-Load");
+
     Environment* enviro;
     vector<Molecule> moleculeVector;
 
     if (inputType == InputFile::Configuration)
     {
         ConfigScanner config_scanner = ConfigScanner();
-        if (!config_scanner.readInConfig(inputPath))
         {
-            std::cerr << "Error: loadBoxData(): Could not read config file" << std::endl;
-            return false;
+            StartupPhase phase("Config-Parse");
+            if (!config_scanner.readInConfig(inputPath))
+            {
+                std::cerr << "Error: loadBoxData(): Could not read config file" << std::endl;
+                return false;
+            }
+        }
+
+        enviro = config_scanner.getEnviro();
+        *steps = config_scanner.getSteps();
+        *startStep = 0;
+
+        box->environment = new Environment(enviro);
+
+        //the topology is fully determined by the precision, the OPLS and
+        //Z-matrix files and the molecule count, so runs that differ only in
+        //their seed, length, temperature or outputs share it
+        unsigned long long topologyKey = FNV_OFFSET_BASIS;
+        int realSize = sizeof(Real);
+        hashBytes(&realSize, sizeof(realSize), topologyKey);
+        hashBytes(&enviro->numOfMolecules, sizeof(enviro->numOfMolecules), topologyKey);
+        if (shareTopology && !(hashFile(config_scanner.getOplsusaparPath(), topologyKey) &&
+                               hashFile(config_scanner.getZmatrixPath(), topologyKey)))
+        {
+            std::cerr << "Warning: loadBoxData(): Could not hash input files; topology will not be shared" << std::endl;
+            shareTopology = false;
+        }
+
+        //a published topology replaces parsing the OPLS and Z-matrix files
+        bool attached;
+        {
+            StartupPhase phase("Topology-Attach");
+            attached = shareTopology && attachTopology(box, topologyKey);
+        }
+        if (attached)
+        {
+            enviro->numOfMolecules = box->moleculeCount;
+            enviro->numOfAtoms = box->atomCount;
+
+            StartupPhase latticePhase("FCC-Lattice");
+            if (!generatefccBox(box))
+            {
+                std::cerr << "Error: loadBoxData(): Could not generate FCC box" << std::endl;
+                return false;
+            }
+            return true;
         }
 
         OplsScanner opls_scanner = OplsScanner();
-        if (!opls_scanner.readInOpls(config_scanner.getOplsusaparPath()))
         {
-            std::cerr << "Error: loadBoxData(): Could not read OPLS file" << std::endl;
-            return false;
+            StartupPhase phase("OPLS-Scan");
+            if (!opls_scanner.readInOpls(config_scanner.getOplsusaparPath()))
+            {
+                std::cerr << "Error: loadBoxData(): Could not read OPLS file" << std::endl;
+                return false;
+            }
         }
 
         ZmatrixScanner zmatrix_scanner = ZmatrixScanner();        
-        if (!zmatrix_scanner.readInZmatrix(config_scanner.getZmatrixPath(), &opls_scanner))
         {
-            std::cerr << "Error: loadBoxData(): Could not read Z-Matrix file" << std::endl;
-            return false;
+            StartupPhase phase("Zmatrix-Scan");
+            if (!zmatrix_scanner.readInZmatrix(config_scanner.getZmatrixPath(), &opls_scanner))
+            {
+                std::cerr << "Error: loadBoxData(): Could not read Z-Matrix file" << std::endl;
+                return false;
+            }
         }
 
-        moleculeVector = zmatrix_scanner.buildMolecule(0);        
-        enviro = config_scanner.getEnviro();
-        *steps = config_scanner.getSteps();
-        *startStep = 0;
-
-        box->environment = new Environment(enviro);
+        {
+            StartupPhase phase("Molecule-Build");
+            moleculeVector = zmatrix_scanner.buildMolecule(0);        
+        }
 
-        if (!buildBoxData(enviro, moleculeVector, box))
+        StartupPhase buildPhase("Box-Build");
+        if (!buildBoxData(enviro, moleculeVector, box, shareTopology ? &topologyKey : NULL))
         {
             std::cerr << "Error: loadBoxData(): Could not build box data" << std::endl;
             return false;
@@ -69,19 +126,22 @@ bool loadBoxData(string inputPath, InputFileType inputType, Box* box, long* star
     else if (inputType == InputFile::State)
     {
         StateScanner state_scanner = StateScanner(inputPath);
-        enviro = state_scanner.readInEnvironment();
-
-        if (enviro == NULL)
         {
-            std::cerr << "Error: Unable to read environment from State File" << std::endl;
-            return false;
-        }
-        moleculeVector = state_scanner.readInMolecules();
+            StartupPhase phase("State-Scan");
+            enviro = state_scanner.readInEnvironment();
 
-        if (moleculeVector.size() == 0)
-        {
-            std::cerr << "Error: Unable to read molecule data from State file" << std::endl;
-            return false;
+            if (enviro == NULL)
+            {
+                std::cerr << "Error: Unable to read environment from State File" << std::endl;
+                return false;
+            }
+            moleculeVector = state_scanner.readInMolecules();
+
+            if (moleculeVector.size() == 0)
+            {
+                std::cerr << "Error: Unable to read molecule data from State file" << std::endl;
+                return false;
+            }
         }
 
         *steps = DEFAULT_STEP_COUNT;
@@ -95,6 +155,7 @@ bool loadBoxData(string inputPath, InputFileType inputType, Box* box, long* star
 
         box->environment = new Environment(enviro);
 
+        StartupPhase fillPhase("Box-Fill");
         if (!fillBoxData(enviro, moleculeVector, box))
         {
             std::cerr << "Error: loadBoxData(): Could not build box data" << std::endl;
@@ -117,9 +178,6 @@ bool fillBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box)
         return false;
     }
 
-    int count[5];//sum up number of atoms,bonds,angles,dihedrals,hops
-    memset(count,0,sizeof(count));
-
     box->moleculeCount = 0;
     box->atomCount = 0;
     box->bondCount = 0;
@@ -151,10 +209,26 @@ bool fillBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box)
     memset(box->dihedrals,0,sizeof(Dihedral)*box->dihedralCount);
     memset(box->hops,0,sizeof(Hop)*box->hopCount);
 
-    for(int j = 0; j < molecVec.size(); j++)
+    //prefix sums of the part counts give each molecule its offsets, so the
+    //molecules can be copied in parallel
+    int moleculeCount = molecVec.size();
+    vector<int> offsets(5 * (moleculeCount + 1), 0);
+    for(int j = 0; j < moleculeCount; j++)
+    {
+        int *offset = &offsets[5 * j];
+        offset[5] = offset[0] + molecVec[j].numOfAtoms;
+        offset[6] = offset[1] + molecVec[j].numOfBonds;
+        offset[7] = offset[2] + molecVec[j].numOfAngles;
+        offset[8] = offset[3] + molecVec[j].numOfDihedrals;
+        offset[9] = offset[4] + molecVec[j].numOfHops;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for(int j = 0; j < moleculeCount; j++)
     {
           //Copy data from vector to molecule
         Molecule molec1 = molecVec[j];   
+        const int *count = &offsets[5 * j];
 
         box->molecules[j].atoms = (Atom *)(box->atoms+count[0]);
         box->molecules[j].bonds = (Bond *)(box->bonds+count[1]);
@@ -163,18 +237,13 @@ bool fillBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box)
         box->molecules[j].hops = (Hop *)(box->hops+count[4]);
 
         box->molecules[j].id = molec1.id;
+        box->molecules[j].type = molec1.type;
         box->molecules[j].numOfAtoms = molec1.numOfAtoms;
         box->molecules[j].numOfBonds = molec1.numOfBonds;
         box->molecules[j].numOfDihedrals = molec1.numOfDihedrals;
         box->molecules[j].numOfAngles = molec1.numOfAngles;
         box->molecules[j].numOfHops = molec1.numOfHops;
 
-        count[0]+=molec1.numOfAtoms;
-        count[1]+=molec1.numOfBonds;
-        count[2]+=molec1.numOfAngles;
-        count[3]+=molec1.numOfDihedrals;
-        count[4]+=molec1.numOfHops;
-
         //get the atoms from the vector molecule
         for(int k = 0; k < molec1.numOfAtoms; k++)
         {
@@ -211,7 +280,8 @@ bool fillBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box)
     return true;
 }
 
-bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box)
+bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box,
+                  const unsigned long long* topologyKey)
 {
     // for (int i = 0; i < molecVec.size(); ++i)
     // {
@@ -350,6 +420,7 @@ bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box)
         box->molecules[j].hops = (Hop *)(box->hops+count[4]);
 
         box->molecules[j].id = molec1.id;
+        box->molecules[j].type = molec1.type;
         box->molecules[j].numOfAtoms = molec1.numOfAtoms;
         box->molecules[j].numOfBonds = molec1.numOfBonds;
         box->molecules[j].numOfDihedrals = molec1.numOfDihedrals;
@@ -393,6 +464,9 @@ bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box)
         }
     }
    
+    //every copy of the z-matrix molecules is filled from the first one, so
+    //the copies are independent of each other
+    #pragma omp parallel for schedule(static)
     for(int m = 1; m < molecDiv; m++)
     {
         int offset=m*molecTypenum;
@@ -407,44 +481,53 @@ bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box)
             box->molecules[offset+n].hops =  box->molecules[n].hops+count[4]*m;
         }
         
-        memcpy(&(box->atoms[offset*count[0]]),box->atoms,sizeof(Atom)*count[0]);
-        memcpy(&(box->bonds[offset*count[1]]),box->bonds,sizeof(Bond)*count[1]);
-        memcpy(&(box->angles[offset*count[2]]),box->angles,sizeof(Angle)*count[2]);
-        memcpy(&(box->dihedrals[offset*count[3]]),box->dihedrals,sizeof(Dihedral)*count[3]);
-        memcpy(&(box->hops[offset*count[4]]),box->hops,sizeof(Hop)*count[4]);
+        //each copy of the z-matrix molecules holds count[] entries, so copy m
+        //starts at m*count[] (not at the index of its first molecule)
+        memcpy(&(box->atoms[m*count[0]]),box->atoms,sizeof(Atom)*count[0]);
         
         for(int k=0;k<count[0];k++)
         {
-            box->atoms[offset*count[0]+k].id=offset*count[0]+k;
+            box->atoms[m*count[0]+k].id=m*count[0]+k;
         }
         
+        memcpy(&(box->bonds[m*count[1]]),box->bonds,sizeof(Bond)*count[1]);
+        memcpy(&(box->angles[m*count[2]]),box->angles,sizeof(Angle)*count[2]);
+        memcpy(&(box->dihedrals[m*count[3]]),box->dihedrals,sizeof(Dihedral)*count[3]);
+        memcpy(&(box->hops[m*count[4]]),box->hops,sizeof(Hop)*count[4]);
+        
         for(int k=0;k<count[1];k++)
         {
-            box->bonds[offset*count[1]+k].atom1+=m*count[0];
-            box->bonds[offset*count[1]+k].atom2+=m*count[0];
+            box->bonds[m*count[1]+k].atom1+=m*count[0];
+            box->bonds[m*count[1]+k].atom2+=m*count[0];
         }
         
         for(int k=0;k<count[2];k++)
         {
-            box->angles[offset*count[2]+k].atom1+=m*count[0];
-            box->angles[offset*count[2]+k].atom2+=m*count[0];
+            box->angles[m*count[2]+k].atom1+=m*count[0];
+            box->angles[m*count[2]+k].atom2+=m*count[0];
         }
         
         for(int k=0;k<count[3];k++)
         {
-            box->dihedrals[offset*count[3]+k].atom1+=m*count[0];
-            box->dihedrals[offset*count[3]+k].atom2+=m*count[0];
+            box->dihedrals[m*count[3]+k].atom1+=m*count[0];
+            box->dihedrals[m*count[3]+k].atom2+=m*count[0];
         }
         
         for(int k=0;k<count[4];k++)
         {
-            box->hops[offset*count[4]+k].atom1+=m*count[0];
-            box->hops[offset*count[4]+k].atom2+=m*count[0];
+            box->hops[m*count[4]+k].atom1+=m*count[0];
+            box->hops[m*count[4]+k].atom2+=m*count[0];
         }
     }
      
     enviro->numOfAtoms = count[0]*molecDiv;     
 
+    if (topologyKey != NULL)
+    {
+        publishTopology(box, *topologyKey);
+    }
+
+    StartupPhase latticePhase("FCC-Lattice");
     if (!generatefccBox(box)) //generate fcc lattice box
     {
     	std::cerr << "Error: buildBoxData(): Could not generate FCC box" << std::endl;
@@ -511,42 +594,42 @@ bool generatefccBox(Box* box)
         molecules[3].atoms[j].z += halfcellL;
     }
     
-	//Init all other molecules to initial coordinates
-	//Build the lattice from the unit cell by repeatedly translating
-	//the four vectors of the unit cell through a distance cellL in
-	//the x, y, and z directions
-	for(int i = 4; i < enviro->numOfMolecules; i++)
-    {
-		for (int j = 0; j < molecules[i].numOfAtoms; j++)
-        {
-			molecules[i].atoms[j].x += 0.0;
-    		molecules[i].atoms[j].y += 0.0;
-   	 		molecules[i].atoms[j].z += 0.0;
-   	 	}		
+	//Build the lattice from the unit cell by translating the four
+	//molecules of the unit cell through a distance cellL in the x, y, and
+	//z directions. Molecule i sits at position i % 4 of cell i / 4, with
+	//x varying fastest, so every molecule is placed independently.
+	int cellCount = (int) cells;
+	
+	//a molecule with more atoms than its unit cell template would read
+	//past the template into molecules that are still being placed, so
+	//such boxes are placed in order
+	bool independent = true;
+	for (int i = 4; i < enviro->numOfMolecules; i++)
+	{
+		if (molecules[i].numOfAtoms > molecules[i % 4].numOfAtoms)
+		{
+			independent = false;
+		}
 	}
 	
-	int offset = 0;
-	for(int z = 1; z <= cells; z++)
-		for(int y = 1; y <= cells; y++)
-			for(int x = 1; x <= cells; x++)
-            {
-				for(int a = 0; a < 4; a++)
-                {
-					int i = a + offset;
-					if(i < enviro->numOfMolecules)
-                    {								
-						for (int j = 0; j < molecules[i].numOfAtoms; j++)
-                        {
-							molecules[i].atoms[j].x = molecules[a].atoms[j].x + cellL * (x-1);
-							molecules[i].atoms[j].y = molecules[a].atoms[j].y + cellL * (y-1);
-							molecules[i].atoms[j].z = molecules[a].atoms[j].z + cellL * (z-1);
-						}
-					}
-				}
-				offset += 4;
-			}
+	#pragma omp parallel for schedule(static) if(independent)
+	for (int i = 4; i < enviro->numOfMolecules; i++)
+	{
+		int a = i % 4;
+		int cell = i / 4;
+		int x = cell % cellCount + 1;
+		int y = (cell / cellCount) % cellCount + 1;
+		int z = cell / (cellCount * cellCount) + 1;
+		for (int j = 0; j < molecules[i].numOfAtoms; j++)
+		{
+			molecules[i].atoms[j].x = molecules[a].atoms[j].x + cellL * (x-1);
+			molecules[i].atoms[j].y = molecules[a].atoms[j].y + cellL * (y-1);
+			molecules[i].atoms[j].z = molecules[a].atoms[j].z + cellL * (z-1);
+		}
+	}
 	
 	//Shift center of box to the origin
+	#pragma omp parallel for schedule(static)
 	for(int i = 0; i < enviro->numOfMolecules; i++)
     {
 		for (int j = 0; j < molecules[i].numOfAtoms; j++)
@@ -1027,9 +1110,10 @@ void OplsScanner::logErrors()
 
 Atom OplsScanner::getAtom(string hashNum)
 {
-    if(oplsTable.count(hashNum)>0 )
+    const Atom* atom = findAtom(hashNum.data(), hashNum.length());
+    if (atom != NULL)
     {
-        return oplsTable[hashNum];
+        return *atom;
 	}
 	else
     {
@@ -1038,6 +1122,14 @@ Atom OplsScanner::getAtom(string hashNum)
 	}
 }
 
+const Atom* OplsScanner::findAtom(const char* hashNum, int length)
+{
+    //the key keeps its capacity between calls, so lookups do not allocate
+    lookupKey.assign(hashNum, length);
+    map<string,Atom>::const_iterator found = oplsTable.find(lookupKey);
+    return found != oplsTable.end() ? &found->second : NULL;
+}
+
 Real OplsScanner::getSigma(string hashNum)
 {
     if(oplsTable.count(hashNum)>0 )
@@ -1110,6 +1202,88 @@ ZmatrixScanner::~ZmatrixScanner()
 {
 }
 
+/**
+  Splits a line into whitespace delimited tokens without copying it.
+  @param line - the null terminated line to split
+  @param tokens - receives the tokens found, up to ZMATRIX_MAX_TOKENS
+  @return - the number of tokens stored in tokens
+*/
+static int tokenizeLine(const char* line, LineToken* tokens)
+{
+    int count = 0;
+    const char* cursor = line;
+
+    while (*cursor != '\0' && count < ZMATRIX_MAX_TOKENS)
+    {
+        while (*cursor != '\0' && isspace((unsigned char) *cursor))
+        {
+            cursor++;
+        }
+        if (*cursor == '\0')
+        {
+            break;
+        }
+
+        tokens[count].start = cursor;
+        while (*cursor != '\0' && !isspace((unsigned char) *cursor))
+        {
+            cursor++;
+        }
+        tokens[count].length = (int) (cursor - tokens[count].start);
+        count++;
+    }
+
+    return count;
+}
+
+/**
+  Converts an entire token to an integer.
+  @param token - the token to convert
+  @param value - receives the converted value
+  @return - true if the whole token is a valid integer
+*/
+static bool tokenToInt(const LineToken& token, int& value)
+{
+    char* end;
+    errno = 0;
+    long parsed = strtol(token.start, &end, 10);
+    if (end != token.start + token.length || errno == ERANGE || parsed > INT_MAX || parsed < INT_MIN)
+    {
+        return false;
+    }
+    value = (int) parsed;
+    return true;
+}
+
+/**
+  Converts an entire token to a floating point value.
+  @param token - the token to convert
+  @param value - receives the converted value
+  @return - true if the whole token is a valid number
+*/
+static bool tokenToReal(const LineToken& token, Real& value)
+{
+    char* end;
+    double parsed = strtod(token.start, &end);
+    if (end != token.start + token.length)
+    {
+        return false;
+    }
+    value = (Real) parsed;
+    return true;
+}
+
+/**
+  Compares a token against a literal.
+  @param token - the token to compare
+  @param text - the null terminated literal
+  @return - true if the token and literal are equal
+*/
+static bool tokenEquals(const LineToken& token, const char* text)
+{
+    return strlen(text) == (size_t) token.length && strncmp(token.start, text, token.length) == 0;
+}
+
 bool ZmatrixScanner::readInZmatrix(string filename, OplsScanner* scanner)
 {
 	fileName = filename;
@@ -1122,98 +1296,111 @@ bool ZmatrixScanner::readInZmatrix(string filename, OplsScanner* scanner)
 		return false;
 	}
 
-    stringstream output;
     int numOfLines=0;
 
-    ifstream zmatrixScanner(fileName.c_str());
-    if( !zmatrixScanner.is_open() )
+    FILE* zmatrixFile = fopen(fileName.c_str(), "r");
+    if (zmatrixFile == NULL)
     {
     	std::cerr << "Error: Unable to open Z-Matrix file (" << fileName << ")" << std::endl;
         return false;
     }
-    else
+
+    char line[ZMATRIX_LINE_LENGTH];
+    while (fgets(line, sizeof(line), zmatrixFile) != NULL)
     {
-        string line; 
-        while( zmatrixScanner.good() )
+        size_t length = strlen(line);
+        numOfLines++;
+        if (length + 1 == sizeof(line) && line[length - 1] != '\n')
         {
-            numOfLines++;
-            getline(zmatrixScanner,line);
-
-            Molecule workingMolecule;
-
-            //check if it is a commented line,
-            //or if it is a title line
-            try
+            //a full buffer is only the whole line if the line ends here
+            int next = fgetc(zmatrixFile);
+            if (next != '\n' && next != EOF)
             {
-                if(line.at(0) != '#' && numOfLines > 1)
-                {
-                    parseLine(line,numOfLines);
-                }
+                std::cerr << "Error: Z-Matrix file (" << fileName << ") line " << numOfLines
+                    << " is longer than " << sizeof(line) - 1 << " characters" << std::endl;
+                fclose(zmatrixFile);
+                return false;
             }
-            catch(std::out_of_range& e){}
-
-            if (startNewMolecule)
-            {
-                Atom* atomArray;
-                Bond* bondArray;
-                Angle* angleArray;
-                Dihedral* dihedralArray;
-                
-                atomArray = (Atom*) malloc(sizeof(Atom) * atomVector.size());
-                bondArray = (Bond*) malloc(sizeof(Bond) * bondVector.size());
-                angleArray = (Angle*) malloc(sizeof(Angle) * angleVector.size());
-                dihedralArray = (Dihedral*) malloc(sizeof(Dihedral) * dihedralVector.size());
-
-                for (int i = 0; i < atomVector.size(); i++)
-                {
-                    atomArray[i] = atomVector[i];
-                }
-                for (int i = 0; i < bondVector.size(); i++)
-                {
-                    bondArray[i] = bondVector[i];
-                }
-                for (int i = 0; i < angleVector.size(); i++)
-                {
-                    angleArray[i] = angleVector[i];
-                }
-                for (int i = 0; i < dihedralVector.size(); i++)
-                {
-                    dihedralArray[i] = dihedralVector[i];
-                }
-
-                moleculePattern.push_back(createMolecule(-1, atomArray, angleArray, bondArray, dihedralArray, 
-                     atomVector.size(), angleVector.size(), bondVector.size(), dihedralVector.size()));
+        }
+        if (length > 0 && line[length - 1] == '\n')
+        {
+            line[--length] = '\0';
+        }
 
-                atomVector.clear();
-                bondVector.clear();
-                angleVector.clear();
-                dihedralVector.clear();
+        //check if it is a commented line, an empty line,
+        //or if it is a title line
+        if (length > 0 && line[0] != '#' && numOfLines > 1)
+        {
+            parseLine(line, numOfLines);
+        }
 
-                startNewMolecule = false;
-            } 
+        if (startNewMolecule)
+        {
+            finishMolecule();
+            startNewMolecule = false;
         }
     }
 
-    zmatrixScanner.close();    	 
+    fclose(zmatrixFile);
+    bindPatterns();
 
     return true;
 }
 
-void ZmatrixScanner::parseLine(string line, int numOfLines)
+void ZmatrixScanner::finishMolecule()
 {
+    int atomCount = atomVector.size(), bondCount = bondVector.size();
+    int angleCount = angleVector.size(), dihedralCount = dihedralVector.size();
+    for (int i = 0; i < moleculePattern.size(); i++)
+    {
+        atomCount -= moleculePattern[i].numOfAtoms;
+        bondCount -= moleculePattern[i].numOfBonds;
+        angleCount -= moleculePattern[i].numOfAngles;
+        dihedralCount -= moleculePattern[i].numOfDihedrals;
+    }
 
-    string atomID, atomType, oplsA, oplsB, bondWith, bondDistance, angleWith, angleMeasure, dihedralWith, dihedralMeasure;
+    moleculePattern.push_back(createMolecule(-1, NULL, NULL, NULL, NULL,
+         atomCount, angleCount, bondCount, dihedralCount));
+}
 
-    stringstream ss;
+void ZmatrixScanner::bindPatterns()
+{
+    int atomOffset = 0, bondOffset = 0, angleOffset = 0, dihedralOffset = 0;
+    for (int i = 0; i < moleculePattern.size(); i++)
+    {
+        Molecule& pattern = moleculePattern[i];
+        pattern.atoms = atomVector.empty() ? NULL : &atomVector[0] + atomOffset;
+        pattern.bonds = bondVector.empty() ? NULL : &bondVector[0] + bondOffset;
+        pattern.angles = angleVector.empty() ? NULL : &angleVector[0] + angleOffset;
+        pattern.dihedrals = dihedralVector.empty() ? NULL : &dihedralVector[0] + dihedralOffset;
+
+        atomOffset += pattern.numOfAtoms;
+        bondOffset += pattern.numOfBonds;
+        angleOffset += pattern.numOfAngles;
+        dihedralOffset += pattern.numOfDihedrals;
+    }
+}
+
+void ZmatrixScanner::parseLine(const char* line, int numOfLines)
+{
+    LineToken tokens[ZMATRIX_MAX_TOKENS];
+    int tokenCount = tokenizeLine(line, tokens);
 
     //check if line contains correct format
-    int format = checkFormat(line);
+    int format = checkFormat(line, tokens, tokenCount);
 
     if(format == 1)
     {
-        //read in strings in columns and store the data in temporary variables
-        ss << line;    	
-        ss >> atomID >> atomType >> oplsA >> oplsB >> bondWith >> bondDistance >> angleWith >> angleMeasure >> dihedralWith >> dihedralMeasure;
+        //the columns were validated by checkFormat, so they convert cleanly
+        int atomID, bondWith, angleWith, dihedralWith;
+        Real bondDistance, angleMeasure, dihedralMeasure;
+        tokenToInt(tokens[0], atomID);
+        tokenToInt(tokens[4], bondWith);
+        tokenToReal(tokens[5], bondDistance);
+        tokenToInt(tokens[6], angleWith);
+        tokenToReal(tokens[7], angleMeasure);
+        tokenToInt(tokens[8], dihedralWith);
+        tokenToReal(tokens[9], dihedralMeasure);
 
         //setup structures for permanent encapsulation
         Atom lineAtom;
@@ -1221,10 +1408,19 @@ void ZmatrixScanner::parseLine(string line, int numOfLines)
         Angle lineAngle;
         Dihedral lineDihedral;
 		  
-        if (oplsA.compare("-1") != 0)
+        if (!tokenEquals(tokens[2], "-1"))
         {
-            lineAtom = oplsScanner->getAtom(oplsA);
-            lineAtom.id = atoi(atomID.c_str());
+            const Atom* oplsAtom = oplsScanner->findAtom(tokens[2].start, tokens[2].length);
+            if (oplsAtom != NULL)
+            {
+                lineAtom = *oplsAtom;
+            }
+            else
+            {
+                cerr << "Index does not exist: " << string(tokens[2].start, tokens[2].length) << endl;
+                lineAtom = createAtom(0, -1, -1, -1, -1, -1, -1, NULL);
+            }
+            lineAtom.id = atomID;
             lineAtom.x = 0;
             lineAtom.y = 0;
             lineAtom.z = 0;
@@ -1232,33 +1428,33 @@ void ZmatrixScanner::parseLine(string line, int numOfLines)
         else//dummy atom
         {
         	char dummy = 'X';
-            lineAtom = createAtom(atoi(atomID.c_str()), -1, -1, -1, -1, -1, -1, dummy);
+            lineAtom = createAtom(atomID, -1, -1, -1, -1, -1, -1, dummy);
         }
 		  atomVector.push_back(lineAtom);
 
-        if (bondWith.compare("0") != 0)
+        if (bondWith != 0)
         {
             lineBond.atom1 = lineAtom.id;
-            lineBond.atom2 = atoi(bondWith.c_str());
-            lineBond.distance = atof(bondDistance.c_str());
+            lineBond.atom2 = bondWith;
+            lineBond.distance = bondDistance;
             lineBond.variable = false;
             bondVector.push_back(lineBond);
         }
 
-        if (angleWith.compare("0") != 0)
+        if (angleWith != 0)
         {
             lineAngle.atom1 = lineAtom.id;
-            lineAngle.atom2 = atoi(angleWith.c_str());
-            lineAngle.value = atof(angleMeasure.c_str());
+            lineAngle.atom2 = angleWith;
+            lineAngle.value = angleMeasure;
             lineAngle.variable = false;
             angleVector.push_back(lineAngle);
         }
 
-        if (dihedralWith.compare("0") != 0)
+        if (dihedralWith != 0)
         {
             lineDihedral.atom1 = lineAtom.id;
-            lineDihedral.atom2 = atoi(dihedralWith.c_str());
-            lineDihedral.value = atof(dihedralMeasure.c_str());
+            lineDihedral.atom2 = dihedralWith;
+            lineDihedral.value = dihedralMeasure;
             lineDihedral.variable = false;
             dihedralVector.push_back(lineDihedral);
         }
@@ -1280,69 +1476,74 @@ void ZmatrixScanner::parseLine(string line, int numOfLines)
 
     previousFormat = format;
 }
-    
-int ZmatrixScanner::checkFormat(string line)
+
+int ZmatrixScanner::checkFormat(const char* line)
+{
+    LineToken tokens[ZMATRIX_MAX_TOKENS];
+    int tokenCount = tokenizeLine(line, tokens);
+    return checkFormat(line, tokens, tokenCount);
+}
+
+int ZmatrixScanner::checkFormat(const char* line, const LineToken* tokens, int tokenCount)
 {
     int format =-1; 
-    stringstream iss(line);
-    stringstream iss2(line);
-    string atomType, someLine;
     int atomID, oplsA, oplsB, bondWith, angleWith,dihedralWith,extra;
     Real bondDistance, angleMeasure, dihedralMeasure;	 
 
-    // check if it is the normal 11 line format
-    if( iss >> atomID >> atomType >> 
-        oplsA >> oplsB >> 
-        bondWith >> bondDistance >> 
-        angleWith >> angleMeasure >> 
-        dihedralWith >> dihedralMeasure >> extra)
+    // check if it is the normal 11 column format
+    if( tokenCount >= 11 &&
+        tokenToInt(tokens[0], atomID) &&
+        tokenToInt(tokens[2], oplsA) && tokenToInt(tokens[3], oplsB) &&
+        tokenToInt(tokens[4], bondWith) && tokenToReal(tokens[5], bondDistance) &&
+        tokenToInt(tokens[6], angleWith) && tokenToReal(tokens[7], angleMeasure) &&
+        tokenToInt(tokens[8], dihedralWith) && tokenToReal(tokens[9], dihedralMeasure) &&
+        tokenToInt(tokens[10], extra))
     {
         format = 1;
     }
     else
     {
-        someLine = line;
-        if(someLine.find("TERZ")!=string::npos)
+        if(strstr(line, "TERZ") != NULL)
         {
             format = 2;
 		}
-        else if(someLine.find("Geometry Variations")!=string::npos)
+        else if(strstr(line, "Geometry Variations") != NULL)
         {
             format = 3;
         }
-        else if(someLine.find("Variable Bonds")!=string::npos)
+        else if(strstr(line, "Variable Bonds") != NULL)
         {
             format = 4;
         }
-        else if(someLine.find("Additional Bonds")!=string::npos)
+        else if(strstr(line, "Additional Bonds") != NULL)
         {
             format = 5;
         }
-        else if(someLine.find("Harmonic Constraints")!=string::npos)
+        else if(strstr(line, "Harmonic Constraints") != NULL)
         {
             format = 6;
         }
-        else if(someLine.find("Variable Bond Angles")!=string::npos)
+        else if(strstr(line, "Variable Bond Angles") != NULL)
         {
             format = 7;
         }
-        else if(someLine.find("Additional Bond Angles")!=string::npos)
+        else if(strstr(line, "Additional Bond Angles") != NULL)
         {
             format = 8;
         }
-        else if(someLine.find("Variable Dihedrals")!=string::npos)
+        else if(strstr(line, "Variable Dihedrals") != NULL)
         {
             format = 9;
         }
-        else if(someLine.find("Additional Dihedrals")!=string::npos)
+        else if(strstr(line, "Additional Dihedrals") != NULL)
         {
             format = 10;
         }
-        else if(someLine.find("Domain Definitions")!=string::npos)
+        else if(strstr(line, "Domain Definitions") != NULL)
         {
             format = 11;
         }
-        else if(someLine.find("Final blank line")!=string::npos)
+        else if(strstr(line, "Final blank line") != NULL)
         {
             format = -2;  
         }
@@ -1351,39 +1552,51 @@ int ZmatrixScanner::checkFormat(string line)
     return format;
 }
 
-void ZmatrixScanner::handleZAdditions(string line, int cmdFormat)
+void ZmatrixScanner::handleZAdditions(const char* line, int cmdFormat)
 {
-    vector<int> atomIds;
-    int id;
-    stringstream tss(line.substr(0,15) );
+    //the patterns are otherwise only bound once the whole file is read
+    bindPatterns();
 
-    if(line.find("AUTO")!=string::npos)
+    int atomIds[2];
+    int idCount = 0;
+
+    if(strstr(line, "AUTO") != NULL)
     {
 	     //Do stuff for AUTO
 	     //but what is AUTO-related stuff?
     }
     else
     {
-        while(tss >> id)
+        //the atom range is held in the first 15 columns as "I4", "I4-I4" or "I4,I4"
+        char range[16];
+        strncpy(range, line, 15);
+        range[15] = '\0';
+
+        const char* cursor = range;
+        while (idCount < 2)
         {
-            atomIds.push_back(id);
-            if(tss.peek()=='-'||tss.peek()==','||tss.peek()==' ')
+            char* end;
+            long id = strtol(cursor, &end, 10);
+            if (end == cursor)
+            {
+                break;
+            }
+            atomIds[idCount++] = (int) id;
+            cursor = end;
+            if (*cursor == '-' || *cursor == ',' || *cursor == ' ')
             {
-                tss.ignore();
+                cursor++;
             }
         }
 
-        int start, end=0;
-        if( atomIds.size()== 1)
-        {
-            start = atomIds[0];
-            end = atomIds[0]; 
-        }
-        else if(atomIds.size() == 2)
+        if (idCount == 0 || moleculePattern.empty())
         {
-            start = atomIds[0]; end = atomIds[1];
+            return;
         }
 
+        int start = atomIds[0];
+        int end = (idCount == 2) ? atomIds[1] : atomIds[0];
+
         switch(cmdFormat)
         {
             case 3:
@@ -1395,7 +1608,6 @@ void ZmatrixScanner::handleZAdditions(string line, int cmdFormat)
                 {
                     if(  moleculePattern[0].bonds[i].atom1 >= start &&  moleculePattern[0].bonds[i].atom1 <= end)
                     {
-                        //cout << "Bond Atom1: "<<  moleculePattern[0].bonds[i].atom1 << " : " <<  moleculePattern[0].bonds[i].variable<<endl;//DEBUG
                         moleculePattern[0].bonds[i].variable = true;
                     }
                 }
@@ -1412,7 +1624,6 @@ void ZmatrixScanner::handleZAdditions(string line, int cmdFormat)
                 {
                     if(  moleculePattern[0].angles[i].atom1 >= start && moleculePattern[0].angles[i].atom1 <= end)
                     {
-                    //cout << "Angle Atom1: "<<  moleculePattern[0].angles[i].atom1 << " : " << moleculePattern[0].angles[i].variable << endl;//DEBUG
                     moleculePattern[0].angles[i].variable = true;
                     }
                 }
@@ -1426,7 +1637,6 @@ void ZmatrixScanner::handleZAdditions(string line, int cmdFormat)
                 {
                     if(  moleculePattern[0].dihedrals[i].atom1 >= start &&  moleculePattern[0].dihedrals[i].atom1 <= end )
                     {
-                        //cout << "Dihedral Atom1: "<<  moleculePattern[0].dihedrals[i].atom1 << " : " <<   moleculePattern[0].dihedrals[i].variable << endl;//DEBUG
                         moleculePattern[0].dihedrals[i].variable = true;
                     }
                 }
@@ -1450,19 +1660,44 @@ vector<Hop> ZmatrixScanner::calculateHops(Molecule molec)
 
     buildAdjacencyMatrix(graph,molec);
 
+    //one breadth first search per atom yields its distance to every other atom
+    vector<int> distance(size);
+    vector<int> frontier(size);
     for(int atom1=0; atom1<size; atom1++)
     {
+        std::fill(distance.begin(), distance.end(), -1);
+        distance[atom1] = 0;
+        int head = 0, tail = 0;
+        frontier[tail++] = atom1;
+        while(head < tail)
+        {
+            int target = frontier[head++];
+            for(int col=0; col<size; col++)
+            {
+                if( graph[target][col]==1 && distance[col] < 0 )
+                {
+                    distance[col] = distance[target] + 1;
+                    frontier[tail++] = col;
+                }
+            }
+        }
+
         for(int atom2=atom1+1; atom2<size; atom2++)
         {
-            int distance = findHopDistance(atom1,atom2,size,graph);
-            if(distance >=3)
+            if(distance[atom2] >= 3)
             {
-				Hop tempHop = Hop(atom1+startId,atom2+startId,distance); //+startId because atoms may not start at 1
+				Hop tempHop = Hop(atom1+startId,atom2+startId,distance[atom2]); //+startId because atoms may not start at 1
                 newHops.push_back(tempHop);			
             }  		      
         }
     }
 
+    for(int i=0; i<size; i++)
+    {
+        delete[] graph[i];
+    }
+    delete[] graph;
+
     return newHops; 
 }
 
@@ -1564,127 +1799,100 @@ void ZmatrixScanner::buildAdjacencyMatrix(int **&graph, Molecule molec)
 vector<Molecule> ZmatrixScanner::buildMolecule(int startingID)
 {
 	int numOfMolec = moleculePattern.size();
-	Molecule newMolecules[numOfMolec];
-	 
-    //need a deep copy of molecule pattern incase it is modified.
-    for (int i = 0; i < moleculePattern.size(); i++)
-    {
-        Atom *atomCopy = new Atom[ moleculePattern[i].numOfAtoms] ;
-        for(int a=0; a <  moleculePattern[i].numOfAtoms ; a++)
-        {
-            atomCopy[a]=  moleculePattern[i].atoms[a];
-        }
-
-        Bond *bondCopy = new Bond[ moleculePattern[i].numOfBonds] ;
-        for(int a=0; a <  moleculePattern[i].numOfBonds ; a++)
-        {
-            bondCopy[a]=  moleculePattern[i].bonds[a];
-        }
-
-        Angle *angleCopy = new Angle[ moleculePattern[i].numOfAngles] ;
-        for(int a=0; a <  moleculePattern[i].numOfAngles ; a++)
-        {
-            angleCopy[a]=  moleculePattern[i].angles[a];
-        }
-
-        Dihedral *dihedCopy = new Dihedral[ moleculePattern[i].numOfDihedrals];
-        for(int a=0; a <  moleculePattern[i].numOfDihedrals ; a++)
-        {
-            dihedCopy[a]=  moleculePattern[i].dihedrals[a];
-        }
+	vector<Molecule> newMolecules;
+	if (numOfMolec == 0)
+	{
+		return newMolecules;
+	}
 
-        //calculate and add array of Hops to the molecule
-        vector<Hop> calculatedHops;
-        calculatedHops = calculateHops(moleculePattern[i]);
-        int numOfHops = calculatedHops.size();
-        Hop *hopCopy = new Hop[numOfHops];
-        for(int a=0; a < numOfHops; a++)
-        {
-            hopCopy[a] = calculatedHops[a];
-        }
+	//calculate the hops of every molecule up front so that they can share one array
+	vector<Hop> calculatedHops;
+	vector<int> hopCounts(numOfMolec);
+	{
+		StartupPhase phase("Hop-Calculation");
+		for (int i = 0; i < numOfMolec; i++)
+		{
+			vector<Hop> moleculeHops = calculateHops(moleculePattern[i]);
+			hopCounts[i] = moleculeHops.size();
+			calculatedHops.insert(calculatedHops.end(), moleculeHops.begin(), moleculeHops.end());
+		}
+	}
 
+	//need a deep copy of molecule pattern incase it is modified. The flat pattern
+	//storage is copied in one block per structure type.
+	Atom *atomCopy = new Atom[atomVector.size()];
+	Bond *bondCopy = new Bond[bondVector.size()];
+	Angle *angleCopy = new Angle[angleVector.size()];
+	Dihedral *dihedCopy = new Dihedral[dihedralVector.size()];
+	Hop *hopCopy = new Hop[calculatedHops.size()];
+	std::copy(atomVector.begin(), atomVector.end(), atomCopy);
+	std::copy(bondVector.begin(), bondVector.end(), bondCopy);
+	std::copy(angleVector.begin(), angleVector.end(), angleCopy);
+	std::copy(dihedralVector.begin(), dihedralVector.end(), dihedCopy);
+	std::copy(calculatedHops.begin(), calculatedHops.end(), hopCopy);
+
+	newMolecules.reserve(numOfMolec);
+	for (int i = 0; i < numOfMolec; i++)
+	{
+		newMolecules.push_back(Molecule(-1, atomCopy, angleCopy, bondCopy, dihedCopy, hopCopy,
+									moleculePattern[i].numOfAtoms,
+									moleculePattern[i].numOfAngles,
+									moleculePattern[i].numOfBonds,
+									moleculePattern[i].numOfDihedrals,
+									hopCounts[i]));
+		atomCopy += moleculePattern[i].numOfAtoms;
+		angleCopy += moleculePattern[i].numOfAngles;
+		bondCopy += moleculePattern[i].numOfBonds;
+		dihedCopy += moleculePattern[i].numOfDihedrals;
+		hopCopy += hopCounts[i];
+	}
 
-        Molecule molecCopy = Molecule(-1,atomCopy, angleCopy, bondCopy, dihedCopy, hopCopy, 
-                                    moleculePattern[i].numOfAtoms, 
-                                    moleculePattern[i].numOfAngles,
-                                    moleculePattern[i].numOfBonds,
-                                    moleculePattern[i].numOfDihedrals,
-                                    numOfHops);	
-		  newMolecules[i] = molecCopy; 
-             
-    }
-				
 	//Assign/calculate the appropiate x,y,z positions to the molecules. 									
-	//buildMoleculeInSpace(newMolecules, numOfMolec);
-	buildMoleculeXYZ(newMolecules, numOfMolec);
-	 
+	buildMoleculeXYZ(&newMolecules[0], numOfMolec);
 
-    for (int i = 0; i < numOfMolec; i++)
-    {
-        if(i == 0)
-        {
-            newMolecules[i].id = startingID;
-        }
-        else
-        {
-            newMolecules[i].id = newMolecules[i-1].id + newMolecules[i-1].numOfAtoms; 
-        }
-    }
-	 
-    for (int j = 0; j < numOfMolec; j++)
-    {
-        Molecule newMolecule = newMolecules[j];
-        //map unique IDs to atoms within structs based on startingID
-        for(int i = 0; i < newMolecules[j].numOfAtoms; i++)
-        {
-            int atomID = newMolecule.atoms[i].id - 1;
-            //newMolecule.atoms[i].id = atomID + newMolecule.id;
-				newMolecule.atoms[i].id = atomID + startingID;
-
-        }
-        for (int i = 0; i < newMolecule.numOfBonds; i++)
-        {
-            int atom1ID = newMolecule.bonds[i].atom1 - 1;
-            int atom2ID = newMolecule.bonds[i].atom2 - 1;
-
-            //newMolecule.bonds[i].atom1 = atom1ID + newMolecule.id;
-            //newMolecule.bonds[i].atom2 = atom2ID + newMolecule.id;
-				newMolecule.bonds[i].atom1 = atom1ID + startingID;
-            newMolecule.bonds[i].atom2 = atom2ID + startingID;
-        }
-        for (int i = 0; i < newMolecule.numOfAngles; i++)
-        {
-            int atom1ID = newMolecule.angles[i].atom1 - 1;
-            int atom2ID = newMolecule.angles[i].atom2 - 1;
-
-            //newMolecule.angles[i].atom1 = atom1ID + newMolecule.id;
-            //newMolecule.angles[i].atom2 = atom2ID + newMolecule.id;
-				newMolecule.angles[i].atom1 = atom1ID + startingID;
-            newMolecule.angles[i].atom2 = atom2ID + startingID;
-        }
-        for (int i = 0; i < newMolecule.numOfDihedrals; i++)
-        {
-            int atom1ID = newMolecule.dihedrals[i].atom1 - 1;
-            int atom2ID = newMolecule.dihedrals[i].atom2 - 1;
-
-            //newMolecule.dihedrals[i].atom1 = atom1ID + newMolecule.id;
-            //newMolecule.dihedrals[i].atom2 = atom2ID + newMolecule.id;
-				newMolecule.dihedrals[i].atom1 = atom1ID + startingID;
-            newMolecule.dihedrals[i].atom2 = atom2ID + startingID;
-        }
-        for (int i = 0; i < newMolecule.numOfHops; i++)
-        {
-            int atom1ID = newMolecule.hops[i].atom1 - 1;
-            int atom2ID = newMolecule.hops[i].atom2 - 1;
+	for (int i = 0; i < numOfMolec; i++)
+	{
+		if(i == 0)
+		{
+			newMolecules[i].id = startingID;
+		}
+		else
+		{
+			newMolecules[i].id = newMolecules[i-1].id + newMolecules[i-1].numOfAtoms; 
+		}
+	}
 
-            //newMolecule.hops[i].atom1 = atom1ID + newMolecule.id;
-            //newMolecule.hops[i].atom2 = atom2ID + newMolecule.id;
-				newMolecule.hops[i].atom1 = atom1ID + startingID;
-            newMolecule.hops[i].atom2 = atom2ID + startingID;
-        }
-    }
+	//map unique IDs to atoms within structs based on startingID
+	for (int j = 0; j < numOfMolec; j++)
+	{
+		Molecule& newMolecule = newMolecules[j];
+		for (int i = 0; i < newMolecule.numOfAtoms; i++)
+		{
+			newMolecule.atoms[i].id = newMolecule.atoms[i].id - 1 + startingID;
+		}
+		for (int i = 0; i < newMolecule.numOfBonds; i++)
+		{
+			newMolecule.bonds[i].atom1 = newMolecule.bonds[i].atom1 - 1 + startingID;
+			newMolecule.bonds[i].atom2 = newMolecule.bonds[i].atom2 - 1 + startingID;
+		}
+		for (int i = 0; i < newMolecule.numOfAngles; i++)
+		{
+			newMolecule.angles[i].atom1 = newMolecule.angles[i].atom1 - 1 + startingID;
+			newMolecule.angles[i].atom2 = newMolecule.angles[i].atom2 - 1 + startingID;
+		}
+		for (int i = 0; i < newMolecule.numOfDihedrals; i++)
+		{
+			newMolecule.dihedrals[i].atom1 = newMolecule.dihedrals[i].atom1 - 1 + startingID;
+			newMolecule.dihedrals[i].atom2 = newMolecule.dihedrals[i].atom2 - 1 + startingID;
+		}
+		for (int i = 0; i < newMolecule.numOfHops; i++)
+		{
+			newMolecule.hops[i].atom1 = newMolecule.hops[i].atom1 - 1 + startingID;
+			newMolecule.hops[i].atom2 = newMolecule.hops[i].atom2 - 1 + startingID;
+		}
+	}
 
-    return vector<Molecule>(newMolecules,newMolecules+sizeof(newMolecules)/sizeof(Molecule) );
+	return newMolecules;
 }
 
 
@@ -1702,16 +1910,33 @@ StateScanner::~StateScanner()
 
 }
 
+int StateScanner::openState(ifstream &inFile)
+{
+    inFile.open(universal_filename.c_str());
+    if (!inFile.is_open())
+        return 0;
+
+    string line;
+    getline(inFile, line);
+
+    int version;
+    string marker = STATE_FORMAT_MARKER;
+    if (line.compare(0, marker.size(), marker) == 0 && fromString<int>(line.substr(marker.size()), version))
+        return version;
+
+    //version 1 files start with the environment line
+    inFile.clear();
+    inFile.seekg(0);
+    return 1;
+}
+
 Environment* StateScanner::readInEnvironment()
 {
-	std::string filename = universal_filename;
-	
     ifstream inFile;
-    inFile.open(filename.c_str());
     string line;
-    Environment* environment;
+    Environment* environment = NULL;
 
-    if(inFile.is_open())
+    if (openState(inFile) > 0)
     {
         getline(inFile, line);
         environment = getEnvironmentFromLine(line);
@@ -1722,13 +1947,11 @@ Environment* StateScanner::readInEnvironment()
 
 long StateScanner::readInStepNumber()
 {
-    std::string filename = universal_filename;
-
     long startingStep = 0;
-    ifstream inFile(filename.c_str());
+    ifstream inFile;
     string line;
 
-    if (inFile.is_open())
+    if (openState(inFile) > 0)
     {
         getline(inFile, line); // Environment
         getline(inFile, line); // Step number
@@ -1743,163 +1966,377 @@ long StateScanner::readInStepNumber()
 
 vector<Molecule> StateScanner::readInMolecules()
 {
-	std::string filename = universal_filename;
-	
+    ifstream inFile;
+    int version = openState(inFile);
+
+    if (version == 1)
+        return readInMoleculesV1(inFile);
+    if (version == STATE_FORMAT_VERSION)
+        return readInMoleculesV2(inFile);
+
+    if (version > 0)
+        std::cerr << "Error: Unsupported state file version " << version << std::endl;
+    return vector<Molecule>();
+}
+
+vector<Molecule> StateScanner::readInMoleculesV1(ifstream &inFile)
+{
     vector<Molecule> molecules;
-    ifstream inFile(filename.c_str());
     string line;
     
-    if(inFile.is_open())
-    {
-        vector<Bond> bonds;
-        vector<Angle> angles;
-        vector<Atom> atoms;
-        vector<Dihedral> dihedrals;
-        vector<Hop> hops;
-
-        //the third line starts the first molecule
-        getline(inFile, line); // envrionment
-        getline(inFile, line); // step number
-        getline(inFile, line); //blank
-        
+    vector<Bond> bonds;
+    vector<Angle> angles;
+    vector<Atom> atoms;
+    vector<Dihedral> dihedrals;
+    vector<Hop> hops;
+
+    //the third line starts the first molecule
+    getline(inFile, line); // envrionment
+    getline(inFile, line); // step number
+    getline(inFile, line); //blank
+    
+    Molecule currentMol;
+    int section = 0; // 0 = id, 1 = atom, 2 = bond, 3 = dihedral, 4 = hop, 5 = angle
+    int molNum = 0;
+    while(inFile.good())
+    {
+        getline(inFile, line);
+        string hold = line.substr(0, 2);
+
+        switch(section)
+        {
+            case 0: // id
+                if(hold.compare("= ") == 0)
+                {
+                    section++;
+                }
+                else
+                {
+                    currentMol.id = atoi(line.c_str());
+                }
+                break;
+            case 1: // atom
+                if(hold.compare("= ") == 0)
+                {
+                    section++;
+                }
+                else
+                {
+                   atoms.push_back(getAtomFromLine(line)); 
+                }
+                break;
+            case 2: // bond
+                if(hold.compare("= ") == 0)
+                {
+                    section++;
+                }
+                else
+                {
+                   bonds.push_back(getBondFromLine(line)); 
+                }
+                break;
+            case 3: // dihedral
+                if(hold.compare("= ") == 0)
+                {
+                    section++;
+                }
+                else
+                {
+                   dihedrals.push_back(getDihedralFromLine(line)); 
+                }
+                break;
+            case 4: // hop
+                if(hold.compare("= ") == 0)
+                {
+                    section++;
+                }
+                else
+                {
+                    hops.push_back(getHopFromLine(line));
+                }
+                break;
+            case 5: // angle
+                if(hold.compare("==") == 0)
+                {
+                    section = 0;
+                    molNum++;
+
+                    currentMol.type = 0;
+                    assignParts(currentMol, atoms, bonds, angles, dihedrals, hops);
+                    
+                    //add molecule to array of returned molecules
+                    molecules.push_back(currentMol); 
+                    
+                    Molecule newMolec;
+                    currentMol = newMolec;
+                }
+                else
+                {
+                   angles.push_back(getAngleFromLine(line)); 
+                }
+                break;
+        }
+    }
+
+    //version 1 files do not record kinds, so molecules with the same
+    //topology share one, numbered in order of first appearance
+    vector<int> templates;
+    vector<int> kinds(molecules.size(), -1);
+    for (int i = 0; i < molecules.size(); i++)
+    {
+        for (int k = 0; k < templates.size() && kinds[i] < 0; k++)
+        {
+            if (sameKind(molecules[i], molecules[templates[k]]))
+                kinds[i] = k;
+        }
+        if (kinds[i] < 0)
+        {
+            kinds[i] = templates.size();
+            templates.push_back(i);
+        }
+    }
+    for (int i = 0; i < molecules.size(); i++)
+    {
+        molecules[i].type = kinds[i];
+    }
+    
+   return molecules;
+}
+
+vector<Molecule> StateScanner::readInMoleculesV2(ifstream &inFile)
+{
+    vector<Molecule> molecules;
+    string line;
+
+    getline(inFile, line); // environment
+    getline(inFile, line); // step number
+    getline(inFile, line); // blank
+
+    // = Kinds <count>
+    getline(inFile, line);
+    int kindCount;
+    if (line.compare(0, 8, "= Kinds ") != 0 || !fromString<int>(line.substr(8), kindCount) || kindCount < 0)
+    {
+        std::cerr << "Error: State file is missing its kind count" << std::endl;
+        return molecules;
+    }
+
+    //the topology of each kind, with atoms numbered from zero
+    vector<int> kindTypes(kindCount);
+    vector<vector<Atom> > kindAtoms(kindCount);
+    vector<vector<Bond> > kindBonds(kindCount);
+    vector<vector<Angle> > kindAngles(kindCount);
+    vector<vector<Dihedral> > kindDihedrals(kindCount);
+    vector<vector<Hop> > kindHops(kindCount);
+    for (int k = 0; k < kindCount; k++)
+    {
+        // = Kind <index> <type>
+        getline(inFile, line);
+        std::istringstream header(line.substr(std::min(line.size(), (size_t) 7)));
+        int index;
+        if (line.compare(0, 7, "= Kind ") != 0 || !(header >> index >> kindTypes[k]) || index != k)
+        {
+            std::cerr << "Error: State file has a malformed header for kind " << k << std::endl;
+            return molecules;
+        }
+
+        readSection(inFile, "= Atoms");
+        vector<string> lines = readSection(inFile, "= Bonds");
+        for (int i = 0; i < lines.size(); i++)
+        {
+            // id sigma epsilon charge
+            std::istringstream fields(lines[i]);
+            Atom atom = createAtom(-1, 0, 0, 0, -1, -1);
+            fields >> atom.id >> atom.sigma >> atom.epsilon >> atom.charge;
+            kindAtoms[k].push_back(atom);
+        }
+        lines = readSection(inFile, "= Dihedrals");
+        for (int i = 0; i < lines.size(); i++)
+            kindBonds[k].push_back(getBondFromLine(lines[i]));
+        lines = readSection(inFile, "= Hops");
+        for (int i = 0; i < lines.size(); i++)
+            kindDihedrals[k].push_back(getDihedralFromLine(lines[i]));
+        lines = readSection(inFile, "= Angles");
+        for (int i = 0; i < lines.size(); i++)
+            kindHops[k].push_back(getHopFromLine(lines[i]));
+        lines = readSection(inFile, "==");
+        for (int i = 0; i < lines.size(); i++)
+            kindAngles[k].push_back(getAngleFromLine(lines[i]));
+    }
+
+    // = Molecules
+    getline(inFile, line);
+    while (getline(inFile, line) && !line.empty())
+    {
+        // id kind firstAtomId, then one "x y z" line per atom
+        std::istringstream header(line);
+        int kind, first;
         Molecule currentMol;
-        int section = 0; // 0 = id, 1 = atom, 2 = bond, 3 = dihedral, 4 = hop, 5 = angle
-        int molNum = 0;
-        while(inFile.good())
+        if (!(header >> currentMol.id >> kind >> first) || kind < 0 || kind >= kindCount)
+        {
+            std::cerr << "Error: State file has a malformed record for molecule " << molecules.size() << std::endl;
+            return vector<Molecule>();
+        }
+        currentMol.type = kindTypes[kind];
+
+        vector<Atom> atoms = kindAtoms[kind];
+        for (int i = 0; i < atoms.size(); i++)
         {
-            //printf("bonds: %d\nangles: %d\natoms: %d\ndihedrals: %d\n\n",
-              //      bonds.size(), angles.size(), atoms.size(), dihedrals.size());
             getline(inFile, line);
-            string hold = line.substr(0, 2);
+            std::istringstream fields(line);
+            fields >> atoms[i].x >> atoms[i].y >> atoms[i].z;
+            atoms[i].id += first;
+        }
 
-            switch(section)
-            {
-                case 0: // id
-                    if(hold.compare("= ") == 0)
-                    {
-                        section++;
-                    }
-                    else
-                    {
-                        currentMol.id = atoi(line.c_str());
-                    }
-                    break;
-                case 1: // atom
-                    if(hold.compare("= ") == 0)
-                    {
-                        section++;
-                    }
-                    else
-                    {
-                       atoms.push_back(getAtomFromLine(line)); 
-                    }
-                    break;
-                case 2: // bond
-                    if(hold.compare("= ") == 0)
-                    {
-                        section++;
-                    }
-                    else
-                    {
-                       bonds.push_back(getBondFromLine(line)); 
-                    }
-                    break;
-                case 3: // dihedral
-                    if(hold.compare("= ") == 0)
-                    {
-                        section++;
-                    }
-                    else
-                    {
-                       dihedrals.push_back(getDihedralFromLine(line)); 
-                    }
-                    break;
-                case 4: // hop
-                    if(hold.compare("= ") == 0)
-                    {
-                        section++;
-                    }
-                    else
-                    {
-                        hops.push_back(getHopFromLine(line));
-                    }
-                    break;
-                case 5: // angle
-                    if(hold.compare("==") == 0)
-                    {
-                        section = 0;
-                        molNum++;
-                        
-                        //convert all vectors to arrays
-                        Bond *bondArray = (Bond *) malloc(sizeof(Bond) * bonds.size());
-                        Angle *angleArray = (Angle *) malloc(sizeof(Angle) * angles.size());
-                        Atom *atomArray = (Atom *) malloc(sizeof(Atom) * atoms.size());
-                        Dihedral *dihedralArray = (Dihedral *) malloc(sizeof(Dihedral) * dihedrals.size());
-                        Hop *hopArray = (Hop *) malloc(sizeof(Hop) * hops.size());
-
-                        for(int i = 0; i < bonds.size(); i++)
-                        {
-                            bondArray[i] = bonds[i];
-                        }
-                        for(int i = 0; i < angles.size(); i++)
-                        {
-                            angleArray[i] = angles[i];
-                        }
-                        for(int i = 0; i < atoms.size(); i++)
-                        {
-                            atomArray[i] = atoms[i];
-                        }
-                        for(int i = 0; i < dihedrals.size(); i++)
-                        {
-                            dihedralArray[i] = dihedrals[i];
-                        }
-                        for(int i = 0; i < hops.size(); i++)
-                        {
-                            hopArray[i] = hops[i];
-                        }
-                       
-                        //assign arrays to molecule
-                        currentMol.atoms = atomArray;
-                        currentMol.numOfAtoms = atoms.size();
-                        
-                        currentMol.bonds = bondArray;
-                        currentMol.numOfBonds = bonds.size();
-                        
-                        currentMol.angles = angleArray;
-                        currentMol.numOfAngles = angles.size();
-
-                        currentMol.dihedrals = dihedralArray;
-                        currentMol.numOfDihedrals = dihedrals.size();
-
-                        currentMol.hops = hopArray;
-                        currentMol.numOfHops = hops.size();
-                        
-                        //add molecule to array of returned molecules
-                        molecules.push_back(currentMol); 
-                        
-                        Molecule newMolec;
-                        currentMol = newMolec;
-
-                        dihedrals.clear();
-                        atoms.clear();
-                        bonds.clear();
-                        angles.clear();
-                        hops.clear();
-                    }
-                    else
-                    {
-                       angles.push_back(getAngleFromLine(line)); 
-                    }
-                    break;
-            }
+        vector<Bond> bonds = kindBonds[kind];
+        for (int i = 0; i < bonds.size(); i++)
+        {
+            bonds[i].atom1 += first;
+            bonds[i].atom2 += first;
         }
+        vector<Angle> angles = kindAngles[kind];
+        for (int i = 0; i < angles.size(); i++)
+        {
+            angles[i].atom1 += first;
+            angles[i].atom2 += first;
+        }
+        vector<Dihedral> dihedrals = kindDihedrals[kind];
+        for (int i = 0; i < dihedrals.size(); i++)
+        {
+            dihedrals[i].atom1 += first;
+            dihedrals[i].atom2 += first;
+        }
+        vector<Hop> hops = kindHops[kind];
+        for (int i = 0; i < hops.size(); i++)
+        {
+            hops[i].atom1 += first;
+            hops[i].atom2 += first;
+        }
+
+        assignParts(currentMol, atoms, bonds, angles, dihedrals, hops);
+        molecules.push_back(currentMol);
     }
-    else
+
+    return molecules;
+}
+
+vector<string> StateScanner::readSection(ifstream &inFile, const char *terminator)
+{
+    vector<string> lines;
+    string line;
+    int length = strlen(terminator);
+    while (getline(inFile, line) && line.compare(0, length, terminator) != 0)
     {
-        return molecules;
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+void StateScanner::assignParts(Molecule &molecule, vector<Atom> &atoms, vector<Bond> &bonds, vector<Angle> &angles,
+                               vector<Dihedral> &dihedrals, vector<Hop> &hops)
+{
+    //convert all vectors to arrays
+    Bond *bondArray = (Bond *) malloc(sizeof(Bond) * bonds.size());
+    Angle *angleArray = (Angle *) malloc(sizeof(Angle) * angles.size());
+    Atom *atomArray = (Atom *) malloc(sizeof(Atom) * atoms.size());
+    Dihedral *dihedralArray = (Dihedral *) malloc(sizeof(Dihedral) * dihedrals.size());
+    Hop *hopArray = (Hop *) malloc(sizeof(Hop) * hops.size());
+
+    for(int i = 0; i < bonds.size(); i++)
+    {
+        bondArray[i] = bonds[i];
+    }
+    for(int i = 0; i < angles.size(); i++)
+    {
+        angleArray[i] = angles[i];
     }
+    for(int i = 0; i < atoms.size(); i++)
+    {
+        atomArray[i] = atoms[i];
+    }
+    for(int i = 0; i < dihedrals.size(); i++)
+    {
+        dihedralArray[i] = dihedrals[i];
+    }
+    for(int i = 0; i < hops.size(); i++)
+    {
+        hopArray[i] = hops[i];
+    }
+   
+    //assign arrays to molecule
+    molecule.atoms = atomArray;
+    molecule.numOfAtoms = atoms.size();
     
-   return molecules;
+    molecule.bonds = bondArray;
+    molecule.numOfBonds = bonds.size();
+    
+    molecule.angles = angleArray;
+    molecule.numOfAngles = angles.size();
+
+    molecule.dihedrals = dihedralArray;
+    molecule.numOfDihedrals = dihedrals.size();
+
+    molecule.hops = hopArray;
+    molecule.numOfHops = hops.size();
+
+    dihedrals.clear();
+    atoms.clear();
+    bonds.clear();
+    angles.clear();
+    hops.clear();
+}
+
+bool StateScanner::sameKind(const Molecule &molecule1, const Molecule &molecule2)
+{
+    if (molecule1.type != molecule2.type || molecule1.numOfAtoms != molecule2.numOfAtoms ||
+        molecule1.numOfBonds != molecule2.numOfBonds || molecule1.numOfAngles != molecule2.numOfAngles ||
+        molecule1.numOfDihedrals != molecule2.numOfDihedrals || molecule1.numOfHops != molecule2.numOfHops ||
+        !sameAtomParameters(molecule1, molecule2))
+        return false;
+    if (molecule1.numOfAtoms == 0)
+        return true;
+
+    int first1 = molecule1.atoms[0].id;
+    int first2 = molecule2.atoms[0].id;
+    for (int i = 0; i < molecule1.numOfAtoms; i++)
+    {
+        if (molecule1.atoms[i].id - first1 != molecule2.atoms[i].id - first2)
+            return false;
+    }
+    for (int i = 0; i < molecule1.numOfBonds; i++)
+    {
+        Bond bond1 = molecule1.bonds[i];
+        Bond bond2 = molecule2.bonds[i];
+        if (bond1.atom1 - first1 != bond2.atom1 - first2 || bond1.atom2 - first1 != bond2.atom2 - first2 ||
+            bond1.distance != bond2.distance || bond1.variable != bond2.variable)
+            return false;
+    }
+    for (int i = 0; i < molecule1.numOfAngles; i++)
+    {
+        Angle angle1 = molecule1.angles[i];
+        Angle angle2 = molecule2.angles[i];
+        if (angle1.atom1 - first1 != angle2.atom1 - first2 || angle1.atom2 - first1 != angle2.atom2 - first2 ||
+            angle1.value != angle2.value || angle1.variable != angle2.variable)
+            return false;
+    }
+    for (int i = 0; i < molecule1.numOfDihedrals; i++)
+    {
+        Dihedral dihedral1 = molecule1.dihedrals[i];
+        Dihedral dihedral2 = molecule2.dihedrals[i];
+        if (dihedral1.atom1 - first1 != dihedral2.atom1 - first2 ||
+            dihedral1.atom2 - first1 != dihedral2.atom2 - first2 ||
+            dihedral1.value != dihedral2.value || dihedral1.variable != dihedral2.variable)
+            return false;
+    }
+    for (int i = 0; i < molecule1.numOfHops; i++)
+    {
+        Hop hop1 = molecule1.hops[i];
+        Hop hop2 = molecule2.hops[i];
+        if (hop1.atom1 - first1 != hop2.atom1 - first2 || hop1.atom2 - first1 != hop2.atom2 - first2 ||
+            hop1.hop != hop2.hop)
+            return false;
+    }
+    return true;
 }
 
 Angle StateScanner::getAngleFromLine(string line)
@@ -2155,13 +2592,47 @@ Hop StateScanner::getHopFromLine(string line)
     return hop;
 }
 
-void StateScanner::outputState(Environment *environment, Molecule *molecules, int numOfMolecules, int step, string filename)
+void StateScanner::outputState(Environment *environment, Molecule *molecules, int numOfMolecules, int step, string filename,
+                               const vector<int> *selection)
 {
+    int writtenMolecules = environment->numOfMolecules;
+    int writtenAtoms = environment->numOfAtoms;
+    if (selection != NULL)
+    {
+        writtenMolecules = selection->size();
+        writtenAtoms = 0;
+        for (int i = 0; i < selection->size(); i++)
+        {
+            writtenAtoms += molecules[(*selection)[i]].numOfAtoms;
+        }
+    }
+
+    //group the written molecules into kinds, each represented by the first
+    //molecule of that kind
+    int count = selection != NULL ? selection->size() : numOfMolecules;
+    vector<int> templates;
+    vector<int> kinds(count, -1);
+    for (int i = 0; i < count; i++)
+    {
+        Molecule &currentMol = molecules[selection != NULL ? (*selection)[i] : i];
+        for (int k = 0; k < templates.size() && kinds[i] < 0; k++)
+        {
+            if (sameKind(currentMol, molecules[templates[k]]))
+                kinds[i] = k;
+        }
+        if (kinds[i] < 0)
+        {
+            kinds[i] = templates.size();
+            templates.push_back(selection != NULL ? (*selection)[i] : i);
+        }
+    }
+
     ofstream outFile;
     outFile.open(filename.c_str());
+    outFile << STATE_FORMAT_MARKER << " " << STATE_FORMAT_VERSION << std::endl;
     outFile << environment->x << " " << environment->y << " " 
-        << environment->z << " " << environment->numOfMolecules << " "
-        << environment->numOfAtoms << " " << environment->temp << " "
+        << environment->z << " " << writtenMolecules << " "
+        << writtenAtoms << " " << environment->temp << " "
         << environment->cutoff << " " << environment->maxTranslation << " "
         << environment->maxRotation << " " << environment->primaryAtomIndex << " "
         << environment->randomseed
@@ -2169,22 +2640,23 @@ void StateScanner::outputState(Environment *environment, Molecule *molecules, in
     outFile << step << std::endl;  // The current simulation step
     outFile << std::endl; //blank line
 
-    for(int i=0; i<numOfMolecules; i++)
+    //the topology of each kind, with atoms numbered from the first atom
+    outFile << "= Kinds " << templates.size() << std::endl;
+    for (int k = 0; k < templates.size(); k++)
     {
-        Molecule currentMol = molecules[i];
-        outFile << currentMol.id << std::endl;
+        Molecule currentMol = molecules[templates[k]];
+        int first = currentMol.numOfAtoms > 0 ? currentMol.atoms[0].id : 0;
+        outFile << "= Kind " << k << " " << currentMol.type << std::endl;
 
-        // Write atoms
+        // Write atom parameters
         outFile << "= Atoms" << std::endl;
         for(int j=0; j<currentMol.numOfAtoms; j++)
         {
             Atom currentAtom = currentMol.atoms[j];
-            outFile << currentAtom.id << " "
-                << currentAtom.x << " " << currentAtom.y
-                << " " << currentAtom.z << " "
+            outFile << currentAtom.id - first << " "
                 << currentAtom.sigma << " "
                 << currentAtom.epsilon << " "
-                << currentAtom.charge << " " << std::endl;
+                << currentAtom.charge << std::endl;
         }
 
         // Write bonds
@@ -2192,18 +2664,10 @@ void StateScanner::outputState(Environment *environment, Molecule *molecules, in
         for(int j=0; j<currentMol.numOfBonds; j++)
         {
             Bond currentBond = currentMol.bonds[j];
-            outFile << currentBond.atom1 << " "
-                << currentBond.atom2 << " "
-                << currentBond.distance << " ";
-            
-            if(currentBond.variable)
-            {
-                outFile << "1" << std::endl;
-            }
-            else
-            {
-                outFile << "0" << std:: endl;
-            }
+            outFile << currentBond.atom1 - first << " "
+                << currentBond.atom2 - first << " "
+                << currentBond.distance << " "
+                << (currentBond.variable ? "1" : "0") << std::endl;
         }
 
         // Write dihedrals
@@ -2211,18 +2675,10 @@ void StateScanner::outputState(Environment *environment, Molecule *molecules, in
         for(int j=0; j<currentMol.numOfDihedrals; j++)
         {
             Dihedral currentDi = currentMol.dihedrals[j];
-            outFile << currentDi.atom1 << " "
-                << currentDi.atom2 << " "
-                << currentDi.value << " ";
-
-            if(currentDi.variable)
-            {
-                outFile << "1" << std::endl;
-            }
-            else
-            {
-                outFile << "0" << std::endl;
-            }
+            outFile << currentDi.atom1 - first << " "
+                << currentDi.atom2 - first << " "
+                << currentDi.value << " "
+                << (currentDi.variable ? "1" : "0") << std::endl;
         }
 
         // Write hops
@@ -2230,9 +2686,8 @@ void StateScanner::outputState(Environment *environment, Molecule *molecules, in
         for(int j=0; j<currentMol.numOfHops; j++)
         {
             Hop currentHop = currentMol.hops[j];
-
-            outFile << currentHop.atom1 << " "
-                << currentHop.atom2 << " "
+            outFile << currentHop.atom1 - first << " "
+                << currentHop.atom2 - first << " "
                 << currentHop.hop << std::endl;
         }
 
@@ -2241,24 +2696,30 @@ void StateScanner::outputState(Environment *environment, Molecule *molecules, in
         for(int j=0; j<currentMol.numOfAngles; j++)
         {
             Angle currentAngle = currentMol.angles[j];
-
-            outFile << currentAngle.atom1 << " "
-                << currentAngle.atom2 << " "
-                << currentAngle.value << " ";
-
-            if(currentAngle.variable)
-            {
-                outFile << "1" << std::endl;
-            }
-            else
-            {
-                outFile << "0" << std::endl;
-            }
+            outFile << currentAngle.atom1 - first << " "
+                << currentAngle.atom2 - first << " "
+                << currentAngle.value << " "
+                << (currentAngle.variable ? "1" : "0") << std::endl;
         }
 
         outFile << "==" << std::endl;
     }
 
+    //one record per molecule: its id, kind and first atom id, then the
+    //coordinates of its atoms
+    outFile << "= Molecules" << std::endl;
+    for(int i=0; i<count; i++)
+    {
+        Molecule currentMol = molecules[selection != NULL ? (*selection)[i] : i];
+        int first = currentMol.numOfAtoms > 0 ? currentMol.atoms[0].id : 0;
+        outFile << currentMol.id << " " << kinds[i] << " " << first << std::endl;
+        for(int j=0; j<currentMol.numOfAtoms; j++)
+        {
+            Atom currentAtom = currentMol.atoms[j];
+            outFile << currentAtom.x << " " << currentAtom.y << " " << currentAtom.z << std::endl;
+        }
+    }
+
     outFile.close();
 }
 
@@ -22,6 +22,15 @@
 #define TRIMMED_CHARS " \n\r\t"
 #define COMMENT_DELIM ';'
 
+#define DEFAULT_STEP_COUNT 100
+
+/**
+  The first line of a state file in the compact format, followed by its
+  version. State files without it are in the original format, version 1.
+*/
+#define STATE_FORMAT_MARKER "#MCGPU-State"
+#define STATE_FORMAT_VERSION 2
+
 class ConfigScanner
 {
     private:
@@ -150,6 +159,10 @@ class OplsScanner
      HashTable that holds all opls references
    */
     map<string,Atom> oplsTable;
+    /**
+      The key of the last findAtom lookup, reused between lookups.
+    */
+    string lookupKey;
 	/**
         HashTable that holds all the Fourier Coefficents
 		  stored
@@ -224,6 +237,15 @@ class OplsScanner
         @return - the atom with that is the value to the hasNum key.
 		*/
 		Atom getAtom(string hashNum);
+
+		/**
+		Finds the atom of a hash number held in part of a Z matrix line,
+		without building a string per lookup.
+		@param hashNum - the first character of the hash number
+		@param length - the length of the hash number
+        @return - the atom of the hash number, or NULL if there is none.
+		*/
+		const Atom* findAtom(const char* hashNum, int length);
 		
 		/**
 		Returns the sigma value based on the hashNum (1st col) in Z matrix file
@@ -256,6 +278,28 @@ class OplsScanner
 };
 
 
+/**
+  The maximum number of whitespace delimited tokens recorded for a single
+  Z-matrix line. Tokens beyond this count are ignored.
+*/
+#define ZMATRIX_MAX_TOKENS 16
+
+/**
+  The size of the line buffer used to stream in Z-matrix files. Files with
+  lines that do not fit are rejected.
+*/
+#define ZMATRIX_LINE_LENGTH 512
+
+/**
+  A whitespace delimited token within a line buffer. Tokens refer directly
+  into the line that was scanned and are never copied.
+*/
+struct LineToken
+{
+    const char* start;
+    int length;
+};
+
 class ZmatrixScanner
 {
    private:
@@ -268,23 +312,24 @@ class ZmatrixScanner
       */
       OplsScanner* oplsScanner;
       /**
-        Vector that holds example molecules.
+        Vector that holds example molecules. The molecules point into the flat
+        atom, bond, angle and dihedral storage below.
       */
       vector<Molecule> moleculePattern;
       /**
-        Vector that holds the atoms contained in the molecule in the Z-matrix.
+        Flat storage holding the atoms of every molecule in the Z-matrix, in file order.
       */
       vector<Atom> atomVector;
       /**
-        Vector that holds the bonds contained in the molecule in the Z-matrix.
+        Flat storage holding the bonds of every molecule in the Z-matrix, in file order.
       */
       vector<Bond> bondVector;
       /**
-        Vector that holds the angles contained in the molecule in the Z-matrix.
+        Flat storage holding the angles of every molecule in the Z-matrix, in file order.
       */
       vector<Angle> angleVector;
       /**
-        Vector that holds the dihedrals contained in the molecule in the Z-matrix.
+        Flat storage holding the dihedrals of every molecule in the Z-matrix, in file order.
       */
       vector<Dihedral> dihedralVector;
       /**
@@ -301,12 +346,36 @@ class ZmatrixScanner
       */
       int previousFormat;
 
+      /**
+        Closes the molecule currently being read: appends a pattern molecule that
+        covers the atoms, bonds, angles and dihedrals stored since the previous
+        molecule was closed.
+      */
+      void finishMolecule();
+
+      /**
+        Points every pattern molecule at its range of the flat storage. The
+        flat storage moves as lines are added, so this is called once the
+        file is read, and before Z-matrix additions edit the patterns.
+      */
+      void bindPatterns();
+
+      /**
+        Checks the format of an already tokenized line. See checkFormat(const char*).
+        @param line - a line from the zmatrix file
+        @param tokens - the whitespace delimited tokens of the line
+        @param tokenCount - the number of entries in tokens
+        @return - Format code, see checkFormat(const char*)
+      */
+      int checkFormat(const char* line, const LineToken* tokens, int tokenCount);
+
    public:
       ZmatrixScanner(); // constructor
       ~ZmatrixScanner();
 		
 		/**
-          Scans in the z-matrix File calls sub-function parseLine
+          Streams in the z-matrix File one line at a time and calls sub-function parseLine.
+          Lines are tokenized in place, so no per-line allocations are made.
           @param filename - the name/path of the z-matrix file
           @return - success code
                     0: Valid z-matrix path
@@ -318,16 +387,15 @@ class ZmatrixScanner
           Parses out a line from the zmatrix file and gets the atom from the OPLS hash
           Creates structs for bond, angle, dihedral, if applicable
           calls sub-function checkFormat()
-          @param line - a line from the zmatrix file
+          @param line - a null terminated line from the zmatrix file
           @param numOflines - number of lines previously read in, used for error output
 		*/
-        void parseLine(string line, int numOfLines);
+        void parseLine(const char* line, int numOfLines);
 		
 		/**
           Checks the format of the line being read in
           returns false if the format of the line is invalid
-          @param line -  a line from the zmatrix file
-          @param stringCount - number of strings in a line you're looking at
+          @param line -  a null terminated line from the zmatrix file
           @return - Format code
                     1: Base atom row listing
                     2: TERZ line
@@ -343,14 +411,14 @@ class ZmatrixScanner
                     -2: Final Blank Line
                     -1: Invalid line format
 		*/
-        int checkFormat(string line);
+        int checkFormat(const char* line);
 
         /**
 		  Handles the additional stuff listed at the bottom of the Z-matrix file
-		  @param line -   a line from the zmatrix file
+		  @param line -   a null terminated line from the zmatrix file
 		  @param cmdFormat- the int representing the format for which the line applies :see checkFormat
 		*/
-        void handleZAdditions(string line, int cmdFormat);
+        void handleZAdditions(const char* line, int cmdFormat);
 
         /**
           Creates a vector containg the Hop distances of a molecule
@@ -390,7 +458,8 @@ class ZmatrixScanner
 		  
         /**
           Creates a molecule(s)  based on a starting unique ID and the pattern specified
-          by the Z-matrix in the scan functions
+          by the Z-matrix in the scan functions. The copies of all molecules share one
+          allocation per structure type (atoms, bonds, angles, dihedrals and hops).
           @param startingID - first ID for the molecule being built
           @return - vector of unique molecules that are copies of the molecules from the
           Z-matrix file.
@@ -404,6 +473,49 @@ class StateScanner
   private:
     std::string universal_filename;
 
+    /**
+      Opens the state file and reads past the version line, if there is one.
+      @param inFile - the stream to open, left at the environment line
+      @return - the format version, or 0 if the file could not be opened
+    */
+    int openState(ifstream &inFile);
+
+    /**
+      Reads the molecules of a version 1 file, in which every molecule
+      repeats its full topology. Molecules with the same topology and
+      parameters are given the same kind.
+    */
+    vector<Molecule> readInMoleculesV1(ifstream &inFile);
+
+    /**
+      Reads the molecules of a version 2 file, in which the topology of each
+      kind is written once and every molecule holds only its kind and
+      coordinates.
+    */
+    vector<Molecule> readInMoleculesV2(ifstream &inFile);
+
+    /**
+      Copies the parts of a molecule read from a file into newly allocated
+      arrays.
+      @param molecule - the molecule to fill in; its id and type are kept
+    */
+    void assignParts(Molecule &molecule, vector<Atom> &atoms, vector<Bond> &bonds, vector<Angle> &angles,
+                     vector<Dihedral> &dihedrals, vector<Hop> &hops);
+
+    /**
+      Reads topology lines up to and including the line starting with the
+      given terminator.
+      @return - the lines read
+    */
+    vector<string> readSection(ifstream &inFile, const char *terminator);
+
+    /**
+      @return - true if the two molecules have the same kind, atom
+        parameters and topology, with atoms numbered from the first atom of
+        each molecule
+    */
+    static bool sameKind(const Molecule &molecule1, const Molecule &molecule2);
+
   public:
     StateScanner(std::string filename);
     ~StateScanner();
@@ -500,12 +612,18 @@ class StateScanner
     */
 
     /**
+      Writes a state file in the compact format. The topology and atom
+      parameters of each molecule kind are written once, and every molecule
+      record holds only its id, kind, first atom id and atom coordinates.
       @param environment - the environment state
       @param molecules - array of molecules to be printed out
       @param numOfMolecules - the number of molecules to be written out
       @param fileName - the name of the file to be written
+      @param selection - the indices of the molecules to write, or NULL to
+        write them all. The header counts only the selected molecules.
     */
-    void outputState(Environment *environment, Molecule *molecules, int numOfMolecules, int step, string filename);
+    void outputState(Environment *environment, Molecule *molecules, int numOfMolecules, int step, string filename,
+                     const vector<int> *selection = NULL);
 };
 
 /**
@@ -519,11 +637,16 @@ class StateScanner
 *		is to be stored; can be modified as necessary for serial or parallel use later.
 * @param: startStep: 
 * @param: steps: 
+* @param: shareTopology: whether to attach to (or publish) the read-only topology arrays in
+*		POSIX shared memory, keyed by a hash of the precision, the OPLS and Z-matrix files
+*		and the molecule count.
+*		Only used when building from a configuration file.
 *
 * @returns: returns TRUE if completed successfully, or FALSE if there was a show-stopping error
 *		for which you should do halt the simulation
 */
-bool loadBoxData(string inputPath, InputFileType inputType, Box* box, long* startStep, long* steps);
+bool loadBoxData(string inputPath, InputFileType inputType, Box* box, long* startStep, long* steps,
+                 bool shareTopology = false);
 
 
 /*************************
@@ -535,11 +658,14 @@ bool loadBoxData(string inputPath, InputFileType inputType, Box* box, long* star
 * @param: enviro: the environment stored in the configuration file
 * @param: molecVec: the array of molecules, partly created from the Zmatrix file
 * @param: box: the box in which all the data is to be stored and the environment set up
+* @param: topologyKey: if not NULL, the input hash under which the molecules, atoms and
+*		topology arrays are published to shared memory once built
 *
 * @return: returns TRUE if completed successfully, or FALSE if there was a show-stopping error
 *		for which you should do halt the simulation
 */
-bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box);
+bool buildBoxData(Environment* enviro, vector<Molecule>& molecVec, Box* box,
+                  const unsigned long long* topologyKey = NULL);
 
 /*************************
 *	Uses data from a given state file to reconstruct a box/environment, as the box looked
@@ -24,14 +24,40 @@ using std::stringstream;
 */
 stringstream output;
 
+//threads that called seedThread draw from their own stream
+static __thread unsigned int *threadStream = NULL;
+
 void seed(int seed)
 {
 	srand(seed);
 }
 
+void seedThread(unsigned int *stream)
+{
+	threadStream = stream;
+}
+
 Real randomReal(const Real start, const Real end)
 {
-	return (end-start) * ((Real)rand() / RAND_MAX) + start;
+	int draw = threadStream != NULL ? rand_r(threadStream) : rand();
+	return (end-start) * ((Real)draw / RAND_MAX) + start;
+}
+
+void randomRotation(Real rotation[3][3])
+{
+	Real u1 = randomReal(0.0, 1.0), u2 = randomReal(0.0, 2 * PI), u3 = randomReal(0.0, 2 * PI);
+	Real w = sqrt(1 - u1) * sin(u2), x = sqrt(1 - u1) * cos(u2);
+	Real y = sqrt(u1) * sin(u3), z = sqrt(u1) * cos(u3);
+
+	rotation[0][0] = 1 - 2 * (y * y + z * z);
+	rotation[0][1] = 2 * (x * y - z * w);
+	rotation[0][2] = 2 * (x * z + y * w);
+	rotation[1][0] = 2 * (x * y + z * w);
+	rotation[1][1] = 1 - 2 * (x * x + z * z);
+	rotation[1][2] = 2 * (y * z - x * w);
+	rotation[2][0] = 2 * (x * z - y * w);
+	rotation[2][1] = 2 * (y * z + x * w);
+	rotation[2][2] = 1 - 2 * (x * x + y * y);
 }
 
 Point createPoint(double X, double Y, double Z)
@@ -375,38 +401,32 @@ double getAngle(Plane p1, Plane p2)
 
 Atom translateAtom(Atom atom, double x, double y, double z)
 {
-    atom.x += x;
-    atom.y += y;
-    atom.z += z;
-
+    translateCoordinates(&atom.x, &atom.y, &atom.z, 1, x, y, z);
     return atom;
 }
 
 Atom rotateAboutX(Atom atom, double theta)
 {
-    double thetaRadians = degreesToRadians(theta);
-    Atom returnAtom = atom;
-    returnAtom.y = atom.y * cos(thetaRadians) + atom.z * sin(thetaRadians);
-    returnAtom.z = atom.z * cos(thetaRadians) - atom.y * sin(thetaRadians);
-    return returnAtom;
+    double rotation[3][3];
+    rotationAboutX(theta, rotation);
+    rotateCoordinates(&atom.x, &atom.y, &atom.z, 1, rotation);
+    return atom;
 }
 
 Atom rotateAboutY(Atom atom, double theta)
 {
-    double thetaRadians = degreesToRadians(theta);
-    Atom returnAtom = atom;
-    returnAtom.z = atom.z * cos(thetaRadians) + atom.x * sin(thetaRadians);
-    returnAtom.x = atom.x * cos(thetaRadians) - atom.z * sin(thetaRadians);
-    return returnAtom; 
+    double rotation[3][3];
+    rotationAboutY(theta, rotation);
+    rotateCoordinates(&atom.x, &atom.y, &atom.z, 1, rotation);
+    return atom;
 }
 
 Atom rotateAboutZ(Atom atom, double theta)
 {
-    double thetaRadians = degreesToRadians(theta);
-    Atom returnAtom = atom;
-    returnAtom.x = atom.x * cos(thetaRadians) + atom.y * sin(thetaRadians);
-    returnAtom.y = atom.y * cos(thetaRadians) - atom.x * sin(thetaRadians);
-    return returnAtom;
+    double rotation[3][3];
+    rotationAboutZ(theta, rotation);
+    rotateCoordinates(&atom.x, &atom.y, &atom.z, 1, rotation);
+    return atom;
 }
 
 Atom rotateAtomInPlane(Atom atom1, Atom atom2, Atom atom3, double theta)
@@ -434,71 +454,124 @@ Atom rotateAtomInPlane(Atom atom1, Atom atom2, Atom atom3, double theta)
 
 Atom rotateAtomAboutVector(Atom atom1, Atom atom2, Atom atom3, double theta)
 {
-    theta *= -1;
+    double rotation[3][3];
+    rotationAboutVector(atom2, atom3, theta, rotation);
 
-    //Translate all atoms so that atom2 is at the origin.
-    //The rotation axis needs to pass through the origin
-    Atom originalAtom2 = atom2;
-    
-    atom1 = translateAtom(atom1, -originalAtom2.x, -originalAtom2.y, -originalAtom2.z);
-    atom2 = translateAtom(atom2, -originalAtom2.x, -originalAtom2.y, -originalAtom2.z);
-    atom3 = translateAtom(atom3, -originalAtom2.x, -originalAtom2.y, -originalAtom2.z);
+    //the rotation axis needs to pass through the origin
+    translateCoordinates(&atom1.x, &atom1.y, &atom1.z, 1, -atom2.x, -atom2.y, -atom2.z);
+    rotateCoordinates(&atom1.x, &atom1.y, &atom1.z, 1, rotation);
+    translateCoordinates(&atom1.x, &atom1.y, &atom1.z, 1, atom2.x, atom2.y, atom2.z);
 
-    //find the angle between the vector and xz plane
-    double xzAngle = 0.0; 
-    if(!inXZPlane(atom2) || !inXZPlane(atom3))
-    { 
-        // rotation axis not in xz plane
-        //determin if the rotation axis is vertical
-        Atom xzVector;
-        if(compareDoubleDifference(atom2.x, atom3.x, DOUBPREC) && compareDoubleDifference(atom2.z, atom3.z, DOUBPREC))
+    return atom1;
+}
+
+/**
+  Fills the matrix of a rotation about one coordinate axis. The other two
+  axes are indexed by first and second, and a positive angle moves the
+  second axis towards the first, as the scalar rotations do.
+*/
+static void rotationAboutAxis(double theta, int axis, int first, int second, double rotation[3][3])
+{
+    double thetaRadians = degreesToRadians(theta);
+    double cosine = cos(thetaRadians);
+    double sine = sin(thetaRadians);
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
         {
-            xzVector = createAtom(-1, atom3.x + 1, atom2.y, atom3.z);
+            rotation[i][j] = 0;
         }
-        else
-        {
-            xzVector = createAtom(-1, atom3.x, 0, atom3.z);
+    }
+    rotation[axis][axis] = 1;
+    rotation[first][first] = cosine;
+    rotation[first][second] = sine;
+    rotation[second][first] = -sine;
+    rotation[second][second] = cosine;
+}
 
-        }
-        xzAngle = getAngle(atom3, atom2, xzVector);  
-        
-        //rotate about z axis so that vector is parallel to xz plane
-        atom1 = rotateAboutZ(atom1, xzAngle);
-        //atom2 should not change because atom2 is at the origin
-        atom2 = rotateAboutZ(atom2, xzAngle);
-        atom3 = rotateAboutZ(atom3, xzAngle);
+void rotationAboutX(double theta, double rotation[3][3])
+{
+    rotationAboutAxis(theta, 0, 1, 2, rotation);
+}
+
+void rotationAboutY(double theta, double rotation[3][3])
+{
+    rotationAboutAxis(theta, 1, 2, 0, rotation);
+}
+
+void rotationAboutZ(double theta, double rotation[3][3])
+{
+    rotationAboutAxis(theta, 2, 0, 1, rotation);
+}
 
+void rotationAboutVector(Atom start, Atom end, double theta, double rotation[3][3])
+{
+    //a rotation of theta about a unit axis is the unit quaternion
+    //(cos(theta / 2), sin(theta / 2) * axis)
+    double axisX = end.x - start.x;
+    double axisY = end.y - start.y;
+    double axisZ = end.z - start.z;
+    double length = sqrt(axisX * axisX + axisY * axisY + axisZ * axisZ);
+    if (length == 0)
+    {
+        rotationFromQuaternion(1, 0, 0, 0, rotation);
+        return;
     }
-    //find the angle between the vector and the z axis
-    Atom zAxis = createAtom(-1, 0, 0, 1);
-    double zAngle = getAngle(atom3, atom2, zAxis);
-    
-    //rotate about y axis so that the vector is parallel to z axis
-    atom1 = rotateAboutY(atom1, zAngle);
-    atom2 = rotateAboutY(atom2, zAngle);
-    atom3 = rotateAboutY(atom3, zAngle);
-
-    //rotate atom1 theta about the z axis.
-    atom1 = rotateAboutZ(atom1, theta);
-
-    //invert rotation about y axis
-    atom1 = rotateAboutY(atom1, -zAngle);
-    atom2 = rotateAboutY(atom2, -zAngle);
-    atom3 = rotateAboutY(atom3, -zAngle);
-
-    //invert rotation about z axis
-    atom1 = rotateAboutZ(atom1, -xzAngle);
-    atom2 = rotateAboutZ(atom2, -xzAngle);
-    atom3 = rotateAboutZ(atom3, -xzAngle);
-    
-    //invert translation to origin
-    atom1 = translateAtom(atom1, originalAtom2.x, originalAtom2.y, atom3.z);
-    atom2 = translateAtom(atom2, originalAtom2.x, originalAtom2.y, atom3.z);
-    atom3 = translateAtom(atom3, originalAtom2.x, originalAtom2.y, atom3.z);
-    
-    //the inversions for atoms 2 and 3 are not neccesary b/c of copy by value.
 
-    return atom1;
+    double halfRadians = degreesToRadians(theta) / 2;
+    double sine = sin(halfRadians) / length;
+    rotationFromQuaternion(cos(halfRadians), sine * axisX, sine * axisY, sine * axisZ, rotation);
+}
+
+void rotationFromQuaternion(double w, double x, double y, double z, double rotation[3][3])
+{
+    double norm = w * w + x * x + y * y + z * z;
+    if (norm == 0)
+    {
+        rotationFromQuaternion(1, 0, 0, 0, rotation);
+        return;
+    }
+
+    //dividing by the squared norm normalizes every term at once
+    double s = 2 / norm;
+    rotation[0][0] = 1 - s * (y * y + z * z);
+    rotation[0][1] = s * (x * y - z * w);
+    rotation[0][2] = s * (x * z + y * w);
+    rotation[1][0] = s * (x * y + z * w);
+    rotation[1][1] = 1 - s * (x * x + z * z);
+    rotation[1][2] = s * (y * z - x * w);
+    rotation[2][0] = s * (x * z - y * w);
+    rotation[2][1] = s * (y * z + x * w);
+    rotation[2][2] = 1 - s * (x * x + y * y);
+}
+
+void translateCoordinates(Real *x, Real *y, Real *z, int count, double dx, double dy, double dz)
+{
+    #pragma omp simd
+    for (int i = 0; i < count; i++)
+    {
+        x[i] += dx;
+        y[i] += dy;
+        z[i] += dz;
+    }
+}
+
+void rotateCoordinates(Real *x, Real *y, Real *z, int count, const double rotation[3][3])
+{
+    //the matrix is held in locals, so it is not reloaded for every atom
+    const double r00 = rotation[0][0], r01 = rotation[0][1], r02 = rotation[0][2];
+    const double r10 = rotation[1][0], r11 = rotation[1][1], r12 = rotation[1][2];
+    const double r20 = rotation[2][0], r21 = rotation[2][1], r22 = rotation[2][2];
+
+    #pragma omp simd
+    for (int i = 0; i < count; i++)
+    {
+        double px = x[i], py = y[i], pz = z[i];
+        x[i] = r00 * px + r01 * py + r02 * pz;
+        y[i] = r10 * px + r11 * py + r12 * pz;
+        z[i] = r20 * px + r21 * py + r22 * pz;
+    }
 }
 
 bool compareDoubleDifference(double a, double b, double precision)
@@ -514,27 +587,54 @@ bool compareDoubleDifference(double a, double b, double precision)
     }
 }
 
+/**
+  Translates and rotates the atoms of a molecule in a single pass. The
+  rotations about the pivot are applied one after the other rather than as
+  their product, and every stage is rounded to Real, so each atom ends up
+  exactly where the scalar functions would put it.
+  @param rotation - the rotation matrices, applied in order.
+  @param rotations - the number of rotation matrices; zero only translates.
+*/
+static void transformMolecule(Molecule &molec, Atom pivot, double rotation[][3][3], int rotations,
+        double xTrans, double yTrans, double zTrans)
+{
+    Atom *atoms = molec.atoms;
+    for (int i = 0; i < molec.numOfAtoms; i++)
+    {
+        Real x = atoms[i].x, y = atoms[i].y, z = atoms[i].z;
+        if (rotations > 0)
+        {
+            //translate to the origin, rotate, and translate back
+            x += -pivot.x;
+            y += -pivot.y;
+            z += -pivot.z;
+            for (int r = 0; r < rotations; r++)
+            {
+                const double (*m)[3] = rotation[r];
+                double px = x, py = y, pz = z;
+                x = m[0][0] * px + m[0][1] * py + m[0][2] * pz;
+                y = m[1][0] * px + m[1][1] * py + m[1][2] * pz;
+                z = m[2][0] * px + m[2][1] * py + m[2][2] * pz;
+            }
+            x += pivot.x;
+            y += pivot.y;
+            z += pivot.z;
+        }
+        atoms[i].x = x + xTrans;
+        atoms[i].y = y + yTrans;
+        atoms[i].z = z + zTrans;
+    }
+}
+
 Molecule moveMolecule(Molecule molec, Atom pivot, double xTrans, double yTrans,
         double zTrans, double xRot, double yRot, double zRot)
 {
-    
-    for(int i = 0; i < molec.numOfAtoms; i++)
-    {
-        //translate molecule to the origin to rotate
-        molec.atoms[i] = translateAtom(molec.atoms[i], -pivot.x, -pivot.y, -pivot.z);
-        //rotateAboutX
-        molec.atoms[i] = rotateAboutX(molec.atoms[i], xRot);
-        //rotateAboutY
-        molec.atoms[i] = rotateAboutY(molec.atoms[i], yRot);
-        //rotateAboutZ
-        molec.atoms[i] = rotateAboutZ(molec.atoms[i], zRot);
-        //translate to original position
-        molec.atoms[i] = translateAtom(molec.atoms[i], pivot.x, pivot.y, pivot.z);
-
-        //translate atom to final position
-        molec.atoms[i] = translateAtom(molec.atoms[i], xTrans, yTrans, zTrans);
-    }
-    
+    double rotation[3][3][3];
+    rotationAboutX(xRot, rotation[0]);
+    rotationAboutY(yRot, rotation[1]);
+    rotationAboutZ(zRot, rotation[2]);
+
+    transformMolecule(molec, pivot, rotation, 3, xTrans, yTrans, zTrans);
     return molec;
 }
 
@@ -549,10 +649,7 @@ Molecule translateMolecule(Molecule molec, double maxTranslation)
 	const double yTrans = randomNUM(-maxTranslation, maxTranslation);
 	const double zTrans = randomNUM(-maxTranslation, maxTranslation);
 	
-    for(int i = 0; i < molec.numOfAtoms; i++)
-    {
-    	molec.atoms[i] = translateAtom(molec.atoms[i], xTrans, yTrans, zTrans);
-    }  
+    transformMolecule(molec, Atom(), NULL, 0, xTrans, yTrans, zTrans);
     return molec;
 }
 
@@ -562,19 +659,12 @@ Molecule rotateMolec(Molecule molec, Atom pivot, double maxRotation)
 	const double yRot = randomNUM(-maxRotation, maxRotation);
 	const double zRot = randomNUM(-maxRotation, maxRotation);
     
-    for(int i = 0; i < molec.numOfAtoms; i++)
-    {
-        //translate molecule to the origin to rotate
-        molec.atoms[i] = translateAtom(molec.atoms[i], -pivot.x, -pivot.y, -pivot.z);
-        //rotateAboutX
-        molec.atoms[i] = rotateAboutX(molec.atoms[i], xRot);
-        //rotateAboutY
-        molec.atoms[i] = rotateAboutY(molec.atoms[i], yRot);
-        //rotateAboutZ
-        molec.atoms[i] = rotateAboutZ(molec.atoms[i], zRot);
-        //translate to original position
-        molec.atoms[i] = translateAtom(molec.atoms[i], pivot.x, pivot.y, pivot.z);
-    }
+    double rotation[3][3][3];
+    rotationAboutX(xRot, rotation[0]);
+    rotationAboutY(yRot, rotation[1]);
+    rotationAboutZ(zRot, rotation[2]);
+
+    transformMolecule(molec, pivot, rotation, 3, 0, 0, 0);
     return molec;
 }
 
@@ -848,137 +938,166 @@ void buildMoleculeInSpace(Molecule *molec, int numBonded)
 
 void buildMoleculeXYZ(Molecule *molec, int numBonded)
 {
-    vector<Molecule> retVector;
-    vector<Atom> atomVector;
-    vector<Bond> bondVector;
-    vector<Angle> angleVector;
-    vector<Dihedral> dihedralVector;
-    vector<unsigned long> dummies;
-	
-	Atom lineAtom;
-	
-	//run a build on each molecule in zmatrix
-	for(int m=0; m<numBonded; m++)
-    {
-	 	//run build on atom 1 in the molecule
-	 	lineAtom = molec[m].atoms[0];
-	 	//set the vectors with appropiate contents as if in Zmatrix 
-		setMoleculeVectors(molec, numBonded, lineAtom.id, bondVector, angleVector, dihedralVector);
-		
-		// First atom at (0,0,0)
-		molec[m].atoms[0].x = 0.0;
-		molec[m].atoms[0].y = 0.0;
-		molec[m].atoms[0].z = 0.0;
-	
-		//run build on atom 2 in the molecule
-		lineAtom = molec[m].atoms[1];		  
-		setMoleculeVectors(molec, numBonded, lineAtom.id, bondVector, angleVector, dihedralVector);
-	
-		int bondFound = hasBond(bondVector,lineAtom.id);
-		if(bondFound >= 0)
-        {
-			Bond lineBond =  bondVector[bondFound];
-	
-			// Second atom on x-axis
-			molec[m].atoms[1].x = lineBond.distance;
-			molec[m].atoms[1].y = 0.0;
-			molec[m].atoms[1].z = 0.0;
+	//Index every atom by its z-matrix id, along with the first bond, angle and
+	//dihedral that defines it (the entry whose atom1 is the atom itself), so that
+	//each atom is placed with constant time lookups in a single pass.
+	int maxId = 0;
+	for (int m = 0; m < numBonded; m++)
+	{
+		for (int a = 0; a < molec[m].numOfAtoms; a++)
+		{
+			maxId = std::max(maxId, (int) molec[m].atoms[a].id);
 		}
-		else
-        {
-			break;
-        }
-		
-		//run build on atom 3 in the molecule
-		lineAtom = molec[m].atoms[2];
-		setMoleculeVectors(molec, numBonded, lineAtom.id, bondVector, angleVector, dihedralVector);
-	
-		int angleFound = hasAngle(angleVector,lineAtom.id);
-		if(angleFound >=0 )
-        {
-			int bondFound = hasBond(bondVector,lineAtom.id);
-			Bond lineBond =  bondVector[bondFound];
-			Angle lineAngle = angleVector[angleFound];
-			unsigned long BondedTo = getOppositeAtom(lineBond, lineAtom.id);
-			double thetaRadians = degreesToRadians(lineAngle.value);
-			
-			// Third atom in XY plane
-			if(BondedTo == 1)
-            {
-				molec[m].atoms[2].x = lineBond.distance * cos(thetaRadians);
-            }
-			else if(BondedTo == 2)
-            {
-				molec[m].atoms[2].x = molec[m].atoms[1].x - lineBond.distance * cos(thetaRadians);
+	}
+
+	vector<Atom*> atomById(maxId + 1, (Atom*) NULL);
+	vector<Bond*> bondById(maxId + 1, (Bond*) NULL);
+	vector<Angle*> angleById(maxId + 1, (Angle*) NULL);
+	vector<Dihedral*> dihedralById(maxId + 1, (Dihedral*) NULL);
+
+	for (int m = 0; m < numBonded; m++)
+	{
+		for (int a = 0; a < molec[m].numOfAtoms; a++)
+		{
+			atomById[molec[m].atoms[a].id] = &molec[m].atoms[a];
+		}
+		for (int x = 0; x < molec[m].numOfBonds; x++)
+		{
+			int id = molec[m].bonds[x].atom1;
+			if (id >= 0 && id <= maxId && bondById[id] == NULL)
+			{
+				bondById[id] = &molec[m].bonds[x];
 			}
-			molec[m].atoms[2].y = lineBond.distance * sin(thetaRadians);
-			molec[m].atoms[2].z = 0.0;
 		}
-		else
-        {
-			break;
-        }
-		
-		//check if atom 4 exists
-		if(molec[m].numOfAtoms < 4)
-        {
-			break;
-        }
-		
-		//run build on atoms 4 and above in the molecule
-		double xbs, ybs, zbs, sinval;
-		double ia[3], ib[3], ic[3];
-		double vecangdih[3],vecangbnd[3];
-		double vx[3], vy[3], vz[3];
-		
-		for(int N = 3; N < molec[m].numOfAtoms; N++)
-        {
-			lineAtom = molec[m].atoms[N];
-			setMoleculeVectors(molec, numBonded, lineAtom.id, bondVector, angleVector, dihedralVector);
-			int bondFound = hasBond(bondVector,lineAtom.id);
-			Bond lineBond =  bondVector[bondFound];
-			int angleFound = hasAngle(angleVector,lineAtom.id);
-			Angle lineAngle = angleVector[angleFound];
-			double thetaRadians = degreesToRadians(lineAngle.value);
+		for (int x = 0; x < molec[m].numOfAngles; x++)
+		{
+			int id = molec[m].angles[x].atom1;
+			if (id >= 0 && id <= maxId && angleById[id] == NULL)
+			{
+				angleById[id] = &molec[m].angles[x];
+			}
+		}
+		for (int x = 0; x < molec[m].numOfDihedrals; x++)
+		{
+			int id = molec[m].dihedrals[x].atom1;
+			if (id >= 0 && id <= maxId && dihedralById[id] == NULL)
+			{
+				dihedralById[id] = &molec[m].dihedrals[x];
+			}
+		}
+	}
+
+	double xbs, ybs, zbs, sinval;
+	double ia[3], ib[3], ic[3];
+	double vecangdih[3],vecangbnd[3];
+	double vx[3], vy[3], vz[3];
+
+	//run a build on each molecule in zmatrix
+	for (int m = 0; m < numBonded; m++)
+	{
+		for (int N = 0; N < molec[m].numOfAtoms; N++)
+		{
+			Atom &lineAtom = molec[m].atoms[N];
+			Bond *lineBond = bondById[lineAtom.id];
+			Angle *lineAngle = angleById[lineAtom.id];
+			Dihedral *lineDihedral = dihedralById[lineAtom.id];
+
+			bool fullyDefined = lineBond != NULL && lineAngle != NULL && lineDihedral != NULL;
+			if (N == 0 && !fullyDefined)
+			{
+				// First atom at (0,0,0)
+				lineAtom.x = 0.0;
+				lineAtom.y = 0.0;
+				lineAtom.z = 0.0;
+				continue;
+			}
+			else if (N == 1 && !fullyDefined)
+			{
+				if (lineBond == NULL)
+				{
+					return;
+				}
+
+				// Second atom on x-axis
+				lineAtom.x = lineBond->distance;
+				lineAtom.y = 0.0;
+				lineAtom.z = 0.0;
+				continue;
+			}
+			else if (N == 2 && !fullyDefined)
+			{
+				if (lineBond == NULL || lineAngle == NULL)
+				{
+					return;
+				}
+
+				unsigned long BondedTo = getOppositeAtom(*lineBond, lineAtom.id);
+				double thetaRadians = degreesToRadians(lineAngle->value);
+
+				// Third atom in XY plane
+				if (BondedTo == 1)
+				{
+					lineAtom.x = lineBond->distance * cos(thetaRadians);
+				}
+				else if (BondedTo == 2)
+				{
+					lineAtom.x = molec[m].atoms[1].x - lineBond->distance * cos(thetaRadians);
+				}
+				lineAtom.y = lineBond->distance * sin(thetaRadians);
+				lineAtom.z = 0.0;
+				continue;
+			}
+			else if (!fullyDefined)
+			{
+				//atoms past the third need a bond, angle and dihedral to be placed
+				continue;
+			}
+
+			unsigned long BondedTo = getOppositeAtom(*lineBond, lineAtom.id);
+			unsigned long AngleWith = getOppositeAtom(*lineAngle, lineAtom.id);
+			unsigned long DihedralWith = getOppositeAtom(*lineDihedral, lineAtom.id);
+			if (BondedTo > (unsigned long) maxId || AngleWith > (unsigned long) maxId ||
+				DihedralWith > (unsigned long) maxId || atomById[BondedTo] == NULL ||
+				atomById[AngleWith] == NULL || atomById[DihedralWith] == NULL)
+			{
+				continue;
+			}
+
+			double thetaRadians = degreesToRadians(lineAngle->value);
 			// Dihedral angle is defined counterclockwise
-			int dihedralFound = hasDihedral(dihedralVector,lineAtom.id);
-			Dihedral lineDihedral = dihedralVector[dihedralFound];
-			double phiRadians = degreesToRadians(lineDihedral.value);
-			
+			double phiRadians = degreesToRadians(lineDihedral->value);
+
 			// x|y|z in the local system
 			// xbs = bndlgth * sin(ang) * cos(dih)
 			// ybs = bndlgth * sin(ang) * sin(dih)
 			// zbs = -bndlgth * cos(ang)
 
 			sinval = sin(thetaRadians);
-			xbs = lineBond.distance * sinval * cos(phiRadians);
-			ybs = lineBond.distance * sinval * sin(phiRadians);
-			zbs = -lineBond.distance * cos(thetaRadians);
-			
+			xbs = lineBond->distance * sinval * cos(phiRadians);
+			ybs = lineBond->distance * sinval * sin(phiRadians);
+			zbs = -lineBond->distance * cos(thetaRadians);
+
 			// Determine transformation (direction cosine) matrix
-			unsigned long BondedTo = getOppositeAtom(lineBond, lineAtom.id);
-			unsigned long AngleWith = getOppositeAtom(lineAngle, lineAtom.id);
-			unsigned long DihedralWith = getOppositeAtom(lineDihedral, lineAtom.id);
-			ia[0] = molec[m].atoms[DihedralWith - 1].x;
-			ia[1] = molec[m].atoms[DihedralWith - 1].y;
-			ia[2] = molec[m].atoms[DihedralWith - 1].z;
-			ib[0] = molec[m].atoms[AngleWith - 1].x;
-			ib[1] = molec[m].atoms[AngleWith - 1].y;
-			ib[2] = molec[m].atoms[AngleWith - 1].z;
-			ic[0] = molec[m].atoms[BondedTo - 1].x;
-			ic[1] = molec[m].atoms[BondedTo - 1].y;
-			ic[2] = molec[m].atoms[BondedTo - 1].z;
-			
+			ia[0] = atomById[DihedralWith]->x;
+			ia[1] = atomById[DihedralWith]->y;
+			ia[2] = atomById[DihedralWith]->z;
+			ib[0] = atomById[AngleWith]->x;
+			ib[1] = atomById[AngleWith]->y;
+			ib[2] = atomById[AngleWith]->z;
+			ic[0] = atomById[BondedTo]->x;
+			ic[1] = atomById[BondedTo]->y;
+			ic[2] = atomById[BondedTo]->z;
+
 			for(int i = 0; i < 3; i++)
-            {
+			{
 				vecangdih[i] = ia[i] - ic[i];
 				vecangbnd[i] = ib[i] - ic[i];
-    		}
-    		
+			}
+
 			cross(vecangdih,vecangbnd,vy);
 			cross(vecangbnd,vy,vx);
 			cross(vx,vy,vz);
-    		
+
 			//Map the coordinates in this basis set to our cartesian coordinates
 			//     x = xbs*vx(0) + ybs*vy(0) + zbs*vz(0)
 			//     y = xbs*vx(1) + ybs*vy(1) + zbs*vz(1)
@@ -987,11 +1106,11 @@ void buildMoleculeXYZ(Molecule *molec, int numBonded)
 			//These coordinates are based at the origin - they need to be based from 
 			//the coordinates of the bond atom e.g.
 			// x += xbnd     y+= ybnd   z+= zbnd
-			
-			molec[m].atoms[N].x = vx[0]*xbs + vy[0]*ybs + vz[0]*zbs + ic[0];
-			molec[m].atoms[N].y = vx[1]*xbs + vy[1]*ybs + vz[1]*zbs + ic[1];
-			molec[m].atoms[N].z = vx[2]*xbs + vy[2]*ybs + vz[2]*zbs + ic[2];
-		} //End for dihedral atoms loop
+
+			lineAtom.x = vx[0]*xbs + vy[0]*ybs + vz[0]*zbs + ic[0];
+			lineAtom.y = vx[1]*xbs + vy[1]*ybs + vz[1]*zbs + ic[1];
+			lineAtom.z = vx[2]*xbs + vy[2]*ybs + vz[2]*zbs + ic[2];
+		} //End for atoms loop
 	} //End for molecules loop
 }
 
@@ -51,8 +51,24 @@ using std::map;
 #define PI 3.14159265
 
 void seed(int seed);
+
+/**
+  Gives the calling thread its own random number stream, so threads that
+  draw concurrently neither share nor race on the stream set by seed().
+  @param stream - the state of the stream, seeded by the caller; it is
+    advanced in place, so a later thread can pick up where this one stopped
+*/
+void seedThread(unsigned int *stream);
+
 Real randomReal(const Real start, const Real end);
 
+/**
+  Draws a rotation uniformly over all orientations, from a random unit
+  quaternion.
+  @param rotation - filled with the rotation matrix
+*/
+void randomRotation(Real rotation[3][3]);
+
 /**
   Structure representing a geometic point.
 */
@@ -354,6 +370,68 @@ Atom rotateAtomInPlane(Atom atom1, Atom atom2, Atom atom3, double theta);
 */
 Atom rotateAtomAboutVector(Atom atom1, Atom atom2, Atom atom3, double theta);
 
+/**
+  Fills a rotation matrix, so that a batch of coordinates can be rotated
+  without recomputing sines and cosines for every atom.
+  @param theta - the distance in degrees to be rotated.
+  @param rotation - filled with the matrix that rotates theta degrees about
+  the x axis, in the same sense as rotateAboutX.
+*/
+void rotationAboutX(double theta, double rotation[3][3]);
+
+/**
+  @param theta - the distance in degrees to be rotated.
+  @param rotation - filled with the matrix that rotates theta degrees about
+  the y axis, in the same sense as rotateAboutY.
+*/
+void rotationAboutY(double theta, double rotation[3][3]);
+
+/**
+  @param theta - the distance in degrees to be rotated.
+  @param rotation - filled with the matrix that rotates theta degrees about
+  the z axis, in the same sense as rotateAboutZ.
+*/
+void rotationAboutZ(double theta, double rotation[3][3]);
+
+/**
+  @param start - the atom defining the start point of the vector.
+  @param end - the atom defining the end point of the vector.
+  @param theta - number of degrees to rotate
+  @param rotation - filled with the matrix that rotates theta degrees about
+  the direction from start to end, in the same sense as
+  rotateAtomAboutVector. The rotation is about the origin, so coordinates
+  are translated by -start before and by start after it. Coincident atoms
+  give the identity.
+*/
+void rotationAboutVector(Atom start, Atom end, double theta, double rotation[3][3]);
+
+/**
+  @param w, x, y, z - the components of a quaternion; it is normalized
+  first, and the zero quaternion gives the identity.
+  @param rotation - filled with the matrix of the rotation the quaternion
+  represents.
+*/
+void rotationFromQuaternion(double w, double x, double y, double z, double rotation[3][3]);
+
+/**
+  Translates a batch of coordinates held as separate x, y and z arrays.
+  Each coordinate is rounded to Real as translateAtom rounds it.
+  @param x, y, z - the coordinate arrays, each of length count.
+  @param count - the number of coordinates.
+  @param dx, dy, dz - the distances to be translated along each axis.
+*/
+void translateCoordinates(Real *x, Real *y, Real *z, int count, double dx, double dy, double dz);
+
+/**
+  Rotates a batch of coordinates held as separate x, y and z arrays about
+  the origin, with a matrix from one of the rotation functions above. The
+  loop has no dependencies between atoms, so it is vectorized.
+  @param x, y, z - the coordinate arrays, each of length count.
+  @param count - the number of coordinates.
+  @param rotation - the rotation matrix.
+*/
+void rotateCoordinates(Real *x, Real *y, Real *z, int count, const double rotation[3][3]);
+
 /**
   @param a - the first double to compare.
   @param b - the second double to compare.
@@ -465,7 +543,9 @@ void buildMoleculeInSpace(Molecule *molec,int numBonded=1);
 /**
   Converts z-matrix to Cartesian coordinates.
   Calculates and sets the Atom positions in a Molecule based on the atom to atom relationships
-  defined in the Bond, Angle, and Dihedral structures. 
+  defined in the Bond, Angle, and Dihedral structures. Atoms are looked up by their z-matrix
+  id, so atoms of later molecules may be defined relative to atoms of earlier ones, and each
+  atom is placed once in a single pass over the molecules.
   @param *molec - an array of bonded molecules to be set
   @param numBounded - the number of bonded molecules being passed in
 */
@@ -0,0 +1,298 @@
+#include "ResultCache.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "FileUtilities.h"
+#include "SharedTopology.h"
+
+/**
+  Copies a file byte for byte.
+  @return - true if the whole file was copied
+*/
+static bool copyFile(const std::string &from, const std::string &to)
+{
+	std::ifstream source(from.c_str(), std::ios::binary);
+	if (!source.is_open())
+		return false;
+
+	std::ofstream target(to.c_str(), std::ios::binary | std::ios::trunc);
+	if (!target.is_open())
+		return false;
+
+	target << source.rdbuf();
+	return !target.fail();
+}
+
+/**
+  Copies a file into the cache under a temporary name, then renames it into
+  place.
+*/
+static bool publishFile(const std::string &from, const std::string &to)
+{
+	std::ostringstream temporary;
+	temporary << to << ".tmp." << getpid();
+	if (!copyFile(from, temporary.str()))
+	{
+		remove(temporary.str().c_str());
+		return false;
+	}
+	return rename(temporary.str().c_str(), to.c_str()) == 0;
+}
+
+static bool fileExists(const std::string &path)
+{
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+/**
+  Hashes one field of a parsed input. Fields are hashed one by one, so
+  struct padding and pointers never reach the key.
+*/
+template <typename T>
+static void hashField(const T &value, unsigned long long &key)
+{
+	hashBytes(&value, sizeof(value), key);
+}
+
+/**
+  Hashes the physical settings of an environment: the box, cutoff,
+  temperature, move sizes, molecule count, primary atom and seed.
+*/
+static void hashEnvironment(const Environment &enviro, unsigned long long &key)
+{
+	hashField(enviro.x, key);
+	hashField(enviro.y, key);
+	hashField(enviro.z, key);
+	hashField(enviro.cutoff, key);
+	hashField(enviro.temp, key);
+	hashField(enviro.maxTranslation, key);
+	hashField(enviro.maxRotation, key);
+	hashField(enviro.numOfMolecules, key);
+	hashField(enviro.primaryAtomIndex, key);
+	hashField(enviro.randomseed, key);
+}
+
+/**
+  Hashes the kind, atoms and topology of every molecule of a state.
+*/
+static void hashMolecules(const std::vector<Molecule> &molecules, unsigned long long &key)
+{
+	for (int i = 0; i < molecules.size(); i++)
+	{
+		const Molecule &molecule = molecules[i];
+		hashField(molecule.type, key);
+		hashField(molecule.numOfAtoms, key);
+		for (int a = 0; a < molecule.numOfAtoms; a++)
+		{
+			const Atom &atom = molecule.atoms[a];
+			hashField(atom.name, key);
+			hashField(atom.id, key);
+			hashField(atom.x, key);
+			hashField(atom.y, key);
+			hashField(atom.z, key);
+			hashField(atom.sigma, key);
+			hashField(atom.epsilon, key);
+			hashField(atom.charge, key);
+		}
+		hashField(molecule.numOfBonds, key);
+		for (int b = 0; b < molecule.numOfBonds; b++)
+		{
+			hashField(molecule.bonds[b].atom1, key);
+			hashField(molecule.bonds[b].atom2, key);
+			hashField(molecule.bonds[b].distance, key);
+			hashField(molecule.bonds[b].variable, key);
+		}
+		hashField(molecule.numOfAngles, key);
+		for (int b = 0; b < molecule.numOfAngles; b++)
+		{
+			hashField(molecule.angles[b].atom1, key);
+			hashField(molecule.angles[b].atom2, key);
+			hashField(molecule.angles[b].value, key);
+			hashField(molecule.angles[b].variable, key);
+		}
+		hashField(molecule.numOfDihedrals, key);
+		for (int b = 0; b < molecule.numOfDihedrals; b++)
+		{
+			hashField(molecule.dihedrals[b].atom1, key);
+			hashField(molecule.dihedrals[b].atom2, key);
+			hashField(molecule.dihedrals[b].value, key);
+			hashField(molecule.dihedrals[b].variable, key);
+		}
+		hashField(molecule.numOfHops, key);
+		for (int b = 0; b < molecule.numOfHops; b++)
+		{
+			hashField(molecule.hops[b].atom1, key);
+			hashField(molecule.hops[b].atom2, key);
+			hashField(molecule.hops[b].hop, key);
+		}
+	}
+}
+
+ResultCache::ResultCache(const std::string &directory)
+{
+	this->directory = directory;
+	key = FNV_OFFSET_BASIS;
+	startStep = 0;
+	steps = 0;
+	resumeSteps = 0;
+	resumable = false;
+}
+
+bool ResultCache::identify(const SimulationArgs &args)
+{
+	key = FNV_OFFSET_BASIS;
+	int realSize = sizeof(Real);
+	hashBytes(&realSize, sizeof(realSize), key);
+
+	if (args.fileType == InputFile::Configuration)
+	{
+		ConfigScanner config_scanner = ConfigScanner();
+		if (!config_scanner.readInConfig(args.filePath))
+			return false;
+		//the parsed settings rather than the file, so comments, the step
+		//count and the output paths do not split the chain
+		hashEnvironment(*config_scanner.getEnviro(), key);
+		if (!hashFile(config_scanner.getOplsusaparPath(), key) ||
+			!hashFile(config_scanner.getZmatrixPath(), key))
+			return false;
+		startStep = 0;
+		steps = config_scanner.getSteps();
+	}
+	else
+	{
+		//the parsed environment and molecules, leaving out the step line
+		StateScanner state_scanner = StateScanner(args.filePath);
+		Environment *enviro = state_scanner.readInEnvironment();
+		if (enviro == NULL)
+			return false;
+		hashEnvironment(*enviro, key);
+		delete enviro;
+		std::vector<Molecule> molecules = state_scanner.readInMolecules();
+		if (molecules.empty())
+			return false;
+		hashMolecules(molecules, key);
+		startStep = state_scanner.readInStepNumber();
+		steps = DEFAULT_STEP_COUNT;
+	}
+	if (args.stepCount > 0)
+		steps = args.stepCount;
+
+	//every setting that can change the results file or the final state;
+	//names, intervals and output locations are left out
+	std::ostringstream settings;
+	settings << "mode=" << args.simulationMode << ";threads=" << args.threadCount
+		<< ";shadow=" << args.shadowEngine << "," << args.shadowInterval << "," << args.shadowTolerance
+		<< ";hard-core=" << args.hardCoreFraction << ";kinds=";
+	for (int i = 0; i < args.outputKinds.size(); i++)
+		settings << args.outputKinds[i] << ",";
+	settings << ";region=" << args.outputRegionMolecule << "," << args.outputRegionExtent << ","
+		<< args.outputRegionCube << ";stride=" << args.outputStride
+		<< ";neighbor-skin=" << args.neighborSkin << ";multipole-radius=" << args.multipoleRadius
+		<< ";mixed-precision=" << args.mixedPrecision << ";non-periodic=" << args.nonPeriodic
+		<< ";adaptive=" << args.adaptiveSolute << "," << args.adaptiveRadius << "," << args.hybridWidth
+		<< ";random-batch-ewald=" << args.randomBatchEwald << ";pair-statistics=" << args.pairStatistics
+		<< ";cutoff-scan=";
+	for (int i = 0; i < args.cutoffScan.size(); i++)
+		settings << args.cutoffScan[i] << ",";
+	std::string text = settings.str();
+	hashBytes(text.data(), text.size(), key);
+
+	resumable = args.outputKinds.empty() && args.outputRegionMolecule < 0;
+	return true;
+}
+
+long ResultCache::getStartStep() const
+{
+	return startStep;
+}
+
+long ResultCache::getSteps() const
+{
+	return steps;
+}
+
+void ResultCache::resumeFrom(long checkpointSteps)
+{
+	resumeSteps = checkpointSteps;
+}
+
+bool ResultCache::restore(const std::string &resultsPath, const std::string &statePath) const
+{
+	std::string cachedResults = runPath(".results");
+	if (!fileExists(cachedResults) || !copyFile(cachedResults, resultsPath))
+		return false;
+
+	std::string cachedState = runPath(".state");
+	if (fileExists(cachedState) && !copyFile(cachedState, statePath))
+		std::cerr << "Warning: Could not restore cached state file " << cachedState << std::endl;
+	return true;
+}
+
+long ResultCache::findCheckpoint(std::string &checkpointPath) const
+{
+	if (!resumable)
+		return 0;
+
+	DIR *entries = opendir(entryDirectory().c_str());
+	if (entries == NULL)
+		return 0;
+
+	long best = 0;
+	struct dirent *entry;
+	while ((entry = readdir(entries)) != NULL)
+	{
+		//only the final states of fresh runs, named <steps>.state; resumed
+		//runs are named <checkpoint>+<steps>.state
+		char *end;
+		long entrySteps = strtol(entry->d_name, &end, 10);
+		if (end != entry->d_name && std::string(end) == ".state" && entrySteps > best && entrySteps < steps)
+			best = entrySteps;
+	}
+	closedir(entries);
+
+	if (best > 0)
+		checkpointPath = entryPath(best, ".state");
+	return best;
+}
+
+bool ResultCache::store(const std::string &resultsPath, const std::string &statePath) const
+{
+	mkdir(directory.c_str(), 0777);
+	mkdir(entryDirectory().c_str(), 0777);
+
+	if (!statePath.empty() && fileExists(statePath))
+		publishFile(statePath, runPath(".state"));
+	return publishFile(resultsPath, runPath(".results"));
+}
+
+std::string ResultCache::entryDirectory() const
+{
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", key);
+	return directory + "/" + name;
+}
+
+std::string ResultCache::entryPath(long entrySteps, const char *extension) const
+{
+	std::ostringstream path;
+	path << entryDirectory() << "/" << entrySteps << extension;
+	return path.str();
+}
+
+std::string ResultCache::runPath(const char *extension) const
+{
+	if (resumeSteps == 0)
+		return entryPath(steps, extension);
+
+	std::ostringstream path;
+	path << entryDirectory() << "/" << resumeSteps << "+" << steps - resumeSteps << extension;
+	return path.str();
+}
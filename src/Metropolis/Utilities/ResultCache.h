@@ -0,0 +1,114 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <string>
+#include "Metropolis/SimulationArgs.h"
+
+/**
+  An opt-in, content-addressed store of finished runs. A run is keyed by a
+  hash of its parsed physical inputs (the environment, the force field and
+  z-matrix files, or the molecules of a state), the precision of the build
+  and every setting that can change its output. The step count, names,
+  comments and output paths are kept out of the key, so all lengths of the
+  same chain share one entry directory:
+
+    <cache directory>/<key>/<steps>.results
+    <cache directory>/<key>/<steps>.state
+
+  A run with a cached results file of the same length is not run again, and
+  a longer run resumes from the longest cached checkpoint of its chain.
+  Resuming reseeds the random stream, so a resumed run follows a different
+  chain from a fresh run of the same length. It is stored under the name of
+  its resume point instead, and is never used as a checkpoint:
+
+    <cache directory>/<key>/<checkpoint steps>+<further steps>.results
+    <cache directory>/<key>/<checkpoint steps>+<further steps>.state
+*/
+class ResultCache
+{
+	public:
+		/**
+		  @param directory - the cache directory, created on the first store
+		*/
+		ResultCache(const std::string &directory);
+
+		/**
+		  Hashes the inputs and settings of a run and works out its length.
+		  @param args - the arguments of the run
+		  @return - false if an input file could not be read
+		*/
+		bool identify(const SimulationArgs &args);
+
+		/**
+		  @return - the step of the input the run starts from
+		*/
+		long getStartStep() const;
+
+		/**
+		  @return - the number of steps the run makes
+		*/
+		long getSteps() const;
+
+		/**
+		  Makes the run continue from a checkpoint, so it is restored from
+		  and stored under the entry of the resumed chain.
+		  @param checkpointSteps - the steps made by the checkpoint
+		*/
+		void resumeFrom(long checkpointSteps);
+
+		/**
+		  Copies a cached run to the locations a fresh run would write.
+		  @param resultsPath - where the results file goes
+		  @param statePath - where the final state file goes, if one is cached
+		  @return - true if the run was cached
+		*/
+		bool restore(const std::string &resultsPath, const std::string &statePath) const;
+
+		/**
+		  Finds the longest cached checkpoint of the same chain that is
+		  shorter than the run. Only the states of fresh runs qualify.
+		  @param checkpointPath - set to the cached state file
+		  @return - the steps made by the checkpoint, or 0 if there is none
+		*/
+		long findCheckpoint(std::string &checkpointPath) const;
+
+		/**
+		  Copies the output of a finished run into the cache. Files are
+		  written under temporary names and renamed, so concurrent runs never
+		  see a partial entry.
+		  @param resultsPath - the results file of the run
+		  @param statePath - the final state file of the run, or an empty
+		    string if none was saved
+		  @return - true if the results were stored
+		*/
+		bool store(const std::string &resultsPath, const std::string &statePath) const;
+
+	private:
+		std::string directory;
+		unsigned long long key;
+		long startStep;
+		long steps;
+
+		/**
+		  The steps made by the checkpoint the run resumes from, or 0 for a
+		  fresh run.
+		*/
+		long resumeSteps;
+
+		/**
+		  Whether the state files of the run hold every molecule, so that
+		  they can be resumed from.
+		*/
+		bool resumable;
+
+		std::string entryDirectory() const;
+		std::string entryPath(long entrySteps, const char *extension) const;
+
+		/**
+		  @return - the path of the run's own entry, which names the resume
+		    point of a resumed run
+		*/
+		std::string runPath(const char *extension) const;
+};
+
+#endif
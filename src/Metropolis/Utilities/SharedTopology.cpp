@@ -0,0 +1,424 @@
+#include "SharedTopology.h"
+
+#include <iostream>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+  Leads every shared topology segment, alone in its first page so that it
+  stays writable while the arrays are protected. The arrays follow the
+  header page in the order molecules, atoms, bonds, angles, dihedrals, hops,
+  each starting on an 8 byte boundary. The molecules and atoms are those of the box before
+  the lattice is laid out, with the molecules' array pointers cleared; the
+  molecules are contiguous and in order, so attaching processes rebuild the
+  pointers from the counts. The ready flag is written last, so a segment
+  that is still being filled is never attached. The publisher's process id
+  lets later processes tell an abandoned segment from one that is still
+  being filled. The reference count is the number of processes mapping the
+  segment; once it drops to zero it never rises again, and the process that
+  dropped it unlinks the segment.
+*/
+struct TopologyHeader
+{
+	unsigned long long magic;
+	unsigned long long key;
+	int moleculeCount, atomCount, bondCount, angleCount, dihedralCount, hopCount;
+	int publisher;
+	volatile int ready;
+	volatile int references;
+};
+
+/**
+  Where each array of a segment starts.
+*/
+struct SegmentArrays
+{
+	Molecule *molecules;
+	Atom *atoms;
+	Bond *bonds;
+	Angle *angles;
+	Dihedral *dihedrals;
+	Hop *hops;
+	size_t size;
+};
+
+static size_t alignedSize(size_t size)
+{
+	return (size + 7) & ~(size_t) 7;
+}
+
+/**
+  @return - the size of the header page, which the arrays follow
+*/
+static size_t headerSize()
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	return (sizeof(TopologyHeader) + page - 1) / page * page;
+}
+
+/**
+  Adds a reference to a complete segment, unless its last reference has
+  already been dropped and it is being unlinked.
+  @return - true if the reference was added
+*/
+static bool acquireTopology(TopologyHeader *header)
+{
+	int references = header->references;
+	while (references > 0)
+	{
+		int previous = __sync_val_compare_and_swap(&header->references, references, references + 1);
+		if (previous == references)
+		{
+			return true;
+		}
+		references = previous;
+	}
+	return false;
+}
+
+/**
+  Lays out the arrays of a segment at an address, which may be NULL to only
+  find the segment's size.
+*/
+static SegmentArrays segmentArrays(void *address, const TopologyHeader *header)
+{
+	SegmentArrays arrays;
+	char *start = (char *) address;
+	size_t offset = headerSize();
+
+	arrays.molecules = (Molecule *) (start + offset);
+	offset += alignedSize(sizeof(Molecule) * header->moleculeCount);
+	arrays.atoms = (Atom *) (start + offset);
+	offset += alignedSize(sizeof(Atom) * header->atomCount);
+	arrays.bonds = (Bond *) (start + offset);
+	offset += alignedSize(sizeof(Bond) * header->bondCount);
+	arrays.angles = (Angle *) (start + offset);
+	offset += alignedSize(sizeof(Angle) * header->angleCount);
+	arrays.dihedrals = (Dihedral *) (start + offset);
+	offset += alignedSize(sizeof(Dihedral) * header->dihedralCount);
+	arrays.hops = (Hop *) (start + offset);
+	offset += alignedSize(sizeof(Hop) * header->hopCount);
+
+	arrays.size = offset;
+	return arrays;
+}
+
+/**
+  Points every molecule of the box at its part of the box's arrays, taking
+  the molecules to be contiguous and in order.
+  @return - false if the counts of the molecules overrun the arrays
+*/
+static bool assignMoleculeArrays(Box *box)
+{
+	int atoms = 0, bonds = 0, angles = 0, dihedrals = 0, hops = 0;
+	for (int i = 0; i < box->moleculeCount; i++)
+	{
+		Molecule &molecule = box->molecules[i];
+		molecule.atoms = box->atoms + atoms;
+		molecule.bonds = box->bonds + bonds;
+		molecule.angles = box->angles + angles;
+		molecule.dihedrals = box->dihedrals + dihedrals;
+		molecule.hops = box->hops + hops;
+		atoms += molecule.numOfAtoms;
+		bonds += molecule.numOfBonds;
+		angles += molecule.numOfAngles;
+		dihedrals += molecule.numOfDihedrals;
+		hops += molecule.numOfHops;
+	}
+	return atoms == box->atomCount && bonds == box->bondCount && angles == box->angleCount &&
+		dihedrals == box->dihedralCount && hops == box->hopCount;
+}
+
+/**
+  @return - true if every molecule of the box starts where the previous one
+    ends in each of the box's arrays
+*/
+static bool moleculesContiguous(Box *box)
+{
+	Atom *atoms = box->atoms;
+	Bond *bonds = box->bonds;
+	Angle *angles = box->angles;
+	Dihedral *dihedrals = box->dihedrals;
+	Hop *hops = box->hops;
+	for (int i = 0; i < box->moleculeCount; i++)
+	{
+		Molecule &molecule = box->molecules[i];
+		if (molecule.atoms != atoms || molecule.bonds != bonds || molecule.angles != angles ||
+			molecule.dihedrals != dihedrals || molecule.hops != hops)
+		{
+			return false;
+		}
+		atoms += molecule.numOfAtoms;
+		bonds += molecule.numOfBonds;
+		angles += molecule.numOfAngles;
+		dihedrals += molecule.numOfDihedrals;
+		hops += molecule.numOfHops;
+	}
+	return atoms == box->atoms + box->atomCount;
+}
+
+void hashBytes(const void *data, size_t size, unsigned long long &hash)
+{
+	const unsigned char *bytes = (const unsigned char *) data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+}
+
+bool hashFile(const std::string &path, unsigned long long &hash)
+{
+	FILE *file = fopen(path.c_str(), "rb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	char buffer[65536];
+	size_t length;
+	while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		hashBytes(buffer, length, hash);
+	}
+
+	bool readAll = !ferror(file);
+	fclose(file);
+	return readAll;
+}
+
+std::string sharedTopologyName(unsigned long long key)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "%s%016llx", SHARED_TOPOLOGY_PREFIX, key);
+	return std::string(name);
+}
+
+bool attachTopology(Box *box, unsigned long long key)
+{
+	std::string name = sharedTopologyName(key);
+	int fd = shm_open(name.c_str(), O_RDWR, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < headerSize())
+	{
+		close(fd);
+		return false;
+	}
+
+	size_t size = info.st_size;
+	void *address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED)
+	{
+		return false;
+	}
+
+	TopologyHeader *header = (TopologyHeader *) address;
+	if (header->magic != SHARED_TOPOLOGY_MAGIC || header->key != key || !header->ready ||
+		segmentArrays(NULL, header).size != size || !acquireTopology(header))
+	{
+		munmap(address, size);
+		return false;
+	}
+	mprotect((char *) address + headerSize(), size - headerSize(), PROT_READ);
+	SegmentArrays arrays = segmentArrays(address, header);
+
+	box->moleculeCount = header->moleculeCount;
+	box->atomCount = header->atomCount;
+	box->bondCount = header->bondCount;
+	box->angleCount = header->angleCount;
+	box->dihedralCount = header->dihedralCount;
+	box->hopCount = header->hopCount;
+
+	//every process moves its own atoms, so only the topology stays shared
+	box->molecules = (Molecule *) malloc(sizeof(Molecule) * box->moleculeCount);
+	box->atoms = (Atom *) malloc(sizeof(Atom) * box->atomCount);
+	memcpy(box->molecules, arrays.molecules, sizeof(Molecule) * box->moleculeCount);
+	memcpy(box->atoms, arrays.atoms, sizeof(Atom) * box->atomCount);
+	box->bonds = arrays.bonds;
+	box->angles = arrays.angles;
+	box->dihedrals = arrays.dihedrals;
+	box->hops = arrays.hops;
+	box->topologySegment = address;
+	box->topologySegmentSize = size;
+
+	if (!assignMoleculeArrays(box))
+	{
+		std::cerr << "Warning: Shared topology " << name << " is inconsistent; ignoring it" << std::endl;
+		releaseTopology(box);
+		FREE(box->molecules);
+		FREE(box->atoms);
+		return false;
+	}
+
+	std::cout << "Attached shared topology " << name << std::endl;
+	return true;
+}
+
+bool removeStaleTopology(unsigned long long key)
+{
+	std::string name = sharedTopologyName(key);
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		close(fd);
+		return false;
+	}
+	bool expired = time(NULL) - info.st_mtime > SHARED_TOPOLOGY_STALE_SECONDS;
+
+	//a publisher sizes the segment right after creating it, so one too
+	//small for its header can only be judged by its age
+	bool stale = expired;
+	if (info.st_size >= sizeof(TopologyHeader))
+	{
+		void *address = mmap(NULL, sizeof(TopologyHeader), PROT_READ, MAP_SHARED, fd, 0);
+		if (address == MAP_FAILED)
+		{
+			close(fd);
+			return false;
+		}
+		const TopologyHeader *header = (const TopologyHeader *) address;
+		bool publisherGone = header->publisher > 0 && kill(header->publisher, 0) != 0 && errno == ESRCH;
+		stale = !header->ready && (expired || publisherGone);
+		munmap(address, sizeof(TopologyHeader));
+	}
+	close(fd);
+
+	if (!stale || shm_unlink(name.c_str()) != 0)
+	{
+		return false;
+	}
+	std::cerr << "Warning: Removed stale shared topology " << name << std::endl;
+	return true;
+}
+
+bool publishTopology(Box *box, unsigned long long key)
+{
+	std::string name = sharedTopologyName(key);
+	if (!moleculesContiguous(box))
+	{
+		std::cerr << "Warning: Molecules are not stored in order; topology will not be shared" << std::endl;
+		return false;
+	}
+
+	int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (fd < 0 && removeStaleTopology(key))
+	{
+		fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	}
+	if (fd < 0)
+	{
+		//another process got there first; keep the private copy
+		return false;
+	}
+
+	TopologyHeader counts;
+	counts.moleculeCount = box->moleculeCount;
+	counts.atomCount = box->atomCount;
+	counts.bondCount = box->bondCount;
+	counts.angleCount = box->angleCount;
+	counts.dihedralCount = box->dihedralCount;
+	counts.hopCount = box->hopCount;
+	size_t size = segmentArrays(NULL, &counts).size;
+	if (ftruncate(fd, size) != 0)
+	{
+		std::cerr << "Warning: Could not size shared topology " << name << std::endl;
+		close(fd);
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	void *address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED)
+	{
+		std::cerr << "Warning: Could not map shared topology " << name << std::endl;
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	TopologyHeader *header = (TopologyHeader *) address;
+	*header = counts;
+	header->magic = SHARED_TOPOLOGY_MAGIC;
+	header->key = key;
+	header->publisher = getpid();
+	header->ready = 0;
+	header->references = 1;
+	SegmentArrays arrays = segmentArrays(address, header);
+
+	memcpy(arrays.molecules, box->molecules, sizeof(Molecule) * box->moleculeCount);
+	for (int i = 0; i < box->moleculeCount; i++)
+	{
+		arrays.molecules[i].atoms = NULL;
+		arrays.molecules[i].bonds = NULL;
+		arrays.molecules[i].angles = NULL;
+		arrays.molecules[i].dihedrals = NULL;
+		arrays.molecules[i].hops = NULL;
+	}
+	memcpy(arrays.atoms, box->atoms, sizeof(Atom) * box->atomCount);
+	memcpy(arrays.bonds, box->bonds, sizeof(Bond) * box->bondCount);
+	memcpy(arrays.angles, box->angles, sizeof(Angle) * box->angleCount);
+	memcpy(arrays.dihedrals, box->dihedrals, sizeof(Dihedral) * box->dihedralCount);
+	memcpy(arrays.hops, box->hops, sizeof(Hop) * box->hopCount);
+
+	//the box switches to the shared topology like an attaching process
+	free(box->bonds);
+	free(box->angles);
+	free(box->dihedrals);
+	free(box->hops);
+	box->bonds = arrays.bonds;
+	box->angles = arrays.angles;
+	box->dihedrals = arrays.dihedrals;
+	box->hops = arrays.hops;
+	box->topologySegment = address;
+	box->topologySegmentSize = size;
+	assignMoleculeArrays(box);
+
+	__sync_synchronize();
+	header->ready = 1;
+	mprotect((char *) address + headerSize(), size - headerSize(), PROT_READ);
+
+	std::cout << "Published shared topology " << name << std::endl;
+	return true;
+}
+
+void releaseTopology(Box *box)
+{
+	if (box->topologySegment == NULL)
+	{
+		return;
+	}
+
+	//the last process to detach removes the segment
+	TopologyHeader *header = (TopologyHeader *) box->topologySegment;
+	if (__sync_sub_and_fetch(&header->references, 1) == 0)
+	{
+		shm_unlink(sharedTopologyName(header->key).c_str());
+	}
+
+	munmap(box->topologySegment, box->topologySegmentSize);
+	box->topologySegment = NULL;
+	box->topologySegmentSize = 0;
+	box->bonds = NULL;
+	box->angles = NULL;
+	box->dihedrals = NULL;
+	box->hops = NULL;
+}
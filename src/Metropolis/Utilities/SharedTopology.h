@@ -0,0 +1,82 @@
+#ifndef SHARED_TOPOLOGY_H
+#define SHARED_TOPOLOGY_H
+
+#include <string>
+#include "Metropolis/Box.h"
+
+#define SHARED_TOPOLOGY_PREFIX "/mcgpu-topology-"
+#define SHARED_TOPOLOGY_MAGIC 0x4d43475054503033ULL
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/** Seconds after which a segment that is still not ready is abandoned. */
+#define SHARED_TOPOLOGY_STALE_SECONDS 60
+
+/**
+  Folds the bytes of a file into a running FNV-1a hash.
+  @param path - the file to hash
+  @param hash - the running hash, updated in place
+  @return - true if the file could be read
+*/
+bool hashFile(const std::string &path, unsigned long long &hash);
+
+/**
+  Folds a block of memory into a running FNV-1a hash.
+  @param data - the bytes to hash
+  @param size - the number of bytes
+  @param hash - the running hash, updated in place
+*/
+void hashBytes(const void *data, size_t size, unsigned long long &hash);
+
+/**
+  @param key - the input hash identifying a topology
+  @return - the name of the POSIX shared memory segment for the key
+*/
+std::string sharedTopologyName(unsigned long long key);
+
+/**
+  Builds a box from a published topology segment instead of the OPLS and
+  Z-matrix files. The segment's arrays are mapped read-only and the box's
+  bond, angle, dihedral and hop arrays point into them; its molecules and
+  atoms are copied out as they were before the lattice was laid out. The
+  box holds a reference to the segment until it is released.
+  @param box - the empty box being built
+  @param key - the input hash identifying the topology
+  @return - true if the box is built; false if no complete matching segment
+    exists, in which case the box is untouched
+*/
+bool attachTopology(Box *box, unsigned long long key);
+
+/**
+  Unlinks the segment of a key if its publisher died before marking it
+  ready: the publisher is no longer running, or the segment has not become
+  ready within SHARED_TOPOLOGY_STALE_SECONDS. Complete segments and
+  segments still being filled are left alone; complete segments are
+  removed by releaseTopology.
+  @param key - the input hash identifying the topology
+  @return - true if a stale segment was removed
+*/
+bool removeStaleTopology(unsigned long long key);
+
+/**
+  Copies the box's molecules, atoms and topology into a new shared memory
+  segment, then swaps the box's bond, angle, dihedral and hop arrays over to
+  a read-only mapping of it and frees the private ones. A stale segment of
+  the same key is removed first. Does nothing if another process is already
+  publishing the key.
+  @param box - the box, built but not yet laid out on the lattice
+  @param key - the input hash identifying the topology
+  @return - true if the box now uses the shared arrays
+*/
+bool publishTopology(Box *box, unsigned long long key);
+
+/**
+  Unmaps the box's shared topology segment, if it has one, and clears the
+  array pointers that referred to it. The last process to release a
+  segment unlinks it, so segments only outlive their runs when a process
+  holding one exits without destroying its box.
+  @param box - the box being destroyed
+*/
+void releaseTopology(Box *box);
+
+#endif
@@ -0,0 +1,82 @@
+#include "StartupProfile.h"
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+static std::vector<StartupPhaseRecord> phases;
+static int openPhases = 0;
+
+/**
+  @return - the wall clock time in seconds
+*/
+static double wallTime()
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return now.tv_sec + now.tv_usec * 1e-6;
+}
+
+/**
+  @return - the peak resident memory of the process so far, in kilobytes
+*/
+static long peakKilobytes()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+	return usage.ru_maxrss;
+}
+
+StartupPhase::StartupPhase(const std::string &name)
+{
+	StartupPhaseRecord record;
+	record.name = name;
+	record.depth = openPhases++;
+	record.seconds = 0;
+	record.peakKilobytes = peakKilobytes();
+	record.peakGrowthKilobytes = 0;
+
+	index = phases.size();
+	phases.push_back(record);
+	start = wallTime();
+}
+
+StartupPhase::~StartupPhase()
+{
+	StartupPhaseRecord &record = phases[index];
+	long peak = peakKilobytes();
+
+	record.seconds = wallTime() - start;
+	record.peakGrowthKilobytes = peak - record.peakKilobytes;
+	record.peakKilobytes = peak;
+	openPhases--;
+}
+
+const std::vector<StartupPhaseRecord> &getStartupPhases()
+{
+	return phases;
+}
+
+void printStartupReport(std::ostream &out)
+{
+	out << "Startup Report:" << std::endl;
+	for (int i = 0; i < phases.size(); i++)
+	{
+		out << "  " << std::string(2 * phases[i].depth, ' ') << phases[i].name << ": "
+			<< phases[i].seconds << " seconds, peak memory " << phases[i].peakKilobytes
+			<< " KB (+" << phases[i].peakGrowthKilobytes << " KB)" << std::endl;
+	}
+}
+
+void writeStartupReport(std::ostream &out)
+{
+	out << "[Startup]" << std::endl;
+	for (int i = 0; i < phases.size(); i++)
+	{
+		out << phases[i].name << "-Time = " << phases[i].seconds << " seconds" << std::endl;
+		out << phases[i].name << "-Peak-Memory = " << phases[i].peakKilobytes << " KB" << std::endl;
+		out << phases[i].name << "-Peak-Growth = " << phases[i].peakGrowthKilobytes << " KB" << std::endl;
+	}
+}
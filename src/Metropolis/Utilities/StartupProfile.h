@@ -0,0 +1,66 @@
+#ifndef STARTUP_PROFILE_H
+#define STARTUP_PROFILE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+  The wall time and memory use of one startup phase.
+*/
+struct StartupPhaseRecord
+{
+	std::string name;
+	int depth;
+	double seconds;
+	long peakKilobytes;
+	long peakGrowthKilobytes;
+};
+
+/**
+  Times a phase of startup from its construction until it goes out of scope,
+  so every return path of the instrumented code is covered. Phases may nest;
+  they are reported in the order they began.
+*/
+class StartupPhase
+{
+	public:
+		/**
+		  Starts timing a phase.
+		  @param name - the name of the phase, without spaces, as it appears in
+		    the startup report and the results file
+		*/
+		StartupPhase(const std::string &name);
+
+		/**
+		  Records the wall time of the phase and the peak resident memory of
+		  the process when it ended.
+		*/
+		~StartupPhase();
+
+	private:
+		int index;
+		double start;
+
+		StartupPhase(const StartupPhase &);
+		StartupPhase &operator=(const StartupPhase &);
+};
+
+/**
+  @return - every startup phase recorded so far, in the order they began
+*/
+const std::vector<StartupPhaseRecord> &getStartupPhases();
+
+/**
+  Prints the recorded phases as an indented table.
+  @param out - the stream to print to
+*/
+void printStartupReport(std::ostream &out);
+
+/**
+  Writes the recorded phases as the [Startup] section of a results file.
+  @param out - the results file
+*/
+void writeStartupReport(std::ostream &out);
+
+#endif
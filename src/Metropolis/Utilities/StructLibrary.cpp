@@ -107,4 +107,22 @@ void copyMolecule(Molecule *destination, Molecule *source){}
 
 void printMolecule(Molecule *molecule){}
 
+bool sameAtomParameters(const Molecule &molecule1, const Molecule &molecule2)
+{
+	if (molecule1.numOfAtoms != molecule2.numOfAtoms)
+	{
+		return false;
+	}
+	for (int i = 0; i < molecule1.numOfAtoms; i++)
+	{
+		const Atom &atom1 = molecule1.atoms[i];
+		const Atom &atom2 = molecule2.atoms[i];
+		if (atom1.sigma != atom2.sigma || atom1.epsilon != atom2.epsilon || atom1.charge != atom2.charge)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 #endif
\ No newline at end of file
@@ -250,6 +250,9 @@ struct Environment
 	int primaryAtomIndex;
 
 	int randomseed; //--Albert
+
+	//false for droplets and clusters, which have no periodic images
+	bool periodic;
 	
 	Environment() //constructor/initialize all values to 0 or some other default, where applicable
 	{
@@ -264,6 +267,7 @@ struct Environment
 		numOfMolecules = 0;
 		primaryAtomIndex = 0;
 		randomseed = 0;
+		periodic = true;
 	}
 
     Environment(Environment* environment)
@@ -284,6 +288,7 @@ struct Environment
         numOfMolecules = environment->numOfMolecules;
         primaryAtomIndex = environment->primaryAtomIndex;
         randomseed = environment->randomseed;
+        periodic = environment->periodic;
     }
 };
 
@@ -298,6 +303,10 @@ struct Molecule
 	*/
 	int id;
 	/*
+	The kind of the molecule: the index of the z-matrix molecule it was built from.
+	*/
+	int type;
+	/*
 	The array representing the collection of atoms in the molecule.
 	*/
 	Atom *atoms;
@@ -340,6 +349,7 @@ struct Molecule
     Molecule(int idIn, Atom *atomsIn, Angle *anglesIn, Bond *bondsIn, Dihedral *dihedralsIn, Hop *hopsIn, int atomCount, int angleCount, int bondCount, int dihedralCount, int hopCount) 
     	{
 		id = idIn;
+		type = 0;
 
 		atoms = atomsIn;
 		angles = anglesIn;
@@ -356,6 +366,7 @@ struct Molecule
 		
 	Molecule() {
 		id = 0;
+		type = 0;
 
 		atoms = new Atom[0];
 		angles = new Angle[0];
@@ -389,4 +400,10 @@ Molecule createMolecule(int id, Atom *atoms, Angle *angles, Bond *bonds, Dihedra
 void copyMolecule(Molecule *destination, Molecule *source);
 void printMolecule(Molecule *molecule);
 
+/**
+  @return - true if the two molecules have the same number of atoms, with the
+    same sigma, epsilon and charge atom by atom
+*/
+bool sameAtomParameters(const Molecule &molecule1, const Molecule &molecule2);
+
 #endif
@@ -0,0 +1,138 @@
+#include "Metropolis/SerialSim/CellGrid.h"
+#include "Metropolis/SerialSim/SerialCalcs.h"
+#include "unittests/TestBoxes.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <vector>
+
+// Pulls the last atom of every fifth molecule away from its primary atom,
+// so those molecules are binned on the coarse level.
+static void stretchEveryFifthMolecule(Molecule *molecules, Environment *environment)
+{
+	for (int i = 0; i < environment->numOfMolecules; i += 5)
+	{
+		molecules[i].atoms[molecules[i].numOfAtoms - 1].x += environment->cutoff;
+	}
+}
+
+// Checks the candidates of the grid against a brute-force search of the
+// primary atoms, at the cutoff and at a wider radius.
+static void expectCandidatesMatchBruteForce(const CellGrid &grid, Molecule *molecules, Environment *environment)
+{
+	int primary = environment->primaryAtomIndex;
+	Real radius = 1.5 * environment->cutoff;
+	std::vector<int> candidates, wide;
+	for (int i = 0; i < environment->numOfMolecules; i++)
+	{
+		SCOPED_TRACE(i);
+		grid.findCandidates(molecules, environment, i, candidates);
+		grid.findCandidatesWithin(molecules[i].atoms[primary], radius, wide);
+		std::sort(candidates.begin(), candidates.end());
+		std::sort(wide.begin(), wide.end());
+
+		for (int j = 0; j < environment->numOfMolecules; j++)
+		{
+			if (j == i)
+			{
+				continue;
+			}
+			if (SerialCalcs::moleculesInCutoff(molecules, environment, i, j))
+			{
+				EXPECT_TRUE(std::binary_search(candidates.begin(), candidates.end(), j)) << j;
+			}
+
+			Atom atom1 = molecules[i].atoms[primary];
+			Atom atom2 = molecules[j].atoms[primary];
+			Real dx = SerialCalcs::makePeriodic(atom1.x - atom2.x, environment->x, environment->periodic);
+			Real dy = SerialCalcs::makePeriodic(atom1.y - atom2.y, environment->y, environment->periodic);
+			Real dz = SerialCalcs::makePeriodic(atom1.z - atom2.z, environment->z, environment->periodic);
+			if (dx * dx + dy * dy + dz * dz < radius * radius)
+			{
+				EXPECT_TRUE(std::binary_search(wide.begin(), wide.end(), j)) << j;
+			}
+		}
+	}
+}
+
+// Descr: the periodic grid, with molecules on both levels, finds every
+//        molecule a brute-force search does, also after molecules move
+TEST(CellGridTest, PeriodicTwoLevelMatchesBruteForce)
+{
+	SerialBox box;
+	ASSERT_TRUE(buildTestBox(&box, "resources/exampleFiles/meoh.z", 250, 26.15, 6.0, 0.8, 1122));
+	Molecule *molecules = box.getMolecules();
+	Environment *environment = box.getEnvironment();
+	stretchEveryFifthMolecule(molecules, environment);
+
+	CellGrid grid;
+	grid.build(molecules, environment);
+	ASSERT_TRUE(grid.isBuilt(environment->numOfMolecules));
+	EXPECT_EQ(50, grid.largeMoleculeCount());
+	expectCandidatesMatchBruteForce(grid, molecules, environment);
+
+	//move molecules of both levels across cell and box boundaries, wrapping
+	//them back into the box by their primary atom
+	for (int i = 0; i < environment->numOfMolecules; i += 3)
+	{
+		Molecule &molecule = molecules[i];
+		Real shift = (i % 2 == 0 ? 1 : -1) * 0.4 * environment->cutoff;
+		Real x = molecule.atoms[environment->primaryAtomIndex].x + shift;
+		if (x >= environment->x)
+		{
+			shift -= environment->x;
+		}
+		else if (x < 0)
+		{
+			shift += environment->x;
+		}
+		for (int j = 0; j < molecule.numOfAtoms; j++)
+		{
+			molecule.atoms[j].x += shift;
+		}
+		grid.update(molecules, environment, i);
+	}
+	expectCandidatesMatchBruteForce(grid, molecules, environment);
+}
+
+// Descr: without periodic images the levels are sparse, only store the
+//        occupied cells, and find every molecule a brute-force search does,
+//        including molecules far outside the box
+TEST(CellGridTest, SparseNonPeriodicMatchesBruteForce)
+{
+	SerialBox box;
+	ASSERT_TRUE(buildTestBox(&box, "resources/exampleFiles/meoh.z", 250, 26.15, 6.0, 0.8, 3344));
+	Molecule *molecules = box.getMolecules();
+	Environment *environment = box.getEnvironment();
+	environment->periodic = false;
+	stretchEveryFifthMolecule(molecules, environment);
+
+	//a detached cluster, far beyond the box and on the negative side
+	for (int i = 1; i < environment->numOfMolecules; i += 10)
+	{
+		for (int j = 0; j < molecules[i].numOfAtoms; j++)
+		{
+			molecules[i].atoms[j].x -= 120;
+			molecules[i].atoms[j].z += 80;
+		}
+	}
+
+	CellGrid grid;
+	grid.build(molecules, environment);
+	EXPECT_EQ(50, grid.largeMoleculeCount());
+	EXPECT_GT(grid.storedCellCount(), 0);
+	EXPECT_LE(grid.storedCellCount(), environment->numOfMolecules);
+	expectCandidatesMatchBruteForce(grid, molecules, environment);
+
+	//bring part of the cluster back, so cells empty and fill
+	for (int i = 1; i < environment->numOfMolecules; i += 20)
+	{
+		for (int j = 0; j < molecules[i].numOfAtoms; j++)
+		{
+			molecules[i].atoms[j].x += 120;
+			molecules[i].atoms[j].z -= 80;
+		}
+		grid.update(molecules, environment, i);
+	}
+	expectCandidatesMatchBruteForce(grid, molecules, environment);
+}
@@ -0,0 +1,76 @@
+#include "Metropolis/SerialSim/SerialCalcs.h"
+#include "unittests/TestBoxes.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <vector>
+
+// Checks the shells of a box against calcSystemEnergy and a count of the
+// molecule pairs within each cutoff.
+static void expectShellsMatchCutoffs(SerialBox &box, const std::vector<double> &cutoffs)
+{
+	Molecule *molecules = box.getMolecules();
+	Environment *environment = box.getEnvironment();
+
+	std::vector<Real> shellEnergies;
+	std::vector<long> shellPairs;
+	SerialCalcs::calcShellEnergies(molecules, environment, cutoffs, shellEnergies, shellPairs);
+	ASSERT_EQ(cutoffs.size(), shellEnergies.size());
+	ASSERT_EQ(cutoffs.size(), shellPairs.size());
+
+	Real simulatedCutoff = environment->cutoff;
+	double cutoffEnergy = 0;
+	long cutoffPairs = 0;
+	for (int s = 0; s < cutoffs.size(); s++)
+	{
+		SCOPED_TRACE(cutoffs[s]);
+		cutoffEnergy += shellEnergies[s];
+		cutoffPairs += shellPairs[s];
+
+		environment->cutoff = cutoffs[s];
+		double energy = SerialCalcs::calcSystemEnergy(molecules, environment);
+		long pairs = 0;
+		for (int i = 0; i < environment->numOfMolecules; i++)
+		{
+			for (int j = i + 1; j < environment->numOfMolecules; j++)
+			{
+				pairs += SerialCalcs::moleculesInCutoff(molecules, environment, i, j);
+			}
+		}
+		environment->cutoff = simulatedCutoff;
+
+		EXPECT_GT(pairs, 0);
+		EXPECT_EQ(pairs, cutoffPairs);
+		EXPECT_NEAR(energy, cutoffEnergy, 1e-4 * fabs(energy));
+	}
+}
+
+// Descr: the energy of the shells up to each cutoff of a periodic box is
+//        the system energy at that cutoff, for cutoffs on either side of
+//        the simulated one
+TEST(CutoffScanTest, PeriodicShellsMatchSystemEnergy)
+{
+	SerialBox box;
+	ASSERT_TRUE(buildTestBox(&box, "resources/exampleFiles/meoh.z", 250, 26.15, 9.0, 0.8, 2468));
+
+	std::vector<double> cutoffs;
+	cutoffs.push_back(4.0);
+	cutoffs.push_back(7.5);
+	cutoffs.push_back(9.0);
+	cutoffs.push_back(12.5);
+	expectShellsMatchCutoffs(box, cutoffs);
+}
+
+// Descr: the same without periodic images, where the scan grid is sparse
+TEST(CutoffScanTest, NonPeriodicShellsMatchSystemEnergy)
+{
+	SerialBox box;
+	ASSERT_TRUE(buildTestBox(&box, "resources/exampleFiles/meoh.z", 250, 26.15, 9.0, 0.8, 1357));
+	box.getEnvironment()->periodic = false;
+
+	std::vector<double> cutoffs;
+	cutoffs.push_back(6.0);
+	cutoffs.push_back(11.0);
+	cutoffs.push_back(20.0);
+	expectShellsMatchCutoffs(box, cutoffs);
+}
@@ -1,6 +1,8 @@
 
 #include "Metropolis/Utilities/MathLibrary.h"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #define PRECISION .0001
@@ -514,3 +516,126 @@ TEST(GeometryTest, RotateInPlane)
     EXPECT_LT( fabs(rotated.z - sqrt(.5))  , .01 );
     EXPECT_LT( fabs(rotated.x - 0.0)  , .01 );
 }
+
+// The batched and scalar functions round in a different order, so their
+// coordinates agree to a tolerance relative to the distance from the origin.
+#define RELATIVE_PRECISION 1e-5
+
+static void expectSamePosition(const Atom &expected, Real x, Real y, Real z)
+{
+    double distance = sqrt((double) expected.x * expected.x + expected.y * expected.y + expected.z * expected.z);
+    double scale = std::max(1.0, distance);
+    EXPECT_NEAR(expected.x, x, RELATIVE_PRECISION * scale);
+    EXPECT_NEAR(expected.y, y, RELATIVE_PRECISION * scale);
+    EXPECT_NEAR(expected.z, z, RELATIVE_PRECISION * scale);
+}
+
+// Descr: the batch rotations match the scalar ones atom for atom
+TEST(GeometryTest, RotateCoordinatesMatchesScalar)
+{
+    srand(time(NULL));
+
+    const int count = 100;
+    Real x[count], y[count], z[count];
+    Atom atoms[count];
+    for (int i = 0; i < count; i++)
+    {
+        atoms[i] = createAtom(-1, ((double) rand() / RAND_MAX) * 30,
+                ((double) rand() / RAND_MAX) * 30, ((double) rand() / RAND_MAX) * 30);
+        x[i] = atoms[i].x;
+        y[i] = atoms[i].y;
+        z[i] = atoms[i].z;
+    }
+
+    double theta = ((double) rand() / RAND_MAX) * 360;
+    double rotation[3][3];
+    rotationAboutX(theta, rotation);
+    rotateCoordinates(x, y, z, count, rotation);
+    rotationAboutY(theta, rotation);
+    rotateCoordinates(x, y, z, count, rotation);
+    rotationAboutZ(theta, rotation);
+    rotateCoordinates(x, y, z, count, rotation);
+    translateCoordinates(x, y, z, count, 1.5, -2.5, 3.5);
+
+    for (int i = 0; i < count; i++)
+    {
+        Atom expected = rotateAboutZ(rotateAboutY(rotateAboutX(atoms[i], theta), theta), theta);
+        expected = translateAtom(expected, 1.5, -2.5, 3.5);
+        expectSamePosition(expected, x[i], y[i], z[i]);
+    }
+}
+
+// Descr: evident
+TEST(GeometryTest, RotationAboutVector)
+{
+    double rotation[3][3];
+    Real x = 0, y = 1, z = 0;
+
+    //the axis does not need to be a unit vector
+    rotationAboutVector(createAtom(-1, 0, 0, 0), createAtom(-1, 3, 0, 0), 90, rotation);
+    rotateCoordinates(&x, &y, &z, 1, rotation);
+    EXPECT_NEAR(0.0, x, PRECISION);
+    EXPECT_NEAR(0.0, y, PRECISION);
+    EXPECT_NEAR(1.0, z, PRECISION);
+
+    //coincident atoms give the identity
+    rotationAboutVector(createAtom(-1, 1, 1, 1), createAtom(-1, 1, 1, 1), 90, rotation);
+    rotateCoordinates(&x, &y, &z, 1, rotation);
+    EXPECT_NEAR(0.0, x, PRECISION);
+    EXPECT_NEAR(0.0, y, PRECISION);
+    EXPECT_NEAR(1.0, z, PRECISION);
+}
+
+// Descr: evident
+TEST(GeometryTest, RotationFromQuaternion)
+{
+    double rotation[3][3];
+    rotationFromQuaternion(1, 0, 0, 0, rotation);
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            EXPECT_NEAR(i == j ? 1.0 : 0.0, rotation[i][j], PRECISION);
+        }
+    }
+
+    //an unnormalized quaternion of 90 degrees about z
+    Real x = 1, y = 0, z = 0;
+    rotationFromQuaternion(2, 0, 0, 2, rotation);
+    rotateCoordinates(&x, &y, &z, 1, rotation);
+    EXPECT_NEAR(0.0, x, PRECISION);
+    EXPECT_NEAR(1.0, y, PRECISION);
+    EXPECT_NEAR(0.0, z, PRECISION);
+}
+
+// Descr: moveMolecule places every atom where the scalar functions do
+TEST(GeometryTest, MoveMolecule)
+{
+    srand(time(NULL));
+
+    const int count = 10;
+    Atom atoms[count], moved[count];
+    for (int i = 0; i < count; i++)
+    {
+        atoms[i] = createAtom(-1, ((double) rand() / RAND_MAX) * 30,
+                ((double) rand() / RAND_MAX) * 30, ((double) rand() / RAND_MAX) * 30);
+        moved[i] = atoms[i];
+    }
+
+    Molecule molec;
+    molec.atoms = moved;
+    molec.numOfAtoms = count;
+    Atom pivot = atoms[0];
+    moveMolecule(molec, pivot, 0.3, -0.2, 0.1, 12, -7, 30);
+
+    for (int i = 0; i < count; i++)
+    {
+        Atom expected = translateAtom(atoms[i], -pivot.x, -pivot.y, -pivot.z);
+        expected = rotateAboutX(expected, 12);
+        expected = rotateAboutY(expected, -7);
+        expected = rotateAboutZ(expected, 30);
+        expected = translateAtom(expected, pivot.x, pivot.y, pivot.z);
+        expected = translateAtom(expected, 0.3, -0.2, 0.1);
+        expectSamePosition(expected, moved[i].x, moved[i].y, moved[i].z);
+    }
+}
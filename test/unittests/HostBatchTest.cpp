@@ -0,0 +1,62 @@
+#include "Metropolis/ParallelSim/HostBatchCalcs.h"
+#include "Metropolis/SerialSim/SerialCalcs.h"
+#include "unittests/TestBoxes.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Checks the batch contribution of a molecule against the serial sum. Small
+// contributions are sums that cancel, so the tolerance has a floor of 1e-4.
+static void expectSameContribution(HostBatchBox &box, int molIdx)
+{
+	double serial = SerialCalcs::calcMolecularEnergyContribution(box.getMolecules(), box.getEnvironment(), molIdx);
+	double batch = HostBatchCalcs::calcMolecularEnergyContribution(&box, molIdx);
+	EXPECT_NEAR(serial, batch, 1e-4 * std::max(1.0, fabs(serial)));
+}
+
+// Descr: the host batch engine gives the system energy of the serial
+//        engine on the same small box
+TEST(HostBatchTest, SystemEnergyMatchesSerial)
+{
+	SerialBox serialBox;
+	ASSERT_TRUE(buildTestBox(&serialBox, "resources/exampleFiles/meoh.z", 108, 19.0, 9.0, 0.8, 5151));
+	HostBatchBox batchBox;
+	ASSERT_TRUE(buildTestBox(&batchBox, "resources/exampleFiles/meoh.z", 108, 19.0, 9.0, 0.8, 5151));
+	batchBox.buildBatchData();
+
+	double serial = SerialCalcs::calcSystemEnergy(&serialBox);
+	double bruteForce = SerialCalcs::calcSystemEnergy(serialBox.getMolecules(), serialBox.getEnvironment());
+	double batch = HostBatchCalcs::calcSystemEnergy(&batchBox);
+	EXPECT_NEAR(bruteForce, serial, 1e-4 * fabs(bruteForce));
+	EXPECT_NEAR(serial, batch, 1e-4 * fabs(serial));
+}
+
+// Descr: the energy contribution of each molecule matches the serial sum,
+//        also after moves that update and restore the coalesced arrays
+TEST(HostBatchTest, MoleculeContributionsMatchSerial)
+{
+	HostBatchBox box;
+	ASSERT_TRUE(buildTestBox(&box, "resources/exampleFiles/meoh.z", 108, 19.0, 9.0, 0.8, 6262));
+	box.buildBatchData();
+
+	for (int i = 0; i < box.moleculeCount; i++)
+	{
+		SCOPED_TRACE(i);
+		expectSameContribution(box, i);
+	}
+
+	for (int i = 0; i < box.moleculeCount; i += 7)
+	{
+		SCOPED_TRACE(i);
+		box.changeMolecule(i);
+		expectSameContribution(box, i);
+
+		//odd moves are rolled back, even ones kept
+		if (i % 2 == 1)
+		{
+			box.rollback(i);
+			expectSameContribution(box, i);
+		}
+	}
+}
@@ -0,0 +1,143 @@
+#include "Metropolis/SerialSim/NeighborList.h"
+#include "Metropolis/SerialSim/SerialCalcs.h"
+#include "unittests/TestBoxes.h"
+#include "gtest/gtest.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Polls a list until its helper has swapped in the given generation.
+static bool waitForRebuild(NeighborList &list, Molecule *molecules, Environment *environment, int generation)
+{
+	for (int attempt = 0; attempt < 10000 && list.getRebuildCount() < generation; attempt++)
+	{
+		usleep(1000);
+		list.poll(molecules, environment);
+	}
+	return list.getRebuildCount() >= generation;
+}
+
+// Moves a molecule by the same distance along each axis, towards the
+// middle of the box so it stays inside.
+static void moveTowardsMiddle(Molecule *molecules, Environment *environment, int molIdx, Real distance)
+{
+	Molecule &molecule = molecules[molIdx];
+	Atom primary = molecule.atoms[environment->primaryAtomIndex];
+	Real dx = primary.x < environment->x / 2 ? distance : -distance;
+	Real dy = primary.y < environment->y / 2 ? distance : -distance;
+	Real dz = primary.z < environment->z / 2 ? distance : -distance;
+	for (int i = 0; i < molecule.numOfAtoms; i++)
+	{
+		molecule.atoms[i].x += dx;
+		molecule.atoms[i].y += dy;
+		molecule.atoms[i].z += dz;
+	}
+}
+
+// Checks that the candidates of every molecule hold each molecule within
+// the cutoff of it.
+static void expectListCoversCutoff(NeighborList &list, Molecule *molecules, Environment *environment)
+{
+	std::vector<int> candidates;
+	for (int i = 0; i < environment->numOfMolecules; i++)
+	{
+		SCOPED_TRACE(i);
+		ASSERT_TRUE(list.findCandidates(molecules, environment, i, candidates));
+		for (int j = 0; j < environment->numOfMolecules; j++)
+		{
+			if (j != i && SerialCalcs::moleculesInCutoff(molecules, environment, i, j))
+			{
+				EXPECT_TRUE(std::binary_search(candidates.begin(), candidates.end(), j));
+			}
+		}
+	}
+}
+
+// Descr: a rebuilt generation lists every molecule within the cutoff, and
+//        a second rebuild is swapped in once the skin runs out
+TEST(NeighborListTest, RebuildsCoverCutoff)
+{
+	SerialBox box;
+	ASSERT_TRUE(buildTestBox(&box, "resources/exampleFiles/meoh.z", 250, 26.15, 9.0, 0.8, 4242));
+	Molecule *molecules = box.getMolecules();
+	Environment *environment = box.getEnvironment();
+
+	NeighborList list;
+	list.setSkin(1.0);
+	std::vector<int> candidates;
+	EXPECT_FALSE(list.findCandidates(molecules, environment, 0, candidates));
+
+	//the first commit starts the first generation
+	list.commit(molecules, environment, 0);
+	ASSERT_TRUE(waitForRebuild(list, molecules, environment, 1));
+	expectListCoversCutoff(list, molecules, environment);
+
+	//moving past the rebuild fraction of the skin starts the next one
+	moveTowardsMiddle(molecules, environment, 7, 0.4);
+	list.commit(molecules, environment, 7);
+	ASSERT_TRUE(waitForRebuild(list, molecules, environment, 2));
+	expectListCoversCutoff(list, molecules, environment);
+}
+
+// Descr: a molecule moved past the skin is not served from the list, and
+//        once such a move is committed no molecule is until the rebuild
+TEST(NeighborListTest, FallsBackBeyondSkin)
+{
+	SerialBox box;
+	ASSERT_TRUE(buildTestBox(&box, "resources/exampleFiles/meoh.z", 250, 26.15, 9.0, 0.8, 8642));
+	Molecule *molecules = box.getMolecules();
+	Environment *environment = box.getEnvironment();
+
+	NeighborList list;
+	list.setSkin(1.0);
+	list.commit(molecules, environment, 0);
+	ASSERT_TRUE(waitForRebuild(list, molecules, environment, 1));
+
+	std::vector<int> candidates;
+	moveTowardsMiddle(molecules, environment, 12, 0.7);
+	EXPECT_FALSE(list.findCandidates(molecules, environment, 12, candidates));
+	EXPECT_TRUE(list.findCandidates(molecules, environment, 13, candidates));
+
+	list.commit(molecules, environment, 12);
+	EXPECT_FALSE(list.findCandidates(molecules, environment, 13, candidates));
+
+	ASSERT_TRUE(waitForRebuild(list, molecules, environment, 2));
+	expectListCoversCutoff(list, molecules, environment);
+}
+
+// Descr: energies found through the lists equal the brute-force sums,
+//        before and after a molecule moves past the skin
+TEST(NeighborListTest, EnergyMatchesBruteForce)
+{
+	SerialBox box;
+	ASSERT_TRUE(buildTestBox(&box, "resources/exampleFiles/meoh.z", 250, 26.15, 9.0, 0.8, 97531));
+	Molecule *molecules = box.getMolecules();
+	Environment *environment = box.getEnvironment();
+	box.neighbors.setSkin(1.0);
+
+	box.commitChange(0);
+	ASSERT_TRUE(waitForRebuild(box.neighbors, molecules, environment, 1));
+	std::vector<int> candidates;
+	ASSERT_TRUE(box.neighbors.findCandidates(molecules, environment, 0, candidates));
+
+	double bruteForce = SerialCalcs::calcSystemEnergy(molecules, environment);
+	EXPECT_NEAR(bruteForce, SerialCalcs::calcSystemEnergy(&box), 1e-4 * fabs(bruteForce));
+
+	//the moved molecule falls back to the grid before its commit, and every
+	//molecule does after it
+	int moved = 30;
+	moveTowardsMiddle(molecules, environment, moved, 1.5);
+	double contribution = SerialCalcs::calcMolecularEnergyContribution(molecules, environment, moved);
+	EXPECT_NEAR(contribution, SerialCalcs::calcMolecularEnergyContribution(&box, moved),
+				1e-4 * fabs(contribution));
+
+	box.commitChange(moved);
+	bruteForce = SerialCalcs::calcSystemEnergy(molecules, environment);
+	EXPECT_NEAR(bruteForce, SerialCalcs::calcSystemEnergy(&box), 1e-4 * fabs(bruteForce));
+
+	ASSERT_TRUE(waitForRebuild(box.neighbors, molecules, environment, 2));
+	ASSERT_TRUE(box.neighbors.findCandidates(molecules, environment, moved, candidates));
+	EXPECT_NEAR(bruteForce, SerialCalcs::calcSystemEnergy(&box), 1e-4 * fabs(bruteForce));
+}
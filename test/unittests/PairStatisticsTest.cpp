@@ -0,0 +1,73 @@
+#include "Metropolis/SerialSim/PairStatistics.h"
+#include "Metropolis/SerialSim/SerialCalcs.h"
+#include "unittests/TestBoxes.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Descr: the pair statistics of a configuration, evaluated with the
+//        parameters they were gathered with, give the energy that
+//        calcSystemEnergy reports, including after a write and read
+TEST(PairStatisticsTest, OriginalParametersReproduceEnergy)
+{
+	SerialBox box;
+	ASSERT_TRUE(buildTestBox(&box, "resources/exampleFiles/meoh.z", 250, 26.15, 9.0, 0.8, 12345));
+	Molecule *molecules = box.getMolecules();
+	Environment *environment = box.getEnvironment();
+
+	double energy = SerialCalcs::calcSystemEnergy(molecules, environment);
+	double tolerance = 1e-4 * fabs(energy);
+
+	PairStatistics statistics;
+	statistics.accumulate(molecules, environment, 4000);
+	double lj, coulomb;
+	statistics.evaluate(statistics.getTypes(), &lj, &coulomb);
+	EXPECT_NEAR(energy, lj + coulomb, tolerance);
+
+	std::string path = "pairStatisticsTest" PAIR_STATISTICS_EXT;
+	ASSERT_TRUE(statistics.write(path));
+	PairStatistics read;
+	ASSERT_TRUE(read.read(path));
+	std::remove(path.c_str());
+	EXPECT_EQ(4000, read.getStep());
+	read.evaluate(read.getTypes(), &lj, &coulomb);
+	EXPECT_NEAR(energy, lj + coulomb, tolerance);
+}
+
+// Descr: reweighting with changed parameters gives the energy of the box
+//        with those parameters
+TEST(PairStatisticsTest, ChangedParametersMatchRecomputedEnergy)
+{
+	SerialBox box;
+	ASSERT_TRUE(buildTestBox(&box, "resources/exampleFiles/meoh.z", 250, 26.15, 9.0, 0.8, 6789));
+	Molecule *molecules = box.getMolecules();
+	Environment *environment = box.getEnvironment();
+
+	PairStatistics statistics;
+	statistics.accumulate(molecules, environment, 0);
+	std::vector<AtomType> types = statistics.getTypes();
+	ASSERT_GT(types.size(), 1);
+
+	//scale the first type in the parameters and in the box alike
+	AtomType original = types[0];
+	types[0].sigma *= 1.1;
+	types[0].epsilon *= 0.9;
+	types[0].charge *= 0.8;
+	for (int i = 0; i < box.atomCount; i++)
+	{
+		Atom &atom = box.atoms[i];
+		if (atom.sigma == original.sigma && atom.epsilon == original.epsilon && atom.charge == original.charge)
+		{
+			atom.sigma = types[0].sigma;
+			atom.epsilon = types[0].epsilon;
+			atom.charge = types[0].charge;
+		}
+	}
+
+	double energy = SerialCalcs::calcSystemEnergy(molecules, environment);
+	double lj, coulomb;
+	statistics.evaluate(types, &lj, &coulomb);
+	EXPECT_NEAR(energy, lj + coulomb, 1e-4 * fabs(energy));
+}
@@ -0,0 +1,213 @@
+#include "Metropolis/Utilities/ResultCache.h"
+#include "unittests/TestBoxes.h"
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Writes a configuration of the bundled methanol z-matrix. The comment,
+// step count and output paths are the parts the cache key leaves out.
+static std::string writeConfig(const std::string &path, const std::string &comment, long steps,
+							   const std::string &temperature, const std::string &outputPath)
+{
+	std::string MCGPU = mcgpuPath();
+	std::ofstream configFile(path.c_str());
+	configFile << "#size of periodic box (x, y, z in angstroms) " << comment << "\n"
+		<< "26.15\n"
+		<< "26.15\n"
+		<< "26.15\n"
+		<< "#temperature in Kelvin\n"
+		<< temperature << "\n"
+		<< "#max translation\n"
+		<< ".12\n"
+		<< "#number of steps\n"
+		<< steps << "\n"
+		<< "#number of molecues\n"
+		<< "256\n"
+		<< "#path to opls.par file\n"
+		<< MCGPU << "resources/bossFiles/oplsaa.par\n"
+		<< "#path to z matrix file\n"
+		<< MCGPU << "resources/exampleFiles/meoh.z\n"
+		<< "#path to state input\n"
+		<< "\n"
+		<< "#path to state output\n"
+		<< outputPath << "\n"
+		<< "#pdb output path\n"
+		<< outputPath << ".pdb\n"
+		<< "#cutoff distance in angstroms\n"
+		<< "11.0\n"
+		<< "#max rotation\n"
+		<< "12.0\n"
+		<< "#Random Seed Input\n"
+		<< "12345\n"
+		<< "#Primary Atom Index\n"
+		<< "1";
+	configFile.close();
+	return path;
+}
+
+// Writes a version 1 state file of one two atom molecule.
+static std::string writeState(const std::string &path, long step, Real x)
+{
+	std::ofstream file(path.c_str());
+	file << "20 20 20 1 2 298.15 9 0.15 15 0 12345" << std::endl;
+	file << step << std::endl;
+	file << std::endl;
+	file << 0 << std::endl;
+	file << "= Atoms" << std::endl;
+	file << "0 " << x << " 0.75 4.5 3.75 0.5 0.125" << std::endl;
+	file << "1 " << x + 1.25 << " 0.75 4.5 3.25 0.375 -0.125" << std::endl;
+	file << "= Bonds" << std::endl;
+	file << "0 1 1.25 0" << std::endl;
+	file << "= Dihedrals" << std::endl;
+	file << "= Hops" << std::endl;
+	file << "= Angles" << std::endl;
+	file << "==" << std::endl;
+	file.close();
+	return path;
+}
+
+// The arguments of a run of an input with no output region, as the command
+// line parser leaves them.
+static SimulationArgs runArgs(const std::string &path, InputFileType fileType)
+{
+	SimulationArgs args = SimulationArgs();
+	args.filePath = path;
+	args.fileType = fileType;
+	args.outputRegionMolecule = -1;
+	return args;
+}
+
+static std::string readFile(const std::string &path)
+{
+	std::ifstream file(path.c_str());
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+class ResultCacheTest : public ::testing::Test
+{
+	protected:
+		std::string directory;
+		std::string resultsPath;
+		std::string statePath;
+
+		virtual void SetUp()
+		{
+			directory = "resultCacheTest.cache";
+			resultsPath = "resultCacheTest.results";
+			statePath = "resultCacheTest.state";
+			system(("rm -rf " + directory).c_str());
+
+			std::ofstream results(resultsPath.c_str());
+			results << "Final-Energy = -1234.5" << std::endl;
+			results.close();
+			writeState(statePath, 1000, -6.5);
+		}
+
+		virtual void TearDown()
+		{
+			system(("rm -rf " + directory).c_str());
+			std::remove(resultsPath.c_str());
+			std::remove(statePath.c_str());
+			std::remove("resultCacheTest1.config");
+			std::remove("resultCacheTest2.config");
+			std::remove("resultCacheTest1.state");
+			std::remove("resultCacheTest2.state");
+			std::remove("resultCacheTest.restored");
+		}
+
+		// Identifies and stores a run of a configuration.
+		void storeConfig(const std::string &path)
+		{
+			SimulationArgs args = runArgs(path, InputFile::Configuration);
+			args.simulationName = "first";
+			ResultCache cache(directory);
+			ASSERT_TRUE(cache.identify(args));
+			ASSERT_TRUE(cache.store(resultsPath, statePath));
+		}
+};
+
+// Descr: a run whose configuration differs only in its comments, output
+//        paths and name is restored from the cache
+TEST_F(ResultCacheTest, HitIgnoresCommentsPathsAndNames)
+{
+	storeConfig(writeConfig("resultCacheTest1.config", "", 1000, "298.15", "firstOutput"));
+
+	std::string path = writeConfig("resultCacheTest2.config", "(second copy)", 1000, "298.150", "secondOutput");
+	SimulationArgs args = runArgs(path, InputFile::Configuration);
+	args.simulationName = "second";
+	ResultCache cache(directory);
+	ASSERT_TRUE(cache.identify(args));
+	EXPECT_EQ(1000, cache.getSteps());
+	ASSERT_TRUE(cache.restore("resultCacheTest.restored", "resultCacheTest.restored.state"));
+	EXPECT_EQ(readFile(resultsPath), readFile("resultCacheTest.restored"));
+	EXPECT_EQ(readFile(statePath), readFile("resultCacheTest.restored.state"));
+	std::remove("resultCacheTest.restored.state");
+}
+
+// Descr: a run at another temperature is not restored
+TEST_F(ResultCacheTest, MissOnPhysicalChange)
+{
+	storeConfig(writeConfig("resultCacheTest1.config", "", 1000, "298.15", "firstOutput"));
+
+	std::string path = writeConfig("resultCacheTest2.config", "", 1000, "310.0", "firstOutput");
+	SimulationArgs args = runArgs(path, InputFile::Configuration);
+	ResultCache cache(directory);
+	ASSERT_TRUE(cache.identify(args));
+	EXPECT_FALSE(cache.restore("resultCacheTest.restored", ""));
+	std::string checkpointPath;
+	EXPECT_EQ(0, cache.findCheckpoint(checkpointPath));
+}
+
+// Descr: a longer run of the same chain, with a different step count and
+//        comments, resumes from the state of the shorter one
+TEST_F(ResultCacheTest, LongerRunResumesFromCheckpoint)
+{
+	storeConfig(writeConfig("resultCacheTest1.config", "", 1000, "298.15", "firstOutput"));
+
+	std::string path = writeConfig("resultCacheTest2.config", "(longer)", 3000, "298.15", "secondOutput");
+	SimulationArgs args = runArgs(path, InputFile::Configuration);
+	ResultCache cache(directory);
+	ASSERT_TRUE(cache.identify(args));
+	EXPECT_EQ(3000, cache.getSteps());
+	EXPECT_FALSE(cache.restore("resultCacheTest.restored", ""));
+
+	std::string checkpointPath;
+	ASSERT_EQ(1000, cache.findCheckpoint(checkpointPath));
+	EXPECT_EQ(readFile(statePath), readFile(checkpointPath));
+
+	//the resumed run is stored under its resume point, not as a checkpoint
+	cache.resumeFrom(1000);
+	EXPECT_FALSE(cache.restore("resultCacheTest.restored", ""));
+	ASSERT_TRUE(cache.store(resultsPath, ""));
+	EXPECT_TRUE(cache.restore("resultCacheTest.restored", ""));
+	EXPECT_EQ(1000, cache.findCheckpoint(checkpointPath));
+}
+
+// Descr: state inputs that differ only in their step line share a key,
+//        and moving an atom changes it
+TEST_F(ResultCacheTest, StateInputIgnoresStepLine)
+{
+	std::string path = writeState("resultCacheTest1.state", 4000, -6.5);
+	SimulationArgs args = runArgs(path, InputFile::State);
+	ResultCache first(directory);
+	ASSERT_TRUE(first.identify(args));
+	EXPECT_EQ(4000, first.getStartStep());
+	ASSERT_TRUE(first.store(resultsPath, ""));
+
+	args.filePath = writeState("resultCacheTest2.state", 9000, -6.5);
+	ResultCache second(directory);
+	ASSERT_TRUE(second.identify(args));
+	EXPECT_EQ(9000, second.getStartStep());
+	EXPECT_TRUE(second.restore("resultCacheTest.restored", ""));
+
+	args.filePath = writeState("resultCacheTest2.state", 4000, -6.25);
+	ResultCache moved(directory);
+	ASSERT_TRUE(moved.identify(args));
+	EXPECT_FALSE(moved.restore("resultCacheTest.restored", ""));
+}
@@ -0,0 +1,245 @@
+#include "Metropolis/Utilities/FileUtilities.h"
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Builds one molecule of either kind: kind 0 is a bent three atom molecule
+// with a bond, an angle, a dihedral and a hop, kind 1 a two atom molecule
+// with a single bond. Atoms are numbered from first, and the parts are
+// stored in the given vectors so they outlive the molecule.
+static Molecule buildMolecule(int id, int kind, int first, Real shift, std::vector<Atom> &atoms,
+                              std::vector<Bond> &bonds, std::vector<Angle> &angles,
+                              std::vector<Dihedral> &dihedrals, std::vector<Hop> &hops)
+{
+    Molecule molecule;
+    molecule.id = id;
+    molecule.type = kind == 0 ? 3 : 7;
+
+    atoms.clear(); bonds.clear(); angles.clear(); dihedrals.clear(); hops.clear();
+    if (kind == 0)
+    {
+        atoms.push_back(createAtom(first, 1.25 + shift, 2.5, -3.75, 3.5, 0.25, -0.5, 'O'));
+        atoms.push_back(createAtom(first + 1, 2.25 + shift, 2.5, -3.75, 2.5, 0.125, 0.25, 'H'));
+        atoms.push_back(createAtom(first + 2, 1.25 + shift, 3.5, -3.75, 2.5, 0.125, 0.25, 'H'));
+        bonds.push_back(Bond(first, first + 1, 0.945, false));
+        bonds.push_back(Bond(first, first + 2, 0.945, true));
+        angles.push_back(Angle(first + 1, first + 2, 104.5, true));
+        dihedrals.push_back(Dihedral(first + 2, first, 180, false));
+        hops.push_back(Hop(first + 1, first + 2, 3));
+    }
+    else
+    {
+        atoms.push_back(createAtom(first, -6.5 + shift, 0.75, 4.5, 3.75, 0.5, 0.125, 'C'));
+        atoms.push_back(createAtom(first + 1, -5.25 + shift, 0.75, 4.5, 3.25, 0.375, -0.125, 'N'));
+        bonds.push_back(Bond(first, first + 1, 1.25, false));
+    }
+
+    molecule.numOfAtoms = atoms.size();
+    molecule.atoms = &atoms[0];
+    molecule.numOfBonds = bonds.size();
+    molecule.bonds = bonds.empty() ? NULL : &bonds[0];
+    molecule.numOfAngles = angles.size();
+    molecule.angles = angles.empty() ? NULL : &angles[0];
+    molecule.numOfDihedrals = dihedrals.size();
+    molecule.dihedrals = dihedrals.empty() ? NULL : &dihedrals[0];
+    molecule.numOfHops = hops.size();
+    molecule.hops = hops.empty() ? NULL : &hops[0];
+    return molecule;
+}
+
+// Checks a molecule read back from a state file against the one written.
+static void expectSameMolecule(const Molecule &expected, const Molecule &actual, int type)
+{
+    EXPECT_EQ(expected.id, actual.id);
+    EXPECT_EQ(type, actual.type);
+
+    ASSERT_EQ(expected.numOfAtoms, actual.numOfAtoms);
+    for (int i = 0; i < expected.numOfAtoms; i++)
+    {
+        EXPECT_EQ(expected.atoms[i].id, actual.atoms[i].id);
+        EXPECT_NEAR(expected.atoms[i].x, actual.atoms[i].x, .0001);
+        EXPECT_NEAR(expected.atoms[i].y, actual.atoms[i].y, .0001);
+        EXPECT_NEAR(expected.atoms[i].z, actual.atoms[i].z, .0001);
+        EXPECT_NEAR(expected.atoms[i].sigma, actual.atoms[i].sigma, .0001);
+        EXPECT_NEAR(expected.atoms[i].epsilon, actual.atoms[i].epsilon, .0001);
+        EXPECT_NEAR(expected.atoms[i].charge, actual.atoms[i].charge, .0001);
+    }
+
+    //the topology of each kind is stored from zero, so these check that it
+    //is moved back to the first atom of every molecule
+    ASSERT_EQ(expected.numOfBonds, actual.numOfBonds);
+    for (int i = 0; i < expected.numOfBonds; i++)
+    {
+        EXPECT_EQ(expected.bonds[i].atom1, actual.bonds[i].atom1);
+        EXPECT_EQ(expected.bonds[i].atom2, actual.bonds[i].atom2);
+        EXPECT_NEAR(expected.bonds[i].distance, actual.bonds[i].distance, .0001);
+        EXPECT_EQ(expected.bonds[i].variable, actual.bonds[i].variable);
+    }
+    ASSERT_EQ(expected.numOfAngles, actual.numOfAngles);
+    for (int i = 0; i < expected.numOfAngles; i++)
+    {
+        EXPECT_EQ(expected.angles[i].atom1, actual.angles[i].atom1);
+        EXPECT_EQ(expected.angles[i].atom2, actual.angles[i].atom2);
+        EXPECT_NEAR(expected.angles[i].value, actual.angles[i].value, .0001);
+        EXPECT_EQ(expected.angles[i].variable, actual.angles[i].variable);
+    }
+    ASSERT_EQ(expected.numOfDihedrals, actual.numOfDihedrals);
+    for (int i = 0; i < expected.numOfDihedrals; i++)
+    {
+        EXPECT_EQ(expected.dihedrals[i].atom1, actual.dihedrals[i].atom1);
+        EXPECT_EQ(expected.dihedrals[i].atom2, actual.dihedrals[i].atom2);
+        EXPECT_NEAR(expected.dihedrals[i].value, actual.dihedrals[i].value, .0001);
+        EXPECT_EQ(expected.dihedrals[i].variable, actual.dihedrals[i].variable);
+    }
+    ASSERT_EQ(expected.numOfHops, actual.numOfHops);
+    for (int i = 0; i < expected.numOfHops; i++)
+    {
+        EXPECT_EQ(expected.hops[i].atom1, actual.hops[i].atom1);
+        EXPECT_EQ(expected.hops[i].atom2, actual.hops[i].atom2);
+        EXPECT_EQ(expected.hops[i].hop, actual.hops[i].hop);
+    }
+}
+
+// The molecules of kind 0, kind 1, kind 0, numbered consecutively, so the
+// second molecule of kind 0 starts five atoms after the first.
+class StateFileTest : public ::testing::Test
+{
+    protected:
+        std::vector<Atom> atoms[3];
+        std::vector<Bond> bonds[3];
+        std::vector<Angle> angles[3];
+        std::vector<Dihedral> dihedrals[3];
+        std::vector<Hop> hops[3];
+        Molecule molecules[3];
+        Environment environment;
+
+        virtual void SetUp()
+        {
+            int kinds[3] = {0, 1, 0};
+            int first = 0;
+            for (int m = 0; m < 3; m++)
+            {
+                molecules[m] = buildMolecule(m, kinds[m], first, 2 * m, atoms[m], bonds[m], angles[m],
+                                             dihedrals[m], hops[m]);
+                first += molecules[m].numOfAtoms;
+            }
+
+            environment.x = 20;
+            environment.y = 20;
+            environment.z = 20;
+            environment.numOfMolecules = 3;
+            environment.numOfAtoms = first;
+            environment.temp = 298.15;
+            environment.cutoff = 9;
+            environment.maxTranslation = 0.15;
+            environment.maxRotation = 15;
+            environment.primaryAtomIndex = 0;
+            environment.randomseed = 12345;
+        }
+};
+
+TEST_F(StateFileTest, VersionTwoRoundTrip)
+{
+    std::string path = "stateFileTest.state";
+    StateScanner writer("");
+    writer.outputState(&environment, molecules, 3, 4000, path);
+
+    //the two molecules of kind 0 share one topology in the file
+    std::ifstream file(path.c_str());
+    std::string line;
+    std::getline(file, line);
+    EXPECT_EQ(std::string(STATE_FORMAT_MARKER " 2"), line);
+    int kindHeaders = 0;
+    while (std::getline(file, line))
+    {
+        if (line.compare(0, 7, "= Kind ") == 0)
+            kindHeaders++;
+    }
+    file.close();
+    EXPECT_EQ(2, kindHeaders);
+
+    StateScanner reader(path);
+    Environment *readEnvironment = reader.readInEnvironment();
+    ASSERT_TRUE(readEnvironment != NULL);
+    EXPECT_EQ(3, readEnvironment->numOfMolecules);
+    EXPECT_EQ(8, readEnvironment->numOfAtoms);
+    EXPECT_NEAR(20, readEnvironment->x, .0001);
+    EXPECT_EQ(4000, reader.readInStepNumber());
+
+    std::vector<Molecule> read = reader.readInMolecules();
+    ASSERT_EQ(3, read.size());
+    for (int m = 0; m < 3; m++)
+    {
+        expectSameMolecule(molecules[m], read[m], molecules[m].type);
+    }
+
+    delete readEnvironment;
+    std::remove(path.c_str());
+}
+
+TEST_F(StateFileTest, VersionOneFile)
+{
+    //the format written before kinds, which repeats every topology
+    std::string path = "stateFileTestV1.state";
+    std::ofstream file(path.c_str());
+    file << "20 20 20 3 8 298.15 9 0.15 15 0 12345" << std::endl;
+    file << 4000 << std::endl;
+    file << std::endl;
+    for (int m = 0; m < 3; m++)
+    {
+        Molecule &molecule = molecules[m];
+        file << molecule.id << std::endl;
+        file << "= Atoms" << std::endl;
+        for (int i = 0; i < molecule.numOfAtoms; i++)
+        {
+            Atom &atom = molecule.atoms[i];
+            file << atom.id << " " << atom.x << " " << atom.y << " " << atom.z << " "
+                << atom.sigma << " " << atom.epsilon << " " << atom.charge << std::endl;
+        }
+        file << "= Bonds" << std::endl;
+        for (int i = 0; i < molecule.numOfBonds; i++)
+        {
+            Bond &bond = molecule.bonds[i];
+            file << bond.atom1 << " " << bond.atom2 << " " << bond.distance << " "
+                << (bond.variable ? "1" : "0") << std::endl;
+        }
+        file << "= Dihedrals" << std::endl;
+        for (int i = 0; i < molecule.numOfDihedrals; i++)
+        {
+            Dihedral &dihedral = molecule.dihedrals[i];
+            file << dihedral.atom1 << " " << dihedral.atom2 << " " << dihedral.value << " "
+                << (dihedral.variable ? "1" : "0") << std::endl;
+        }
+        file << "= Hops" << std::endl;
+        for (int i = 0; i < molecule.numOfHops; i++)
+        {
+            Hop &hop = molecule.hops[i];
+            file << hop.atom1 << " " << hop.atom2 << " " << hop.hop << std::endl;
+        }
+        file << "= Angles" << std::endl;
+        for (int i = 0; i < molecule.numOfAngles; i++)
+        {
+            Angle &angle = molecule.angles[i];
+            file << angle.atom1 << " " << angle.atom2 << " " << angle.value << " "
+                << (angle.variable ? "1" : "0") << std::endl;
+        }
+        file << "==" << std::endl;
+    }
+    file.close();
+
+    StateScanner reader(path);
+    EXPECT_EQ(4000, reader.readInStepNumber());
+
+    //version 1 files do not record types, so molecules are given kinds in
+    //order of first appearance
+    std::vector<Molecule> read = reader.readInMolecules();
+    ASSERT_EQ(3, read.size());
+    expectSameMolecule(molecules[0], read[0], 0);
+    expectSameMolecule(molecules[1], read[1], 1);
+    expectSameMolecule(molecules[2], read[2], 0);
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,90 @@
+/*
+	Boxes of bundled molecules for the unit tests that check the energy
+	engines and spatial indexes against brute-force sums.
+*/
+
+#ifndef TESTBOXES_H
+#define TESTBOXES_H
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "Metropolis/SerialSim/SerialBox.h"
+#include "Metropolis/Utilities/FileUtilities.h"
+
+/// @return Returns the path of the MCGPU checkout the tests run in,
+///   ending in a slash.
+inline std::string mcgpuPath()
+{
+	std::string directory = get_current_dir_name();
+	std::size_t found = directory.find("MCGPU");
+	if (found != std::string::npos)
+	{
+		directory = directory.substr(0, found + 6);
+	}
+	return directory;
+}
+
+/// Fills a box with molecules of a bundled z-matrix on the FCC lattice,
+///   then moves every molecule by up to a given distance along each axis,
+///   so the pair distances are irregular.
+/// @param box The empty box to fill.
+/// @param zMatrixPath The z-matrix, relative to the checkout.
+/// @param moleculeCount The number of molecules.
+/// @param edge The edge of the cubic box.
+/// @param cutoff The cutoff of the box.
+/// @param jitter The largest move along each axis.
+/// @param seed The seed of the moves.
+/// @return Returns false if the box could not be built.
+inline bool buildTestBox(Box *box, const std::string &zMatrixPath, int moleculeCount, Real edge, Real cutoff,
+						 Real jitter, unsigned int seed)
+{
+	std::string MCGPU = mcgpuPath();
+	OplsScanner opls;
+	ZmatrixScanner scanner;
+	if (!opls.readInOpls(MCGPU + "resources/bossFiles/oplsaa.par") ||
+		!scanner.readInZmatrix(MCGPU + zMatrixPath, &opls))
+	{
+		return false;
+	}
+	std::vector<Molecule> molecules = scanner.buildMolecule(0);
+
+	Environment environment;
+	environment.x = edge;
+	environment.y = edge;
+	environment.z = edge;
+	environment.numOfMolecules = moleculeCount;
+	environment.cutoff = cutoff;
+	environment.temp = 298.15;
+	environment.maxTranslation = 0.15;
+	environment.maxRotation = 15;
+	environment.primaryAtomIndex = 0;
+	environment.randomseed = seed;
+
+	box->environment = new Environment(&environment);
+	if (!buildBoxData(&environment, molecules, box))
+	{
+		return false;
+	}
+	box->environment->numOfAtoms = environment.numOfAtoms;
+
+	for (int i = 0; i < box->moleculeCount; i++)
+	{
+		Real move[3];
+		for (int d = 0; d < 3; d++)
+		{
+			move[d] = jitter * (2.0 * rand_r(&seed) / RAND_MAX - 1.0);
+		}
+		Molecule &molecule = box->molecules[i];
+		for (int j = 0; j < molecule.numOfAtoms; j++)
+		{
+			molecule.atoms[j].x += move[0];
+			molecule.atoms[j].y += move[1];
+			molecule.atoms[j].z += move[2];
+		}
+	}
+	return true;
+}
+
+#endif
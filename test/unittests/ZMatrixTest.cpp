@@ -0,0 +1,269 @@
+#include "Metropolis/Utilities/FileUtilities.h"
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::string mcgpuDirectory()
+{
+    string directory = get_current_dir_name();
+    std::string mc ("MCGPU");
+    std::size_t found = directory.find(mc);
+
+    if (found != std::string::npos) {
+        directory = directory.substr(0,found+6);
+    }
+    return directory;
+}
+
+// Reads the next line of a reference file that is not a comment.
+static bool nextLine(std::ifstream &file, std::istringstream &fields)
+{
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] != '#')
+        {
+            fields.clear();
+            fields.str(line);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Builds the molecules of a bundled z-matrix and compares them with those
+// the previous parser built, stored in Integration/ZMatrixTest. The previous
+// parser placed the atoms of every molecule after the first of a
+// multi-molecule z-matrix at meaningless positions, so those are only
+// checked against their bond lengths.
+static void compareWithReference(const std::string &MCGPU, const std::string &zMatrixPath, const std::string &name)
+{
+    SCOPED_TRACE(zMatrixPath);
+
+    OplsScanner opls;
+    ASSERT_TRUE(opls.readInOpls(MCGPU + "resources/bossFiles/oplsaa.par"));
+    ZmatrixScanner scanner;
+    ASSERT_TRUE(scanner.readInZmatrix(MCGPU + zMatrixPath, &opls));
+    vector<Molecule> molecules = scanner.buildMolecule(0);
+
+    std::string referencePath = MCGPU + "test/unittests/Integration/ZMatrixTest/" + name + ".reference";
+    std::ifstream reference(referencePath.c_str());
+    ASSERT_TRUE(reference.is_open());
+
+    std::istringstream fields;
+    int moleculeCount = -1;
+    ASSERT_TRUE(nextLine(reference, fields));
+    fields >> moleculeCount;
+    ASSERT_EQ(moleculeCount, molecules.size());
+
+    std::map<unsigned long, Atom> atomsById;
+    for (int m = 0; m < moleculeCount; m++)
+    {
+        Molecule &molecule = molecules[m];
+        int id, atoms, bonds, angles, dihedrals, hops;
+        ASSERT_TRUE(nextLine(reference, fields));
+        fields >> id >> atoms >> bonds >> angles >> dihedrals >> hops;
+        EXPECT_EQ(id, molecule.id);
+        ASSERT_EQ(atoms, molecule.numOfAtoms);
+        ASSERT_EQ(bonds, molecule.numOfBonds);
+        ASSERT_EQ(angles, molecule.numOfAngles);
+        ASSERT_EQ(dihedrals, molecule.numOfDihedrals);
+        ASSERT_EQ(hops, molecule.numOfHops);
+
+        for (int i = 0; i < atoms; i++)
+        {
+            unsigned long atomId;
+            double x, y, z, sigma, epsilon, charge;
+            ASSERT_TRUE(nextLine(reference, fields));
+            fields >> atomId >> x >> y >> z >> sigma >> epsilon >> charge;
+            Atom &atom = molecule.atoms[i];
+            EXPECT_EQ(atomId, atom.id);
+            if (m == 0)
+            {
+                EXPECT_NEAR(x, atom.x, .0001);
+                EXPECT_NEAR(y, atom.y, .0001);
+                EXPECT_NEAR(z, atom.z, .0001);
+            }
+            EXPECT_NEAR(sigma, atom.sigma, .0001);
+            EXPECT_NEAR(epsilon, atom.epsilon, .0001);
+            EXPECT_NEAR(charge, atom.charge, .0001);
+            atomsById[atom.id] = atom;
+        }
+
+        for (int i = 0; i < bonds; i++)
+        {
+            int atom1, atom2, variable;
+            double distance;
+            ASSERT_TRUE(nextLine(reference, fields));
+            fields >> atom1 >> atom2 >> distance >> variable;
+            EXPECT_EQ(atom1, molecule.bonds[i].atom1);
+            EXPECT_EQ(atom2, molecule.bonds[i].atom2);
+            EXPECT_NEAR(distance, molecule.bonds[i].distance, .0001);
+            EXPECT_EQ(variable != 0, molecule.bonds[i].variable);
+        }
+
+        for (int i = 0; i < angles; i++)
+        {
+            int atom1, atom2, variable;
+            double value;
+            ASSERT_TRUE(nextLine(reference, fields));
+            fields >> atom1 >> atom2 >> value >> variable;
+            EXPECT_EQ(atom1, molecule.angles[i].atom1);
+            EXPECT_EQ(atom2, molecule.angles[i].atom2);
+            EXPECT_NEAR(value, molecule.angles[i].value, .0001);
+            EXPECT_EQ(variable != 0, molecule.angles[i].variable);
+        }
+
+        for (int i = 0; i < dihedrals; i++)
+        {
+            int atom1, atom2, variable;
+            double value;
+            ASSERT_TRUE(nextLine(reference, fields));
+            fields >> atom1 >> atom2 >> value >> variable;
+            EXPECT_EQ(atom1, molecule.dihedrals[i].atom1);
+            EXPECT_EQ(atom2, molecule.dihedrals[i].atom2);
+            EXPECT_NEAR(value, molecule.dihedrals[i].value, .0001);
+            EXPECT_EQ(variable != 0, molecule.dihedrals[i].variable);
+        }
+
+        for (int i = 0; i < hops; i++)
+        {
+            int atom1, atom2, hop;
+            ASSERT_TRUE(nextLine(reference, fields));
+            fields >> atom1 >> atom2 >> hop;
+            EXPECT_EQ(atom1, molecule.hops[i].atom1);
+            EXPECT_EQ(atom2, molecule.hops[i].atom2);
+            EXPECT_EQ(hop, molecule.hops[i].hop);
+        }
+    }
+
+    //bonds of later molecules may reach back into earlier ones
+    for (int m = 1; m < moleculeCount; m++)
+    {
+        for (int i = 0; i < molecules[m].numOfBonds; i++)
+        {
+            Bond &bond = molecules[m].bonds[i];
+            ASSERT_EQ(1, atomsById.count(bond.atom1));
+            ASSERT_EQ(1, atomsById.count(bond.atom2));
+            Atom &atom1 = atomsById[bond.atom1];
+            Atom &atom2 = atomsById[bond.atom2];
+            double length = sqrt(pow(atom1.x - atom2.x, 2) + pow(atom1.y - atom2.y, 2) + pow(atom1.z - atom2.z, 2));
+            EXPECT_NEAR(bond.distance, length, .0001);
+        }
+    }
+}
+
+// Descr: the in-place Z-matrix parser builds the same molecules as the
+//        stringstream parser it replaced, on every bundled z-matrix
+TEST(ZMatrixTest, MatchesPreviousParser)
+{
+    std::string MCGPU = mcgpuDirectory();
+
+    const char *bossFiles[] = {"adesucH", "mesh", "t3p", "t3pdim", "testZ", "watt3f", "watt4p"};
+    for (int i = 0; i < sizeof(bossFiles) / sizeof(bossFiles[0]); i++)
+    {
+        compareWithReference(MCGPU, std::string("resources/bossFiles/") + bossFiles[i] + ".z", bossFiles[i]);
+    }
+
+    const char *exampleFiles[] = {"indole", "meoh"};
+    for (int i = 0; i < sizeof(exampleFiles) / sizeof(exampleFiles[0]); i++)
+    {
+        compareWithReference(MCGPU, std::string("resources/exampleFiles/") + exampleFiles[i] + ".z", exampleFiles[i]);
+    }
+}
+
+// Descr: buildBoxData fills every copy of a z-matrix with more than one
+//        molecule, each with its own atoms and topology
+TEST(ZMatrixTest, BoxCopiesMultiMoleculeZMatrix)
+{
+    std::string MCGPU = mcgpuDirectory();
+
+    OplsScanner opls;
+    ASSERT_TRUE(opls.readInOpls(MCGPU + "resources/bossFiles/oplsaa.par"));
+    ZmatrixScanner scanner;
+    ASSERT_TRUE(scanner.readInZmatrix(MCGPU + "resources/bossFiles/t3pdim.z", &opls));
+    vector<Molecule> molecules = scanner.buildMolecule(0);
+    ASSERT_EQ(2, molecules.size());
+
+    Environment environment;
+    environment.x = 20;
+    environment.y = 20;
+    environment.z = 20;
+    environment.numOfMolecules = 8;
+    environment.cutoff = 9;
+    environment.temp = 298.15;
+
+    Box box;
+    box.environment = new Environment(&environment);
+    ASSERT_TRUE(buildBoxData(&environment, molecules, &box));
+
+    //four copies of the two molecules
+    int atoms = molecules[0].numOfAtoms + molecules[1].numOfAtoms;
+    int bonds = molecules[0].numOfBonds + molecules[1].numOfBonds;
+    int hops = molecules[0].numOfHops + molecules[1].numOfHops;
+    ASSERT_EQ(8, box.moleculeCount);
+    ASSERT_EQ(4 * atoms, box.atomCount);
+    ASSERT_EQ(4 * bonds, box.bondCount);
+
+    for (int i = 0; i < box.atomCount; i++)
+    {
+        EXPECT_EQ(i, box.atoms[i].id);
+    }
+
+    int firstAtom = 0;
+    for (int j = 0; j < box.moleculeCount; j++)
+    {
+        Molecule &molecule = box.molecules[j];
+        EXPECT_EQ(box.atoms + firstAtom, molecule.atoms);
+        firstAtom += molecule.numOfAtoms;
+    }
+
+    //copy m is the first copy moved by m * atoms
+    for (int m = 1; m < 4; m++)
+    {
+        for (int k = 0; k < bonds; k++)
+        {
+            EXPECT_EQ(box.bonds[k].atom1 + m * atoms, box.bonds[m * bonds + k].atom1);
+            EXPECT_EQ(box.bonds[k].atom2 + m * atoms, box.bonds[m * bonds + k].atom2);
+            EXPECT_NEAR(box.bonds[k].distance, box.bonds[m * bonds + k].distance, .0001);
+        }
+        for (int k = 0; k < hops; k++)
+        {
+            EXPECT_EQ(box.hops[k].atom1 + m * atoms, box.hops[m * hops + k].atom1);
+            EXPECT_EQ(box.hops[k].atom2 + m * atoms, box.hops[m * hops + k].atom2);
+        }
+    }
+}
+
+// Descr: a line that fills the line buffer is read, and a longer line
+//        fails the read instead of being cut short
+TEST(ZMatrixTest, OverlongLineIsRejected)
+{
+    std::string MCGPU = mcgpuDirectory();
+    OplsScanner opls;
+    ASSERT_TRUE(opls.readInOpls(MCGPU + "resources/bossFiles/oplsaa.par"));
+
+    std::ifstream source((MCGPU + "resources/exampleFiles/meoh.z").c_str());
+    std::stringstream contents;
+    contents << source.rdbuf();
+
+    std::string path = "zMatrixTestOverlong.z";
+    for (int extra = 0; extra < 2; extra++)
+    {
+        SCOPED_TRACE(extra);
+        std::ofstream file(path.c_str());
+        file << "#" << std::string(ZMATRIX_LINE_LENGTH - 2 + extra, '-') << std::endl;
+        file << contents.str();
+        file.close();
+
+        ZmatrixScanner scanner;
+        EXPECT_EQ(extra == 0, scanner.readInZmatrix(path, &opls));
+    }
+    std::remove(path.c_str());
+}